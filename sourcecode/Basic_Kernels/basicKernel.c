@@ -27,6 +27,7 @@
 #ifndef INCLHEADER
 #define INCLHEADER
 #include <stdio.h>
+#include <string.h>
 // #include <stdlib.h>
 #include <config.h>
 //#include <math.h>
@@ -54,6 +55,68 @@ __attribute__ ((section(".heapsram"))) data_t linear_H        [BUFFER_LIN_H_SIZE
 /** @brief buffer of size MAX_NR_TRANSACTIONS for collecting running DMA transactions*/
 __attribute__ ((section(".heapsram"))) int dma_trans_ids [MAX_NR_TRANSACTIONS];
 
+#if defined(WEIGHT_COMPRESSION) && defined(DMA)
+/** @brief L1 stage of the compressed FC weights of the next layer (expanded into the weight buffer by all cores)*/
+__attribute__ ((section(".heapsram"))) uint32_t weightStage [(WCOMP_STAGE_SIZE+3)/4];
+#endif
+
+#ifdef INFER_PIPELINE
+/** @brief L1 input stages of the pipelined inference queue (input k+1 arrives while inference k runs)*/
+__attribute__ ((section(".heapsram"))) data_t inferPipeIn [2][BUFFER_SIZE2];
+/** @brief second FM buffer of the pipelined inference queue (output k is written back during inference k+1)*/
+__attribute__ ((section(".heapsram"))) data_t inferPipeBuffer [BUFFER_SIZE];
+#endif
+
+#endif
+
+#if defined(PROFILING_NEW) && defined(PROFILING_LAYERS)
+/** @brief per-core ring buffers of the layer profiler (kept in L2 to not steal TCDM from the kernels)*/
+L2_DATA struct layer_profile layerProfile [NR_CORES];
+#endif
+
+#if defined(BARRIER_PROFILE) && defined(MULTICORE) && !defined(ASIP)
+/** @brief per-core ring buffers of the barrier profiler (L1, the timestamps are taken in every barrier)*/
+__attribute__ ((section(".heapsram"))) struct barrier_profile barrierProfile [NR_CORES_MAX];
+#endif
+
+#if defined(DMA_PROFILE) && defined(DMA) && defined(MULTICORE) && !defined(ASIP)
+/** @brief ring buffers of the DMA profiler (L2, only core 0 records the prefetches)*/
+L2_DATA struct dma_profile dmaProfile;
+#endif
+
+#ifdef AUTOTUNE
+/** @brief largest output FM tile of LinearLayer for the current layer per core (set per layer by inferNetwork)*/
+int linearMaxTile [NR_CORES_MAX] = {[0 ... NR_CORES_MAX-1] = OUTPUTBUFFER};
+#endif
+
+#ifdef AUTOTUNE
+/** @brief tuning table, pre-filled with the offline results of scripts/autotune.py (tuning.h)*/
+L2_DATA struct tuning_entry tuningTable [TUNING_TABLE_SIZE] = {
+#if __has_include("tuning.h")
+#include "tuning.h"
+#endif
+};
+/** @brief tile chosen by core 0 during tuning, read by all cores after the barrier*/
+L2_DATA int tuneBest;
+#endif
+
+#ifdef DEADLINE_SCHEDULER
+/** @brief cycle models of the kernels, calibrated by scripts/wcet.py (wcet.h), then the built-in defaults
+ *
+ *  The defaults are conservative estimates of the Xpulp kernels (OUTPUTBUFFER 8) on any number of cores.
+ */
+L2_DATA struct wcet_entry wcetTable [WCET_TABLE_SIZE] = {
+#if __has_include("wcet.h")
+#include "wcet.h"
+#endif
+    // {type, cores, fixed, perRow, perMac},
+    {LINEAR,  0,  400, 24,  160},
+    {RNN,     0,  800, 40,  160},
+    {LSTM,    0, 1200, 48,  160},
+    {SOFTMAX, 0,  600, 40,    0},
+    {ARGMAX,  0,  300,  6,    0},
+    {TOPK,    0,  400,  6, 1536},
+};
 #endif
 
 
@@ -82,7 +145,12 @@ void startPerf () {
     {
 #endif // TIMER
     numFunctionCalls++;
+#ifdef PROFILING_LAYERS
+    // counters run freely during the whole inference, measure the delta instead
+    perf[rt_core_id()].perf_start = cpu_perf_get(perf[rt_core_id()].perf_counter_id);
+#else
     perf_reset();
+#endif
     perf_enable_id(perf[rt_core_id()].perf_counter_id); // start correct counter
     // perf_start(); // starts all counters, but should only start one
 #ifdef TIMER
@@ -112,8 +180,14 @@ void endPerf () {
     {
 #endif // TIMER
 
+#ifdef PROFILING_LAYERS
+    int value = cpu_perf_get(perf[rt_core_id()].perf_counter_id) - perf[rt_core_id()].perf_start;
+    layerProfileRecord(LAYER_PROFILE_KERNEL, value);
+#else
     perf_stop();
-    perf[rt_core_id()].perf_counters[perf[rt_core_id()].perf_counter_id] += cpu_perf_get(perf[rt_core_id()].perf_counter_id);
+    int value = cpu_perf_get(perf[rt_core_id()].perf_counter_id);
+#endif
+    perf[rt_core_id()].perf_counters[perf[rt_core_id()].perf_counter_id] += value;
 
 #ifdef TIMER
     }
@@ -164,869 +238,3233 @@ void endTimer () {
 #endif // TIMER
 }
 
-#endif // ifndef ASIP
-
-
 
+#if (defined(PROFILING_NEW) && defined(PROFILING_LAYERS)) || (defined(BARRIER_PROFILE) && defined(MULTICORE) && !defined(ASIP)) || \
+    (defined(DMA_PROFILE) && defined(DMA) && defined(MULTICORE) && !defined(ASIP))
+/** @brief Names of the layer types as printed by layerProfileDump(), barrierProfileDump() and dmaProfileDump() */
+static const char * layerProfileTypeNames[] = {"LINEAR", "RNN", "LSTM", "Conv2d", "SOFTMAX", "ARGMAX", "TOPK"};
+#endif
 
-/** @brief Runs a neural network
+#if defined(PROFILING_NEW) && defined(PROFILING_LAYERS)
+
+/** @brief Names of the performance counters as printed by layerProfileDump() */
+static const char * layerProfileEventNames[CSR_PCER_NB_EVENTS] = {
+    [CSR_PCER_CYCLES]       = "cycles",
+    [CSR_PCER_INSTR]        = "instructions",
+    [CSR_PCER_LD_STALL]     = "load_stalls",
+    [CSR_PCER_JMP_STALL]    = "jump_stalls",
+    [CSR_PCER_IMISS]        = "icache_misses",
+    [CSR_PCER_LD]           = "loads",
+    [CSR_PCER_ST]           = "stores",
+    [CSR_PCER_JUMP]         = "jumps",
+    [CSR_PCER_BRANCH]       = "branches",
+    [CSR_PCER_TAKEN_BRANCH] = "branches_taken",
+    [CSR_PCER_RVC]          = "compressed_instructions",
+    [CSR_PCER_LD_EXT]       = "ext_loads",
+    [CSR_PCER_ST_EXT]       = "ext_stores",
+    [CSR_PCER_LD_EXT_CYC]   = "ext_load_cycles",
+    [CSR_PCER_ST_EXT_CYC]   = "ext_store_cycles",
+    [CSR_PCER_TCDM_CONT]    = "tcdm_contention",
+};
+
+
+/** @brief Appends one measurement of the current layer to the ring buffer of the calling core
  *
- *  Iterates through all the layers while passing the intermediate FM with a double 
- *  buffering approach
+ *  The counted event is the one selected in perf[].perf_counter_id, i.e. the profiling loop in
+ *  testKernel.c multiplexes all events over repeated inference runs. Runs measuring the TIMER
+ *  are not recorded.
  *
- *  @param network Array of concecutive layers of the current neural network
- *  @param depth Number of Layers (aka array size)
- *  @param inFeatures Input Feature Map
- *  @param buffer Buffer to store intermediate results
- *  @return Output Feature Map
+ *  @param type Layer type (enum layerType) or LAYER_PROFILE_KERNEL
+ *  @param value Counter delta
  */
-data_t * NOINLINE inferNetwork(
-    struct layer * network,
-    int depth,
-    data_t * __restrict__ inFeatures,
-    data_t * __restrict__ buffer)
-{
-    // printf("delete, just for test1, core: %d \n", rt_core_id());
-
-  data_t * in;
+void layerProfileRecord (int type, int value) {
+    int core_id = rt_core_id();
+    struct layer_profile * prof = &layerProfile[core_id];
+
+    if(perf[core_id].perf_counter_id >= CSR_PCER_NB_EVENTS)
+      return;
+
+    struct layer_profile_record * rec = &prof->records[prof->head % LAYER_PROFILE_RECORDS];
+    rec->run   = prof->run;
+    rec->layer = prof->layer;
+    rec->type  = type;
+    rec->event = perf[core_id].perf_counter_id;
+    rec->value = value;
+    prof->head++;
+}
 
-  int core_id = rt_core_id();
 
-#ifdef MULTICORE
-  in  = &buffer[0];
-#else
-  in  = inFeatures;
-#endif
+/** @brief Clears the ring buffer of the calling core (e.g. to drop the ICACHE warm-up runs)
+ */
+void layerProfileReset () {
+    layerProfile[rt_core_id()].head = 0;
+    layerProfile[rt_core_id()].run  = 0;
+}
 
-  data_t * out = &buffer[BUFFER_SIZE2];
-  _Bool first_layer = True;
 
-#ifdef MULTICORE
-  data_t * W1;
-  data_t * B1;
-  data_t * W1_next;
-  data_t * B1_next;
+/** @brief Marks the start of a layer in the layer profiler
+ *
+ *  @param layer Index of the layer in the network (layer 0 starts a new inference run)
+ */
+void layerProfileStart (int layer) {
+    int core_id = rt_core_id();
+
+    if(layer==0)
+      layerProfile[core_id].run++;
+    layerProfile[core_id].layer = layer;
+    if(perf[core_id].perf_counter_id < CSR_PCER_NB_EVENTS)
+      layerProfile[core_id].layer_start = cpu_perf_get(perf[core_id].perf_counter_id);
+}
 
-  W1 = &linear_Weights[0];
-  B1 = &linear_Bias[0];
-  W1_next = &linear_Weights[BUFFER_LIN_W1_SIZE2];
-  B1_next = &linear_Bias[BUFFER_LIN_B1_SIZE2];
 
-  data_t * W2;
-  data_t * B2;
+/** @brief Marks the end of the current layer and records its counter delta
+ *
+ *  @param type Layer type (enum layerType)
+ */
+void layerProfileEnd (int type) {
+    int core_id = rt_core_id();
 
-  data_t * W2_next;
-  data_t * B2_next;
+    if(perf[core_id].perf_counter_id < CSR_PCER_NB_EVENTS)
+      layerProfileRecord(type, cpu_perf_get(perf[core_id].perf_counter_id) - layerProfile[core_id].layer_start);
+}
 
-  W2 = &linear_Weights2[0];
-  B2 = &linear_Bias2[0];
 
-  W2_next = &linear_Weights2[BUFFER_LIN_W2_SIZE2];
-  B2_next = &linear_Bias2[BUFFER_LIN_B2_SIZE2];
-#endif
+/** @brief Prints the ring buffers of all cores as CSV (one line per record, prefixed with LAYPROF)
+ *
+ *  Has to be called by a single core after all cores finished. scripts/profile_layers.py collects
+ *  the lines and converts them to CSV and JSON reports.
+ */
+void layerProfileDump () {
+    printf("LAYPROF,core,run,layer,type,event,value\n");
+    for(int c=0; c<NR_CORES; c++)
+    {
+      struct layer_profile * prof = &layerProfile[c];
+      int first = 0;
 
-#ifdef TIMER
-  timer_cl = 0;
-#endif
+      if(prof->head > LAYER_PROFILE_RECORDS)
+      {
+        first = prof->head - LAYER_PROFILE_RECORDS;
+        printf("\033[91mWARNING - layer profiler of core %d dropped %d records, increase LAYER_PROFILE_RECORDS!!!\033[0m\n", c, first);
+      }
 
-/*****************************************************************************
- *
- * Copy Input data (to be copied once)
- *
- *****************************************************************************/
+      for(int r=first; r<prof->head; r++)
+      {
+        struct layer_profile_record * rec = &prof->records[r % LAYER_PROFILE_RECORDS];
+        const char * event = layerProfileEventNames[rec->event];
 
-#ifdef MULTICORE
+        printf("LAYPROF,%d,%d,%d,%s,", c, rec->run, rec->layer,
+               rec->type == LAYER_PROFILE_KERNEL ? CODE_SEGMENT : layerProfileTypeNames[rec->type]);
+        if(event)
+          printf("%s,%d\n", event, rec->value);
+        else
+          printf("event%d,%d\n", rec->event, rec->value);
+      }
+    }
+}
 
-  struct layer lay = network[0];
-  unsigned short act_size;
+#endif // PROFILING_NEW && PROFILING_LAYERS
 
-  if (core_id==0)
-  {
+#if defined(BARRIER_PROFILE) && defined(MULTICORE) && !defined(ASIP)
 
-    if(lay.type == LINEAR)
-    {
-      act_size = (unsigned short) 2*lay.attributes[LAY_LIN_IN];
-    }
-    else if(lay.type == LSTM)
-    {
-      act_size = (unsigned short) 2*lay.attributes[LAY_LSTM_IN];
-    }
-    else
-    {
-      printf("\033[91mERROR - only Lin Layer or LSTM are supported!!!\033[0m\n");
-    }
- 
-#ifdef DMA
-#ifdef BATCHING
-    for(int b=0; b<BATCHING; b++)
+/** @brief Clears the ring buffers of all cores and starts the timer of the timestamps
+ *
+ *  Has to be called by a single core before the cores enter inferNetwork.
+ */
+void barrierProfileReset () {
+    for(int c=0; c<NR_CORES_MAX; c++)
     {
-      // printf("batching b %d %d %d\n", b, b*act_size/4, (((v2s*)in+b*act_size)));
-      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)inFeatures)), (uint32_t) (((v2s*)in+b*act_size/4)), act_size,  1));
+      barrierProfile[c].head  = 0;
+      barrierProfile[c].run   = 0;
+      barrierProfile[c].layer = -1;
     }
-    // printf("input in: ");
-    // PrintTensor(BATCHING*lay.attributes[LAY_LIN_IN], in);
-#else
-    plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)inFeatures)), (uint32_t) (((v2s*)in)), act_size,  1));
-#endif
-#else // no DMA
+    timer_reset(timer_base_cl(0, 0, 0));
+    timer_start(timer_base_cl(0, 0, 0));
+}
 
-    for(int j = 0; j < act_size/2; j++)
-    {
-      in[j] = inFeatures[j];
-    }
 
- #endif // DMA
+/** @brief Marks the start of a layer, the first segment of the layer starts now
+ *
+ *  @param layer Index of the layer in the network (layer 0 starts a new inference run)
+ *  @param type Layer type (enum layerType)
+ *  @param inSize Input neurons (or tensor size) of the layer
+ *  @param outSize Output or hidden neurons of the layer
+ */
+void barrierProfileStart (int layer, int type, int inSize, int outSize) {
+    struct barrier_profile * prof = &barrierProfile[CLUSTER_CORE_ID()];
+
+    if(layer==0)
+      prof->run++;
+    prof->layer   = layer;
+    prof->type    = type;
+    prof->inSize  = inSize;
+    prof->outSize = outSize;
+    prof->segment = 0;
+    prof->entry   = BARRIER_PROFILE_TIME();
+}
 
 
+/** @brief Marks the end of the current layer, later barriers are not recorded
+ */
+void barrierProfileEnd () {
+    barrierProfile[CLUSTER_CORE_ID()].layer = -1;
+}
 
-/*****************************************************************************
- *
- * Copy Weight Data of first layer
+
+/** @brief Records the segment which ends with the barrier and starts the next segment
  *
- *****************************************************************************/
+ *  @param arrive Timestamp of the arrival at the barrier (end of the computation of the core)
+ *  @param exit Timestamp of the exit of the barrier (the slowest core arrived)
+ */
+void barrierProfileRecord (unsigned int arrive, unsigned int exit) {
+    struct barrier_profile * prof = &barrierProfile[CLUSTER_CORE_ID()];
+
+    if(prof->layer < 0)
+      return;
+
+    struct barrier_record * rec = &prof->records[prof->head % BARRIER_PROFILE_RECORDS];
+    rec->run     = prof->run;
+    rec->layer   = prof->layer;
+    rec->type    = prof->type;
+    rec->segment = prof->segment++;
+    rec->inSize  = prof->inSize;
+    rec->outSize = prof->outSize;
+    rec->entry   = prof->entry;
+    rec->arrive  = arrive;
+    rec->exit    = exit;
+    prof->head++;
+    prof->entry = exit;
+}
 
-    // printf("INFO - copy weigt data of first layer!!! \n");
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    // LINEAR LAYER
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    if(lay.type == LINEAR)
+
+/** @brief Prints the ring buffers of all cores as CSV (one line per record, prefixed with BARPROF)
+ *
+ *  Has to be called by a single core after all cores finished. scripts/barrier_profile.py collects
+ *  the lines and reports the load imbalance and barrier waits per layer and shape.
+ */
+void barrierProfileDump () {
+    printf("BARPROF,core,run,layer,type,in,out,segment,entry,arrive,exit\n");
+    for(int c=0; c<NR_CORES_MAX; c++)
     {
-      act_size = (unsigned short) 2*lay.attributes[LAY_LIN_IN];
-    
-  #ifdef DMA
-      unsigned short b_size = lay.attributes[LAY_LIN_OUT]*2;
-      unsigned w_size = (b_size)*(act_size);
+      struct barrier_profile * prof = &barrierProfile[c];
+      int first = 0;
 
-      // copy BIAS
-      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LAY_LIN_BIAS]))), (uint32_t) (((v2s*)B1)), b_size, 1));
+      if(prof->head > BARRIER_PROFILE_RECORDS)
+      {
+        first = prof->head - BARRIER_PROFILE_RECORDS;
+        printf("\033[91mWARNING - barrier profiler of core %d dropped %d records, increase BARRIER_PROFILE_RECORDS!!!\033[0m\n", c, first);
+      }
 
-      if (w_size >= 65532)
+      for(int r=first; r<prof->head; r++)
       {
-        // printf("\033[91mWARNING - DATA too big for DMA!!!\033[0m\n");
-        // printf("dma weight size: %d %d %d %x \n", w_size, b_size, act_size, (uint32_t) ((v2s*)W1));
-        int nr_dma_tiles                          = w_size / 65532;
-        int dima_tiles_overflow                   = w_size % 65532;
-        if (dima_tiles_overflow!=0) nr_dma_tiles +=1;
+        struct barrier_record * rec = &prof->records[r % BARRIER_PROFILE_RECORDS];
+        printf("BARPROF,%d,%d,%d,%s,%d,%d,%d,%u,%u,%u\n", c, rec->run, rec->layer,
+               layerProfileTypeNames[rec->type], rec->inSize, rec->outSize, rec->segment, rec->entry,
+               rec->arrive, rec->exit);
+      }
+    }
+}
 
-        unsigned short curr_w_size = 0;
-        int curr_w_idx = 0;
-        int curr_w_idx_local = 0;
+#endif // BARRIER_PROFILE
 
-        // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+#if defined(DMA_PROFILE) && defined(DMA) && defined(MULTICORE) && !defined(ASIP)
 
-        for(int d=0; d<nr_dma_tiles; d++)
-        {
-          if(d==nr_dma_tiles-1)
-          {
-            curr_w_size = dima_tiles_overflow;
-            curr_w_idx = (d*65532)/2;
-            curr_w_idx_local = (curr_w_idx+1)/2;
-          }
-          else
-          {
-            curr_w_size = 65532;
-            curr_w_idx = (d*65532)/2;
-            curr_w_idx_local = ((curr_w_idx+1)/2);
-          }
+/** @brief Clears the ring buffers and starts the timer of the timestamps
+ *
+ *  Has to be called by a single core before the cores enter inferNetwork.
+ */
+void dmaProfileReset () {
+    dmaProfile.xferHead   = 0;
+    dmaProfile.windowHead = 0;
+    dmaProfile.run        = 0;
+    dmaProfile.first      = 0;
+    timer_reset(timer_base_cl(0, 0, 0));
+    timer_start(timer_base_cl(0, 0, 0));
+}
 
-          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LAY_LIN_WEIGHTS]+curr_w_idx))), (uint32_t) (((v2s*)W1+curr_w_idx_local)), curr_w_size,  1));
 
-        }
-      }
-      else
-      {
-        plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LAY_LIN_WEIGHTS]))), (uint32_t) (((v2s*)W1)), w_size,  1));
-      }
+/** @brief Opens the compute window of a layer (core 0, before the prefetches of the next layer are issued)
+ *
+ *  @param layer Index of the layer in the network (layer 0 starts a new inference run)
+ *  @param type Layer type (enum layerType)
+ *  @param nextType Layer type of the next layer, whose parameters are prefetched
+ */
+void dmaProfileStart (int layer, int type, int nextType) {
+    struct dma_profile_window * win = &dmaProfile.current;
+
+    if(layer==0)
+      dmaProfile.run++;
+    dmaProfile.first = dmaProfile.xferHead;
+    win->run      = dmaProfile.run;
+    win->layer    = layer;
+    win->type     = type;
+    win->nextType = nextType;
+    win->xfers    = 0;
+    win->bytes    = 0;
+    win->start    = DMA_PROFILE_TIME();
+}
 
-  #else // no DMA
 
-      for(int m = 0; m < lay.attributes[LAY_LIN_OUT]; m++)
-      {
-        B1[m] = lay.parameters[LAY_LIN_BIAS][m];
-        for(int n = 0; n < lay.attributes[LAY_LIN_IN] + W_OFFSET; n++) //+2
-        {
-          W1[m*(lay.attributes[LAY_LIN_IN]+W_OFFSET)+n] = lay.parameters[LAY_LIN_WEIGHTS][m*(lay.attributes[LAY_LIN_IN])+n];
-        }
-      }
+/** @brief Issues a prefetch with plp_dma_memcpy and records its issue time and size (core 0)
+ *
+ *  @return Transaction id of plp_dma_memcpy
+ */
+int dmaProfileIssue (uint32_t ext, uint32_t loc, unsigned int size, int ext2loc) {
+    struct dma_profile_xfer * xfer = &dmaProfile.xfers[dmaProfile.xferHead % DMA_PROFILE_XFERS];
+
+    xfer->issue = DMA_PROFILE_TIME();
+    xfer->run   = dmaProfile.current.run;
+    xfer->layer = dmaProfile.current.layer;
+    xfer->index = dmaProfile.current.xfers++;
+    xfer->size  = size;
+    xfer->done  = xfer->issue;
+    dmaProfile.current.bytes += size;
+    dmaProfile.xferHead++;
+    return plp_dma_memcpy(ext, loc, size, ext2loc);
+}
 
-  #endif //  DMA
 
-    }
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    // LSTM
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    else if(lay.type == LSTM)
+/** @brief Closes the compute window of the layer and waits for its prefetches one by one (all cores)
+ *
+ *  The barrier separates the computation of all cores from the DMA wait, i.e. the compute end is the
+ *  arrival of the slowest core. Core 0 then waits for every transaction of the layer in issue order,
+ *  the return of plp_dma_wait is the (observed) completion of the transaction. Transactions which
+ *  completed during the computation return immediately, i.e. their completion is only bounded by the
+ *  compute end. The profiled build has one barrier more per layer than the normal build.
+ *
+ *  @param nrTransactions Number of prefetches issued in the layer (dma_idx of core 0)
+ */
+void dmaProfileWait (int nrTransactions) {
+    synch_barrier();
+    if(rt_core_id()!=0)
+      return;
+
+    struct dma_profile_window * win = &dmaProfile.current;
+    win->computeEnd = DMA_PROFILE_TIME();
+    for(int t=0; t<nrTransactions; t++)
     {
-        act_size = (unsigned short) 2*lay.attributes[LAY_LSTM_IN];
+      plp_dma_wait(dma_trans_ids[t]);
+      int r = dmaProfile.first + t;
+      if(r >= dmaProfile.xferHead - DMA_PROFILE_XFERS)
+        dmaProfile.xfers[r % DMA_PROFILE_XFERS].done = DMA_PROFILE_TIME();
+    }
+    win->waitEnd = DMA_PROFILE_TIME();
+    dmaProfile.windows[dmaProfile.windowHead % DMA_PROFILE_WINDOWS] = *win;
+    dmaProfile.windowHead++;
+}
 
-#ifdef DMA
-          unsigned short hidden_4_size = 2*lay.attributes[LAY_LSTM_HID];
-          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay.parameters[LSTM_H])), (uint32_t) (((v2s*)linear_H)), hidden_4_size,  1));
-          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay.parameters[LSTM_C])), (uint32_t) (((v2s*)linear_C)), hidden_4_size,  1));
-#else // DMA
-          for(int j = 0; j < lay.attributes[LAY_LSTM_HID]; j++)
-          {
-            linear_H[j] = lay.parameters[LSTM_H][j];
-            linear_C[j] = lay.parameters[LSTM_C][j];
-          }
-#endif // DMA
 
-  #ifdef DMA
-      unsigned short b_size = 2*4*lay.attributes[LAY_LSTM_HID];
-      unsigned w_size = (b_size)*(act_size);
-      unsigned w2_size = (b_size)*2*lay.attributes[LAY_LSTM_HID];
+/** @brief Prints the compute windows (DMAWIN) and the transactions (DMAXFER) as CSV (prefixed with DMAPROF)
+ *
+ *  Has to be called by a single core after all cores finished. scripts/dma_profile.py collects the
+ *  lines and reports the exposed DMA latency per layer, the achieved bandwidth and the bandwidth-bound layers.
+ */
+void dmaProfileDump () {
+    int first = 0;
 
-      // copy BIASES
-      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_BIAS_IH]))), (uint32_t) (((v2s*)B1)), b_size, 1));
-      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_BIAS_HH]))), (uint32_t) (((v2s*)B2)), b_size, 1));
+    if(dmaProfile.windowHead > DMA_PROFILE_WINDOWS || dmaProfile.xferHead > DMA_PROFILE_XFERS)
+      printf("\033[91mWARNING - DMA profiler dropped records, increase DMA_PROFILE_WINDOWS or DMA_PROFILE_XFERS!!!\033[0m\n");
 
+    printf("DMAPROF,window,run,layer,type,next,xfers,bytes,start,computeEnd,waitEnd\n");
+    if(dmaProfile.windowHead > DMA_PROFILE_WINDOWS)
+      first = dmaProfile.windowHead - DMA_PROFILE_WINDOWS;
+    for(int r=first; r<dmaProfile.windowHead; r++)
+    {
+      struct dma_profile_window * win = &dmaProfile.windows[r % DMA_PROFILE_WINDOWS];
+      printf("DMAPROF,window,%d,%d,%s,%s,%d,%u,%u,%u,%u\n", win->run, win->layer, layerProfileTypeNames[win->type],
+             layerProfileTypeNames[win->nextType], win->xfers, win->bytes, win->start, win->computeEnd, win->waitEnd);
+    }
 
-      // printf("size %u \n", w_size);
-      // Copy W1
-      if (w_size < 65532)
-      {
+    printf("DMAPROF,xfer,run,layer,index,size,issue,done\n");
+    first = 0;
+    if(dmaProfile.xferHead > DMA_PROFILE_XFERS)
+      first = dmaProfile.xferHead - DMA_PROFILE_XFERS;
+    for(int r=first; r<dmaProfile.xferHead; r++)
+    {
+      struct dma_profile_xfer * xfer = &dmaProfile.xfers[r % DMA_PROFILE_XFERS];
+      printf("DMAPROF,xfer,%d,%d,%d,%u,%u,%u\n", xfer->run, xfer->layer, xfer->index, xfer->size, xfer->issue,
+             xfer->done);
+    }
+}
 
-        plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_IH]))), (uint32_t) (((v2s*)W1)), w_size, 1)); //b_size*2*lay.attributes[LAY_LSTM_HID],  1));
-      }
-      else
-      {
+#endif // DMA_PROFILE
 
-        int nr_dma_tiles           = w_size / 65532;
-        int dima_tiles_overflow    = w_size % 65532;
-        if (dima_tiles_overflow!=0) nr_dma_tiles+=1;
-        unsigned short curr_w_size = 0;
-        int curr_w_idx = 0;
-        int curr_w_idx_local = 0;
+#ifdef AUTOTUNE
+/** @brief Starts the timer used to measure the tile candidates */
+static void tuneTimerStart () {
+#ifdef MULTICORE
+    timer_reset(timer_base_cl(0, 0, 1));
+    timer_start(timer_base_cl(0, 0, 1));
+#else
+    timer_reset(timer_base_fc(0, 1));
+    timer_start(timer_base_fc(0, 1));
+#endif // MULTICORE
+}
 
-        // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+/** @brief Stops the tuning timer
+ *  @return elapsed time since tuneTimerStart()
+ */
+static unsigned int tuneTimerStop () {
+    unsigned int time;
+#ifdef MULTICORE
+    time = timer_count_get(timer_base_cl(0, 0, 1));
+    timer_conf_set(timer_base_cl(0, 0, 1), 0);
+#else
+    time = timer_count_get(timer_base_fc(0, 1));
+    timer_conf_set(timer_base_fc(0, 1), 0);
+#endif // MULTICORE
+    return time;
+}
 
-        for(int d=0; d<nr_dma_tiles; d++)
+/** @brief Looks up the tuned output FM tile of a FC Layer (for the current number of cores and batch size)
+ *
+ *  @param inFeaturesSize Number of input neurons
+ *  @param outFeaturesSize Number of output neurons
+ *  @return tuning table entry or NULL if the layer shape has not been tuned yet
+ */
+struct tuning_entry * tuneLookup (int inFeaturesSize, int outFeaturesSize) {
+    for(int t=0; t<TUNING_TABLE_SIZE && tuningTable[t].in != 0; t++)
+    {
+      if(tuningTable[t].in == inFeaturesSize && tuningTable[t].out == outFeaturesSize &&
+         tuningTable[t].cores == NR_CORES && tuningTable[t].batch == TUNING_BATCH)
+        return &tuningTable[t];
+    }
+    return NULL;
+}
+
+/** @brief Returns the largest output FM tile for a FC Layer, tunes it at first load
+ *
+ *  If the layer shape is not in the tuning table, the layer is executed once for every tile
+ *  option of LinearLayer (OUTPUTBUFFER, 8, 4, 2, 1) and the fastest one is added to the table.
+ *  Has to be called by all cores (the candidates are separated by barriers).
+ *
+ *  @param lay FC Layer
+ *  @param weight Weights of the layer (local copy in MULTICORE mode)
+ *  @param bias Bias of the layer (local copy in MULTICORE mode)
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map (overwritten by the candidates)
+ *  @return largest output FM tile to be used by LinearLayer
+ */
+int tuneLinearLayer (struct layer * lay, data_t * weight, data_t * bias, data_t * inFeatures, data_t * outFeatures) {
+    int core_id = rt_core_id();
+    int tileOptions[] = {OUTPUTBUFFER, 8, 4, 2, 1};
+    struct tuning_entry * entry = tuneLookup(lay->attributes[LAY_LIN_IN], lay->attributes[LAY_LIN_OUT]);
+    unsigned int bestTime = ~0u;
+
+    if(entry)
+      return entry->maxTile;
+
+    tuneBest = OUTPUTBUFFER;
+    for(unsigned int i=0; i<sizeof(tileOptions)/sizeof(int); i++)
+    {
+      // larger tiles than the layer fall back to the next smaller option anyway
+      if(tileOptions[i] > OUTPUTBUFFER || (tileOptions[i] > lay->attributes[LAY_LIN_OUT] && tileOptions[i] > 1))
+        continue;
+      if(i>0 && tileOptions[i] == tileOptions[i-1])
+        continue;
+      LINEAR_MAX_TILE = tileOptions[i];
+
+      synch_barrier();
+      if(core_id == 0)
+        tuneTimerStart();
+#ifdef MULTICORE
+      if ( core_id<lay->attributes[LAY_LIN_TILES] )
+#endif
+      LinearLayer(lay->attributes[LAY_LIN_IN],
+                  lay->attributes[LAY_LIN_OUT],
+  #ifdef EFFICIENT_CORE_ASSIGNMENT
+                  lay->attributes[LAY_LIN_TILE_SIZE],
+  #endif
+                  True,
+  #if defined(BATCHING) && defined(MULTICORE)
+                  BATCHING,
+  #endif
+                  weight,
+                  bias,
+                  inFeatures,
+                  outFeatures);
+      synch_barrier();
+      if(core_id == 0)
+      {
+        unsigned int time = tuneTimerStop();
+        if(time < bestTime)
         {
-          if(d==nr_dma_tiles-1)
-          {
-            curr_w_size = dima_tiles_overflow;
-            curr_w_idx = (d*65532)/2;
-            curr_w_idx_local = (curr_w_idx+1)/2;
-          }
-          else
-          {
-            curr_w_size = 65532;
-            curr_w_idx = (d*65532)/2;
-            curr_w_idx_local = ((curr_w_idx+1)/2);
-          }
-          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_IH]+curr_w_idx))), (uint32_t) (((v2s*)W1+curr_w_idx_local)), curr_w_size,  1));
+          bestTime = time;
+          tuneBest = tileOptions[i];
         }
       }
-      
+    }
 
-      // Copy W2
-      if (w2_size < 65532)
+    if(core_id == 0)
+    {
+      int t = 0;
+      while(t<TUNING_TABLE_SIZE && tuningTable[t].in != 0)
+        t++;
+      if(t<TUNING_TABLE_SIZE)
       {
-        plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_HH]))), (uint32_t) (((v2s*)W2)), w2_size, 1)); //b_size*2*lay.attributes[LAY_LSTM_HID],  1));
+        tuningTable[t].out     = lay->attributes[LAY_LIN_OUT];
+        tuningTable[t].cores   = NR_CORES;
+        tuningTable[t].batch   = TUNING_BATCH;
+        tuningTable[t].maxTile = tuneBest;
+        tuningTable[t].in      = lay->attributes[LAY_LIN_IN];
       }
       else
-      {
-        // printf("\033[91mWARNING - LSTM W2 DATA too big for DMA!!!\033[0m\n");
+        printf("\033[91mERROR - tuning table full, increase TUNING_TABLE_SIZE!!!\033[0m\n");
+    }
+    synch_barrier();
+    return tuneBest;
+}
 
-        int nr_dma_tiles           = w2_size / 65532;
-        int dima_tiles_overflow    = w2_size % 65532;
-        if (dima_tiles_overflow!=0) nr_dma_tiles+=1;
-        unsigned short curr_w_size = 0;
-        int curr_w_idx = 0;
-        int curr_w_idx_local = 0;
+/** @brief Prints the tuning table in the format of tuning.h (collected by scripts/autotune.py) */
+void tuneDump () {
+    for(int t=0; t<TUNING_TABLE_SIZE && tuningTable[t].in != 0; t++)
+      printf("TUNE {%d, %d, %d, %d, %d},\n", tuningTable[t].in, tuningTable[t].out,
+             tuningTable[t].cores, tuningTable[t].batch, tuningTable[t].maxTile);
+}
+#endif // AUTOTUNE
 
-        // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+/** @brief Checks if a model container header matches this build
+ *
+ *  @param header Container header
+ *  @param maxDepth Maximum number of layers
+ *  @return 0 or -1 if the container does not match the build
+ */
+static int checkModelContainer (struct model_container_header * header, int maxDepth) {
+    if(memcmp(header->magic, MODEL_CONTAINER_MAGIC, 4) != 0 || header->version != MODEL_CONTAINER_VERSION)
+    {
+      printf("\033[91mERROR - no model container or unsupported version!!!\033[0m\n");
+      return -1;
+    }
+    if(header->q_fraction != q_frac || header->depth > (unsigned int)maxDepth)
+    {
+      printf("\033[91mERROR - container with Q%d.%d and %u layers does not fit this build!!!\033[0m\n",
+             header->q_integer, header->q_fraction, (unsigned int)header->depth);
+      return -1;
+    }
+#ifdef WEIGHT_PACKING
+    if(!(header->flags & MODEL_CONTAINER_PACKED) || header->pack_tile != OUTPUTBUFFER)
+#else
+    if(header->flags & MODEL_CONTAINER_PACKED)
+#endif
+    {
+      printf("\033[91mERROR - weight packing of the container does not match WEIGHT_PACKING/OUTPUTBUFFER!!!\033[0m\n");
+      return -1;
+    }
+#ifdef WEIGHT_COMPRESSION
+    if(!(header->flags & MODEL_CONTAINER_COMPRESSED))
+#else
+    if(header->flags & MODEL_CONTAINER_COMPRESSED)
+#endif
+    {
+      printf("\033[91mERROR - weight compression of the container does not match WEIGHT_COMPRESSION!!!\033[0m\n");
+      return -1;
+    }
+    return 0;
+}
 
-        for(int d=0; d<nr_dma_tiles; d++)
-        {
-          if(d==nr_dma_tiles-1)
-          {
-            curr_w_size = dima_tiles_overflow;
-            curr_w_idx = (d*65532)/2;
-            curr_w_idx_local = (curr_w_idx+1)/2;
-          }
-          else
-          {
-            curr_w_size = 65532;
-            curr_w_idx = (d*65532)/2;
-            curr_w_idx_local = ((curr_w_idx+1)/2);
-          }
-          // printf("dma_tile %d curr_w_size %d  curr_w_idx %d \n", d, curr_w_size, curr_w_idx);
-          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_HH]+curr_w_idx))), (uint32_t) (((v2s*)W2+curr_w_idx_local)), curr_w_size,  1));
-        }
-      }
+/** @brief Checks if a blob of a model container lies within the image
+ *
+ *  @param offset Offset of the blob
+ *  @param elements Number of 16 bit elements of the blob
+ *  @param imageSize Size of the image in bytes
+ *  @return 1 if the blob is halfword aligned and ends within the image
+ */
+static int containerBlobFits (uint32_t offset, uint32_t elements, uint32_t imageSize) {
+    return !(offset & 1) && offset <= imageSize && elements <= (imageSize-offset)/sizeof(data_t);
+}
 
-  #else // no DMA
+/** @brief Checks if the layer table and the FMs of a model container lie within its image
+ *
+ *  @param header Container header
+ *  @return 0 or -1 if the header is corrupt
+ */
+static int checkContainerLayout (struct model_container_header * header) {
+    if((header->layer_offset & 3) ||
+       !containerBlobFits(header->layer_offset, header->depth*(sizeof(struct model_container_layer)/sizeof(data_t)), header->image_size) ||
+       !containerBlobFits(header->in_offset, header->in_size, header->image_size) ||
+       !containerBlobFits(header->out_offset, header->out_size, header->image_size))
+    {
+      printf("\033[91mERROR - model container is truncated or its header is corrupt!!!\033[0m\n");
+      return -1;
+    }
+    return 0;
+}
 
-      for(int m = 0; m < 4*lay.attributes[LAY_LSTM_HID]; m++)
-      {
-        B1[m] = lay.parameters[LSTM_BIAS_IH][m];
-        B2[m] = lay.parameters[LSTM_BIAS_HH][m];
+/** @brief Checks one entry of the layer table of a model container
+ *
+ *  Used by loadModelContainer and streamOpen. The type has to be one inferNetwork computes (FC,
+ *  LSTM or output head), the shape positive and every parameter the layer uses (weights, biases,
+ *  LSTM states and the tensors of fused operations) has to lie within the image and hold at least
+ *  the shape.
+ *
+ *  @param header Container header
+ *  @param lay Layer table entry
+ *  @param l Index of the layer
+ *  @return 0 or -1 if the layer is corrupt
+ */
+static int checkContainerLayer (struct model_container_header * header, struct model_container_layer * lay, unsigned int l) {
+    // parameter elements the layer uses (0: unused)
+    uint64_t need[6] = {0};
 
-        for(int n = 0; n < lay.attributes[LAY_LSTM_IN] + W_OFFSET; n++) //+2
-        {
-          W1[m*(lay.attributes[LAY_LSTM_IN]+W_OFFSET)+n] = lay.parameters[LSTM_WGHT_IH][m*(lay.attributes[LAY_LSTM_IN])+n];
-        }
-        for(int n = 0; n < lay.attributes[LAY_LSTM_HID] + W_OFFSET; n++) //+2
+    if(lay->type > TOPK || lay->type == RNN || lay->type == Conv2d)
+    {
+      printf("\033[91mERROR - layer %u has the type %u which inferNetwork cannot compute!!!\033[0m\n", l, (unsigned int) lay->type);
+      return -1;
+    }
+    for(int a=0; a<5; a++)
+      if(lay->attributes[a] < 0)
+      {
+        printf("\033[91mERROR - layer %u has a negative attribute!!!\033[0m\n", l);
+        return -1;
+      }
+    if((lay->type == LINEAR && (lay->attributes[LAY_LIN_IN] == 0 || lay->attributes[LAY_LIN_OUT] == 0)) ||
+       (lay->type == LSTM && (lay->attributes[LAY_LSTM_IN] == 0 || lay->attributes[LAY_LSTM_HID] == 0)) ||
+       ((lay->type == SOFTMAX || lay->type == ARGMAX || lay->type == TOPK) && lay->attributes[LAY_HEAD_IN] == 0))
+    {
+      printf("\033[91mERROR - layer %u has no neurons!!!\033[0m\n", l);
+      return -1;
+    }
+    if(lay->type == TOPK && (lay->attributes[LAY_HEAD_K] < 1 || lay->attributes[LAY_HEAD_K] > TOPK_MAX ||
+                             lay->attributes[LAY_HEAD_K] > lay->attributes[LAY_HEAD_IN]))
+    {
+      printf("\033[91mERROR - layer %u: k=%d is not within 1..min(TOPK_MAX, inputs)!!!\033[0m\n", l, lay->attributes[LAY_HEAD_K]);
+      return -1;
+    }
+    for(int p=0; p<6; p++)
+      if(lay->param_offset[p] && !containerBlobFits(lay->param_offset[p], lay->param_size[p], header->image_size))
+      {
+        printf("\033[91mERROR - parameter %d of layer %u exceeds the model container!!!\033[0m\n", p, l);
+        return -1;
+      }
+    if(lay->type == LINEAR)
+    {
+      int in  = lay->attributes[LAY_LIN_IN];
+      int out = lay->attributes[LAY_LIN_OUT];
+      int tensors = 0;
+      need[LAY_LIN_BIAS]    = out;
+      // compressed blobs are checked against the shape by weightCompCheck
+      need[LAY_LIN_WEIGHTS] = (header->flags & MODEL_CONTAINER_COMPRESSED) ? 1 : (uint64_t)in*out;
+      for(int ops=lay->attributes[LAY_LIN_FUSED_OPS]; (ops & FUSE_OP_MASK) != FUSE_NONE; ops>>=FUSE_OP_BITS)
+      {
+        int op = ops & FUSE_OP_MASK;
+        if(op > FUSE_SIG || (op == FUSE_RESIDUAL && in != out) ||
+           ((op == FUSE_ADD || op == FUSE_HADAMARD) && tensors == FUSE_MAX_TENSORS))
         {
-          W2[m*(lay.attributes[LAY_LSTM_HID]+W_OFFSET)+n] = lay.parameters[LSTM_WGHT_HH][m*(lay.attributes[LAY_LSTM_HID])+n];
+          printf("\033[91mERROR - layer %u has an invalid chain of fused operations!!!\033[0m\n", l);
+          return -1;
         }
+        if(op == FUSE_ADD || op == FUSE_HADAMARD)
+          need[LAY_LIN_FUSED_TENSORS+tensors++] = out;
       }
-  #endif // DMA
-  
     }
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    // CONVOLUTION
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    else
+    else if(lay->type == LSTM)
     {
-      printf("\033[91mERROR - only Lin Layer or LSTM are supported!!!\033[0m\n");
+      uint64_t hid = lay->attributes[LAY_LSTM_HID];
+      need[LSTM_WGHT_IH] = 4*hid*lay->attributes[LAY_LSTM_IN];
+      need[LSTM_WGHT_HH] = 4*hid*hid;
+      need[LSTM_BIAS_IH] = 4*hid;
+      need[LSTM_BIAS_HH] = 4*hid;
+      need[LSTM_H]       = hid;
+      need[LSTM_C]       = hid;
     }
-  }
-
-  synch_barrier(); // TODO: needed???
-          
-#endif // MULTICORE
-
-  synch_barrier();
-  PROFILING_ALL_START
+    for(int p=0; p<6; p++)
+      if(need[p] && (lay->param_offset[p] == 0 || lay->param_size[p] < need[p]))
+      {
+        printf("\033[91mERROR - parameter %d of layer %u is missing or smaller than its shape!!!\033[0m\n", p, l);
+        return -1;
+      }
+    return 0;
+}
 
-/*****************************************************************************
+/** @brief Builds the layer array of a network from a binary model container
  *
- * Current Layer Execution
+ *  The parameters are not copied, the layers point into the image (zero-copy), i.e. the image
+ *  has to stay in memory (L2, memory-mapped flash or a mmap-ed file on the host) and the LSTM
+ *  states have to be writable.
+ *  The layer table, the FMs and all parameter blobs have to lie within the image, the layer
+ *  types have to be known and the shapes positive (checkContainerLayer), otherwise the container
+ *  is rejected before any pointer is built.
  *
- *****************************************************************************/
-  short toFIRST = False;
-  for(int i = 0; i < depth; i++)
-  {
-
-#ifdef MULTICORE
-    int dma_idx = 0;
+ *  @param image Model container (aligned to MODEL_CONTAINER_ALIGN)
+ *  @param imageSize Bytes available at image (e.g. the file size)
+ *  @param network Layer array to be filled
+ *  @param maxDepth Size of the layer array
+ *  @param inFeatures Returns the input FM stored in the container
+ *  @param outFeatures Returns the expected output FM stored in the container
+ *  @param outSize Returns the number of output elements
+ *  @return Number of layers or -1 if the container is corrupt or does not match the build
+ */
+int loadModelContainer (void * image, unsigned int imageSize, struct layer * network, int maxDepth, data_t ** inFeatures, data_t ** outFeatures, int * outSize) {
+    struct model_container_header * header = (struct model_container_header *) image;
+    struct model_container_layer  * table;
 
-    // switch buffers
-    if(toFIRST) 
+    if(imageSize < sizeof(struct model_container_header))
     {
-      W1 = &linear_Weights[BUFFER_LIN_W1_SIZE2];
-      B1 = &linear_Bias[BUFFER_LIN_B1_SIZE2];
-      W2 = &linear_Weights2[BUFFER_LIN_W2_SIZE2];
-      B2 = &linear_Bias2[BUFFER_LIN_B2_SIZE2];
-
-      W1_next = &linear_Weights[0];
-      B1_next = &linear_Bias[0];
-      W2_next = &linear_Weights2[0];
-      B2_next = &linear_Bias2[0];
-
+      printf("\033[91mERROR - model container of %u bytes is truncated!!!\033[0m\n", imageSize);
+      return -1;
     }
-    else 
+    if(checkModelContainer(header, maxDepth) < 0)
+      return -1;
+    if(header->image_size > imageSize)
     {
-      W1 = &linear_Weights[0];
-      B1 = &linear_Bias[0];
-      W2 = &linear_Weights2[0];
-      B2 = &linear_Bias2[0];
+      printf("\033[91mERROR - model container is truncated or its header is corrupt!!!\033[0m\n");
+      return -1;
+    }
+    if(checkContainerLayout(header) < 0)
+      return -1;
 
-      W1_next = &linear_Weights[BUFFER_LIN_W1_SIZE2];
-      B1_next = &linear_Bias[BUFFER_LIN_B1_SIZE2];
-      W2_next = &linear_Weights2[BUFFER_LIN_W2_SIZE2];
-      B2_next = &linear_Bias2[BUFFER_LIN_B2_SIZE2];
+    table = (struct model_container_layer *) ((char *) image + header->layer_offset);
+    for(unsigned int l=0; l<header->depth; l++)
+    {
+      if(checkContainerLayer(header, &table[l], l) < 0)
+        return -1;
+#ifdef WEIGHT_COMPRESSION
+      if(table[l].type == LINEAR)
+      {
+        struct weight_comp_header * blob = (struct weight_comp_header *) ((char *) image + table[l].param_offset[LAY_LIN_WEIGHTS]);
+        if(table[l].param_size[LAY_LIN_WEIGHTS] < sizeof(struct weight_comp_header)/sizeof(data_t) ||
+           blob->size > sizeof(data_t)*table[l].param_size[LAY_LIN_WEIGHTS] ||
+           weightCompCheck((const uint8_t *) blob, table[l].attributes[LAY_LIN_OUT], table[l].attributes[LAY_LIN_IN]) < 0)
+        {
+          printf("\033[91mERROR - compressed weights of layer %u are corrupt or do not fit WCOMP_STAGE_SIZE!!!\033[0m\n", l);
+          return -1;
+        }
+      }
+#endif
 
+      network[l].type = (enum layerType) table[l].type;
+      for(int a=0; a<5; a++)
+        network[l].attributes[a] = table[l].attributes[a];
+      for(int p=0; p<6; p++)
+        network[l].parameters[p] = table[l].param_offset[p] ? (data_t *) ((char *) image + table[l].param_offset[p]) : NULL;
+#if !defined(LAYER_FUSION) || defined(TILING) || defined(BATCHING)
+      if(network[l].type == LINEAR && network[l].attributes[LAY_LIN_FUSED_OPS] != FUSE_NONE)
+      {
+        printf("\033[91mERROR - layer %d: fused element-wise operations need LAYER_FUSION without TILING/BATCHING!!!\033[0m\n", l);
+        return -1;
+      }
+#elif defined(FixedPt) && defined(SIMD)
+      // FusedLinearLayer reads the weight rows as v2s words
+      if(network[l].type == LINEAR && network[l].attributes[LAY_LIN_FUSED_OPS] != FUSE_NONE && (network[l].attributes[LAY_LIN_IN] & 1))
+      {
+        printf("\033[91mERROR - layer %d: fused element-wise operations need an even number of input neurons!!!\033[0m\n", l);
+        return -1;
+      }
+#endif
     }
-#endif //MULTICORE
 
-    // printf("INFO - Layer %d %d core %d\n", i, toFIRST, rt_core_id());
-    struct layer lay = network[i];
-    struct layer lay_next;
+    *inFeatures  = (data_t *) ((char *) image + header->in_offset);
+    *outFeatures = (data_t *) ((char *) image + header->out_offset);
+    *outSize     = header->out_size;
+    return header->depth;
+}
 
-    if(i+1<depth)
-    {
+#endif // ifndef ASIP
 
- /*****************************************************************************
- *
- * Start Copy Weight Data of next layer
+
+#if defined(DMA_DISTRIBUTED) && defined(DMA) && defined(MULTICORE) && !defined(ASIP)
+
+/** @brief Starts an L2 -> L1 transfer of the calling core, waits for its oldest transfer if
+ *  DMA_CORE_OUTSTANDING transfers are in flight (the transaction ids are shared by all cores)
  *
- *****************************************************************************/
-    #ifdef MULTICORE
-      if ( core_id==0 )
-      {
-        lay_next = network[i+1];
+ *  @param queue DMA transfers of the calling core
+ *  @param ext Source in L2
+ *  @param loc Destination in L1
+ *  @param size Bytes of the transfer (at most DMA_MAX_CHUNK)
+ */
+static void dmaQueuePush (struct dma_queue * queue, const void * ext, void * loc, unsigned int size) {
+    if(queue->issued - queue->completed == DMA_CORE_OUTSTANDING)
+      plp_dma_wait(queue->ids[queue->completed++ % DMA_CORE_OUTSTANDING]);
+    queue->ids[queue->issued++ % DMA_CORE_OUTSTANDING] = plp_dma_memcpy((uintptr_t) ext, (uintptr_t) loc, size, 1);
+}
 
-        // printf("INFO - copy weigt data of next layer!!! \n");
-        //////////////////////////////////////////////////////////////////////////////////////////////
-        // LINEAR
-        //////////////////////////////////////////////////////////////////////////////////////////////
-        if(lay_next.type == LINEAR)
-        {
-          // printf("INFO - copy weigt data of next layer!!! LINEAR asd\n");
 
-          act_size = (unsigned short) 2*lay_next.attributes[LAY_LIN_IN];
+/** @brief Waits for all transfers of the calling core
+ *
+ *  @param queue DMA transfers of the calling core
+ */
+void dmaQueueWait (struct dma_queue * queue) {
+    while(queue->completed < queue->issued)
+      plp_dma_wait(queue->ids[queue->completed++ % DMA_CORE_OUTSTANDING]);
+}
 
-      #ifdef DMA
-          unsigned short b_size = lay_next.attributes[LAY_LIN_OUT]*2;
-          unsigned w_size = (b_size)*(act_size);
 
-          // Copy Bias
-          dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_BIAS]))), (uint32_t) (((v2s*)B1_next)), b_size, 1);
-          dma_idx += 1;
+/** @brief Part of a copy of units (words or rows) issued by the calling core
+ *
+ *  The copy is split into slices of at least DMA_SLICE_MIN bytes, one per core (small copies use
+ *  fewer cores, the first core rotates from copy to copy, i.e. every core has to see the same copies).
+ *
+ *  @param queue DMA transfers of the calling core
+ *  @param units Number of units of the copy
+ *  @param unitSize Bytes per unit
+ *  @param start First unit of the calling core
+ *  @param end End of the units of the calling core
+ */
+static void dmaSlice (struct dma_queue * queue, unsigned int units, unsigned int unitSize, unsigned int * start,
+                      unsigned int * end) {
+    int nrSlices = Max(1, Min((int) NR_CORES, (int) ((units*unitSize + DMA_SLICE_MIN - 1) / DMA_SLICE_MIN)));
+    int slice    = (rt_core_id() - queue->rotate + NR_CORES) % NR_CORES;
+    queue->rotate = (queue->rotate + nrSlices) % NR_CORES;
+
+    unsigned int perSlice = (units + nrSlices - 1) / nrSlices;
+    *start = Min(slice * perSlice, units);
+    *end   = slice < nrSlices ? Min(*start + perSlice, units) : *start;
+}
 
-          if (w_size >= 65532)
-          {
-            // printf("\033[91mWARNING - DATA too big for DMA 2 !!!\033[0m\n");
 
-            // printf("dma bias size: %d \n", b_size);
-            // printf("dma weight size: %d %d %d %x \n", w_size, b_size, act_size, (uint32_t) ((v2s*)W1_next));
-            int nr_dma_tiles                          = w_size / 65532;
-            int dima_tiles_overflow                   = w_size % 65532;
-            if (dima_tiles_overflow!=0) nr_dma_tiles +=1;
+/** @brief Issues the slice of the calling core of a contiguous L2 -> L1 copy (called by all cores)
+ *
+ *  Every core copies a word-aligned slice (see dmaSlice()) in chunks of at most DMA_MAX_CHUNK bytes.
+ *  The transfers are not waited for, see dmaQueueWait().
+ *
+ *  @param queue DMA transfers of the calling core
+ *  @param ext Source in L2
+ *  @param loc Destination in L1
+ *  @param size Bytes of the copy
+ */
+static void dmaCopySliced (struct dma_queue * queue, const data_t * ext, data_t * loc, unsigned int size) {
+    unsigned int start, end;
+
+    dmaSlice(queue, (size + 3) / 4, 4, &start, &end);
+    start *= 4;
+    end    = Min(end * 4, size);
+    for(unsigned int off=start; off<end; off+=DMA_MAX_CHUNK)
+      dmaQueuePush(queue, (const char *) ext + off, (char *) loc + off, Min(end - off, (unsigned int) DMA_MAX_CHUNK));
+}
 
-            unsigned short curr_w_size = 0;
-            int curr_w_idx = 0;
-            int curr_w_idx_local = 0;
 
-            // printf("core %d  nr_dma_tiles %d dima_tiles_overflow %d  \n", rt_core_id(), nr_dma_tiles, dima_tiles_overflow);
+/** @brief Issues the rows of the calling core of a dense L2 -> padded L1 copy (called by all cores)
+ *
+ *  The rows are scattered into an L1 layout with a row stride of locStride bytes (W_OFFSET padding)
+ *  during the transfer, every core copies a contiguous range of rows (see dmaSlice()). The 2D mode of
+ *  the cluster DMA strides on the L2 side only, i.e. every row is one transfer. Without padding, the
+ *  copy is contiguous (dmaCopySliced()).
+ *
+ *  @param queue DMA transfers of the calling core
+ *  @param ext Source in L2 (rows of rowSize bytes)
+ *  @param loc Destination in L1
+ *  @param rows Number of rows
+ *  @param rowSize Bytes per row in L2
+ *  @param locStride Bytes per row in L1 (at least rowSize)
+ */
+static void dmaCopyRows (struct dma_queue * queue, const data_t * ext, data_t * loc, unsigned int rows,
+                         unsigned int rowSize, unsigned int locStride) {
+    unsigned int start, end;
 
-            for(int d=0; d<nr_dma_tiles; d++)
-            // for(int d=0; d<3; d++)
-            {
-              if(d==nr_dma_tiles-1)
-              {
-                curr_w_size = dima_tiles_overflow/2;
-                curr_w_idx = (d*65532)/2;
-                curr_w_idx_local = (curr_w_idx+1)/2;
-              }
-              else
-              {
-                curr_w_size = 65532;
-                curr_w_idx = (d*65532)/2;
-                curr_w_idx_local = ((curr_w_idx+1)/2);
-              }
+    if(locStride == rowSize)
+    {
+      dmaCopySliced(queue, ext, loc, rows*rowSize);
+      return;
+    }
+    dmaSlice(queue, rows, rowSize, &start, &end);
+    for(unsigned int r=start; r<end; r++)
+      for(unsigned int off=0; off<rowSize; off+=DMA_MAX_CHUNK)
+        dmaQueuePush(queue, (const char *) ext + r*rowSize + off, (char *) loc + r*locStride + off,
+                     Min(rowSize - off, (unsigned int) DMA_MAX_CHUNK));
+}
 
-              // printf("core %d %d value %d \n", rt_core_id(), 0, *(lay_next.parameters[LAY_LIN_WEIGHTS]+curr_w_idx) );
- 
-              dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_WEIGHTS]+curr_w_idx))), (uint32_t) (((v2s*)W1_next+curr_w_idx_local)), curr_w_size,  1);
-              dma_idx += 1;
-            }
-          }
-          else
-          {
-            dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_WEIGHTS]))), (uint32_t) (((v2s*)W1_next)), w_size,  1);
-            dma_idx += 1;
-          }
-      #else // no DMA
 
-          for(int m = 0; m < lay_next.attributes[LAY_LIN_OUT]; m++)
-          {
-            B1_next[m] = lay_next.parameters[LAY_LIN_BIAS][m];
-            for(int n = 0; n < lay_next.attributes[LAY_LIN_IN] + W_OFFSET; n++) //+2
-            {
-              W1_next[m*(lay_next.attributes[LAY_LIN_IN]+W_OFFSET)+n] = lay_next.parameters[LAY_LIN_WEIGHTS][m*(lay_next.attributes[LAY_LIN_IN])+n];
-            }
-          }
+/** @brief Issues the slices of the calling core of all parameter copies of a layer (called by all cores)
+ *
+ *  @param queue DMA transfers of the calling core
+ *  @param lay Layer whose parameters are copied
+ *  @param W1 L1 buffer of the (input) weights
+ *  @param B1 L1 buffer of the (input) bias
+ *  @param W2 L1 buffer of the hidden weights (LSTM)
+ *  @param B2 L1 buffer of the hidden bias (LSTM)
+ *  @param H L1 buffer of the hidden state (LSTM)
+ *  @param C L1 buffer of the cell state (LSTM)
+ */
+void dmaLoadLayer (struct dma_queue * queue, struct layer * lay, data_t * W1, data_t * B1, data_t * W2, data_t * B2,
+                   data_t * H, data_t * C) {
+    if(lay->type == LINEAR)
+    {
+      unsigned int in  = lay->attributes[LAY_LIN_IN];
+      unsigned int out = lay->attributes[LAY_LIN_OUT];
+      dmaCopySliced(queue, lay->parameters[LAY_LIN_BIAS], B1, 2*out);
+#ifdef WEIGHT_COMPRESSION
+      // compressed blobs are staged as they are and expanded after the wait (weightExpandLayer()),
+      // inferNetwork has checked that they fit weightStage (weightCompCheck())
+      struct weight_comp_header * header = (struct weight_comp_header *) lay->parameters[LAY_LIN_WEIGHTS];
+      if(header->format != WCOMP_RAW)
+        dmaCopySliced(queue, lay->parameters[LAY_LIN_WEIGHTS], (data_t *) weightStage, header->size);
+      else
+        dmaCopyRows(queue, (data_t *) (header+1), W1, out, 2*in, 2*(in+W_OFFSET));
+#else
+      dmaCopyRows(queue, lay->parameters[LAY_LIN_WEIGHTS], W1, out, 2*in, 2*(in+W_OFFSET));
+#endif
+    }
+    else if(lay->type == LSTM)
+    {
+      unsigned int in  = lay->attributes[LAY_LSTM_IN];
+      unsigned int hid = lay->attributes[LAY_LSTM_HID];
+      dmaCopySliced(queue, lay->parameters[LSTM_H], H, 2*hid);
+      dmaCopySliced(queue, lay->parameters[LSTM_C], C, 2*hid);
+      dmaCopySliced(queue, lay->parameters[LSTM_BIAS_IH], B1, 2*4*hid);
+      dmaCopySliced(queue, lay->parameters[LSTM_BIAS_HH], B2, 2*4*hid);
+      dmaCopyRows(queue, lay->parameters[LSTM_WGHT_IH], W1, 4*hid, 2*in, 2*(in+W_OFFSET));
+      dmaCopyRows(queue, lay->parameters[LSTM_WGHT_HH], W2, 4*hid, 2*hid, 2*(hid+W_OFFSET));
+    }
+}
+
+#endif // DMA_DISTRIBUTED
 
-      #endif // DMA
 
+#ifdef WEIGHT_COMPRESSION
+
+/** @brief Expands a compressed FC weight blob into the (padded) L1 weight layout (called by all cores)
+ *
+ *  Every core expands a balanced number of rows, the rows of the L1 layout have a stride of
+ *  cols+W_OFFSET elements. The blob is written by scripts/weight_compression.py: WCOMP_EXP8 scales
+ *  the int8 mantissas by 2^exponent of their group, WCOMP_CB4 looks up two 4-bit indices per byte
+ *  (low nibble first) in the codebook and WCOMP_RAW copies the 16-bit weights. The caller synchronizes
+ *  the cores before the weights are used.
+ *
+ *  @param blob Compressed weights (struct weight_comp_header followed by the payload, word aligned)
+ *  @param weight Expanded weights
+ *  @param rows Number of rows (output neurons)
+ *  @param cols Number of columns (input neurons)
+ */
+void weightExpand (const uint8_t * blob, data_t * weight, int rows, int cols) {
+    const struct weight_comp_header * header = (const struct weight_comp_header *) blob;
+    const uint8_t * payload = blob + sizeof(struct weight_comp_header);
+    int stride = cols + W_OFFSET;
+
+    /* each core expands a balanced number of rows */
+    int core_id = rt_core_id();
+    int n_cores = NR_CORES;
+    int chunck = 1;
+    if(rows >= n_cores)
+    {
+      int Log2Core = __builtin_pulp_fl1(n_cores);
+      chunck = (rows >> Log2Core) + ((rows & (n_cores-1))!=0);
+    }
+    int start = MIN(chunck * core_id, rows);
+    int stop = MIN(start + chunck, rows);
+
+    if(header->format == WCOMP_EXP8)
+    {
+      int log2Group = header->log2Group;
+      int groups = (cols + (1<<log2Group) - 1) >> log2Group;
+      const int8_t * mantissas = (const int8_t *) (payload + ((rows*groups + 3) & ~3));
+      for(int r=start; r<stop; r++)
+      {
+        const uint8_t * exps = &payload[r*groups];
+        const int8_t  * mant = &mantissas[r*cols];
+        data_t * w = &weight[r*stride];
+        for(int g=0; g<groups; g++)
+        {
+          int shift = exps[g];
+          int end = MIN((g+1)<<log2Group, cols);
+          for(int c=g<<log2Group; c<end; c++)
+            w[c] = mant[c] * (1 << shift);
         }
-        //////////////////////////////////////////////////////////////////////////////////////////////
-        // LSTM
-        //////////////////////////////////////////////////////////////////////////////////////////////
-        else if(lay_next.type == LSTM)
+      }
+    }
+    else if(header->format == WCOMP_CB4)
+    {
+      data_t codebook[WCOMP_CODEBOOK];
+      for(int k=0; k<WCOMP_CODEBOOK; k++)
+        codebook[k] = ((const data_t *) payload)[k];
+      const uint8_t * indices = payload + sizeof(codebook);
+      for(int r=start; r<stop; r++)
+      {
+        const uint8_t * idx = &indices[r*(cols/2)];
+        data_t * w = &weight[r*stride];
+        for(int c=0; c<cols/2; c++)
         {
-          // printf("INFO - copy weigt data of next layer!!! LSTM\n");
+          w[2*c]   = codebook[idx[c] & 0xF];
+          w[2*c+1] = codebook[idx[c] >> 4];
+        }
+      }
+    }
+    else
+    {
+      const data_t * raw = (const data_t *) payload;
+      for(int r=start; r<stop; r++)
+        for(int c=0; c<cols; c++)
+          weight[r*stride+c] = raw[r*cols+c];
+    }
+}
 
-          act_size = (unsigned short) 2*lay_next.attributes[LAY_LSTM_IN];
 
+/** @brief Checks a compressed FC weight blob before it is staged and expanded
+ *
+ *  The format has to be known, the blob has to hold the payload weightExpand reads for the
+ *  layer shape (WCOMP_CB4 needs an even number of columns, the WCOMP_EXP8 exponents must not
+ *  exceed WCOMP_MAX_EXP) and, with DMA, a compressed blob has to fit weightStage.
+ *
+ *  @param blob Compressed weights (struct weight_comp_header followed by the payload)
+ *  @param rows Number of rows (output neurons)
+ *  @param cols Number of columns (input neurons)
+ *  @return 0 or -1 if the blob cannot be expanded
+ */
+int weightCompCheck (const uint8_t * blob, int rows, int cols) {
+    const struct weight_comp_header * header = (const struct weight_comp_header *) blob;
+    unsigned int payload;
+
+    if(header->format == WCOMP_EXP8)
+    {
+      if(header->log2Group > 15)
+        return -1;
+      unsigned int groups = (cols + (1<<header->log2Group) - 1) >> header->log2Group;
+      payload = ((rows*groups + 3) & ~3) + rows*cols;
+    }
+    else if(header->format == WCOMP_CB4)
+    {
+      if(cols & 1)
+        return -1;
+      payload = sizeof(data_t)*WCOMP_CODEBOOK + rows*(cols/2);
+    }
+    else if(header->format == WCOMP_RAW)
+      payload = sizeof(data_t)*rows*cols;
+    else
+      return -1;
+
+    if(header->size < sizeof(struct weight_comp_header) + payload)
+      return -1;
+    if(header->format == WCOMP_EXP8)
+    {
+      // the exponents are stored first, one per group of every row
+      const uint8_t * exps = blob + sizeof(struct weight_comp_header);
+      unsigned int groups = (cols + (1<<header->log2Group) - 1) >> header->log2Group;
+      for(unsigned int e=0; e<rows*groups; e++)
+        if(exps[e] > WCOMP_MAX_EXP)
+          return -1;
+    }
 #ifdef DMA
-          unsigned short hidden_4_size = 2*lay_next.attributes[LAY_LSTM_HID];
-          // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay_next.parameters[LSTM_H])), (uint32_t) (((v2s*)linear_H)), hidden_4_size,  1));
-          dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)lay_next.parameters[LSTM_H])), (uint32_t) (((v2s*)linear_H)), hidden_4_size,  1);
-          dma_idx += 1;
-          // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay_next.parameters[LSTM_C])), (uint32_t) (((v2s*)linear_C)), hidden_4_size,  1));
-          dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)lay_next.parameters[LSTM_C])), (uint32_t) (((v2s*)linear_C)), hidden_4_size,  1);
-          dma_idx += 1;
-#else
-          for(int j = 0; j < lay_next.attributes[LAY_LSTM_HID]; j++)
-          {
-            linear_H[j] = lay_next.parameters[LSTM_H][j];
-            linear_C[j] = lay_next.parameters[LSTM_C][j];
-          }
+    if(header->format != WCOMP_RAW && header->size > WCOMP_STAGE_SIZE)
+      return -1;
 #endif
+    return 0;
+}
 
-      #ifdef DMA
-          unsigned short b_size = 2*4*lay_next.attributes[LAY_LSTM_HID];
-          unsigned w_size = (b_size)*(act_size);
-          // printf("size %u \n", w_size);
-          if (w_size >= 65532)
-          {
 
-            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_BIAS]))),    (uint32_t) (((v2s*)B1_next)),    b_size,  1));
-            dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_BIAS]))),    (uint32_t) (((v2s*)B1_next)),    b_size,  1);
-            dma_idx += 1;
-            // printf("dma bias size: %d \n", b_size);
-            // printf("dma weight size: %d %d %d %x \n", w_size, b_size, act_size, (uint32_t) ((v2s*)W1_next));
-            int nr_dma_tiles           = w_size / 65532;
-            int dima_tiles_overflow    = w_size % 65532;
-            if (dima_tiles_overflow!=0) nr_dma_tiles+=1;
-            unsigned short curr_w_size = 0;
-            int curr_w_idx;
+#if defined(DMA) && !defined(DMA_DISTRIBUTED)
+/** @brief Issues the L2 -> L1 transfers of the compressed weights of a FC Layer (core 0)
+ *
+ *  Compressed blobs are copied as they are into weightStage, WCOMP_RAW weights directly into
+ *  the weight buffer. inferNetwork has checked that the blobs fit weightStage (weightCompCheck()).
+ *
+ *  @param blob Compressed weights in L2
+ *  @param weight L1 weight buffer of the layer
+ *  @param ids Returns the transaction ids
+ *  @param prefetch Issue the transfers with DMA_PREFETCH (next layer) instead of plp_dma_memcpy
+ *  @return Number of transfers
+ */
+static int weightCompLoad (data_t * blob, data_t * weight, int * ids, int prefetch) {
+    struct weight_comp_header * header = (struct weight_comp_header *) blob;
+    char * src = (char *) blob;
+    char * dst = (char *) weightStage;
+    unsigned int size = header->size;
+    int n = 0;
+
+    if(header->format == WCOMP_RAW)
+    {
+      src  += sizeof(struct weight_comp_header);
+      dst   = (char *) weight;
+      size -= sizeof(struct weight_comp_header);
+    }
+    for(unsigned int off=0; off<size; off+=DMA_MAX_CHUNK)
+    {
+      unsigned int chunk = Min(size - off, (unsigned int) DMA_MAX_CHUNK);
+      if(prefetch)
+        ids[n++] = DMA_PREFETCH((uint32_t) (((v2s*)(src+off))), (uint32_t) (((v2s*)(dst+off))), chunk, 1);
+      else
+        ids[n++] = plp_dma_memcpy((uint32_t) (((v2s*)(src+off))), (uint32_t) (((v2s*)(dst+off))), chunk, 1);
+    }
+    return n;
+}
+#endif
 
-            // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
 
-            for(int d=0; d<nr_dma_tiles; d++)
-            {
-              if(d==nr_dma_tiles-1)
-              {
-                curr_w_size = dima_tiles_overflow;
-                curr_w_idx = (d*65532)/2;
-              }
-              else
-              {
-                curr_w_size = 65532;
-                curr_w_idx  = d*curr_w_size/2;
-              }
+/** @brief Expands the weights of a FC Layer into its L1 weight buffer (all cores, after the transfers completed)
+ *
+ *  With DMA, the compressed blob was staged in weightStage and WCOMP_RAW weights are already in
+ *  place, without DMA the blob is read from L2.
+ *
+ *  @param lay FC Layer
+ *  @param weight L1 weight buffer of the layer
+ */
+static void weightExpandLayer (struct layer * lay, data_t * weight) {
+    const uint8_t * blob = (const uint8_t *) lay->parameters[LAY_LIN_WEIGHTS];
 
-              // printf("dma_tile %d curr_w_size %d  curr_w_idx %d \n", d, curr_w_size, curr_w_idx);
-              dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_WEIGHTS]+curr_w_idx))), (uint32_t) (((v2s*)W1_next+curr_w_idx)), curr_w_size,  1);
-              dma_idx += 1;
-            }
-          }
-          else
-          {
-            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_IH]))), (uint32_t) (((v2s*)B1_next)),     b_size,  1));
-            dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_IH]))), (uint32_t) (((v2s*)B1_next)),     b_size,  1);
-            dma_idx += 1;
-            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_IH]))), (uint32_t) (((v2s*)W1_next)),  w_size,  1));
-            dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_IH]))), (uint32_t) (((v2s*)W1_next)),  w_size,  1);
-            dma_idx += 1;
-            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_HH]))), (uint32_t) (((v2s*)B2_next)),    b_size,  1));
-            dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_HH]))), (uint32_t) (((v2s*)B2_next)),    b_size,  1);
-            dma_idx += 1;
-            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_HH]))), (uint32_t) (((v2s*)W2_next)), b_size*2*lay_next.attributes[LAY_LSTM_HID],  1));
-            dma_trans_ids[dma_idx] = plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_HH]))), (uint32_t) (((v2s*)W2_next)), b_size*2*lay_next.attributes[LAY_LSTM_HID],  1);
-            dma_idx += 1;
-          }
+#ifdef DMA
+    if(((const struct weight_comp_header *) blob)->format == WCOMP_RAW)
+      return;
+    blob = (const uint8_t *) weightStage;
+#endif
+    weightExpand(blob, weight, lay->attributes[LAY_LIN_OUT], lay->attributes[LAY_LIN_IN]);
+    synch_barrier();
+}
 
-      #else // no DMA
+#endif // WEIGHT_COMPRESSION
 
-          for(int m = 0; m < 4*lay_next.attributes[LAY_LSTM_HID]; m++)
-          {
-            B1_next[m] = lay_next.parameters[LSTM_BIAS_IH][m];
-            B2_next[m] = lay_next.parameters[LSTM_BIAS_HH][m];
 
-            for(int n = 0; n < lay_next.attributes[LAY_LSTM_IN] + W_OFFSET; n++) //+2
-            {
-              W1_next[m*(lay_next.attributes[LAY_LSTM_IN]+W_OFFSET)+n] = lay_next.parameters[LSTM_WGHT_IH][m*(lay_next.attributes[LAY_LSTM_IN])+n];
-            }
-            for(int n = 0; n < lay_next.attributes[LAY_LSTM_HID] + W_OFFSET; n++) //+2
-            {
-              W2_next[m*(lay_next.attributes[LAY_LSTM_HID]+W_OFFSET)+n] = lay_next.parameters[LSTM_WGHT_HH][m*(lay_next.attributes[LAY_LSTM_HID])+n];
-            }
-          }
-      #endif // DMA
-      
-        }
-        //////////////////////////////////////////////////////////////////////////////////////////////
-        // CONVOLUTION
-        //////////////////////////////////////////////////////////////////////////////////////////////
-        else
-        {
-          printf("ERROR - only Lin Layer or LSTM are supported!!! \n");
-          // return 1;
-        }
+/** @brief Runs a neural network
+ *
+ *  Iterates through all the layers while passing the intermediate FM with a double 
+ *  buffering approach
+ *
+ *  @param network Array of concecutive layers of the current neural network
+ *  @param depth Number of Layers (aka array size)
+ *  @param inFeatures Input Feature Map
+ *  @param buffer Buffer to store intermediate results
+ *  @return Output Feature Map (NULL if the build cannot compute a fused layer, k of a TOPK layer exceeds
+ *          TOPK_MAX or compressed weights cannot be expanded, see weightCompCheck)
+ */
+data_t * NOINLINE inferNetwork(
+    struct layer * network,
+    int depth,
+    data_t * __restrict__ inFeatures,
+    data_t * __restrict__ buffer)
+{
+    // printf("delete, just for test1, core: %d \n", rt_core_id());
+
+  data_t * in;
+
+  int core_id = rt_core_id();
+
+  // layers which this build cannot compute are rejected before any transfer is issued
+  for(int i=0; i<depth; i++)
+    if(network[i].type == TOPK && (network[i].attributes[LAY_HEAD_K] < 1 || network[i].attributes[LAY_HEAD_K] > TOPK_MAX))
+    {
+      if(core_id==0)
+        printf("\033[91mERROR - layer %d: k=%d is not within 1..TOPK_MAX!!!\033[0m\n", i, network[i].attributes[LAY_HEAD_K]);
+      return NULL;
+    }
+  for(int i=0; i<depth; i++)
+    if(network[i].type == LINEAR && network[i].attributes[LAY_LIN_FUSED_OPS] != FUSE_NONE)
+    {
+#if !defined(LAYER_FUSION) || defined(TILING) || defined(BATCHING)
+      if(core_id==0)
+        printf("\033[91mERROR - layer %d: fused element-wise operations need LAYER_FUSION without TILING/BATCHING!!!\033[0m\n", i);
+      return NULL;
+#elif defined(FixedPt) && defined(SIMD)
+      if(network[i].attributes[LAY_LIN_IN] & 1)
+      {
+        if(core_id==0)
+          printf("\033[91mERROR - layer %d: fused element-wise operations need an even number of input neurons!!!\033[0m\n", i);
+        return NULL;
       }
-    #endif
+#endif
+    }
 
+#ifdef WEIGHT_COMPRESSION
+  // all cores take the same decision before any transfer is issued
+  for(int i=0; i<depth; i++)
+    if(network[i].type == LINEAR &&
+       weightCompCheck((const uint8_t *) network[i].parameters[LAY_LIN_WEIGHTS],
+                       network[i].attributes[LAY_LIN_OUT], network[i].attributes[LAY_LIN_IN]) < 0)
+    {
+      if(core_id==0)
+        printf("\033[91mERROR - compressed weights of layer %d are corrupt or do not fit WCOMP_STAGE_SIZE!!!\033[0m\n", i);
+      return NULL;
     }
-    // synch_barrier();
+#endif
+
+#ifdef MULTICORE
+  in  = &buffer[0];
+#ifdef INFER_PIPELINE
+  // the input was prefetched into L1 by inferQueueServe, the first layer reads it in place
+  _Bool inResident = inFeatures == inferPipeIn[0] || inFeatures == inferPipeIn[1];
+  if(inResident)
+    in = inFeatures;
+#endif
+#else
+  in  = inFeatures;
+#endif
+
+  data_t * out = &buffer[BUFFER_SIZE2];
+  _Bool first_layer = True;
+
+#ifdef MULTICORE
+  data_t * W1;
+  data_t * B1;
+  data_t * W1_next;
+  data_t * B1_next;
+
+  W1 = &linear_Weights[0];
+  B1 = &linear_Bias[0];
+  W1_next = &linear_Weights[BUFFER_LIN_W1_SIZE2];
+  B1_next = &linear_Bias[BUFFER_LIN_B1_SIZE2];
+
+  data_t * W2;
+  data_t * B2;
+
+  data_t * W2_next;
+  data_t * B2_next;
+
+  W2 = &linear_Weights2[0];
+  B2 = &linear_Bias2[0];
+
+  W2_next = &linear_Weights2[BUFFER_LIN_W2_SIZE2];
+  B2_next = &linear_Bias2[BUFFER_LIN_B2_SIZE2];
 
+  // LSTM hidden and cell states are kept in a ring of two buffers (current and next layer)
+  data_t * H;
+  data_t * C;
+  data_t * H_next;
+  data_t * C_next;
+
+  H = &linear_H[0];
+  C = &linear_C[0];
+  H_next = &linear_H[BUFFER_LIN_H_SIZE2];
+  C_next = &linear_C[BUFFER_LIN_C_SIZE2];
+
+#ifdef MULTI_MODEL
+  // concurrent core groups stage their parameters and LSTM states in disjoint slices of the L1 buffers
+  W1      = &linear_Weights[coreGroupL1Offset(BUFFER_LIN_W1_SIZE, 0)];
+  W1_next = &linear_Weights[coreGroupL1Offset(BUFFER_LIN_W1_SIZE, 1)];
+  B1      = &linear_Bias[coreGroupL1Offset(BUFFER_LIN_B1_SIZE, 0)];
+  B1_next = &linear_Bias[coreGroupL1Offset(BUFFER_LIN_B1_SIZE, 1)];
+  W2      = &linear_Weights2[coreGroupL1Offset(BUFFER_LIN_W2_SIZE, 0)];
+  W2_next = &linear_Weights2[coreGroupL1Offset(BUFFER_LIN_W2_SIZE, 1)];
+  B2      = &linear_Bias2[coreGroupL1Offset(BUFFER_LIN_B2_SIZE, 0)];
+  B2_next = &linear_Bias2[coreGroupL1Offset(BUFFER_LIN_B2_SIZE, 1)];
+  H       = &linear_H[coreGroupL1Offset(BUFFER_LIN_H_SIZE, 0)];
+  H_next  = &linear_H[coreGroupL1Offset(BUFFER_LIN_H_SIZE, 1)];
+  C       = &linear_C[coreGroupL1Offset(BUFFER_LIN_C_SIZE, 0)];
+  C_next  = &linear_C[coreGroupL1Offset(BUFFER_LIN_C_SIZE, 1)];
+#endif
+#endif
+
+#ifdef TIMER
+  timer_cl = 0;
+#endif
 
 /*****************************************************************************
  *
- * LINEAR LAYER
+ * Copy Input data (to be copied once)
  *
  *****************************************************************************/
-      if(lay.type == LINEAR)
-      {
 
+#ifdef MULTICORE
 
-  #ifdef DEBUG_LSTM
+  struct layer lay = network[0];
+  unsigned short act_size;
+#if defined(DMA) && defined(DMA_DISTRIBUTED)
+  // DMA transfers of this core in flight
+  struct dma_queue dmaQueue = {.issued = 0, .completed = 0, .rotate = 0};
+#endif
+
+  if (core_id==0)
+  {
+
+    if(lay.type == LINEAR)
+    {
+      act_size = (unsigned short) 2*lay.attributes[LAY_LIN_IN];
+    }
+    else if(lay.type == LSTM)
+    {
+      act_size = (unsigned short) 2*lay.attributes[LAY_LSTM_IN];
+    }
+    else if(lay.type == SOFTMAX || lay.type == ARGMAX || lay.type == TOPK)
+    {
+      act_size = (unsigned short) 2*lay.attributes[LAY_HEAD_IN];
+    }
+    else
+    {
+      printf("\033[91mERROR - only Lin Layer or LSTM are supported!!!\033[0m\n");
+    }
+ 
+#ifdef INFER_PIPELINE
+    if(!inResident)
+#endif
+    {
+#ifdef DMA
+#ifdef BATCHING
+    for(int b=0; b<BATCHING; b++)
+    {
+      // printf("batching b %d %d %d\n", b, b*act_size/4, (((v2s*)in+b*act_size)));
+      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)inFeatures)), (uint32_t) (((v2s*)in+b*act_size/4)), act_size,  1));
+    }
+    // printf("input in: ");
+    // PrintTensor(BATCHING*lay.attributes[LAY_LIN_IN], in);
+#else
+    plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)inFeatures)), (uint32_t) (((v2s*)in)), act_size,  1));
+#endif
+#else // no DMA
+
+    for(int j = 0; j < act_size/2; j++)
+    {
+      in[j] = inFeatures[j];
+    }
+
+ #endif // DMA
+    }
+
+
+
+#if !defined(DMA) || !defined(DMA_DISTRIBUTED)
+/*****************************************************************************
+ *
+ * Copy Weight Data of first layer
+ *
+ *****************************************************************************/
+
+    // printf("INFO - copy weigt data of first layer!!! \n");
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    // LINEAR LAYER
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    if(lay.type == LINEAR)
+    {
+      act_size = (unsigned short) 2*lay.attributes[LAY_LIN_IN];
+    
+  #ifdef DMA
+      unsigned short b_size = lay.attributes[LAY_LIN_OUT]*2;
+      unsigned w_size = (b_size)*(act_size);
+
+      // copy BIAS
+      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LAY_LIN_BIAS]))), (uint32_t) (((v2s*)B1)), b_size, 1));
+
+    #ifdef WEIGHT_COMPRESSION
+      int nr_dma = weightCompLoad(lay.parameters[LAY_LIN_WEIGHTS], W1, dma_trans_ids, 0);
+      for(int t=0; t<nr_dma; t++)
+        plp_dma_wait(dma_trans_ids[t]);
+      (void) w_size;
+    #else
+      if (w_size >= 65532)
+      {
+        // printf("\033[91mWARNING - DATA too big for DMA!!!\033[0m\n");
+        // printf("dma weight size: %d %d %d %x \n", w_size, b_size, act_size, (uint32_t) ((v2s*)W1));
+        int nr_dma_tiles                          = w_size / 65532;
+        int dima_tiles_overflow                   = w_size % 65532;
+        if (dima_tiles_overflow!=0) nr_dma_tiles +=1;
+
+        unsigned short curr_w_size = 0;
+        int curr_w_idx = 0;
+        int curr_w_idx_local = 0;
+
+        // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+
+        for(int d=0; d<nr_dma_tiles; d++)
+        {
+          if(d==nr_dma_tiles-1)
+          {
+            curr_w_size = dima_tiles_overflow;
+            curr_w_idx = (d*65532)/2;
+            curr_w_idx_local = (curr_w_idx+1)/2;
+          }
+          else
+          {
+            curr_w_size = 65532;
+            curr_w_idx = (d*65532)/2;
+            curr_w_idx_local = ((curr_w_idx+1)/2);
+          }
+
+          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LAY_LIN_WEIGHTS]+curr_w_idx))), (uint32_t) (((v2s*)W1+curr_w_idx_local)), curr_w_size,  1));
+
+        }
+      }
+      else
+      {
+        plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LAY_LIN_WEIGHTS]))), (uint32_t) (((v2s*)W1)), w_size,  1));
+      }
+    #endif // WEIGHT_COMPRESSION
+
+  #else // no DMA
+
+      for(int m = 0; m < lay.attributes[LAY_LIN_OUT]; m++)
+      {
+        B1[m] = lay.parameters[LAY_LIN_BIAS][m];
+    #ifndef WEIGHT_COMPRESSION // expanded by all cores
+        for(int n = 0; n < lay.attributes[LAY_LIN_IN] + W_OFFSET; n++) //+2
+        {
+          W1[m*(lay.attributes[LAY_LIN_IN]+W_OFFSET)+n] = lay.parameters[LAY_LIN_WEIGHTS][m*(lay.attributes[LAY_LIN_IN])+n];
+        }
+    #endif
+      }
+
+  #endif //  DMA
+
+    }
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    // LSTM
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    else if(lay.type == LSTM)
+    {
+        act_size = (unsigned short) 2*lay.attributes[LAY_LSTM_IN];
+
+#ifdef DMA
+          unsigned short hidden_4_size = 2*lay.attributes[LAY_LSTM_HID];
+          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay.parameters[LSTM_H])), (uint32_t) (((v2s*)H)), hidden_4_size,  1));
+          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay.parameters[LSTM_C])), (uint32_t) (((v2s*)C)), hidden_4_size,  1));
+#else // DMA
+          for(int j = 0; j < lay.attributes[LAY_LSTM_HID]; j++)
+          {
+            H[j] = lay.parameters[LSTM_H][j];
+            C[j] = lay.parameters[LSTM_C][j];
+          }
+#endif // DMA
+
+  #ifdef DMA
+      unsigned short b_size = 2*4*lay.attributes[LAY_LSTM_HID];
+      unsigned w_size = (b_size)*(act_size);
+      unsigned w2_size = (b_size)*2*lay.attributes[LAY_LSTM_HID];
+
+      // copy BIASES
+      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_BIAS_IH]))), (uint32_t) (((v2s*)B1)), b_size, 1));
+      plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_BIAS_HH]))), (uint32_t) (((v2s*)B2)), b_size, 1));
+
+
+      // printf("size %u \n", w_size);
+      // Copy W1
+      if (w_size < 65532)
+      {
+
+        plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_IH]))), (uint32_t) (((v2s*)W1)), w_size, 1)); //b_size*2*lay.attributes[LAY_LSTM_HID],  1));
+      }
+      else
+      {
+
+        int nr_dma_tiles           = w_size / 65532;
+        int dima_tiles_overflow    = w_size % 65532;
+        if (dima_tiles_overflow!=0) nr_dma_tiles+=1;
+        unsigned short curr_w_size = 0;
+        int curr_w_idx = 0;
+        int curr_w_idx_local = 0;
+
+        // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+
+        for(int d=0; d<nr_dma_tiles; d++)
+        {
+          if(d==nr_dma_tiles-1)
+          {
+            curr_w_size = dima_tiles_overflow;
+            curr_w_idx = (d*65532)/2;
+            curr_w_idx_local = (curr_w_idx+1)/2;
+          }
+          else
+          {
+            curr_w_size = 65532;
+            curr_w_idx = (d*65532)/2;
+            curr_w_idx_local = ((curr_w_idx+1)/2);
+          }
+          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_IH]+curr_w_idx))), (uint32_t) (((v2s*)W1+curr_w_idx_local)), curr_w_size,  1));
+        }
+      }
+      
+
+      // Copy W2
+      if (w2_size < 65532)
+      {
+        plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_HH]))), (uint32_t) (((v2s*)W2)), w2_size, 1)); //b_size*2*lay.attributes[LAY_LSTM_HID],  1));
+      }
+      else
+      {
+        // printf("\033[91mWARNING - LSTM W2 DATA too big for DMA!!!\033[0m\n");
+
+        int nr_dma_tiles           = w2_size / 65532;
+        int dima_tiles_overflow    = w2_size % 65532;
+        if (dima_tiles_overflow!=0) nr_dma_tiles+=1;
+        unsigned short curr_w_size = 0;
+        int curr_w_idx = 0;
+        int curr_w_idx_local = 0;
+
+        // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+
+        for(int d=0; d<nr_dma_tiles; d++)
+        {
+          if(d==nr_dma_tiles-1)
+          {
+            curr_w_size = dima_tiles_overflow;
+            curr_w_idx = (d*65532)/2;
+            curr_w_idx_local = (curr_w_idx+1)/2;
+          }
+          else
+          {
+            curr_w_size = 65532;
+            curr_w_idx = (d*65532)/2;
+            curr_w_idx_local = ((curr_w_idx+1)/2);
+          }
+          // printf("dma_tile %d curr_w_size %d  curr_w_idx %d \n", d, curr_w_size, curr_w_idx);
+          plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay.parameters[LSTM_WGHT_HH]+curr_w_idx))), (uint32_t) (((v2s*)W2+curr_w_idx_local)), curr_w_size,  1));
+        }
+      }
+
+  #else // no DMA
+
+      for(int m = 0; m < 4*lay.attributes[LAY_LSTM_HID]; m++)
+      {
+        B1[m] = lay.parameters[LSTM_BIAS_IH][m];
+        B2[m] = lay.parameters[LSTM_BIAS_HH][m];
+
+        for(int n = 0; n < lay.attributes[LAY_LSTM_IN] + W_OFFSET; n++) //+2
+        {
+          W1[m*(lay.attributes[LAY_LSTM_IN]+W_OFFSET)+n] = lay.parameters[LSTM_WGHT_IH][m*(lay.attributes[LAY_LSTM_IN])+n];
+        }
+        for(int n = 0; n < lay.attributes[LAY_LSTM_HID] + W_OFFSET; n++) //+2
+        {
+          W2[m*(lay.attributes[LAY_LSTM_HID]+W_OFFSET)+n] = lay.parameters[LSTM_WGHT_HH][m*(lay.attributes[LAY_LSTM_HID])+n];
+        }
+      }
+  #endif // DMA
+  
+    }
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    // OUTPUT HEADS (no parameters)
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    else if(lay.type == SOFTMAX || lay.type == ARGMAX || lay.type == TOPK)
+    {
+    }
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    // CONVOLUTION
+    //////////////////////////////////////////////////////////////////////////////////////////////
+    else
+    {
+      printf("\033[91mERROR - only Lin Layer or LSTM are supported!!!\033[0m\n");
+    }
+#endif // !DMA_DISTRIBUTED
+  }
+
+#if defined(DMA) && defined(DMA_DISTRIBUTED)
+  // every core issues its slices of the parameters of the first layer
+  dmaLoadLayer(&dmaQueue, &lay, W1, B1, W2, B2, H, C);
+  dmaQueueWait(&dmaQueue);
+#endif
+
+  synch_barrier(); // TODO: needed???
+
+#ifdef WEIGHT_COMPRESSION
+  if(lay.type == LINEAR)
+    weightExpandLayer(&lay, W1);
+#endif
+
+#ifdef BANK_PLACEMENT
+  bankReplicateLUTs();
+#endif
+          
+#endif // MULTICORE
+
+  synch_barrier();
+  PROFILING_ALL_START
+
+/*****************************************************************************
+ *
+ * Current Layer Execution
+ *
+ *****************************************************************************/
+  short toFIRST = False;
+  for(int i = 0; i < depth; i++)
+  {
+    PROFILING_LAYER_START(i)
+
+#ifdef MULTICORE
+    int dma_idx = 0;
+
+    // switch buffers
+    if(toFIRST) 
+    {
+      W1 = &linear_Weights[BUFFER_LIN_W1_SIZE2];
+      B1 = &linear_Bias[BUFFER_LIN_B1_SIZE2];
+      W2 = &linear_Weights2[BUFFER_LIN_W2_SIZE2];
+      B2 = &linear_Bias2[BUFFER_LIN_B2_SIZE2];
+
+      W1_next = &linear_Weights[0];
+      B1_next = &linear_Bias[0];
+      W2_next = &linear_Weights2[0];
+      B2_next = &linear_Bias2[0];
+
+      H = &linear_H[BUFFER_LIN_H_SIZE2];
+      C = &linear_C[BUFFER_LIN_C_SIZE2];
+      H_next = &linear_H[0];
+      C_next = &linear_C[0];
+
+    }
+    else 
+    {
+      W1 = &linear_Weights[0];
+      B1 = &linear_Bias[0];
+      W2 = &linear_Weights2[0];
+      B2 = &linear_Bias2[0];
+
+      W1_next = &linear_Weights[BUFFER_LIN_W1_SIZE2];
+      B1_next = &linear_Bias[BUFFER_LIN_B1_SIZE2];
+      W2_next = &linear_Weights2[BUFFER_LIN_W2_SIZE2];
+      B2_next = &linear_Bias2[BUFFER_LIN_B2_SIZE2];
+
+      H = &linear_H[0];
+      C = &linear_C[0];
+      H_next = &linear_H[BUFFER_LIN_H_SIZE2];
+      C_next = &linear_C[BUFFER_LIN_C_SIZE2];
+
+    }
+#ifdef MULTI_MODEL
+    // same ring within the L1 slices of the core group
+    W1      = &linear_Weights[coreGroupL1Offset(BUFFER_LIN_W1_SIZE, toFIRST)];
+    W1_next = &linear_Weights[coreGroupL1Offset(BUFFER_LIN_W1_SIZE, !toFIRST)];
+    B1      = &linear_Bias[coreGroupL1Offset(BUFFER_LIN_B1_SIZE, toFIRST)];
+    B1_next = &linear_Bias[coreGroupL1Offset(BUFFER_LIN_B1_SIZE, !toFIRST)];
+    W2      = &linear_Weights2[coreGroupL1Offset(BUFFER_LIN_W2_SIZE, toFIRST)];
+    W2_next = &linear_Weights2[coreGroupL1Offset(BUFFER_LIN_W2_SIZE, !toFIRST)];
+    B2      = &linear_Bias2[coreGroupL1Offset(BUFFER_LIN_B2_SIZE, toFIRST)];
+    B2_next = &linear_Bias2[coreGroupL1Offset(BUFFER_LIN_B2_SIZE, !toFIRST)];
+    H       = &linear_H[coreGroupL1Offset(BUFFER_LIN_H_SIZE, toFIRST)];
+    H_next  = &linear_H[coreGroupL1Offset(BUFFER_LIN_H_SIZE, !toFIRST)];
+    C       = &linear_C[coreGroupL1Offset(BUFFER_LIN_C_SIZE, toFIRST)];
+    C_next  = &linear_C[coreGroupL1Offset(BUFFER_LIN_C_SIZE, !toFIRST)];
+#endif
+#endif //MULTICORE
+
+    // printf("INFO - Layer %d %d core %d\n", i, toFIRST, rt_core_id());
+    struct layer lay = network[i];
+    struct layer lay_next;
+    BARRIER_PROFILE_LAYER_START(i, lay.type, lay.attributes[0], lay.attributes[1])
+    DMA_PROFILE_LAYER_START(i, lay.type, i+1<depth ? network[i+1].type : lay.type)
+
+    if(i+1<depth)
+    {
+
+ /*****************************************************************************
+ *
+ * Start Copy Weight Data of next layer
+ *
+ *****************************************************************************/
+    #ifdef MULTICORE
+    #if defined(DMA) && defined(DMA_DISTRIBUTED)
+      // every core issues its slices of the parameters of the next layer (completed at the end of the layer)
+      lay_next = network[i+1];
+      dmaLoadLayer(&dmaQueue, &lay_next, W1_next, B1_next, W2_next, B2_next, H_next, C_next);
+    #else
+      if ( core_id==0 )
+      {
+        lay_next = network[i+1];
+
+        // printf("INFO - copy weigt data of next layer!!! \n");
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        // LINEAR
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        if(lay_next.type == LINEAR)
+        {
+          // printf("INFO - copy weigt data of next layer!!! LINEAR asd\n");
+
+          act_size = (unsigned short) 2*lay_next.attributes[LAY_LIN_IN];
+
+      #ifdef DMA
+          unsigned short b_size = lay_next.attributes[LAY_LIN_OUT]*2;
+          unsigned w_size = (b_size)*(act_size);
+
+          // Copy Bias
+          dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_BIAS]))), (uint32_t) (((v2s*)B1_next)), b_size, 1);
+          dma_idx += 1;
+
+        #ifdef WEIGHT_COMPRESSION
+          // compressed weights, expanded into W1_next at the end of the layer
+          dma_idx += weightCompLoad(lay_next.parameters[LAY_LIN_WEIGHTS], W1_next, &dma_trans_ids[dma_idx], 1);
+          (void) w_size;
+        #else
+          if (w_size >= 65532)
+          {
+            // printf("\033[91mWARNING - DATA too big for DMA 2 !!!\033[0m\n");
+
+            // printf("dma bias size: %d \n", b_size);
+            // printf("dma weight size: %d %d %d %x \n", w_size, b_size, act_size, (uint32_t) ((v2s*)W1_next));
+            int nr_dma_tiles                          = w_size / 65532;
+            int dima_tiles_overflow                   = w_size % 65532;
+            if (dima_tiles_overflow!=0) nr_dma_tiles +=1;
+
+            unsigned short curr_w_size = 0;
+            int curr_w_idx = 0;
+            int curr_w_idx_local = 0;
+
+            // printf("core %d  nr_dma_tiles %d dima_tiles_overflow %d  \n", rt_core_id(), nr_dma_tiles, dima_tiles_overflow);
+
+            for(int d=0; d<nr_dma_tiles; d++)
+            // for(int d=0; d<3; d++)
+            {
+              if(d==nr_dma_tiles-1)
+              {
+                curr_w_size = dima_tiles_overflow/2;
+                curr_w_idx = (d*65532)/2;
+                curr_w_idx_local = (curr_w_idx+1)/2;
+              }
+              else
+              {
+                curr_w_size = 65532;
+                curr_w_idx = (d*65532)/2;
+                curr_w_idx_local = ((curr_w_idx+1)/2);
+              }
+
+              // printf("core %d %d value %d \n", rt_core_id(), 0, *(lay_next.parameters[LAY_LIN_WEIGHTS]+curr_w_idx) );
+ 
+              dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_WEIGHTS]+curr_w_idx))), (uint32_t) (((v2s*)W1_next+curr_w_idx_local)), curr_w_size,  1);
+              dma_idx += 1;
+            }
+          }
+          else
+          {
+            dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_WEIGHTS]))), (uint32_t) (((v2s*)W1_next)), w_size,  1);
+            dma_idx += 1;
+          }
+        #endif // WEIGHT_COMPRESSION
+      #else // no DMA
+
+          for(int m = 0; m < lay_next.attributes[LAY_LIN_OUT]; m++)
+          {
+            B1_next[m] = lay_next.parameters[LAY_LIN_BIAS][m];
+        #ifndef WEIGHT_COMPRESSION // expanded by all cores at the end of the layer
+            for(int n = 0; n < lay_next.attributes[LAY_LIN_IN] + W_OFFSET; n++) //+2
+            {
+              W1_next[m*(lay_next.attributes[LAY_LIN_IN]+W_OFFSET)+n] = lay_next.parameters[LAY_LIN_WEIGHTS][m*(lay_next.attributes[LAY_LIN_IN])+n];
+            }
+        #endif
+          }
+
+      #endif // DMA
+
+        }
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        // LSTM
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        else if(lay_next.type == LSTM)
+        {
+          // printf("INFO - copy weigt data of next layer!!! LSTM\n");
+
+          act_size = (unsigned short) 2*lay_next.attributes[LAY_LSTM_IN];
+
+#ifdef DMA
+          unsigned short hidden_4_size = 2*lay_next.attributes[LAY_LSTM_HID];
+          // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay_next.parameters[LSTM_H])), (uint32_t) (((v2s*)H_next)), hidden_4_size,  1));
+          dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)lay_next.parameters[LSTM_H])), (uint32_t) (((v2s*)H_next)), hidden_4_size,  1);
+          dma_idx += 1;
+          // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)lay_next.parameters[LSTM_C])), (uint32_t) (((v2s*)C_next)), hidden_4_size,  1));
+          dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)lay_next.parameters[LSTM_C])), (uint32_t) (((v2s*)C_next)), hidden_4_size,  1);
+          dma_idx += 1;
+#else
+          for(int j = 0; j < lay_next.attributes[LAY_LSTM_HID]; j++)
+          {
+            H_next[j] = lay_next.parameters[LSTM_H][j];
+            C_next[j] = lay_next.parameters[LSTM_C][j];
+          }
+#endif
+
+      #ifdef DMA
+          unsigned short b_size = 2*4*lay_next.attributes[LAY_LSTM_HID];
+          unsigned w_size = (b_size)*(act_size);
+          // printf("size %u \n", w_size);
+          if (w_size >= 65532)
+          {
+
+            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_BIAS]))),    (uint32_t) (((v2s*)B1_next)),    b_size,  1));
+            dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_BIAS]))),    (uint32_t) (((v2s*)B1_next)),    b_size,  1);
+            dma_idx += 1;
+            // printf("dma bias size: %d \n", b_size);
+            // printf("dma weight size: %d %d %d %x \n", w_size, b_size, act_size, (uint32_t) ((v2s*)W1_next));
+            int nr_dma_tiles           = w_size / 65532;
+            int dima_tiles_overflow    = w_size % 65532;
+            if (dima_tiles_overflow!=0) nr_dma_tiles+=1;
+            unsigned short curr_w_size = 0;
+            int curr_w_idx;
+
+            // printf("nr_dma_tiles %d dima_tiles_overflow %d  \n", nr_dma_tiles, dima_tiles_overflow);
+
+            for(int d=0; d<nr_dma_tiles; d++)
+            {
+              if(d==nr_dma_tiles-1)
+              {
+                curr_w_size = dima_tiles_overflow;
+                curr_w_idx = (d*65532)/2;
+              }
+              else
+              {
+                curr_w_size = 65532;
+                curr_w_idx  = d*curr_w_size/2;
+              }
+
+              // printf("dma_tile %d curr_w_size %d  curr_w_idx %d \n", d, curr_w_size, curr_w_idx);
+              dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LAY_LIN_WEIGHTS]+curr_w_idx))), (uint32_t) (((v2s*)W1_next+curr_w_idx)), curr_w_size,  1);
+              dma_idx += 1;
+            }
+          }
+          else
+          {
+            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_IH]))), (uint32_t) (((v2s*)B1_next)),     b_size,  1));
+            dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_IH]))), (uint32_t) (((v2s*)B1_next)),     b_size,  1);
+            dma_idx += 1;
+            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_IH]))), (uint32_t) (((v2s*)W1_next)),  w_size,  1));
+            dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_IH]))), (uint32_t) (((v2s*)W1_next)),  w_size,  1);
+            dma_idx += 1;
+            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_HH]))), (uint32_t) (((v2s*)B2_next)),    b_size,  1));
+            dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LSTM_BIAS_HH]))), (uint32_t) (((v2s*)B2_next)),    b_size,  1);
+            dma_idx += 1;
+            // plp_dma_wait(plp_dma_memcpy((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_HH]))), (uint32_t) (((v2s*)W2_next)), b_size*2*lay_next.attributes[LAY_LSTM_HID],  1));
+            dma_trans_ids[dma_idx] = DMA_PREFETCH((uint32_t) (((v2s*)(lay_next.parameters[LSTM_WGHT_HH]))), (uint32_t) (((v2s*)W2_next)), b_size*2*lay_next.attributes[LAY_LSTM_HID],  1);
+            dma_idx += 1;
+          }
+
+      #else // no DMA
+
+          for(int m = 0; m < 4*lay_next.attributes[LAY_LSTM_HID]; m++)
+          {
+            B1_next[m] = lay_next.parameters[LSTM_BIAS_IH][m];
+            B2_next[m] = lay_next.parameters[LSTM_BIAS_HH][m];
+
+            for(int n = 0; n < lay_next.attributes[LAY_LSTM_IN] + W_OFFSET; n++) //+2
+            {
+              W1_next[m*(lay_next.attributes[LAY_LSTM_IN]+W_OFFSET)+n] = lay_next.parameters[LSTM_WGHT_IH][m*(lay_next.attributes[LAY_LSTM_IN])+n];
+            }
+            for(int n = 0; n < lay_next.attributes[LAY_LSTM_HID] + W_OFFSET; n++) //+2
+            {
+              W2_next[m*(lay_next.attributes[LAY_LSTM_HID]+W_OFFSET)+n] = lay_next.parameters[LSTM_WGHT_HH][m*(lay_next.attributes[LAY_LSTM_HID])+n];
+            }
+          }
+      #endif // DMA
+      
+        }
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        // OUTPUT HEADS (no parameters)
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        else if(lay_next.type == SOFTMAX || lay_next.type == ARGMAX || lay_next.type == TOPK)
+        {
+        }
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        // CONVOLUTION
+        //////////////////////////////////////////////////////////////////////////////////////////////
+        else
+        {
+          printf("ERROR - only Lin Layer or LSTM are supported!!! \n");
+          // return 1;
+        }
+      }
+    #endif // DMA_DISTRIBUTED
+    #endif
+
+    }
+    // synch_barrier();
+
+
+/*****************************************************************************
+ *
+ * LINEAR LAYER
+ *
+ *****************************************************************************/
+      if(lay.type == LINEAR)
+      {
+
+
+  #ifdef DEBUG_LSTM
+    #ifdef MULTICORE
+        if ( core_id<lay.attributes[LAY_LIN_TILES] )
+        {
+    #endif
+        printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
+        printf("Inputs in: ");
+        PrintTensor(lay.attributes[LAY_LIN_IN], in);
+
+        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
+        printf("bias in: ");
+        PrintTensor(lay.attributes[LAY_LIN_OUT], B1);
+
+        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
+        printf("weights in: ");
+        PrintTensor(lay.attributes[LAY_LIN_OUT]*lay.attributes[LAY_LIN_IN], W1);
+    #ifdef MULTICORE
+        }
+    #endif
+  #endif
+
+#if defined(AUTOTUNE) && !defined(TILING)
+        if(lay.attributes[LAY_LIN_FUSED_OPS] == FUSE_NONE)
+        {
+  #ifdef MULTICORE
+          LINEAR_MAX_TILE = tuneLinearLayer(&lay, W1, B1, in, out);
+  #else
+          LINEAR_MAX_TILE = tuneLinearLayer(&lay, lay.parameters[LAY_LIN_WEIGHTS], lay.parameters[LAY_LIN_BIAS], in, out);
+  #endif
+        }
+#endif // AUTOTUNE
+
+#ifdef MULTICORE
+        // printf("INFO - inside 3!!! \n");
+        if ( core_id<lay.attributes[LAY_LIN_TILES] )
+        {
+  #ifdef TILING
+          LinearLayer(lay.attributes[LAY_LIN_IN],
+                      chunk, //lay.attributes[LAY_LIN_OUT],
+                      True,
+                      W1, //linear_Weights,
+                      B1, //linear_Bias,
+                      // Input and Output Features
+                      in,   //inFeatures,
+                      out+(start)); // outFeatures
+  #else // no TILING
+          // printf("INFO - inside 3a!!! \n");
+    #if defined(BANK_PLACEMENT) && !defined(BATCHING)
+          // every core reads the input FM from its own bank-staggered replica
+          data_t * linIn = bankReplicateInput(in, lay.attributes[LAY_LIN_IN]);
+    #else
+          data_t * linIn = in;
+    #endif
+    #if defined(LAYER_FUSION) && !defined(BATCHING)
+          if(lay.attributes[LAY_LIN_FUSED_OPS] != FUSE_NONE)
+          {
+            FusedLinearLayer(lay.attributes[LAY_LIN_IN],
+                      lay.attributes[LAY_LIN_OUT],
+                      lay.attributes[LAY_LIN_FUSED_OPS],
+                      W1, //linear_Weights,
+                      B1, //linear_Bias,
+                      &lay.parameters[LAY_LIN_FUSED_TENSORS],
+                      // Input and Output Features
+                      linIn,   //inFeatures,
+                      out); // outFeatures
+          }
+          else
+    #endif // LAYER_FUSION
+    #if defined(BATCHING) && defined(GEMM_BATCHING)
+          // all BATCHING input vectors per weight load
+          GemmLayer(lay.attributes[LAY_LIN_IN],
+                      lay.attributes[LAY_LIN_OUT],
+                      BATCHING,
+                      True,
+                      W1, //linear_Weights,
+                      B1, //linear_Bias,
+                      // Input and Output Features
+                      linIn,   //inFeatures,
+                      out); // outFeatures
+    #else
+          LinearLayer(lay.attributes[LAY_LIN_IN],
+                      lay.attributes[LAY_LIN_OUT],
+    #ifdef EFFICIENT_CORE_ASSIGNMENT
+                      lay.attributes[LAY_LIN_TILE_SIZE],
+    #endif
+                      True,
+    #ifdef BATCHING
+                      BATCHING,
+    #endif
+                      W1, //linear_Weights,
+                      B1, //linear_Bias,
+                      // Input and Output Features
+                      linIn,   //inFeatures,
+                      out); // outFeatures
+    #endif // GEMM_BATCHING
+          // printf("INFO - inside 3b!!! \n");
+  #endif // TILING
+        }
+        // synch_barrier();
+        // printf("INFO - inside 4!!! \n");
+#else
+  #ifdef TILING
+        LinearLayer(lay.attributes[LAY_LIN_IN],
+                    chunk,
+                    True,
+                    lay.parameters[LAY_LIN_WEIGHTS],
+                    lay.parameters[LAY_LIN_BIAS],
+                    // Input and Output Features
+                    in,   //inFeatures,
+                    out+(start)); // outFeatures
+  #else // no TILING
+    #if defined(LAYER_FUSION) && !defined(BATCHING)
+        if(lay.attributes[LAY_LIN_FUSED_OPS] != FUSE_NONE)
+        {
+          FusedLinearLayer(lay.attributes[LAY_LIN_IN],
+                    lay.attributes[LAY_LIN_OUT],
+                    lay.attributes[LAY_LIN_FUSED_OPS],
+                    lay.parameters[LAY_LIN_WEIGHTS],
+                    lay.parameters[LAY_LIN_BIAS],
+                    &lay.parameters[LAY_LIN_FUSED_TENSORS],
+                    // Input and Output Features
+                    in,   //inFeatures,
+                    out); // outFeatures
+        }
+        else
+    #endif // LAYER_FUSION
+        LinearLayer(lay.attributes[LAY_LIN_IN],
+                    lay.attributes[LAY_LIN_OUT],
+      #ifdef EFFICIENT_CORE_ASSIGNMENT
+                    lay.attributes[LAY_LIN_TILE_SIZE],
+      #endif
+                    True,
+                    lay.parameters[LAY_LIN_WEIGHTS],
+                    lay.parameters[LAY_LIN_BIAS],
+                    // Input and Output Features
+                    in,   //inFeatures,
+                    out); // outFeatures
+  #endif // TILING
+#endif
+
+  #ifdef DEBUG_LSTM
     #ifdef MULTICORE
         if ( core_id<lay.attributes[LAY_LIN_TILES] )
         {
     #endif
-        printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
+        printf("Results in: ");
+      #ifdef BATCHING
+        PrintTensor(2*lay.attributes[LAY_LIN_OUT], out);
+      #else
+        PrintTensor(lay.attributes[LAY_LIN_OUT], out);
+      #endif
+    #ifdef MULTICORE
+        }
+    #endif
+  #endif
+
+
+#ifdef TILING
+        }
+#endif // TILING
+#ifdef AUTOTUNE
+        LINEAR_MAX_TILE = OUTPUTBUFFER;
+#endif
+
+        toFIRST ^= 1;
+
+        // switch buffer (double buffering)
+        if(toFIRST)
+        {
+          in  = &buffer[BUFFER_SIZE2];
+          out = &buffer[0];
+        }
+        else 
+        {
+          in  = &buffer[0];
+          out = &buffer[BUFFER_SIZE2];
+        }
+      }
+
+/*****************************************************************************
+ *
+ * LSTM LAYER
+ *
+ *****************************************************************************/
+      else if (lay.type == LSTM) {
+
+  #ifdef DEBUG_LSTM
+    #ifdef MULTICORE
+        if ( core_id<lay.attributes[LAY_LSTM_TILES] )
+        {
+    #endif
+        printf("LSTM (%i, %i)\n", lay.attributes[LAY_LSTM_IN], lay.attributes[LAY_LSTM_HID]);
         printf("Inputs in: ");
-        PrintTensor(lay.attributes[LAY_LIN_IN], in);
+        PrintTensor(lay.attributes[LAY_LSTM_IN], in);
+        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
+        printf("bias in1: ");
+        PrintTensor(lay.attributes[LAY_LSTM_HID]*4, B1);
+        printf("bias in2: ");
+        PrintTensor(lay.attributes[LAY_LSTM_HID]*4, B2);
+
+        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
+        printf("weights in1: ");
+        PrintTensor(lay.attributes[LAY_LSTM_HID]*4*lay.attributes[LAY_LSTM_IN], W1);
+        printf("weights in2: ");
+        PrintTensor(lay.attributes[LAY_LSTM_HID]*4*lay.attributes[LAY_LSTM_HID], W2);
+    #ifdef MULTICORE
+        }
+    #endif
+  #endif
+
+        int numHidden = lay.attributes[LAY_LSTM_HID];
+        data_t * lstm_h_new;
+#ifdef MULTICORE
+        // synch_barrier();
+        // if ( rt_core_id()<NR_CORES )
+        // {
+        lstm_h_new = LSTMLayer ( // Layer Attributes
+                    lay.attributes[LAY_LSTM_IN], numHidden,
+                    // Layer Parameters
+                    W1, //linear_Weights, //lay.parameters[LSTM_WGHT_IH],
+                    W2, //linear_Weights2, //lay.parameters[LSTM_WGHT_HH],
+                    B1, //linear_Bias, //lay.parameters[LSTM_BIAS_IH],
+                    B2,//linear_Bias2, //lay.parameters[LSTM_BIAS_HH],
+                    // Input and Output Features
+                    in,
+                    H, //lay.parameters[LSTM_H],
+                    // Hidden Features
+                    C, //lay.parameters[LSTM_C],
+                    // intermediate nodes
+                    out,
+                    out + 2*numHidden*1, //f
+                    out + 3*numHidden*1, //i
+                    out + 4*numHidden*1, //g
+                    out + 5*numHidden*1  //o
+                  );
+        // }
+        // synch_barrier();
+#else
+        lstm_h_new = LSTMLayer ( // Layer Attributes
+                    lay.attributes[LAY_LSTM_IN], numHidden,
+                    // Layer Parameters
+                    lay.parameters[LSTM_WGHT_IH],
+                    lay.parameters[LSTM_WGHT_HH],
+                    lay.parameters[LSTM_BIAS_IH],
+                    lay.parameters[LSTM_BIAS_HH],
+                    // Input and Output Features
+                    in,
+                    lay.parameters[LSTM_H],
+                    // Hidden Features
+                    lay.parameters[LSTM_C],
+                    // intermediate nodes
+                    out, //h_out
+                    out + 2*numHidden*1, //f
+                    out + 3*numHidden*1, //i
+                    out + 4*numHidden*1, //g
+                    out + 1*numHidden*1//o
+                  );
+        // in  =  (data_t *)lay.parameters[LSTM_H];
+        // in  =  (data_t *)lay.parameters[LSTM_H];
+#endif
+
+
+  #ifdef DEBUG_LSTM
+    #ifdef MULTICORE
+        if ( core_id<lay.attributes[LAY_LSTM_TILES] )
+        {
+    #endif
+        printf("Results at: ");
+// #ifdef MULTICORE
+//         PrintTensor(lay.attributes[LAY_LSTM_HID], linear_H);
+// #else
+        PrintTensor(lay.attributes[LAY_LSTM_HID], out);
+// #endif
+    #ifdef MULTICORE
+        }
+    #endif
+  #endif
+
+        // h_t is left in the hidden state ring (H for an even number of timesteps), it is copied
+        // to out once per layer, as H is reused by the state prefetch of the next but one layer
+        // and the returned FM must not point into the ring
+        if(lstm_h_new != out)
+        {
+#ifdef MULTICORE
+          int chunk = (numHidden+NR_CORES-1)/NR_CORES;
+          int start = MIN(chunk*core_id, numHidden);
+          int stop  = MIN(start+chunk, numHidden);
+          CopyTensor(stop-start, out+start, lstm_h_new+start);
+          synch_barrier();
+#else
+          CopyTensor(numHidden, out, lstm_h_new);
+#endif
+        }
+
+        toFIRST ^= 1; 
+
+        // switch buffers
+        if(toFIRST) 
+        {
+          in  = &buffer[BUFFER_SIZE2];
+          out = &buffer[0];
+        }
+        else 
+        {
+          in  = &buffer[0];
+          out = &buffer[BUFFER_SIZE2];
+        }
+
+      }
+/*****************************************************************************
+ *
+ * Conv2D LAYER
+ *
+ *****************************************************************************/
+      else if(lay.type == Conv2d) {
+
+  #ifdef DEBUG_LSTM
+        printf("Conv2D (%i->%i, ker=%i^2, h*w=%i*%i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT], lay.attributes[LAY_CONV_KER],lay.attributes[LAY_CONV_H],lay.attributes[LAY_CONV_W]);
+        printf("Inputs in: ");
+        PrintTensor(lay.attributes[LAY_LIN_IN]*lay.attributes[LAY_CONV_H]*lay.attributes[LAY_CONV_W], in);
+  #endif
+
+        Conv2dLayer(&lay,
+                    lay.attributes[LAY_CONV_H],
+                    lay.attributes[LAY_CONV_W],
+                    in,
+                    out
+                    );
+
+  #ifdef DEBUG_LSTM
+        printf("Conv2D (%i->%i, ker=%i^2, h*w=%i*%i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT], lay.attributes[LAY_CONV_KER],lay.attributes[LAY_CONV_H],lay.attributes[LAY_CONV_W]);
+        printf("Results in: ");
+        PrintTensor(lay.attributes[LAY_CONV_OUT]*lay.attributes[LAY_CONV_H]*lay.attributes[LAY_CONV_W], out);
+  #endif
+
+        toFIRST ^= 1; 
+
+        // switch buffers
+        if(toFIRST) 
+        {
+          in  = &buffer[BUFFER_SIZE2];
+          out = &buffer[0];
+        }
+        else 
+        {
+          in  = &buffer[0];
+          out = &buffer[BUFFER_SIZE2];
+        }
+
+      }
+/*****************************************************************************
+ *
+ * Output Heads (Softmax, Argmax, Top-k)
+ *
+ *****************************************************************************/
+      else if(lay.type == SOFTMAX || lay.type == ARGMAX || lay.type == TOPK) {
+
+        if(lay.type == SOFTMAX)
+        {
+          SoftmaxLayer(lay.attributes[LAY_HEAD_IN], in, out);
+        }
+        else if(lay.type == ARGMAX)
+        {
+          ArgmaxLayer(lay.attributes[LAY_HEAD_IN], in, out);
+        }
+        else
+        {
+          TopKLayer(lay.attributes[LAY_HEAD_IN], lay.attributes[LAY_HEAD_K], in, out);
+        }
+
+  #ifdef DEBUG_LSTM
+        printf("Head (%i, k=%i)\n", lay.attributes[LAY_HEAD_IN], lay.attributes[LAY_HEAD_K]);
+        printf("Results in: ");
+        PrintTensor(lay.type == SOFTMAX ? lay.attributes[LAY_HEAD_IN] : MAX(lay.attributes[LAY_HEAD_K], 1), out);
+  #endif
+
+        toFIRST ^= 1; 
+
+        // switch buffers
+        if(toFIRST) 
+        {
+          in  = &buffer[BUFFER_SIZE2];
+          out = &buffer[0];
+        }
+        else 
+        {
+          in  = &buffer[0];
+          out = &buffer[BUFFER_SIZE2];
+        }
+
+      }
+      else {
+        printf("\033[91mERROR: not a valid layer\033[0m\n");
+      }
+
+#ifdef MULTICORE
+#if defined(DMA) && defined(DMA_DISTRIBUTED)
+        dmaQueueWait(&dmaQueue);
+#else
+        DMA_PROFILE_WAIT(dma_idx)
+#ifdef INFER_PIPELINE
+        // only the prefetches of this layer, the input and output transfers of the inference queue keep running
+        for(int t=0; t<dma_idx; t++)
+          plp_dma_wait(dma_trans_ids[t]);
+#else
+        plp_dma_barrier();
+#endif
+#endif
+#endif
+      synch_barrier();
+#ifdef WEIGHT_COMPRESSION
+      if(i+1<depth && network[i+1].type == LINEAR)
+        weightExpandLayer(&network[i+1], W1_next);
+#endif
+      PROFILING_LAYER_END(lay.type)
+      BARRIER_PROFILE_LAYER_END()
+    }
 
-        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
-        printf("bias in: ");
-        PrintTensor(lay.attributes[LAY_LIN_OUT], B1);
+  return &in[0]; // return address of output feature map
+}
 
-        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
-        printf("weights in: ");
-        PrintTensor(lay.attributes[LAY_LIN_OUT]*lay.attributes[LAY_LIN_IN], W1);
-    #ifdef MULTICORE
+
+#ifdef ASYNC_INFERENCE
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Asynchronous inference queue
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/** @brief Initializes an empty inference queue (FC, before the cluster serves it) */
+void inferQueueInit (struct infer_queue * queue) {
+    queue->head     = 0;
+    queue->tail     = 0;
+    queue->notified = 0;
+    queue->stop     = 0;
+    queue->current  = NULL;
+}
+
+/** @brief Submits an inference request without waiting (FC)
+ *
+ *  @param queue Inference queue
+ *  @param req Request, has to stay valid until its callback has been called
+ *  @return 0 or -1 if the queue is full (call inferPoll to release completed requests)
+ */
+int inferSubmit (struct infer_queue * queue, struct infer_request * req) {
+    if(queue->head - queue->notified >= INFER_QUEUE_SIZE)
+      return -1;
+    req->done   = 0;
+    req->result = NULL;
+#ifdef DEADLINE_SCHEDULER
+    req->wcet   = networkWcet(req->network, req->depth, NR_CORES);
+#endif
+    queue->slot[queue->head % INFER_QUEUE_SIZE] = req;
+    INFER_QUEUE_FENCE();
+    queue->head++;
+    return 0;
+}
+
+/** @brief Calls the callbacks of the completed requests in submission order (FC, non-blocking)
+ *
+ *  @param queue Inference queue
+ *  @return Number of requests which have been notified
+ */
+int inferPoll (struct infer_queue * queue) {
+    int count = 0;
+    unsigned int tail = queue->tail;
+    INFER_QUEUE_FENCE();
+    while(queue->notified != tail)
+    {
+      struct infer_request * req = queue->slot[queue->notified % INFER_QUEUE_SIZE];
+      queue->notified++;
+      if(req->callback)
+        req->callback(req, req->arg);
+      count++;
+    }
+    return count;
+}
+
+/** @brief Waits for a submitted request, the callbacks of all completed requests are called (FC) */
+void inferWait (struct infer_queue * queue, struct infer_request * req) {
+    while(!req->done)
+      INFER_QUEUE_IDLE();
+    inferPoll(queue);
+}
+
+/** @brief Lets inferQueueServe return once all submitted requests are completed (FC) */
+void inferQueueStop (struct infer_queue * queue) {
+    INFER_QUEUE_FENCE();
+    queue->stop = 1;
+}
+
+/** @brief Marks a request as completed, its output is in place (cluster core 0) */
+static void inferComplete (struct infer_queue * queue, struct infer_request * req, data_t * out) {
+    req->result = out;
+    INFER_QUEUE_FENCE();
+    queue->tail++;
+    // inferWait relies on tail being up to date once done is set
+    INFER_QUEUE_FENCE();
+    req->done = 1;
+}
+
+#ifdef INFER_PIPELINE
+/** @brief Number of input elements of a network (input FM of the first layer) */
+static int networkInSize (struct layer * network) {
+    if(network[0].type == LINEAR)
+      return network[0].attributes[LAY_LIN_IN];
+    if(network[0].type == LSTM || network[0].type == RNN)
+      return network[0].attributes[LAY_LSTM_IN];
+    return network[0].attributes[LAY_HEAD_IN];
+}
+
+/** @brief Computes the requests of the queue back-to-back in a three stage pipeline (called by all cluster cores)
+ *
+ *  While inference k runs, core 0 has started the DMA transfers of the input of request k+1 into
+ *  the other L1 input stage (inferPipeIn) and of the output of request k-1 back to its destination.
+ *  The inferences alternate between buffer and inferPipeBuffer, i.e. the output FM of request k-1
+ *  stays untouched during inference k. Request k-1 is marked done after inference k, or as soon as
+ *  the queue runs empty. Requests without destination get the output in the FM buffer, which is
+ *  valid until the next but one request.
+ *
+ *  @param queue Inference queue
+ *  @param buffer Buffer to store intermediate results (as for inferNetwork)
+ */
+void inferQueueServe (struct infer_queue * queue, data_t * buffer) {
+    int core_id = rt_core_id();
+    unsigned int fetched = queue->tail;    // requests started (core 0)
+    struct infer_request * pending = NULL; // output write-back in flight (core 0)
+    data_t * pendingOut = NULL;
+    struct infer_request * staged = NULL;  // input prefetched into the next stage (core 0)
+    int pendingId = 0, stagedId = 0;
+
+    for(int k=0; ; k++)
+    {
+      data_t * stage = inferPipeIn[k%2];
+
+      if(core_id == 0)
+      {
+        // a request which is not followed by another one is completed before the cluster idles
+        if(pending && fetched == queue->head)
+        {
+          plp_dma_wait(pendingId);
+          inferComplete(queue, pending, pendingOut);
+          pending = NULL;
         }
-    #endif
-  #endif
+        while(fetched == queue->head && !queue->stop)
+          INFER_QUEUE_IDLE();
+        INFER_QUEUE_FENCE();
+        struct infer_request * req = fetched != queue->head ? queue->slot[fetched % INFER_QUEUE_SIZE] : NULL;
 
-#ifdef MULTICORE
-        // printf("INFO - inside 3!!! \n");
-        if ( core_id<lay.attributes[LAY_LIN_TILES] )
+        if(req)
         {
-  #ifdef TILING
-          LinearLayer(lay.attributes[LAY_LIN_IN],
-                      chunk, //lay.attributes[LAY_LIN_OUT],
-                      True,
-                      W1, //linear_Weights,
-                      B1, //linear_Bias,
-                      // Input and Output Features
-                      in,   //inFeatures,
-                      out+(start)); // outFeatures
-  #else // no TILING
-          // printf("INFO - inside 3a!!! \n");
-          LinearLayer(lay.attributes[LAY_LIN_IN],
-                      lay.attributes[LAY_LIN_OUT],
-    #ifdef EFFICIENT_CORE_ASSIGNMENT
-                      lay.attributes[LAY_LIN_TILE_SIZE],
-    #endif
-                      True,
-    #ifdef BATCHING
-                      BATCHING,
-    #endif
-                      W1, //linear_Weights,
-                      B1, //linear_Bias,
-                      // Input and Output Features
-                      in,   //inFeatures,
-                      out); // outFeatures
-          // printf("INFO - inside 3b!!! \n");
-  #endif // TILING
+          fetched++;
+          if(staged == req)
+            plp_dma_wait(stagedId);
+          else
+            plp_dma_wait(plp_dma_memcpy((uintptr_t) req->inFeatures, (uintptr_t) stage, 2*networkInSize(req->network), 1));
+          staged = NULL;
+          // input of the next request, if it is already submitted
+          if(fetched != queue->head)
+          {
+            INFER_QUEUE_FENCE();
+            staged   = queue->slot[fetched % INFER_QUEUE_SIZE];
+            stagedId = plp_dma_memcpy((uintptr_t) staged->inFeatures, (uintptr_t) inferPipeIn[(k+1)%2],
+                                      2*networkInSize(staged->network), 1);
+          }
         }
-        // synch_barrier();
-        // printf("INFO - inside 4!!! \n");
+        queue->current = req;
+      }
+      synch_barrier();
+
+      struct infer_request * req = queue->current;
+      if(req == NULL)
+        break;
+
+      data_t * out = inferNetwork(req->network, req->depth, stage, k%2 ? inferPipeBuffer : buffer);
+
+      if(core_id == 0)
+      {
+        if(pending)
+        {
+          plp_dma_wait(pendingId);
+          inferComplete(queue, pending, pendingOut);
+          pending = NULL;
+        }
+        if(out == NULL) // rejected by inferNetwork, completed without output
+          inferComplete(queue, req, NULL);
+        else if(req->outFeatures)
+        {
+          pending    = req;
+          pendingOut = req->outFeatures;
+          pendingId  = plp_dma_memcpy((uintptr_t) req->outFeatures, (uintptr_t) out, 2*req->outSize, 0);
+        }
+        else
+          inferComplete(queue, req, out);
+      }
+      // queue->current is not updated before all cores have left the inference
+      synch_barrier();
+    }
+}
 #else
-  #ifdef TILING
-        LinearLayer(lay.attributes[LAY_LIN_IN],
-                    chunk,
-                    True,
-                    lay.parameters[LAY_LIN_WEIGHTS],
-                    lay.parameters[LAY_LIN_BIAS],
-                    // Input and Output Features
-                    in,   //inFeatures,
-                    out+(start)); // outFeatures
-  #else // no TILING
-        LinearLayer(lay.attributes[LAY_LIN_IN],
-                    lay.attributes[LAY_LIN_OUT],
-      #ifdef EFFICIENT_CORE_ASSIGNMENT
-                    lay.attributes[LAY_LIN_TILE_SIZE],
-      #endif
-                    True,
-                    lay.parameters[LAY_LIN_WEIGHTS],
-                    lay.parameters[LAY_LIN_BIAS],
-                    // Input and Output Features
-                    in,   //inFeatures,
-                    out); // outFeatures
-  #endif // TILING
-#endif
+/** @brief Computes the requests of the queue back-to-back (called by all cluster cores)
+ *
+ *  Core 0 polls the queue in L2 while the other cores wait in the barrier. The output FM is
+ *  copied to the destination of the request before the request is marked done, such that the
+ *  next inference can reuse the FM buffer while the FC post-processes the previous output.
+ *
+ *  @param queue Inference queue
+ *  @param buffer Buffer to store intermediate results (as for inferNetwork)
+ */
+void inferQueueServe (struct infer_queue * queue, data_t * buffer) {
+    int core_id = rt_core_id();
 
-  #ifdef DEBUG_LSTM
-    #ifdef MULTICORE
-        if ( core_id<lay.attributes[LAY_LIN_TILES] )
+    while(1)
+    {
+      if(core_id == 0)
+      {
+        while(queue->tail == queue->head && !queue->stop)
+          INFER_QUEUE_IDLE();
+        INFER_QUEUE_FENCE();
+        queue->current = queue->tail != queue->head ? queue->slot[queue->tail % INFER_QUEUE_SIZE] : NULL;
+      }
+      synch_barrier();
+
+      struct infer_request * req = queue->current;
+      if(req == NULL)
+        break;
+
+      data_t * out = inferNetwork(req->network, req->depth, req->inFeatures, buffer);
+
+      if(core_id == 0)
+      {
+        // out is NULL if inferNetwork rejected the network, the request is completed without output
+        if(out && req->outFeatures)
         {
-    #endif
-        printf("Results in: ");
-      #ifdef BATCHING
-        PrintTensor(2*lay.attributes[LAY_LIN_OUT], out);
-      #else
-        PrintTensor(lay.attributes[LAY_LIN_OUT], out);
-      #endif
-    #ifdef MULTICORE
+          for(int o=0; o<req->outSize; o++)
+            req->outFeatures[o] = out[o];
+          out = req->outFeatures;
         }
-    #endif
-  #endif
+        inferComplete(queue, req, out);
+      }
+      // queue->current is not updated before all cores have left the inference
+      synch_barrier();
+    }
+}
+#endif // INFER_PIPELINE
+#endif // ASYNC_INFERENCE
+
+
+#ifdef MULTI_MODEL
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Concurrent models on disjoint core groups
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/** @brief Group of every cluster core (NULL outside of inferNetworksConcurrent) */
+struct core_group * coreGroupOf[NR_CORES_MAX];
+/** @brief L1 FM buffers of the core groups which do not bring their own buffer */
+__attribute__ ((section(".heapsram"))) data_t coreGroupBuffers[CORE_GROUPS_MAX][BUFFER_SIZE];
+
+/** @brief Multiply-accumulate operations of one inference (element operations for the heads)
+ *
+ *  @param network Array of concecutive layers of the neural network
+ *  @param depth Number of Layers
+ *  @return MACs per inference
+ */
+long networkMacs (struct layer * network, int depth) {
+    long macs = 0;
+    for(int i=0; i<depth; i++)
+    {
+      struct layer * lay = &network[i];
+      if(lay->type == LINEAR)
+        macs += lay->attributes[LAY_LIN_IN]*lay->attributes[LAY_LIN_OUT];
+      else if(lay->type == RNN)
+        macs += (lay->attributes[LAY_LSTM_IN]+lay->attributes[LAY_LSTM_HID])*lay->attributes[LAY_LSTM_HID];
+      else if(lay->type == LSTM)
+        macs += 4*(lay->attributes[LAY_LSTM_IN]+lay->attributes[LAY_LSTM_HID])*lay->attributes[LAY_LSTM_HID];
+      else
+        macs += lay->attributes[LAY_HEAD_IN];
+    }
+    return macs;
+}
+
+/** @brief Checks that every layer of the model of a group fits into the slices of the L1 buffers
+ *
+ *  inferNetwork stages the parameters (and the LSTM states) of the current and of the next layer in
+ *  L1, concurrent groups get 1/nrGroups of every buffer (see coreGroupL1Offset).
+ */
+static int coreGroupFits (struct core_group * group) {
+    int g = group->nrGroups;
+    for(int i=0; i<group->depth; i++)
+    {
+      struct layer * lay = &group->network[i];
+      if(lay->type == LINEAR)
+      {
+        if(lay->attributes[LAY_LIN_OUT]*(lay->attributes[LAY_LIN_IN]+W_OFFSET) > coreGroupL1Half(BUFFER_LIN_W1_SIZE, g) ||
+           lay->attributes[LAY_LIN_OUT] > coreGroupL1Half(BUFFER_LIN_B1_SIZE, g))
+          return False;
+      }
+      else if(lay->type == LSTM)
+      {
+        int hid = lay->attributes[LAY_LSTM_HID];
+        if(4*hid*(lay->attributes[LAY_LSTM_IN]+W_OFFSET) > coreGroupL1Half(BUFFER_LIN_W1_SIZE, g) ||
+           4*hid*(hid+W_OFFSET) > coreGroupL1Half(BUFFER_LIN_W2_SIZE, g) ||
+           4*hid > coreGroupL1Half(BUFFER_LIN_B1_SIZE, g) || 4*hid > coreGroupL1Half(BUFFER_LIN_B2_SIZE, g) ||
+           hid > coreGroupL1Half(BUFFER_LIN_H_SIZE, g) || hid > coreGroupL1Half(BUFFER_LIN_C_SIZE, g))
+          return False;
+      }
+    }
+    return True;
+}
+
+/** @brief Splits the cluster cores into one contiguous group per model
+ *
+ *  Every group gets one core, then the group with the largest work per core relative to its
+ *  deadline is doubled as long as the remaining cores allow it (best-effort models are treated as
+ *  having the latest deadline). The kernels split the rows with __builtin_pulp_fl1(NR_CORES), i.e.
+ *  the group sizes have to be powers of two, the cores which are left over stay idle.
+ *
+ *  @param groups Models with network, depth, input and deadline
+ *  @param nrGroups Number of models
+ *  @param nrCores Number of cluster cores to distribute
+ *  @return 0 or -1 if the models cannot be assigned
+ */
+int coreGroupsPlan (struct core_group * groups, int nrGroups, int nrCores) {
+    int maxDeadline = 1;
+    int first = 0;
+    int spare;
+
+    if(nrGroups < 1 || nrGroups > CORE_GROUPS_MAX || nrGroups > nrCores || nrCores > NR_CORES_MAX)
+    {
+      printf("\033[91mERROR - %d models cannot be assigned to %d cores (at most CORE_GROUPS_MAX=%d)!!!\033[0m\n", nrGroups, nrCores, CORE_GROUPS_MAX);
+      return -1;
+    }
+    for(int g=0; g<nrGroups; g++)
+    {
+      groups[g].macs    = networkMacs(groups[g].network, groups[g].depth);
+      groups[g].nrCores = 1;
+      maxDeadline = Max(maxDeadline, groups[g].deadline);
+    }
+    spare = nrCores-nrGroups;
+    for(;;)
+    {
+      // macs/(cores*deadline) compared without division, among the groups which can be doubled
+      int worst = -1;
+      long long worstMacs = 0, worstScale = 1;
+      for(int g=0; g<nrGroups; g++)
+      {
+        long long scale = (long long)groups[g].nrCores*(groups[g].deadline > 0 ? groups[g].deadline : maxDeadline);
+        if(groups[g].nrCores <= spare && (worst < 0 || groups[g].macs*worstScale > worstMacs*scale))
+        {
+          worst      = g;
+          worstMacs  = groups[g].macs;
+          worstScale = scale;
+        }
+      }
+      if(worst < 0)
+        break;
+      spare -= groups[worst].nrCores;
+      groups[worst].nrCores *= 2;
+    }
+    for(int g=0; g<nrGroups; g++)
+    {
+      groups[g].firstCore = first;
+      groups[g].index     = g;
+      groups[g].nrGroups  = nrGroups;
+      groups[g].barrier   = 1+g;
+      first += groups[g].nrCores;
+      if(!coreGroupFits(&groups[g]))
+      {
+        printf("\033[91mERROR - the parameters of model %d do not fit its slice of the L1 buffers!!!\033[0m\n", g);
+        return -1;
+      }
+    }
+    return 0;
+}
+
+/** @brief Runs several models concurrently, each on the core group planned by coreGroupsPlan
+ *
+ *  Called by all cluster cores. Within inferNetwork the group core id, group size and group
+ *  barrier replace rt_core_id(), NR_CORES and synch_barrier() (see general.h), cores which are
+ *  not part of a group wait for the others. The outputs are in groups[g].outFeatures.
+ *
+ *  @param groups Planned core groups
+ *  @param nrGroups Number of core groups
+ */
+void inferNetworksConcurrent (struct core_group * groups, int nrGroups) {
+    int core_id = clusterCoreId();
+
+    if(core_id == 0)
+    {
+      for(int g=0; g<nrGroups; g++)
+      {
+        if(groups[g].buffer == NULL)
+          groups[g].buffer = coreGroupBuffers[g];
+        eu_bar_setup(eu_bar_addr(groups[g].barrier), ((1<<groups[g].nrCores)-1)<<groups[g].firstCore);
+        for(int c=groups[g].firstCore; c<groups[g].firstCore+groups[g].nrCores; c++)
+          coreGroupOf[c] = &groups[g];
+      }
+    }
+    clusterBarrier();
+
+    struct core_group * group = coreGroupOf[core_id];
+    if(group)
+    {
+      data_t * out = inferNetwork(group->network, group->depth, group->inFeatures, group->buffer);
+      if(coreGroupCoreId() == 0)
+        group->outFeatures = out;
+    }
+    clusterBarrier();
+    coreGroupOf[core_id] = NULL;
+}
+#endif // MULTI_MODEL
+
+
+#ifdef DEADLINE_SCHEDULER
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Deadline-aware inference
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/** @brief Worst-case cycles of one layer on the slowest core (without WCET_MARGIN)
+ *
+ *  Uses the cycle model of wcetTable measured on nrCores cores, or the one for any number of cores.
+ *
+ *  @param lay Layer
+ *  @param nrCores Number of cores computing the layer
+ *  @return Cycles or -1 if there is no cycle model for the layer type
+ */
+long layerWcet (struct layer * lay, int nrCores) {
+    struct wcet_entry * model = NULL;
+    for(int t=0; t<WCET_TABLE_SIZE && (wcetTable[t].fixed != 0 || wcetTable[t].perRow != 0); t++)
+    {
+      if(wcetTable[t].type != (int)lay->type)
+        continue;
+      if(wcetTable[t].cores == nrCores)
+      {
+        model = &wcetTable[t];
+        break;
+      }
+      if(wcetTable[t].cores == 0 && model == NULL)
+        model = &wcetTable[t];
+    }
+    if(model == NULL)
+      return -1;
+
+    long rows, macs; // rows of the layer and MACs per row
+    if(lay->type == LINEAR)
+    {
+      rows = lay->attributes[LAY_LIN_OUT];
+      macs = lay->attributes[LAY_LIN_IN];
+    }
+    else if(lay->type == RNN || lay->type == LSTM)
+    {
+      rows = (lay->type == LSTM ? 4 : 1)*lay->attributes[LAY_LSTM_HID];
+      macs = lay->attributes[LAY_LSTM_IN]+lay->attributes[LAY_LSTM_HID];
+    }
+    else
+    {
+      rows = lay->attributes[LAY_HEAD_IN];
+      macs = lay->type == TOPK ? lay->attributes[LAY_HEAD_K] : 0;
+    }
+
+    long rowsPerCore = (rows+nrCores-1)/nrCores;
+    return model->fixed + rowsPerCore*model->perRow + ((rowsPerCore*macs*model->perMac) >> WCET_FRAC_BITS);
+}
+
+/** @brief Worst-case cycles of one inference including the safety margin WCET_MARGIN
+ *
+ *  @param network Array of concecutive layers of the neural network
+ *  @param depth Number of Layers
+ *  @param nrCores Number of cores computing the network
+ *  @return Cycles or -1 if a layer has no cycle model
+ */
+long networkWcet (struct layer * network, int depth, int nrCores) {
+    long cycles = 0;
+    for(int i=0; i<depth; i++)
+    {
+      long layer = layerWcet(&network[i], nrCores);
+      if(layer < 0)
+        return -1;
+      cycles += layer;
+    }
+    return cycles + cycles*WCET_MARGIN/100;
+}
+
+/** @brief Admission test of a model against a cycle budget
+ *
+ *  @param model Primary and fallback model, the decision is stored in model->decision
+ *  @param budget Cycles until the deadline
+ *  @param backlog Cycles of the work which is computed before the model (e.g. queued inferences)
+ *  @param nrCores Number of cores computing the model
+ *  @return DEADLINE_PRIMARY, DEADLINE_FALLBACK or DEADLINE_REJECTED
+ */
+int deadlineAdmit (struct deadline_model * model, long budget, long backlog, int nrCores) {
+    long wcet = networkWcet(model->network, model->depth, nrCores);
+
+    model->decision = DEADLINE_REJECTED;
+    if(wcet >= 0 && backlog+wcet <= budget)
+      model->decision = DEADLINE_PRIMARY;
+    else if(model->fallback)
+    {
+      wcet = networkWcet(model->fallback, model->fallbackDepth, nrCores);
+      if(wcet >= 0 && backlog+wcet <= budget)
+        model->decision = DEADLINE_FALLBACK;
+    }
+    return model->decision;
+}
+
+/** @brief Runs the primary model if it meets the budget, otherwise the fallback model (all cores)
+ *
+ *  All cores take the same decision, no synchronization is needed before the inference.
+ *
+ *  @param model Primary and fallback model, the model which has been run is given by model->decision
+ *  @param inFeatures Input Feature Map
+ *  @param buffer Buffer to store intermediate results (as for inferNetwork)
+ *  @param budget Cycles until the deadline
+ *  @return Pointer to the output FM or NULL if the request is rejected
+ */
+data_t * NOINLINE inferNetworkDeadline (struct deadline_model * model, data_t * __restrict__ inFeatures,
+                                        data_t * __restrict__ buffer, long budget) {
+    int decision = deadlineAdmit(model, budget, 0, NR_CORES);
+
+    if(decision == DEADLINE_PRIMARY)
+      return inferNetwork(model->network, model->depth, inFeatures, buffer);
+    else if(decision == DEADLINE_FALLBACK)
+      return inferNetwork(model->fallback, model->fallbackDepth, inFeatures, buffer);
+    return NULL;
+}
+
+#ifdef ASYNC_INFERENCE
+/** @brief Worst-case cycles of the submitted requests which are not completed yet (FC)
+ *
+ *  The request in progress is counted completely.
+ *
+ *  @return Cycles or -1 if a queued request has no cycle model (unbounded backlog)
+ */
+long inferQueueBacklog (struct infer_queue * queue) {
+    long backlog = 0;
+    unsigned int head = queue->head;
+    for(unsigned int r=queue->tail; r != head; r++)
+    {
+      long wcet = queue->slot[r % INFER_QUEUE_SIZE]->wcet;
+      if(wcet < 0)
+        return -1;
+      backlog += wcet;
+    }
+    return backlog;
+}
+
+/** @brief Submits the primary or the fallback model if it completes before the deadline (FC)
+ *
+ *  The requests in the queue are computed first, their worst-case cycles are part of the budget.
+ *  If a queued request has no cycle model (see inferQueueBacklog) no model can be admitted.
+ *
+ *  @param queue Inference queue
+ *  @param req Request, network and depth are set to the admitted model
+ *  @param model Primary and fallback model
+ *  @param budget Cycles until the deadline of the request
+ *  @return DEADLINE_PRIMARY, DEADLINE_FALLBACK, DEADLINE_REJECTED (not submitted) or DEADLINE_QUEUE_FULL
+ */
+int inferSubmitDeadline (struct infer_queue * queue, struct infer_request * req, struct deadline_model * model, long budget) {
+    if(queue->head - queue->notified >= INFER_QUEUE_SIZE)
+      return DEADLINE_QUEUE_FULL;
+
+    long backlog = inferQueueBacklog(queue);
+    if(backlog < 0)
+    {
+      model->decision = DEADLINE_REJECTED;
+      return DEADLINE_REJECTED;
+    }
 
+    int decision = deadlineAdmit(model, budget, backlog, NR_CORES);
+    if(decision == DEADLINE_REJECTED)
+      return decision;
 
-#ifdef TILING
-        }
-#endif // TILING
+    req->network = decision == DEADLINE_PRIMARY ? model->network : model->fallback;
+    req->depth   = decision == DEADLINE_PRIMARY ? model->depth : model->fallbackDepth;
+    inferSubmit(queue, req);
+    return decision;
+}
+#endif // ASYNC_INFERENCE
+#endif // DEADLINE_SCHEDULER
 
-        toFIRST ^= 1;
 
-        // switch buffer (double buffering)
-        if(toFIRST)
+#ifdef L3_STREAMING
+//////////////////////////////////////////////////////////////////////////////////////////////
+// L3 -> L2 -> L1 weight streaming
+//////////////////////////////////////////////////////////////////////////////////////////////
+extern int lstm_seqSize;
+
+/** @brief L1 double buffer of the streamed blocks (filled by the cluster DMA) */
+__attribute__ ((section(".heapsram"))) int streamL1[2][STREAM_SLOT_SIZE/4];
+/** @brief L2 ring of the blocks fetched from L3 (filled by the uDMA) */
+L2_DATA int streamL2[STREAM_L2_SLOTS][STREAM_SLOT_SIZE/4];
+/** @brief activations and LSTM states of the streamed network */
+__attribute__ ((section(".heapsram"))) data_t streamState[STREAM_STATE_SIZE];
+
+/** @brief Reads a part of the model container from L3 (blocking)
+ *
+ *  @param eng Streaming engine
+ *  @param offset Offset in the container image (bytes)
+ *  @param l2 Destination in L2
+ *  @param size Number of bytes
+ */
+void streamRead (struct stream_engine * eng, unsigned int offset, void * l2, int size) {
+    pi_cl_ram_req_t req;
+    pi_cl_ram_read(eng->device, eng->base+offset, l2, size, &req);
+    pi_cl_ram_read_wait(&req);
+}
+
+/** @brief Opens a model container in L3 for streaming
+ *
+ *  Only the header and the layer table are read, the parameters are streamed block by block
+ *  during the inference. A block holds as many output rows of a layer (with their weights and
+ *  bias) as fit STREAM_SLOT_SIZE, the initial LSTM states are one block each. The layers are
+ *  checked like by loadModelContainer, so streamDescribe only addresses rows within their blobs.
+ *  Called by one core.
+ *
+ *  @param eng Streaming engine to be initialized
+ *  @param device L3 memory holding the container
+ *  @param base L3 address of the container image
+ *  @return Number of layers or -1 if the container cannot be streamed with this build
+ */
+int streamOpen (struct stream_engine * eng, struct pi_device * device, unsigned int base) {
+    eng->device = device;
+    eng->base   = base;
+    streamRead(eng, 0, &eng->header, sizeof(struct model_container_header));
+    if(checkModelContainer(&eng->header, MODEL_CONTAINER_MAX_DEPTH) < 0 || checkContainerLayout(&eng->header) < 0)
+      return -1;
+    streamRead(eng, eng->header.layer_offset, eng->layers, eng->header.depth*sizeof(struct model_container_layer));
+    for(unsigned int l=0; l<eng->header.depth; l++)
+      if(checkContainerLayer(&eng->header, &eng->layers[l], l) < 0)
+        return -1;
+
+    if(eng->header.depth == 0)
+    {
+      printf("\033[91mERROR - the streamed model has no layers!!!\033[0m\n");
+      return -1;
+    }
+
+    // the input and the golden output are read into buffers of STREAM_STATE_SIZE/2 elements
+    struct model_container_layer * first = &eng->layers[0];
+    int firstIn = first->type == LSTM ? first->attributes[LAY_LSTM_IN]*lstm_seqSize :
+                  first->type == LINEAR ? first->attributes[LAY_LIN_IN] : first->attributes[LAY_HEAD_IN];
+    if(eng->header.in_size != (uint32_t)firstIn ||
+       eng->header.in_size > STREAM_STATE_SIZE/2 || eng->header.out_size > STREAM_STATE_SIZE/2)
+    {
+      printf("\033[91mERROR - input/output (%u/%u elements) of the streamed model do not match its first layer or exceed STREAM_STATE_SIZE/2!!!\033[0m\n",
+             (unsigned int) eng->header.in_size, (unsigned int) eng->header.out_size);
+      return -1;
+    }
+
+    eng->totalBlocks       = 0;
+    eng->bytesPerInference = 0;
+    eng->maxAct            = 0;
+    eng->maxHidden         = 0;
+    for(unsigned int l=0; l<eng->header.depth; l++)
+    {
+      struct model_container_layer * lay = &eng->layers[l];
+      int rows, rowBytes, segments;
+
+      eng->blocks[l]       = 0;
+      eng->rowsPerBlock[l] = 0;
+      if(lay->type == LINEAR)
+      {
+        if(lay->attributes[LAY_LIN_FUSED_OPS] != FUSE_NONE)
         {
-          in  = &buffer[BUFFER_SIZE2];
-          out = &buffer[0];
+          printf("\033[91mERROR - fused element-wise operations cannot be streamed (layer %d)!!!\033[0m\n", l);
+          return -1;
         }
-        else 
+        rows     = lay->attributes[LAY_LIN_OUT];
+        rowBytes = 2*lay->attributes[LAY_LIN_IN] + 2;
+        segments = 2;
+        eng->maxAct = Max(eng->maxAct, Max(lay->attributes[LAY_LIN_IN], rows));
+      }
+      else if(lay->type == LSTM)
+      {
+        rows     = lay->attributes[LAY_LSTM_HID];
+        rowBytes = 2*(lay->attributes[LAY_LSTM_IN]+rows) + 4;
+        segments = 4;
+        eng->maxAct    = Max(eng->maxAct, Max(lay->attributes[LAY_LSTM_IN]*lstm_seqSize, rows));
+        eng->maxHidden = Max(eng->maxHidden, rows);
+        if(2*rows > STREAM_SLOT_SIZE)
         {
-          in  = &buffer[0];
-          out = &buffer[BUFFER_SIZE2];
+          printf("\033[91mERROR - LSTM state of layer %d does not fit STREAM_SLOT_SIZE!!!\033[0m\n", l);
+          return -1;
         }
       }
+      else if(lay->type == SOFTMAX || lay->type == ARGMAX || lay->type == TOPK)
+      {
+        eng->maxAct = Max(eng->maxAct, Max(lay->attributes[LAY_HEAD_IN], TOPK_MAX));
+        continue;
+      }
+      else
+      {
+        printf("\033[91mERROR - only Lin Layer, LSTM and output heads can be streamed!!!\033[0m\n");
+        return -1;
+      }
 
-/*****************************************************************************
- *
- * LSTM LAYER
- *
- *****************************************************************************/
-      else if (lay.type == LSTM) {
+      int perBlock = (STREAM_SLOT_SIZE - 4*segments) / rowBytes;
+      if(perBlock < 1)
+      {
+        printf("\033[91mERROR - one row of layer %d (%d bytes) does not fit STREAM_SLOT_SIZE!!!\033[0m\n", l, rowBytes);
+        return -1;
+      }
+      perBlock = Min(perBlock, rows);
+      int chunks = (rows+perBlock-1)/perBlock;
 
-  #ifdef DEBUG_LSTM
-    #ifdef MULTICORE
-        if ( core_id<lay.attributes[LAY_LSTM_TILES] )
-        {
-    #endif
-        printf("LSTM (%i, %i)\n", lay.attributes[LAY_LSTM_IN], lay.attributes[LAY_LSTM_HID]);
-        printf("Inputs in: ");
-        PrintTensor(lay.attributes[LAY_LSTM_IN], in);
-        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
-        printf("bias in1: ");
-        PrintTensor(lay.attributes[LAY_LSTM_HID]*4, B1);
-        printf("bias in2: ");
-        PrintTensor(lay.attributes[LAY_LSTM_HID]*4, B2);
+      eng->rowsPerBlock[l] = perBlock;
+      if(lay->type == LINEAR)
+      {
+        eng->blocks[l]          = chunks;
+        eng->bytesPerInference += rows*rowBytes;
+      }
+      else
+      {
+        // initial hidden and cell state, then the four gates of every timestep
+        eng->blocks[l]          = 2 + lstm_seqSize*4*chunks;
+        eng->bytesPerInference += 4*rows + lstm_seqSize*4*rows*rowBytes;
+      }
+      eng->totalBlocks += eng->blocks[l];
+    }
 
-        // printf("Linear (%i, %i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT]);
-        printf("weights in1: ");
-        PrintTensor(lay.attributes[LAY_LSTM_HID]*4*lay.attributes[LAY_LSTM_IN], W1);
-        printf("weights in2: ");
-        PrintTensor(lay.attributes[LAY_LSTM_HID]*4*lay.attributes[LAY_LSTM_HID], W2);
-    #ifdef MULTICORE
-        }
-    #endif
-  #endif
+    // in, out, two hidden states, the cell state and four gates
+    if(2*eng->maxAct + 7*eng->maxHidden > STREAM_STATE_SIZE)
+    {
+      printf("\033[91mERROR - activations and LSTM states (%d elements) do not fit STREAM_STATE_SIZE!!!\033[0m\n",
+             2*eng->maxAct + 7*eng->maxHidden);
+      return -1;
+    }
+    return eng->header.depth;
+}
 
-        int numHidden = lay.attributes[LAY_LSTM_HID];
-#ifdef MULTICORE
-        // synch_barrier();
-        // if ( rt_core_id()<NR_CORES )
-        // {
-        LSTMLayer ( // Layer Attributes
-                    lay.attributes[LAY_LSTM_IN], numHidden,
-                    // Layer Parameters
-                    W1, //linear_Weights, //lay.parameters[LSTM_WGHT_IH],
-                    W2, //linear_Weights2, //lay.parameters[LSTM_WGHT_HH],
-                    B1, //linear_Bias, //lay.parameters[LSTM_BIAS_IH],
-                    B2,//linear_Bias2, //lay.parameters[LSTM_BIAS_HH],
-                    // Input and Output Features
-                    in,
-                    linear_H, //lay.parameters[LSTM_H],
-                    // Hidden Features
-                    linear_C, //lay.parameters[LSTM_C],
-                    // intermediate nodes
-                    out,
-                    out + 2*numHidden*1, //f
-                    out + 3*numHidden*1, //i
-                    out + 4*numHidden*1, //g
-                    out + 5*numHidden*1  //o
-                  );
-        in  =  (data_t *)linear_H;
-        // }
-        // synch_barrier();
-#else
-        LSTMLayer ( // Layer Attributes
-                    lay.attributes[LAY_LSTM_IN], numHidden,
-                    // Layer Parameters
-                    lay.parameters[LSTM_WGHT_IH],
-                    lay.parameters[LSTM_WGHT_HH],
-                    lay.parameters[LSTM_BIAS_IH],
-                    lay.parameters[LSTM_BIAS_HH],
-                    // Input and Output Features
-                    in,
-                    lay.parameters[LSTM_H],
-                    // Hidden Features
-                    lay.parameters[LSTM_C],
-                    // intermediate nodes
-                    out, //h_out
-                    out + 2*numHidden*1, //f
-                    out + 3*numHidden*1, //i
-                    out + 4*numHidden*1, //g
-                    out + 1*numHidden*1//o
-                  );
-        // in  =  (data_t *)lay.parameters[LSTM_H];
-        // in  =  (data_t *)lay.parameters[LSTM_H];
-#endif
+/** @brief Appends a parameter segment to a block, segments start word aligned in the slot */
+static inline void streamAddSegment (struct stream_engine * eng, struct stream_block * blk, unsigned int offset, int size) {
+    int s = blk->nrSegments++;
+    blk->l3Addr[s]    = eng->base + offset;
+    blk->segSize[s]   = size;
+    blk->segOffset[s] = s==0 ? 0 : (blk->segOffset[s-1]+blk->segSize[s-1]+3) & ~3;
+}
 
+/** @brief Describes block step of layer l (same order as consumed by inferNetworkStreamed) */
+static void streamDescribe (struct stream_engine * eng, int l, int step, struct stream_block * blk) {
+    struct model_container_layer * lay = &eng->layers[l];
+    int perBlock = eng->rowsPerBlock[l];
 
-  #ifdef DEBUG_LSTM
-    #ifdef MULTICORE
-        if ( core_id<lay.attributes[LAY_LSTM_TILES] )
-        {
-    #endif
-        printf("Results at: ");
-// #ifdef MULTICORE
-//         PrintTensor(lay.attributes[LAY_LSTM_HID], linear_H);
-// #else
-        PrintTensor(lay.attributes[LAY_LSTM_HID], out);
-// #endif
-    #ifdef MULTICORE
-        }
-    #endif
-  #endif
+    blk->layer      = l;
+    blk->nrSegments = 0;
+    if(lay->type == LINEAR)
+    {
+      int in = lay->attributes[LAY_LIN_IN];
+      blk->row  = step*perBlock;
+      blk->rows = Min(perBlock, lay->attributes[LAY_LIN_OUT]-blk->row);
+      streamAddSegment(eng, blk, lay->param_offset[LAY_LIN_WEIGHTS] + 2*blk->row*in, 2*blk->rows*in);
+      streamAddSegment(eng, blk, lay->param_offset[LAY_LIN_BIAS] + 2*blk->row, 2*blk->rows);
+    }
+    else if(step < 2)
+    {
+      // initial hidden (step 0) and cell state (step 1)
+      blk->row  = 0;
+      blk->rows = lay->attributes[LAY_LSTM_HID];
+      streamAddSegment(eng, blk, lay->param_offset[step==0 ? LSTM_H : LSTM_C], 2*blk->rows);
+    }
+    else
+    {
+      int in     = lay->attributes[LAY_LSTM_IN];
+      int hid    = lay->attributes[LAY_LSTM_HID];
+      int chunks = (hid+perBlock-1)/perBlock;
+      int gate   = ((step-2)/chunks) % 4;
+      blk->row   = ((step-2)%chunks)*perBlock;
+      blk->rows  = Min(perBlock, hid-blk->row);
+      int gateRow = gate*hid + blk->row;
+      streamAddSegment(eng, blk, lay->param_offset[LSTM_WGHT_IH] + 2*gateRow*in, 2*blk->rows*in);
+      streamAddSegment(eng, blk, lay->param_offset[LSTM_WGHT_HH] + 2*gateRow*hid, 2*blk->rows*hid);
+      streamAddSegment(eng, blk, lay->param_offset[LSTM_BIAS_IH] + 2*gateRow, 2*blk->rows);
+      streamAddSegment(eng, blk, lay->param_offset[LSTM_BIAS_HH] + 2*gateRow, 2*blk->rows);
+    }
+}
 
-        toFIRST ^= 1; 
+/** @brief Starts the L3 -> L2 transfer (uDMA) of block k into its slot of the L2 ring */
+static void streamFetch (struct stream_engine * eng, int k) {
+    int slot = k % STREAM_L2_SLOTS;
+    struct stream_block * blk = &eng->slot[slot];
 
-        // switch buffers
-        if(toFIRST) 
-        {
-          in  = &buffer[BUFFER_SIZE2];
-          out = &buffer[0];
-        }
-        else 
+    while(eng->fetchStep >= eng->blocks[eng->fetchLayer])
+    {
+      eng->fetchLayer++;
+      eng->fetchStep = 0;
+    }
+    streamDescribe(eng, eng->fetchLayer, eng->fetchStep++, blk);
+    for(int s=0; s<blk->nrSegments; s++)
+      pi_cl_ram_read(eng->device, blk->l3Addr[s], (char *) streamL2[slot] + blk->segOffset[s], blk->segSize[s], &eng->req[slot][s]);
+}
+
+/** @brief Waits for block k in L2 and starts its L2 -> L1 transfer (cluster DMA) */
+static void streamLoad (struct stream_engine * eng, int k) {
+    int slot = k % STREAM_L2_SLOTS;
+    struct stream_block * blk = &eng->slot[slot];
+
+    for(int s=0; s<blk->nrSegments; s++)
+      pi_cl_ram_read_wait(&eng->req[slot][s]);
+    int size = blk->segOffset[blk->nrSegments-1] + blk->segSize[blk->nrSegments-1];
+    eng->dmaId[k%2] = plp_dma_memcpy((uintptr_t) streamL2[slot], (uintptr_t) streamL1[k%2], size, 1);
+}
+
+/** @brief Fills the L2 ring and starts the transfer of the first block into L1 (called by one core) */
+static void streamBegin (struct stream_engine * eng) {
+    eng->fetchLayer = 0;
+    eng->fetchStep  = 0;
+    eng->consumed   = 0;
+    for(int k=0; k<Min(STREAM_L2_SLOTS, eng->totalBlocks); k++)
+      streamFetch(eng, k);
+    if(eng->totalBlocks > 0)
+      streamLoad(eng, 0);
+}
+
+/** @brief Returns the next block in L1 (called by all cores)
+ *
+ *  Core 0 waits for the block, refills its L2 slot with the block STREAM_L2_SLOTS ahead and
+ *  starts the transfer of the following block into the other half of the L1 double buffer, i.e.
+ *  the uDMA and the cluster DMA run while the cores compute on the returned block. The block
+ *  stays valid until the next but one call.
+ *
+ *  @param eng Streaming engine (started by inferNetworkStreamed)
+ *  @return Block descriptor with the L1 pointer of the block
+ */
+struct stream_block * streamAcquire (struct stream_engine * eng) {
+    int k = eng->consumed;
+
+    // all cores are done with block k-1, its L1 buffer is overwritten with block k+1
+    synch_barrier();
+    if(rt_core_id()==0)
+    {
+      plp_dma_wait(eng->dmaId[k%2]);
+      eng->current[k%2]      = eng->slot[k%STREAM_L2_SLOTS];
+      eng->current[k%2].data = (data_t *) streamL1[k%2];
+      if(k+STREAM_L2_SLOTS < eng->totalBlocks)
+        streamFetch(eng, k+STREAM_L2_SLOTS);
+      if(k+1 < eng->totalBlocks)
+        streamLoad(eng, k+1);
+      eng->consumed = k+1;
+    }
+    synch_barrier();
+    return &eng->current[k%2];
+}
+
+/** @brief Parameter segment s of a block in L1 */
+#define STREAM_SEGMENT(blk, s) ((blk)->data + (blk)->segOffset[s]/2)
+
+/** @brief Rows [start, stop) of a streamed LSTM block computed by this core
+ *
+ *  Same partition as LSTMLayer (LSTM_HIGH_OPT), i.e. TwoLinearLayersAccumulate is called
+ *  per core on its share of the block, with less rows than cores core 0 takes all of them.
+ *
+ *  @param rows Number of rows of the block
+ *  @param start First row of the core (relative to the block)
+ *  @return Number of rows of the core
+ */
+static inline int streamCoreRows (int rows, int * start) {
+    int core_id = rt_core_id();
+    int n_cores = NR_CORES;
+    int chunck = 1;
+    int chunkg_orig = 1;
+    int start_offset = 0;
+
+    if(rows <= n_cores)
+    {
+      chunck = core_id == 0 ? rows : 0;
+    }
+    else
+    {
+      int Log2Core = __builtin_pulp_fl1(n_cores);
+      chunck = (rows >> Log2Core) + ((rows & (n_cores-1))!=0);
+      chunkg_orig = chunck;
+      // odd chunks: the even cores take one row more
+      if((chunck % 2)!=0)
+      {
+        if((core_id%2)==0)
+          chunck = chunck+1;
+        else
         {
-          in  = &buffer[0];
-          out = &buffer[BUFFER_SIZE2];
+          chunck = chunck-1;
+          start_offset = 1;
         }
-
       }
-/*****************************************************************************
+    }
+    *start = MIN(chunkg_orig*core_id+start_offset, rows);
+    return MIN(*start+chunck, rows) - *start;
+}
+
+/** @brief Runs a neural network whose parameters are streamed from L3
  *
- * Conv2D LAYER
+ *  Same computation as inferNetwork, but the layers are computed block by block (output rows)
+ *  while the next blocks are transferred L3 -> L2 -> L1. The activations and the LSTM states are
+ *  kept in L1 (streamState). Called by all cores.
  *
- *****************************************************************************/
-      else if(lay.type == Conv2d) {
-
-  #ifdef DEBUG_LSTM
-        printf("Conv2D (%i->%i, ker=%i^2, h*w=%i*%i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT], lay.attributes[LAY_CONV_KER],lay.attributes[LAY_CONV_H],lay.attributes[LAY_CONV_W]);
-        printf("Inputs in: ");
-        PrintTensor(lay.attributes[LAY_LIN_IN]*lay.attributes[LAY_CONV_H]*lay.attributes[LAY_CONV_W], in);
-  #endif
+ *  @param eng Streaming engine (see streamOpen)
+ *  @param inFeatures Input Feature Map
+ *  @return Output Feature Map (in L1)
+ */
+data_t * NOINLINE inferNetworkStreamed (struct stream_engine * eng, data_t * __restrict__ inFeatures)
+{
+  int core_id = rt_core_id();
+  int depth   = eng->header.depth;
 
-        Conv2dLayer(&lay,
-                    lay.attributes[LAY_CONV_H],
-                    lay.attributes[LAY_CONV_W],
-                    in,
-                    out
-                    );
+  data_t * in    = &streamState[0];
+  data_t * out   = &streamState[eng->maxAct];
+  data_t * state = &streamState[2*eng->maxAct];
+  data_t * C     = state + 2*eng->maxHidden;
+  data_t * gate[4];
+  for(int g=0; g<4; g++)
+    gate[g] = C + (g+1)*eng->maxHidden;
 
-  #ifdef DEBUG_LSTM
-        printf("Conv2D (%i->%i, ker=%i^2, h*w=%i*%i)\n", lay.attributes[LAY_LIN_IN], lay.attributes[LAY_LIN_OUT], lay.attributes[LAY_CONV_KER],lay.attributes[LAY_CONV_H],lay.attributes[LAY_CONV_W]);
-        printf("Results in: ");
-        PrintTensor(lay.attributes[LAY_CONV_OUT]*lay.attributes[LAY_CONV_H]*lay.attributes[LAY_CONV_W], out);
-  #endif
+  if(core_id==0)
+  {
+    struct model_container_layer * first = &eng->layers[0];
+    int size = first->type == LSTM ? first->attributes[LAY_LSTM_IN]*lstm_seqSize : first->attributes[LAY_LIN_IN];
+    for(int j=0; j<size; j++)
+      in[j] = inFeatures[j];
+    streamBegin(eng);
+  }
+#ifdef BANK_PLACEMENT
+  bankReplicateLUTs();
+#endif
+  synch_barrier();
 
-        toFIRST ^= 1; 
+  for(int i=0; i<depth; i++)
+  {
+    struct model_container_layer * lay = &eng->layers[i];
+    PROFILING_LAYER_START(i)
+    BARRIER_PROFILE_LAYER_START(i, lay->type, lay->attributes[0], lay->attributes[1])
 
-        // switch buffers
-        if(toFIRST) 
-        {
-          in  = &buffer[BUFFER_SIZE2];
-          out = &buffer[0];
-        }
-        else 
+    if(lay->type == LINEAR)
+    {
+      for(int b=0; b<eng->blocks[i]; b++)
+      {
+        struct stream_block * blk = streamAcquire(eng);
+        LinearLayer(lay->attributes[LAY_LIN_IN], blk->rows,
+                    True,
+                    STREAM_SEGMENT(blk, 0), STREAM_SEGMENT(blk, 1),
+                    in, out+blk->row);
+      }
+    }
+    else if(lay->type == LSTM)
+    {
+      int inSize = lay->attributes[LAY_LSTM_IN];
+      int hid    = lay->attributes[LAY_LSTM_HID];
+      int chunks = (hid+eng->rowsPerBlock[i]-1)/eng->rowsPerBlock[i];
+      int rowStart, rows;
+      // hidden state ring of two buffers
+      data_t * H     = state;
+      data_t * H_out = state + eng->maxHidden;
+
+      struct stream_block * blk = streamAcquire(eng);
+      if(core_id==0)
+        for(int j=0; j<hid; j++)
+          H[j] = blk->data[j];
+      blk = streamAcquire(eng);
+      if(core_id==0)
+        for(int j=0; j<hid; j++)
+          C[j] = blk->data[j];
+
+      for(int seq=0; seq<lstm_seqSize; seq++)
+      {
+        // i, f, g and o gate (order of the weights as in PyTorch)
+        for(int g=0; g<4; g++)
         {
-          in  = &buffer[0];
-          out = &buffer[BUFFER_SIZE2];
+          for(int c=0; c<chunks; c++)
+          {
+            blk  = streamAcquire(eng);
+            rows = streamCoreRows(blk->rows, &rowStart);
+            if(rows > 0)
+              TwoLinearLayersAccumulate(inSize, hid, rows, g==2 ? ACT_TANH : ACT_SIG,
+                                        STREAM_SEGMENT(blk, 0) + rowStart*inSize,
+                                        STREAM_SEGMENT(blk, 1) + rowStart*hid,
+                                        STREAM_SEGMENT(blk, 2) + rowStart,
+                                        STREAM_SEGMENT(blk, 3) + rowStart,
+                                        in+seq*inSize, H, gate[g]+blk->row+rowStart);
+          }
+#ifndef DOACTONTHEFLY
+          synch_barrier();
+          if(g==2)
+            TanhLayer(hid, gate[g]);
+          else
+            SigLayer(hid, gate[g]);
+#endif
         }
-
-      }
-      else {
-        printf("\033[91mERROR: not a valid layer\033[0m\n");
+        synch_barrier();
+        //ct=ft*c(t−1)+it*gt
+        HadMulTensor(hid, C, gate[1]);
+        HadMulTensor(hid, gate[0], gate[2]);
+        AddTensor(hid, C, gate[0]);
+        synch_barrier();
+        //ht=ottanh(ct)
+        TanhHadMulTensor(hid, H_out, C, gate[3]);
+        synch_barrier();
+
+        data_t * H_tmp = H;
+        H     = H_out;
+        H_out = H_tmp;
       }
 
-#ifdef MULTICORE
-
-        plp_dma_barrier();
-#endif
-      synch_barrier();
+      if(core_id==0)
+        for(int j=0; j<hid; j++)
+          out[j] = H[j];
+    }
+    else if(lay->type == SOFTMAX)
+    {
+      SoftmaxLayer(lay->attributes[LAY_HEAD_IN], in, out);
+    }
+    else if(lay->type == ARGMAX)
+    {
+      ArgmaxLayer(lay->attributes[LAY_HEAD_IN], in, out);
+    }
+    else if(lay->type == TOPK)
+    {
+      TopKLayer(lay->attributes[LAY_HEAD_IN], lay->attributes[LAY_HEAD_K], in, out);
     }
 
-  return &in[0]; // return address of output feature map
+    synch_barrier();
+    data_t * tmp = in;
+    in  = out;
+    out = tmp;
+    PROFILING_LAYER_END(lay->type)
+    BARRIER_PROFILE_LAYER_END()
+  }
+
+  return in;
 }
+#endif // L3_STREAMING
@@ -51,6 +51,10 @@
 
 data_t generic_tanh(data_t value);
 data_t generic_sig(data_t x);
+#ifdef SIMD
+v2s generic_tanh_v2s(v2s value);
+v2s generic_sig_v2s(v2s value);
+#endif
 extern double tanh(double value);
 
 
@@ -78,6 +82,34 @@ inline int shiftAndAct(int value, int activationFunction) {
 }
 
 
+/** @brief runs the fused element-wise operation chain on one requantized output neuron
+ *
+ *  @param value Requantized output neuron of the FC layer
+ *  @param o Index of the output neuron
+ *  @param fusedOps Operation chain (FUSE_*, FUSE_OP_BITS per operation, first operation in the LSBs)
+ *  @param fusedTensors Tensors consumed in order by FUSE_ADD and FUSE_HADAMARD
+ *  @param inFeatures Input FM of the FC layer (used by FUSE_RESIDUAL)
+ *  @return Result of the operation chain
+ */
+inline int fusedEpilogue(int value, int o, int fusedOps, data_t ** fusedTensors, data_t * inFeatures) {
+    int tensor = 0;
+    for(int ops=fusedOps; ops!=0; ops>>=FUSE_OP_BITS) {
+        switch(ops & FUSE_OP_MASK) {
+            case FUSE_RESIDUAL: value += inFeatures[o]; break;
+            case FUSE_ADD:      value += fusedTensors[tensor++][o]; break;
+#ifdef FixedPt
+            case FUSE_HADAMARD: value = (value*fusedTensors[tensor++][o])>>(q_fraqP1); break;
+#else
+            case FUSE_HADAMARD: value *= fusedTensors[tensor++][o]; break;
+#endif
+            case FUSE_TANH:     value = generic_tanh(value); break;
+            case FUSE_SIG:      value = generic_sig(value); break;
+        }
+    }
+    return value;
+}
+
+
 data_t * NOINLINE inferNetwork(
     struct layer * network,
     int depth,
@@ -27,6 +27,9 @@
 
 #include "basicKernel_mc.h"
 #include <stdio.h>
+#if defined(__AVX2__) && !defined(ASIP)
+#include <immintrin.h>
+#endif
 
 /** \brief Length (in time) of RNN Sequence */
 int rnn_seqSize=1; 
@@ -46,6 +49,18 @@ __attribute__ ((section(".heapsram")))  int   l1_lut_Tanh_q[16] = {17060, 512067
 __attribute__ ((section(".heapsram")))  short l1_lut_sig_m[16]  = {1019, 988, 930, 850, 758, 660, 563, 472, 391, 319, 258, 207, 165, 131, 104, 82};
 /** \brief Piecewise Linear Approximation "q"-LUT of sigm */
 __attribute__ ((section(".heapsram")))  int   l1_lut_sig_q[16]  = {8389671, 8423495, 8544906, 8789991, 9169470, 9670607, 10264318, 10914030, 11583389, 12241371, 12864661, 13437943, 13952921, 14406803, 14800713, 15138308};
+
+#ifdef BANK_PLACEMENT
+/** \brief Per-core replicas of the tanh/sigm LUTs, consecutive replicas start TCDM_BANKING_FACTOR banks apart */
+__attribute__ ((section(".heapsram")))  struct bank_lut_replica bankLUTs[NR_CORES_MAX];
+/** \brief input FM replicas of the cores (see bankReplicateInput) */
+__attribute__ ((section(".heapsram")))  data_t bankInputReplicas[NR_CORES_MAX*BANK_REPLICA_STRIDE];
+/// LUT entry of the replica of the calling core
+#define L1_LUT(lut, id) (bankLUTs[CLUSTER_CORE_ID()].lut[id])
+#else
+/// LUT entry in the shared L1 LUT
+#define L1_LUT(lut, id) (l1_lut_##lut[id])
+#endif // BANK_PLACEMENT
 #else
 
 /** \brief Piecewise Linear Approximation "m"-LUT of tanh */
@@ -58,6 +73,23 @@ const short lut_sig_m[16]  = {1019, 988, 930, 850, 758, 660, 563, 472, 391, 319,
 const int lut_sig_q[16]    = {8389671, 8423495, 8544906, 8789991, 9169470, 9670607, 10264318, 10914030, 11583389, 12241371, 12864661, 13437943, 13952921, 14406803, 14800713, 15138308};
 #endif
 
+#ifdef MULTICORE
+/** \brief Piecewise Linear Approximation "m"-LUT of e^(-x) */
+__attribute__ ((section(".heapsram")))  short l1_lut_exp_m[32] = {3624, 2822, 2198, 1712, 1333, 1038, 809, 630, 490, 382, 297, 232, 180, 141, 109, 85, 66, 52, 40, 31, 24, 19, 15, 12, 9, 7, 5, 4, 3, 3, 2, 2};
+/** \brief Piecewise Linear Approximation "q"-LUT of e^(-x) */
+__attribute__ ((section(".heapsram")))  int   l1_lut_exp_q[32] = {16719280, 15911202, 14642556, 13156637, 11611639, 10106404, 8698935, 7419631, 6280658, 5282529, 4418664, 3678502, 3049586, 2518915, 2073799, 1702353, 1393765, 1138401, 927815, 754690, 612758, 496691, 401990, 324882, 262217, 211379, 170201, 136898, 110001, 88304, 70824, 56756};
+
+/** \brief Partial results of the cores for the reductions in the output heads */
+__attribute__ ((section(".heapsram")))  int   head_partial_val[NR_CORES_MAX*TOPK_MAX];
+/** \brief Partial indices of the cores for the reductions in the output heads */
+__attribute__ ((section(".heapsram")))  int   head_partial_idx[NR_CORES_MAX*TOPK_MAX];
+#else
+/** \brief Piecewise Linear Approximation "m"-LUT of e^(-x) */
+const short lut_exp_m[32] = {3624, 2822, 2198, 1712, 1333, 1038, 809, 630, 490, 382, 297, 232, 180, 141, 109, 85, 66, 52, 40, 31, 24, 19, 15, 12, 9, 7, 5, 4, 3, 3, 2, 2};
+/** \brief Piecewise Linear Approximation "q"-LUT of e^(-x) */
+const int lut_exp_q[32]   = {16719280, 15911202, 14642556, 13156637, 11611639, 10106404, 8698935, 7419631, 6280658, 5282529, 4418664, 3678502, 3049586, 2518915, 2073799, 1702353, 1393765, 1138401, 927815, 754690, 612758, 496691, 401990, 324882, 262217, 211379, 170201, 136898, 110001, 88304, 70824, 56756};
+#endif
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 /** @brief Sigmoid Activation Function
@@ -65,7 +97,7 @@ const int lut_sig_q[16]    = {8389671, 8423495, 8544906, 8789991, 9169470, 96706
  *  @param value input varialbe
  *  @return sigmoid of the input variable
  */
-inline data_t sig(data_t value) {
+static inline data_t sig(data_t value) {
     data_t a = value;
     unsigned int lutsize = 16;
     unsigned int value1 = 4096;
@@ -93,8 +125,8 @@ inline data_t sig(data_t value) {
     }
     else {
 #ifdef MULTICORE
-        m = l1_lut_sig_m[tmp];
-        q = l1_lut_sig_q[tmp];
+        m = L1_LUT(sig_m, tmp);
+        q = L1_LUT(sig_q, tmp);
 #else
         m = lut_sig_m[tmp];
         q = lut_sig_q[tmp];
@@ -118,7 +150,7 @@ inline data_t sig(data_t value) {
  *  @param value input variable
  *  @return tangent hypberbolic of the input variable
  */
-inline data_t Tanh(data_t value) {
+static inline data_t Tanh(data_t value) {
     data_t x = value;
     unsigned int lutsize = 16;
     unsigned int value1 = 4096;
@@ -146,8 +178,8 @@ inline data_t Tanh(data_t value) {
     }
     else {
 #ifdef MULTICORE
-        m = l1_lut_Tanh_m[id];
-        q = l1_lut_Tanh_q[id];
+        m = L1_LUT(Tanh_m, id);
+        q = L1_LUT(Tanh_q, id);
 #else
         m = lut_Tanh_m[id];
         q = lut_Tanh_q[id];
@@ -159,6 +191,200 @@ inline data_t Tanh(data_t value) {
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Sigmoid Activation Function without branches
+ *
+ *  Same piecewise linear approximation as sig(), but the sign and the saturation are
+ *  handled with masks and the LUT index is clamped, such that all values follow the 
+ *  same instruction stream (used for the v2s activations).
+ *
+ *  @param value input varialbe
+ *  @return sigmoid of the input variable
+ */
+static inline data_t sig_noBranch(int value) {
+    int sign_mask = value>>31;                   // 0x0 or 0xffffffff
+    int abs_a     = (value^sign_mask)-sign_mask;
+    int id        = abs_a>>(13-3);
+    int sat       = (id>=16);                    // set-less-than, no branch
+    int mac_result;
+
+    id = MIN(id, 15);
+#ifdef MULTICORE
+    mac_result = (L1_LUT(sig_m, id)*abs_a+L1_LUT(sig_q, id))>>12;
+#else
+    mac_result = (lut_sig_m[id]*abs_a+lut_sig_q[id])>>12;
+#endif
+    mac_result = (mac_result & (sat-1)) | (4096 & (-sat));
+
+    // negative: 1-(mx+q) = 4095+(~mac_result), saturated to 0
+    return (mac_result^sign_mask) + (sign_mask & (4095+2*sat));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Tangent Hyperbolic without branches
+ *
+ *  Same piecewise linear approximation as Tanh(), see sig_noBranch().
+ *
+ *  @param value input variable
+ *  @return tangent hypberbolic of the input variable
+ */
+static inline data_t Tanh_noBranch(int value) {
+    int sign_mask = value>>31;                   // 0x0 or 0xffffffff
+    int abs_x     = (value^sign_mask)-sign_mask;
+    int id        = abs_x>>(13-3);
+    int sat       = (id>=16);                    // set-less-than, no branch
+    int mac_result;
+
+    id = MIN(id, 15);
+#ifdef MULTICORE
+    mac_result = (L1_LUT(Tanh_m, id)*abs_x+L1_LUT(Tanh_q, id))>>12;
+#else
+    mac_result = (lut_Tanh_m[id]*abs_x+lut_Tanh_q[id])>>12;
+#endif
+    mac_result = (mac_result & (sat-1)) | (4096 & (-sat));
+
+    // negative: ~(mx+q), saturated to -1
+    return (mac_result^sign_mask) + (sign_mask & sat);
+}
+
+
+#if defined(MULTICORE) && defined(BANK_PLACEMENT)
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Copies the tanh/sigm LUTs into the replica of the calling core
+ *
+ *  Has to be called by every core before the activations are used (done by inferNetwork).
+ */
+void bankReplicateLUTs() {
+    struct bank_lut_replica * rep = &bankLUTs[CLUSTER_CORE_ID()];
+    for(int i=0; i<16; i++)
+    {
+      rep->Tanh_m[i] = l1_lut_Tanh_m[i];
+      rep->sig_m[i]  = l1_lut_sig_m[i];
+      rep->Tanh_q[i] = l1_lut_Tanh_q[i];
+      rep->sig_q[i]  = l1_lut_sig_q[i];
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Copies the input FM into the replica of the calling core
+ *
+ *  All cores read the input FM in the same order, i.e. from the same bank in every cycle. The
+ *  replicas are BANK_REPLICA_STRIDE elements apart, which moves the replica of core c by
+ *  c*TCDM_BANKING_FACTOR banks. The copy itself starts at a core-dependent word to not collide
+ *  on the shared FM either.
+ *
+ *  @param inFeatures shared input FM (complete and visible to all cores)
+ *  @param size number of elements
+ *  @return replica of the calling core or inFeatures if the FM does not fit BANK_REPLICA_SIZE
+ */
+data_t * bankReplicateInput(data_t * inFeatures, int size) {
+    int core_id = CLUSTER_CORE_ID();
+    int words   = (size+1)/2;
+    v2s * src   = (v2s *) inFeatures;
+    v2s * dst   = (v2s *) &bankInputReplicas[core_id*BANK_REPLICA_STRIDE];
+
+    if(size > BANK_REPLICA_SIZE)
+      return inFeatures;
+
+    int w = (core_id*TCDM_BANKING_FACTOR) % words;
+    for(int i=0; i<words; i++)
+    {
+      dst[w] = src[w];
+      w = (w+1 == words) ? 0 : w+1;
+    }
+    return (data_t *) dst;
+}
+#endif // MULTICORE && BANK_PLACEMENT
+
+
+#ifdef SIMD
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Sigmoid Activation Function on two packed values
+ *
+ *  @param value two input variables
+ *  @return sigmoid of both input variables
+ */
+static inline v2s sig_SIMD(v2s value) {
+    return (v2s){sig_noBranch(value[0]), sig_noBranch(value[1])};
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Tangent Hyperbolic on two packed values
+ *
+ *  @param value two input variables
+ *  @return tangent hypberbolic of both input variables
+ */
+static inline v2s Tanh_SIMD(v2s value) {
+    return (v2s){Tanh_noBranch(value[0]), Tanh_noBranch(value[1])};
+}
+#endif // SIMD
+
+
+// the LUT activations of TanhLayer/SigLayer on 16 neurons per iteration in host AVX2 builds
+#if defined(__AVX2__) && !defined(ASIP) && defined(MULTICORE) && !defined(PULP_USETANHSIG) && !defined(MATHH)
+#define ACT_AVX2
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Lookup of 8 indices (0..15) in a 16-entry LUT held in two registers (permutes, no gather) */
+static inline __m256i actLutPermute(__m256i lo, __m256i hi, __m256i id) {
+    __m256i upper = _mm256_cmpgt_epi32(id, _mm256_set1_epi32(7));
+    return _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(lo, id), _mm256_permutevar8x32_epi32(hi, id), upper);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief sig_noBranch()/Tanh_noBranch() on 16 neurons per iteration (bit-exact)
+ *
+ *  The LUT is kept in registers, the neurons are widened to 32 bit for the MAC and the sign
+ *  and saturation masks of the scalar kernels are applied lane-wise.
+ *
+ *  @param Features Input and Output of Activation Function
+ *  @param start First neuron
+ *  @param stop End of the neurons
+ *  @param isSig Sigmoid (1) or tangent hyperbolic (0)
+ *  @return First neuron which is left for the scalar/v2s tail (less than 16 neurons)
+ */
+static int actLayerAvx2(data_t * Features, int start, int stop, int isSig) {
+    int m[16], q[16];
+    for(int i=0; i<16; i++)
+    {
+      m[i] = isSig ? L1_LUT(sig_m, i) : L1_LUT(Tanh_m, i);
+      q[i] = isSig ? L1_LUT(sig_q, i) : L1_LUT(Tanh_q, i);
+    }
+    const __m256i mLo   = _mm256_loadu_si256((const __m256i *) &m[0]);
+    const __m256i mHi   = _mm256_loadu_si256((const __m256i *) &m[8]);
+    const __m256i qLo   = _mm256_loadu_si256((const __m256i *) &q[0]);
+    const __m256i qHi   = _mm256_loadu_si256((const __m256i *) &q[8]);
+    const __m256i maxId = _mm256_set1_epi32(15);
+    const __m256i one   = _mm256_set1_epi32(1);
+    const __m256i neg   = _mm256_set1_epi32(isSig ? 4095 : 0);  // added to negative values
+    const __m256i negSat = _mm256_set1_epi32(isSig ? 4097 : 1); // added to saturated negative values
+
+    int o = start;
+    for(; o+16<=stop; o+=16)
+    {
+      __m256i x16 = _mm256_loadu_si256((const __m256i *) &Features[o]);
+      __m256i y[2];
+      for(int h=0; h<2; h++)
+      {
+        __m256i x    = _mm256_cvtepi16_epi32(h ? _mm256_extracti128_si256(x16, 1) : _mm256_castsi256_si128(x16));
+        __m256i sign = _mm256_srai_epi32(x, 31);
+        __m256i absx = _mm256_sub_epi32(_mm256_xor_si256(x, sign), sign);
+        __m256i id   = _mm256_srli_epi32(absx, 10);
+        __m256i sat  = _mm256_cmpgt_epi32(id, maxId);
+        id = _mm256_min_epi32(id, maxId);
+        __m256i mac  = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(actLutPermute(mLo, mHi, id), absx),
+                                                          actLutPermute(qLo, qHi, id)), 12);
+        mac = _mm256_blendv_epi8(mac, _mm256_slli_epi32(one, 12), sat);
+        y[h] = _mm256_add_epi32(_mm256_xor_si256(mac, sign), _mm256_and_si256(sign, _mm256_blendv_epi8(neg, negSat, sat)));
+      }
+      // packs interleaves the 128-bit lanes
+      _mm256_storeu_si256((__m256i *) &Features[o], _mm256_permute4x64_epi64(_mm256_packs_epi32(y[0], y[1]), 0xD8));
+    }
+    return o;
+}
+#endif // ACT_AVX2
+
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -178,7 +404,139 @@ inline data_t Tanh(data_t value) {
  //|_____ |_____| |     | |_____/ |  |  | |     | |_____         \/   |_____ __|__ |__|__|   // 
  //                                                                                          //
  //////////////////////////////////////////////////////////////////////////////////////////////
-#if defined FMOUTTILING && !defined(ASIP) && defined MANUALLOOPUNFOLDING && defined VLIWEXT // obv vliw
+#if defined(WEIGHT_PACKING) && !defined(ASIP)
+/** @brief Calculates a Fully-Connected (or Linear Layer) with pre-packed weights
+ *
+ *  The weights are exported pre-packed (see packWeights in pyTorch_Kernels.py): the output neurons
+ *  are grouped in tiles of OUTPUTBUFFER neurons (the last tile holds the remaining neurons) and
+ *  within a tile the weights of all neurons are interleaved per v2s word:
+ *  w[o+0][0:1], w[o+1][0:1], ..., w[o+OUTPUTBUFFER-1][0:1], w[o+0][2:3], ...
+ *  An odd last input neuron is stored as one halfword per neuron at the end of the tile.
+ *  The inner loop therefore reads one sequential weight stream with a single address register,
+ *  no W_OFFSET padding is needed and every tile is one contiguous block (single DMA burst).
+ *  Supports the following configurations:
+ *  => FixedPt and SIMD only, OUTPUTBUFFER has to be even
+ *  => VLIWEXT: full tiles with pl.sdotsp (alternating SPRs on the same stream)
+ *  => MULTICORE: the tiles are distributed over the cores
+ *
+ *  @param inFeaturesSize Number of input neurons
+ *  @param outFeaturesSize Number of output neurons
+ *  @param hasBias FC with bias or not?
+ *  @param weight Pointer to the packed weights
+ *  @param bias Pointer to bias
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map
+ */
+void NOINLINE LinearLayer (
+  // Layer Attributes
+  int inFeaturesSize,
+  int outFeaturesSize,
+  short hasBias,
+  // Layer Parameters
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures) //property(functional)
+{
+
+    PROFILING_LINEAR_START
+
+    int inFeaturesSizeP2 = inFeaturesSize/2;
+    int outFeatureTiles  = (outFeaturesSize-1)/OUTPUTBUFFER+1;
+
+#ifdef MULTICORE
+    /* instructions to parallelize the workload:
+    each core computes a balanced number of output tiles */
+    int core_id = rt_core_id();
+    int n_cores = NR_CORES;
+    int chunck = 1;
+    /* handle the case when number of tiles
+    is less than number of cores: chunck=1 */
+    if(outFeatureTiles < n_cores)
+    {
+        n_cores = outFeatureTiles;
+    }
+    else
+    {
+        int Log2Core = __builtin_pulp_fl1(n_cores);
+        chunck = (outFeatureTiles >> Log2Core) + ((outFeatureTiles & (n_cores-1))!=0);
+    }
+    /* start and stop tile to be computed, for each core */
+    int start = MIN(chunck * core_id, outFeatureTiles);
+    int stop = MIN(start + chunck, outFeatureTiles);
+#else
+    int start = 0;
+    int stop = outFeatureTiles;
+#endif
+
+    for (int o_tile=start; o_tile<stop; o_tile++)
+    {
+      int o_start  = o_tile*OUTPUTBUFFER;
+      int tileSize = Min(OUTPUTBUFFER, outFeaturesSize-o_start);
+      v2s * weight_ptr = (v2s*)&weight[o_start*inFeaturesSize];
+      int32_t temp[OUTPUTBUFFER];
+
+      for(int o_rel=0; o_rel<tileSize; o_rel++)
+        temp[o_rel] = hasBias ? (int32_t)bias[o_start+o_rel]<<(q_fraqP1) : 0;
+
+      if(tileSize == OUTPUTBUFFER)
+      {
+#ifdef VLIWEXT
+        // register null
+        register int x0 asm("x0");
+        register_attribute uint32_t addr = (uint32_t) weight_ptr;
+        register_attribute uint32_t in_addr = (uint32_t) inFeatures;
+
+        asm volatile("pl.sdotsp.h.0 %0, %1, %2" : "+r" (x0), "+r" (addr) : "r" (x0) ); // preload first weight
+        asm volatile("pl.sdotsp.h.1 %0, %1, %2" : "+r" (x0), "+r" (addr) : "r" (x0) ); // preload second weight
+
+        for(int i=0; i<inFeaturesSizeP2; i++) {
+          v2s inF_temp;
+          asm volatile("p.lw %0, 4(%1!)" : "=r" (inF_temp), "+r" (in_addr));
+          // weights of neuron 2k and 2k+1 are in SPR0 and SPR1, the next two words are loaded from the same stream
+          for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel+=2) {
+            asm volatile("pl.sdotsp.h.0 %0, %1, %2" : "+r" (temp[o_rel+0]), "+r" (addr) : "r" (inF_temp) );
+            asm volatile("pl.sdotsp.h.1 %0, %1, %2" : "+r" (temp[o_rel+1]), "+r" (addr) : "r" (inF_temp) );
+          }
+        }
+#else // no VLIWEXT
+        for(int i=0; i<inFeaturesSizeP2; i++) {
+          v2s inF_temp = ((v2s*)inFeatures)[i];
+          for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel++) {
+            SDOTP_GENERIC(temp[o_rel], weight_ptr[o_rel], inF_temp);
+          }
+          weight_ptr += OUTPUTBUFFER;
+        }
+#endif // VLIWEXT
+      }
+      else // last tile with less than OUTPUTBUFFER neurons
+      {
+        for(int i=0; i<inFeaturesSizeP2; i++) {
+          v2s inF_temp = ((v2s*)inFeatures)[i];
+          for(int o_rel=0; o_rel<tileSize; o_rel++) {
+            SDOTP_GENERIC(temp[o_rel], weight_ptr[o_rel], inF_temp);
+          }
+          weight_ptr += tileSize;
+        }
+      }
+
+      // odd number of input neurons: one halfword per neuron at the end of the tile
+      if(inFeaturesSize & 1)
+      {
+        data_t * weight_tail = &weight[o_start*inFeaturesSize + 2*inFeaturesSizeP2*tileSize];
+        for(int o_rel=0; o_rel<tileSize; o_rel++)
+          temp[o_rel] += inFeatures[inFeaturesSize-1]*weight_tail[o_rel];
+      }
+
+      for(int o_rel=0; o_rel<tileSize; o_rel++)
+        outFeatures[o_start+o_rel] = temp[o_rel]>>(q_fraqP1);
+    }
+
+    PROFILING_LINEAR_END
+}
+
+#elif defined FMOUTTILING && !defined(ASIP) && defined MANUALLOOPUNFOLDING && defined VLIWEXT // obv vliw
 /** @brief Calculates a Fully-Connected (or Linear Layer) 
  *  
  *  Calculates a fully conntected Layer with the custom VLIW instructions for load and MAC
@@ -448,6 +806,7 @@ void NOINLINE LinearLayer (
   // Tile with largest tileOption
   for(unsigned int i=0; i<sizeof(tileOptions)/sizeof(int); i++) {
     outFeaturesPerTile = tileOptions[i];
+    if(outFeaturesPerTile > LINEAR_MAX_TILE) continue; // tile limit of the current layer (see tuneLinearLayer)
     outFeatureTiles = outFeaturesSize_remain/outFeaturesPerTile;
 
     if(outFeatureTiles == 0) continue;
@@ -1483,6 +1842,7 @@ void NOINLINE LinearLayer (
   // Tile with largest tileOption
   for(unsigned int i=0; i<sizeof(tileOptions)/sizeof(int); i++) {
     outFeaturesPerTile = tileOptions[i];
+    if(outFeaturesPerTile > LINEAR_MAX_TILE) continue; // tile limit of the current layer (see tuneLinearLayer)
     outFeatureTiles = outFeaturesSize_remain/outFeaturesPerTile;
 
     if(outFeatureTiles == 0) continue;
@@ -2100,6 +2460,7 @@ void NOINLINE LinearLayer (
   // Tile with largest tileOption
   for(unsigned int i=0; i<sizeof(tileOptions)/sizeof(int); i++) {
     outFeaturesPerTile = tileOptions[i];
+    if(outFeaturesPerTile > LINEAR_MAX_TILE) continue; // tile limit of the current layer (see tuneLinearLayer)
     outFeatureTiles = outFeaturesSize_remain/outFeaturesPerTile;
     
     if(outFeatureTiles == 0) continue;
@@ -2906,7 +3267,7 @@ void NOINLINE LinearLayer (
 //     printf("FMOUTTILING \n");
 // #endif // DEBUG_LSTM
 
-    const int outFeaturesPerTile = Min(outFeaturesSize, OUTPUTBUFFER); // Find maximum possible feature tile size
+    const int outFeaturesPerTile = Min(outFeaturesSize, Min(OUTPUTBUFFER, LINEAR_MAX_TILE)); // Find maximum possible feature tile size
     int outFeatureTiles = (int)(outFeaturesSize-1)/outFeaturesPerTile+1; // output channels per tile (round it up)
 
     // printf("outFeaturesSize=%i, outFeaturesPerTile=%i, outFeatureTiles=%i", outFeaturesSize, outFeaturesPerTile, outFeatureTiles);
@@ -6487,32 +6848,41 @@ void NOINLINE TwoLinearLayersAccumulate (
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////
-/** @brief Calculates point-wise Addition of Tensors (A+=B)
+/** @brief Calculates a Fully-Connected Layer with fused element-wise operations
  *
- *  @param TensorSize Input Value
- *  @param FeaturesA Accumulation Tensor
- *  @param FeaturesB Addend Tensor
+ *  Calculates outFeatures = ops(weight*inFeatures + bias) in a single kernel invocation,
+ *  where ops is the chain of element-wise operations (residual add, tensor add, Hadamard
+ *  product, tanh, sigmoid) folded into the FC layer by the network export.
+ *  As in LinearLayer, the output neurons of a core are calculated in tiles of OUTPUTBUFFER
+ *  neurons (with pl.sdotsp if VLIWEXT), every input pair is loaded once per tile. The
+ *  accumulators stay in registers until the operation chain is applied to them and they
+ *  are stored once, so there are no intermediate FM round-trips and no barriers between the ops.
+ *  With SIMD the number of input neurons has to be even (word-aligned weight rows), odd
+ *  sizes are rejected by the export (fuseLayers) and by inferNetwork.
+ *
+ *  @param inFeaturesSize Number of input neurons
+ *  @param outFeaturesSize Number of output neurons
+ *  @param fusedOps Fused operation chain (see FUSE_*)
+ *  @param weight Pointer to weights
+ *  @param bias Pointer to bias
+ *  @param fusedTensors Tensors consumed by FUSE_ADD and FUSE_HADAMARD
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map
  */
-void NOINLINE AddTensor (
+void NOINLINE FusedLinearLayer (
   // Layer Attributes
-  int TensorSize,
+  int inFeaturesSize, int outFeaturesSize,
+  int fusedOps,
   // Layer Parameters
-  data_t * __restrict__ FeaturesA,
-  data_t * __restrict__ FeaturesB)
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  data_t ** __restrict__ fusedTensors,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
 {
 
-  PROFILING_ADDT_START
-
-#ifdef ASIP
-
-// TODO implement SIMD add on tzscale
-  for(int o=0; o<TensorSize; o++)
-    FeaturesA[o] += FeaturesB[o];
-
-  return;
-
-#else // ASIP
-
+  PROFILING_LINEAR_START
 
 #ifdef MULTICORE
   /* instructions to parallelize the workload:
@@ -6520,67 +6890,470 @@ void NOINLINE AddTensor (
   int core_id = rt_core_id();
   int n_cores = NR_CORES;
   int chunck = 1;
-  int chunkg_orig=1;
-
-  int start_offset = 0;
   /* handle the case when number of neurons
   is less than number of cores: chunck=1 */
-  if(TensorSize <= n_cores)
+  if(outFeaturesSize < n_cores)
   {
-      // n_cores = TensorSize;
-      n_cores = 1;
-      if (core_id == 0)
-      {
-        chunck = TensorSize;
-      } else
-      {
-        chunck = 0;
-      }
+    n_cores = outFeaturesSize;
   }
   else
   {
-      int Log2Core = __builtin_pulp_fl1(n_cores);
-      chunck = (TensorSize >> Log2Core) + ((TensorSize & (n_cores-1))!=0);
-      chunkg_orig = chunck;
-      // printf(" core_id %d a\n",core_id);
-      if ((chunck % 2)!=0)
+    int Log2Core = __builtin_pulp_fl1(n_cores);
+    chunck = (outFeaturesSize >> Log2Core) + ((outFeaturesSize & (n_cores-1))!=0);
+  }
+  /* start and stop neuron to be computed, for each core */
+  int start = MIN(chunck * core_id,outFeaturesSize);
+  int stop = MIN(start + chunck, outFeaturesSize);
+#else
+  int start = 0;
+  int stop = outFeaturesSize;
+#endif
+
+#if defined(FixedPt) && defined(SIMD)
+  int inFeaturesSizeP2    = (inFeaturesSize)/2;
+  int inFeaturesSizeP2_p1 = (inFeaturesSize)/2 + W_OFFSET/2;
+
+  for (int o_start=start; o_start<stop; o_start+=OUTPUTBUFFER)
+  {
+    int tileSize = Min(OUTPUTBUFFER, stop-o_start);
+    v2s * weight_ptr = &((v2s*)weight)[inFeaturesSizeP2_p1*o_start];
+    int32_t temp[OUTPUTBUFFER];
+
+    for(int o_rel=0; o_rel<tileSize; o_rel++)
+      temp[o_rel] = (int32_t)bias[o_start+o_rel]<<(q_fraqP1);
+
+    if(tileSize == OUTPUTBUFFER)
+    {
+# if defined(VLIWEXT) && !defined(ASIP) && (OUTPUTBUFFER % 2) == 0
+      // one weight stream per neuron, neighbouring neurons alternate between SPR0 and SPR1 and
+      // every pl.sdotsp preloads the weight of the neuron two positions later
+      register int x0 asm("x0");
+      uint32_t addr[OUTPUTBUFFER]; // kept in registers as the tile loops are unrolled
+      register_attribute uint32_t in_addr = (uint32_t) inFeatures;
+      for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel++)
+        addr[o_rel] = (uint32_t) &weight_ptr[inFeaturesSizeP2_p1*o_rel];
+
+      PL_SDOTP0(x0, addr[0], x0); // preload first weight
+      PL_SDOTP1(x0, addr[1], x0); // preload second weight
+
+      for(int i=0; i<inFeaturesSizeP2; i++)
       {
-        // printf(" core_id %d b\n",core_id);
-        if ((core_id%2)==0)
+        v2s inF_temp;
+        asm volatile("p.lw %0, 4(%1!)" : "=r" (inF_temp), "+r" (in_addr));
+        for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel+=2)
         {
-          // printf(" core_id %d +\n",core_id);
-          chunkg_orig = chunck;
-          chunck = chunck+1;
+          PL_SDOTP0(temp[o_rel+0], addr[(o_rel+2)%OUTPUTBUFFER], inF_temp);
+          PL_SDOTP1(temp[o_rel+1], addr[(o_rel+3)%OUTPUTBUFFER], inF_temp);
         }
-        else
+      }
+# else // no VLIWEXT
+      for(int i=0; i<inFeaturesSizeP2; i++)
+      {
+        v2s inF_temp = ((v2s*)inFeatures)[i];
+        for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel++)
         {
-          // printf(" core_id %d -\n",core_id);
-          chunkg_orig = chunck;
-          chunck = chunck-1;
-          start_offset = 1;
+          SDOTP_GENERIC(temp[o_rel], weight_ptr[inFeaturesSizeP2_p1*o_rel + i], inF_temp);
+        }
+      }
+# endif // VLIWEXT
+    }
+    else // last tile of the core with less than OUTPUTBUFFER neurons
+    {
+      for(int i=0; i<inFeaturesSizeP2; i++)
+      {
+        v2s inF_temp = ((v2s*)inFeatures)[i];
+        for(int o_rel=0; o_rel<tileSize; o_rel++)
+        {
+          SDOTP_GENERIC(temp[o_rel], weight_ptr[inFeaturesSizeP2_p1*o_rel + i], inF_temp);
         }
       }
+    }
+
+    for(int o_rel=0; o_rel<tileSize; o_rel++)
+      outFeatures[o_start+o_rel] = fusedEpilogue(temp[o_rel]>>(q_fraqP1), o_start+o_rel, fusedOps, fusedTensors, inFeatures);
   }
-  /* start and stop neuron to be computed, for each core */
-  int start = MIN((chunkg_orig) * core_id+start_offset,TensorSize);
-  int stop = MIN(start + chunck, TensorSize);
-  int chunck_final = (stop-start);
 
-  // printf("addtensor core_id %d - start: %d - stop: %d \n",core_id, start, stop);
+#else // no FixedPt SIMD
+  for (int o=start; o<stop; o++)
+  {
+# ifdef FixedPt
+    int32_t temp = ((int32_t)bias[o])<<(q_fraqP1);
+# else
+    data_t temp = bias[o];
+# endif
+    for(int i=0; i<inFeaturesSize; i++)
+    {
+      temp += inFeatures[i]*weight[(inFeaturesSize+W_OFFSET)*o + i];
+    }
+# ifdef FixedPt
+    temp = temp>>(q_fraqP1);
+# endif
+    outFeatures[o] = fusedEpilogue(temp, o, fusedOps, fusedTensors, inFeatures);
+  }
+#endif // FixedPt SIMD
 
+  PROFILING_LINEAR_END
+}
 
-#endif // MULTICORE
+
+#if defined(__AVX2__) && !defined(ASIP)
+/** @brief Sum of the 8 32 bit lanes of an AVX2 accumulator (host GemmLayer) */
+static inline int32_t gemmHsum(__m256i acc) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates one (edge) tile of GemmLayer without register blocking
+ *
+ *  @param inFeaturesSize Number of input neurons (K)
+ *  @param outFeaturesSize Number of output neurons (M)
+ *  @param o0 First output neuron of the tile
+ *  @param rows Output neurons of the tile
+ *  @param n0 First vector of the tile
+ *  @param cols Vectors of the tile
+ *  @param hasBias FC with bias or not?
+ *  @param weight Pointer to weights
+ *  @param bias Pointer to bias
+ *  @param inFeatures Input Feature Maps (one vector after the other)
+ *  @param outFeatures Output Feature Maps (one vector after the other)
+ */
+static void gemmEdgeTile (
+  int inFeaturesSize, int outFeaturesSize,
+  int o0, int rows, int n0, int cols,
+  short hasBias,
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+#ifdef FixedPt
+  typedef int32_t acc_t;
+#else
+  typedef data_t acc_t;
+#endif
+  int inFeaturesSizeP2    = (inFeaturesSize)/2;
+  int inFeaturesSizeP2_p1 = (inFeaturesSize)/2 + W_OFFSET/2;
+
+  for (int n=n0; n<n0+cols; n++)
+  {
+    for (int o=o0; o<o0+rows; o++)
+    {
+#ifdef FixedPt
+      acc_t temp0 = hasBias ? ((acc_t)bias[o])<<(q_fraqP1) : 0;
+#else
+      acc_t temp0 = hasBias ? bias[o] : 0;
+#endif
+
+#if defined(FixedPt) && defined(SIMD)
+      if ((inFeaturesSize & 0x1) == 0)
+      {
+        v2s * weight0 = &((v2s*)weight)[inFeaturesSizeP2_p1*o];
+        v2s * inF0    = &((v2s*)inFeatures)[inFeaturesSizeP2*n];
+        for(int i=0; i<inFeaturesSizeP2; i++)
+        {
+# ifdef ASIP
+          temp0 = temp0 + inF0[i] * weight0[i];
+# else // not ASIP
+          temp0 = __SUMDOTP2(inF0[i], weight0[i], temp0);
+# endif // ASIP
+        }
+      }
+      else
+#endif // FixedPt SIMD
+      // odd number of input neurons: the rows and vectors are not word aligned, no v2s loads
+      for(int i=0; i<inFeaturesSize; i++)
+      {
+        temp0 += inFeatures[inFeaturesSize*n + i]*weight[(inFeaturesSize+W_OFFSET)*o + i];
+      }
+
+#ifdef FixedPt
+      temp0 = temp0>>(q_fraqP1);
+#endif
+      outFeatures[outFeaturesSize*n + o] = temp0;
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates a Fully-Connected Layer on several input vectors (GEMM)
+ *
+ *  Calculates outFeatures[n] = weight*inFeatures[n] + bias for nrVectors input vectors, i.e. the
+ *  (M x K) by (K x N) matrix product with M=outFeaturesSize, K=inFeaturesSize and N=nrVectors.
+ *  The outputs are computed in register blocks of GEMM_BLOCK_M output neurons times GEMM_BLOCK_N
+ *  vectors: every loaded weight pair is used for GEMM_BLOCK_N vectors and every input pair for
+ *  GEMM_BLOCK_M neurons, instead of one MAC per weight load as in LinearLayer. The blocks are
+ *  distributed to the cores in contiguous chunks (vectors of a block row first, so consecutive
+ *  blocks of a core reuse the same weight rows), the blocks at the matrix edges use gemmEdgeTile.
+ *  The vectors use the BATCHING layout (inFeatures[n*K+k], outFeatures[n*M+m]), the weights the
+ *  layout of LinearLayer (rows padded by W_OFFSET). On the host, the blocks use AVX2 if enabled.
+ *
+ *  @param inFeaturesSize Number of input neurons (K)
+ *  @param outFeaturesSize Number of output neurons (M)
+ *  @param nrVectors Number of input vectors (N)
+ *  @param hasBias FC with bias or not?
+ *  @param weight Pointer to weights
+ *  @param bias Pointer to bias
+ *  @param inFeatures Input Feature Maps (one vector after the other)
+ *  @param outFeatures Output Feature Maps (one vector after the other)
+ */
+void NOINLINE GemmLayer (
+  // Layer Attributes
+  int inFeaturesSize, int outFeaturesSize,
+  int nrVectors,
+  short hasBias,
+  // Layer Parameters
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+
+  PROFILING_LINEAR_START
+
+  int tilesM  = (outFeaturesSize+GEMM_BLOCK_M-1)/GEMM_BLOCK_M;
+  int tilesN  = (nrVectors+GEMM_BLOCK_N-1)/GEMM_BLOCK_N;
+  int nrTiles = tilesM*tilesN;
+
+#ifdef MULTICORE
+  /* instructions to parallelize the workload:
+  each core computes a balanced number of blocks */
+  int core_id = rt_core_id();
+  int n_cores = NR_CORES;
+  int chunck = 1;
+  /* handle the case when number of blocks
+  is less than number of cores: chunck=1 */
+  if(nrTiles < n_cores)
+  {
+    n_cores = nrTiles;
+  }
+  else
+  {
+    int Log2Core = __builtin_pulp_fl1(n_cores);
+    chunck = (nrTiles >> Log2Core) + ((nrTiles & (n_cores-1))!=0);
+  }
+  /* start and stop block to be computed, for each core */
+  int start = MIN(chunck * core_id,nrTiles);
+  int stop = MIN(start + chunck, nrTiles);
+#else
+  int start = 0;
+  int stop = nrTiles;
+#endif
+#ifdef FixedPt
+  typedef int32_t acc_t;
+#else
+  typedef data_t acc_t;
+#endif
+
+  // with an odd number of input neurons all blocks are computed by gemmEdgeTile (scalar)
+  int inFeaturesSizeP2    = (inFeaturesSize)/2;
+  int inFeaturesSizeP2_p1 = (inFeaturesSize)/2 + W_OFFSET/2;
+
+  for (int t=start; t<stop; t++)
+  {
+    int o = (t/tilesN)*GEMM_BLOCK_M;
+    int n = (t%tilesN)*GEMM_BLOCK_N;
+#if defined(FixedPt) && defined(SIMD)
+    if (o+GEMM_BLOCK_M > outFeaturesSize || n+GEMM_BLOCK_N > nrVectors || (inFeaturesSize & 0x1))
+#endif
+    {
+      gemmEdgeTile(inFeaturesSize, outFeaturesSize, o, Min(GEMM_BLOCK_M, outFeaturesSize-o),
+                   n, Min(GEMM_BLOCK_N, nrVectors-n), hasBias, weight, bias, inFeatures, outFeatures);
+      continue;
+    }
+
+#if defined(FixedPt) && defined(SIMD)
+    // 4 output neurons x 2 vectors (GEMM_BLOCK_M x GEMM_BLOCK_N)
+    acc_t temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
+    acc_t temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
+    if (hasBias)
+    {
+      temp0 = temp4 = ((acc_t)bias[o  ])<<(q_fraqP1);
+      temp1 = temp5 = ((acc_t)bias[o+1])<<(q_fraqP1);
+      temp2 = temp6 = ((acc_t)bias[o+2])<<(q_fraqP1);
+      temp3 = temp7 = ((acc_t)bias[o+3])<<(q_fraqP1);
+    }
+
+    v2s * weight0 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o  )];
+    v2s * weight1 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o+1)];
+    v2s * weight2 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o+2)];
+    v2s * weight3 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o+3)];
+    v2s * inF0    = &((v2s*)inFeatures)[inFeaturesSizeP2*(n  )];
+    v2s * inF1    = &((v2s*)inFeatures)[inFeaturesSizeP2*(n+1)];
+
+    int i = 0;
+# if defined(__AVX2__) && !defined(ASIP)
+    // host: 8 v2s (16 MACs) per instruction, the 32 bit sums wrap like __SUMDOTP2
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+    __m256i acc4 = _mm256_setzero_si256(), acc5 = _mm256_setzero_si256();
+    __m256i acc6 = _mm256_setzero_si256(), acc7 = _mm256_setzero_si256();
+    for(; i+8<=inFeaturesSizeP2; i+=8)
+    {
+      __m256i inF_temp0 = _mm256_loadu_si256((__m256i*)&inF0[i]);
+      __m256i inF_temp1 = _mm256_loadu_si256((__m256i*)&inF1[i]);
+      __m256i w;
+      w = _mm256_loadu_si256((__m256i*)&weight0[i]);
+      acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(w, inF_temp0));
+      acc4 = _mm256_add_epi32(acc4, _mm256_madd_epi16(w, inF_temp1));
+      w = _mm256_loadu_si256((__m256i*)&weight1[i]);
+      acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(w, inF_temp0));
+      acc5 = _mm256_add_epi32(acc5, _mm256_madd_epi16(w, inF_temp1));
+      w = _mm256_loadu_si256((__m256i*)&weight2[i]);
+      acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(w, inF_temp0));
+      acc6 = _mm256_add_epi32(acc6, _mm256_madd_epi16(w, inF_temp1));
+      w = _mm256_loadu_si256((__m256i*)&weight3[i]);
+      acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(w, inF_temp0));
+      acc7 = _mm256_add_epi32(acc7, _mm256_madd_epi16(w, inF_temp1));
+    }
+    temp0 += gemmHsum(acc0); temp1 += gemmHsum(acc1); temp2 += gemmHsum(acc2); temp3 += gemmHsum(acc3);
+    temp4 += gemmHsum(acc4); temp5 += gemmHsum(acc5); temp6 += gemmHsum(acc6); temp7 += gemmHsum(acc7);
+# endif // __AVX2__
+    for(; i<inFeaturesSizeP2; i++)
+    {
+      v2s inF_temp0 = inF0[i];
+      v2s inF_temp1 = inF1[i];
+      v2s w0 = weight0[i], w1 = weight1[i], w2 = weight2[i], w3 = weight3[i];
+# ifdef ASIP
+      temp0 = temp0 + inF_temp0 * w0;
+      temp1 = temp1 + inF_temp0 * w1;
+      temp2 = temp2 + inF_temp0 * w2;
+      temp3 = temp3 + inF_temp0 * w3;
+      temp4 = temp4 + inF_temp1 * w0;
+      temp5 = temp5 + inF_temp1 * w1;
+      temp6 = temp6 + inF_temp1 * w2;
+      temp7 = temp7 + inF_temp1 * w3;
+# else // not ASIP
+      temp0 = __SUMDOTP2(inF_temp0, w0, temp0);
+      temp1 = __SUMDOTP2(inF_temp0, w1, temp1);
+      temp2 = __SUMDOTP2(inF_temp0, w2, temp2);
+      temp3 = __SUMDOTP2(inF_temp0, w3, temp3);
+      temp4 = __SUMDOTP2(inF_temp1, w0, temp4);
+      temp5 = __SUMDOTP2(inF_temp1, w1, temp5);
+      temp6 = __SUMDOTP2(inF_temp1, w2, temp6);
+      temp7 = __SUMDOTP2(inF_temp1, w3, temp7);
+# endif // ASIP
+    }
+
+    data_t * out0 = &outFeatures[outFeaturesSize*(n  ) + o];
+    data_t * out1 = &outFeatures[outFeaturesSize*(n+1) + o];
+    out0[0] = temp0>>(q_fraqP1);
+    out0[1] = temp1>>(q_fraqP1);
+    out0[2] = temp2>>(q_fraqP1);
+    out0[3] = temp3>>(q_fraqP1);
+    out1[0] = temp4>>(q_fraqP1);
+    out1[1] = temp5>>(q_fraqP1);
+    out1[2] = temp6>>(q_fraqP1);
+    out1[3] = temp7>>(q_fraqP1);
+#endif // FixedPt SIMD
+  }
+
+  PROFILING_LINEAR_END
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates point-wise Addition of Tensors (A+=B)
+ *
+ *  @param TensorSize Input Value
+ *  @param FeaturesA Accumulation Tensor
+ *  @param FeaturesB Addend Tensor
+ */
+void NOINLINE AddTensor (
+  // Layer Attributes
+  int TensorSize,
+  // Layer Parameters
+  data_t * __restrict__ FeaturesA,
+  data_t * __restrict__ FeaturesB)
+{
+
+  PROFILING_ADDT_START
+
+#ifdef ASIP
+
+// TODO implement SIMD add on tzscale
+  for(int o=0; o<TensorSize; o++)
+    FeaturesA[o] += FeaturesB[o];
+
+  return;
+
+#else // ASIP
+
+
+#ifdef MULTICORE
+  /* instructions to parallelize the workload:
+  each core computes a balanced number of neurons */
+  int core_id = rt_core_id();
+  int n_cores = NR_CORES;
+  int chunck = 1;
+  int chunkg_orig=1;
+
+  int start_offset = 0;
+  /* handle the case when number of neurons
+  is less than number of cores: chunck=1 */
+  if(TensorSize <= n_cores)
+  {
+      // n_cores = TensorSize;
+      n_cores = 1;
+      if (core_id == 0)
+      {
+        chunck = TensorSize;
+      } else
+      {
+        chunck = 0;
+      }
+  }
+  else
+  {
+      int Log2Core = __builtin_pulp_fl1(n_cores);
+      chunck = (TensorSize >> Log2Core) + ((TensorSize & (n_cores-1))!=0);
+      chunkg_orig = chunck;
+      // printf(" core_id %d a\n",core_id);
+      if ((chunck % 2)!=0)
+      {
+        // printf(" core_id %d b\n",core_id);
+        if ((core_id%2)==0)
+        {
+          // printf(" core_id %d +\n",core_id);
+          chunkg_orig = chunck;
+          chunck = chunck+1;
+        }
+        else
+        {
+          // printf(" core_id %d -\n",core_id);
+          chunkg_orig = chunck;
+          chunck = chunck-1;
+          start_offset = 1;
+        }
+      }
+  }
+  /* start and stop neuron to be computed, for each core */
+  int start = MIN((chunkg_orig) * core_id+start_offset,TensorSize);
+  int stop = MIN(start + chunck, TensorSize);
+  int chunck_final = (stop-start);
+
+  // printf("addtensor core_id %d - start: %d - stop: %d \n",core_id, start, stop);
+
+
+#endif // MULTICORE
 
 
 #ifdef SIMD
 
 #ifdef MULTICORE
 
-  int TensorSizeP2 = start + chunck_final/2;
+  // start is even for all cores (see partitioning above), the loop runs over v2s pairs
+  int TensorSizeP2 = start/2 + chunck_final/2;
   v2s * SIMD_FeaturesA = (v2s*) FeaturesA;
   v2s * SIMD_FeaturesB = (v2s*) FeaturesB;
 
-  for(int o=start; o<stop; o++)
+  for(int o=start/2; o<TensorSizeP2; o++)
   {
 #else // MULTICORE
 
@@ -6706,6 +7479,99 @@ void NOINLINE HadMulTensor (
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates the Hadamard Product with the tangent hyperbolic of a Tensor (Out=tanh(A)*B)
+ *
+ *  Writes the LSTM hidden state h_t=o_t*tanh(c_t) directly to its destination, without copying
+ *  the cell state and without intermediate barriers.
+ *
+ *  @param TensorSize Input Value
+ *  @param FeaturesOut Output Tensor
+ *  @param FeaturesA Tensor passed through tanh (not modified)
+ *  @param FeaturesB Multiplicand Tensor
+ */
+void NOINLINE TanhHadMulTensor (
+  // Layer Attributes
+  int TensorSize,
+  // Layer Parameters
+  data_t * __restrict__ FeaturesOut,
+  data_t * __restrict__ FeaturesA,
+  data_t * __restrict__ FeaturesB)
+{
+
+  PROFILING_HADM_START
+
+#ifdef MULTICORE
+  /* instructions to parallelize the workload:
+  each core computes a balanced number of neurons */
+  int core_id = rt_core_id();
+  int n_cores = NR_CORES;
+  int chunck = 1;
+  int chunkg_orig=1;
+
+  int start_offset = 0;
+  /* handle the case when number of neurons
+  is less than number of cores: chunck=1 */
+  if(TensorSize <= n_cores)
+  {
+      // n_cores = TensorSize;
+      n_cores = 1;
+      if (core_id == 0)
+      {
+        chunck = TensorSize;
+      } else
+      {
+        chunck = 0;
+      }
+  }
+  else
+  {
+      int Log2Core = __builtin_pulp_fl1(n_cores);
+      chunck = (TensorSize >> Log2Core) + ((TensorSize & (n_cores-1))!=0);
+      chunkg_orig = chunck;
+      // printf(" core_id %d a\n",core_id);
+      if ((chunck % 2)!=0)
+      {
+        // printf(" core_id %d b\n",core_id);
+        if ((core_id%2)==0)
+        {
+          // printf(" core_id %d +\n",core_id);
+          chunkg_orig = chunck;
+          chunck = chunck+1;
+        }
+        else
+        {
+          // printf(" core_id %d -\n",core_id);
+          chunkg_orig = chunck;
+          chunck = chunck-1;
+          start_offset = 1;
+        }
+      }
+  }
+  /* start and stop neuron to be computed, for each core */
+  int start = MIN((chunkg_orig) * core_id+start_offset,TensorSize);
+  int stop = MIN(start + chunck, TensorSize);
+  int chunck_final = (stop-start);
+
+  for (int o=start; o<stop; o++) 
+  {
+#else
+  for (int o=0; o<TensorSize; o++) 
+  {
+#endif
+
+#ifdef FixedPt
+    FeaturesOut[o] = (generic_tanh(FeaturesA[o])*FeaturesB[o])>>(q_fraqP1);
+#else
+    FeaturesOut[o] = generic_tanh(FeaturesA[o])*FeaturesB[o];
+#endif
+
+  }
+  PROFILING_HADM_END
+
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 /** @brief Copy of Tensor A to B
  *
@@ -6809,18 +7675,45 @@ void NOINLINE TanhLayer (
   /* start and stop neuron to be computed, for each core */
   int start = MIN((chunkg_orig) * core_id+start_offset,TensorSize);
   int stop = MIN(start + chunck, TensorSize);
-  int chunck_final = (stop-start);
 
-  for (int o=start; o<stop; o++) 
-  {
 #else
-  for (int o=0; o<TensorSize; o++) 
-  {
+  int start = 0;
+  int stop  = TensorSize;
 #endif
 
+#ifdef ACT_AVX2
+  start = actLayerAvx2(Features, start, stop, 0);
+#endif
+
+#ifdef SIMD
+  // peel off the first neuron if it is not word-aligned
+  int o = start;
+  if ((o<stop) && ((uintptr_t)&Features[o] & 0x2))
+  {
     Features[o] = generic_tanh(Features[o]);
+    o++;
   }
 
+  // two neurons per iteration
+  v2s * Features_v2s = (v2s *)&Features[o];
+  for (; o<stop-1; o+=2) 
+  {
+    *Features_v2s = generic_tanh_v2s(*Features_v2s);
+    Features_v2s++;
+  }
+
+  // leftover
+  if (o<stop)
+  {
+    Features[o] = generic_tanh(Features[o]);
+  }
+#else
+  for (int o=start; o<stop; o++) 
+  {
+    Features[o] = generic_tanh(Features[o]);
+  }
+#endif // SIMD
+
   PROFILING_TANH_END
 }
 
@@ -6843,113 +7736,410 @@ void NOINLINE SigLayer (
 {
   PROFILING_TANH_START
 
-  for(int i=0; i<TensorSize; i++) {
-    //ext_nop();chess_separator_scheduler();
-    Features[i] = tzscale_sig(Features[i]); //tzscale_tanh(Features[i],0);
+  for(int i=0; i<TensorSize; i++) {
+    //ext_nop();chess_separator_scheduler();
+    Features[i] = tzscale_sig(Features[i]); //tzscale_tanh(Features[i],0);
+  }
+  PROFILING_TANH_END
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+#else // ASIP_USETANHSIG
+
+void NOINLINE SigLayer (
+  // Layer Attributes
+  int TensorSize,
+  data_t * __restrict__ Features)
+{
+  PROFILING_TANH_START
+
+  #ifdef MULTICORE
+  /* instructions to parallelize the workload:
+  each core computes a balanced number of neurons */
+  int core_id = rt_core_id();
+  int n_cores = NR_CORES;
+  int chunck = 1;
+  int chunkg_orig=1;
+
+  int start_offset = 0;
+  /* handle the case when number of neurons
+  is less than number of cores: chunck=1 */
+  if(TensorSize <= n_cores)
+  {
+      // n_cores = TensorSize;
+      n_cores = 1;
+      if (core_id == 0)
+      {
+        chunck = TensorSize;
+      } else
+      {
+        chunck = 0;
+      }
+  }
+  else
+  {
+      int Log2Core = __builtin_pulp_fl1(n_cores);
+      chunck = (TensorSize >> Log2Core) + ((TensorSize & (n_cores-1))!=0);
+      chunkg_orig = chunck;
+      // printf(" core_id %d a\n",core_id);
+      if ((chunck % 2)!=0)
+      {
+        // printf(" core_id %d b\n",core_id);
+        if ((core_id%2)==0)
+        {
+          // printf(" core_id %d +\n",core_id);
+          chunkg_orig = chunck;
+          chunck = chunck+1;
+        }
+        else
+        {
+          // printf(" core_id %d -\n",core_id);
+          chunkg_orig = chunck;
+          chunck = chunck-1;
+          start_offset = 1;
+        }
+      }
+  }
+  /* start and stop neuron to be computed, for each core */
+  int start = MIN((chunkg_orig) * core_id+start_offset,TensorSize);
+  int stop = MIN(start + chunck, TensorSize);
+
+  // printf(" core_id %d - start: %d - stop: %d \n",core_id, start, stop);
+
+#else
+  int start = 0;
+  int stop  = TensorSize;
+#endif
+
+#ifdef ACT_AVX2
+  start = actLayerAvx2(Features, start, stop, 1);
+#endif
+
+#ifdef SIMD
+  // peel off the first neuron if it is not word-aligned
+  int o = start;
+  if ((o<stop) && ((uintptr_t)&Features[o] & 0x2))
+  {
+    Features[o] = generic_sig(Features[o]);
+    o++;
+  }
+
+  // two neurons per iteration
+  v2s * Features_v2s = (v2s *)&Features[o];
+  for (; o<stop-1; o+=2) 
+  {
+    *Features_v2s = generic_sig_v2s(*Features_v2s);
+    Features_v2s++;
+  }
+
+  // leftover
+  if (o<stop)
+  {
+    Features[o] = generic_sig(Features[o]);
+  }
+#else
+  for (int o=start; o<stop; o++) 
+  {
+    Features[o] = generic_sig(Features[o]);
+  }
+#endif // SIMD
+
+  PROFILING_TANH_END
+}
+
+#endif // ASIP_USETANHSIG
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Fills Tensor with contstant
+ *
+ *  @param TensorSize Input Value
+ *  @param Tensor Input and Output of Activation Fucntion
+ *  @param fillValue constant value
+ */
+void NOINLINE fillTensor (
+  // Layer Attributes
+  int TensorSize,
+  data_t * __restrict__ Tensor,
+  data_t fillValue)
+{
+  PROFILING_FILL_START
+  for (int o=0; o< TensorSize; o++) 
+  {
+    Tensor[o] = fillValue;
+  }
+  PROFILING_FILL_END
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Piecewise linear approximation of e^(-x) for x>=0
+ *
+ *  32 segments of width 0.25 cover [0,8), larger inputs return 0.
+ *
+ *  @param value non-negative input value
+ *  @return e^(-value)
+ */
+inline int expNeg(int value) {
+    int id = MIN(value>>(13-3), 31); // get (clamped) index of LUT
+#ifdef MULTICORE
+    return MAX((l1_lut_exp_q[id]-l1_lut_exp_m[id]*value)>>12, 0);
+#else
+    return MAX((lut_exp_q[id]-lut_exp_m[id]*value)>>12, 0);
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Inserts a value into a (descending) sorted list of k values
+ *
+ *  @param value value to be inserted
+ *  @param index index of the value
+ *  @param k length of the list
+ *  @param values sorted values
+ *  @param indices indices belonging to values
+ */
+inline void topkInsert(int value, int index, int k, int * values, int * indices) {
+    if(value <= values[k-1]) return;
+    int j = k-1;
+    while(j>0 && values[j-1] < value) {
+        values[j]  = values[j-1];
+        indices[j] = indices[j-1];
+        j--;
+    }
+    values[j]  = value;
+    indices[j] = index;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates a fixed-point softmax
+ *
+ *  out_i = e^(x_i-max(x)) / sum_j e^(x_j-max(x)), the maximum and the sum are reduced
+ *  across all cores.
+ *
+ *  @param TensorSize Number of neurons
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map
+ */
+void NOINLINE SoftmaxLayer (
+  // Layer Attributes
+  int TensorSize,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+  PROFILING_HEAD_START
+
+#ifdef MULTICORE
+  int core_id  = rt_core_id();
+  // partial results of the cores, disjoint for concurrent core groups (MULTI_MODEL)
+  int * partial_val = &head_partial_val[CORE_GROUP_FIRST()*TOPK_MAX];
+  int Log2Core = __builtin_pulp_fl1(NR_CORES);
+  int chunck   = (TensorSize >> Log2Core) + ((TensorSize & (NR_CORES-1))!=0);
+  int start    = MIN(chunck * core_id, TensorSize);
+  int stop     = MIN(start + chunck, TensorSize);
+#else
+  int start = 0;
+  int stop  = TensorSize;
+#endif
+
+  // maximum, such that all exponents are <= 0
+  int max_value = HEAD_MIN_VALUE;
+  for (int o=start; o<stop; o++)
+  {
+    max_value = MAX(max_value, inFeatures[o]);
+  }
+#ifdef MULTICORE
+  partial_val[core_id] = max_value;
+  synch_barrier();
+  for (int c=0; c<NR_CORES; c++)
+  {
+    max_value = MAX(max_value, partial_val[c]);
+  }
+  synch_barrier(); // partial results are overwritten below
+#endif
+
+  // exponents and (partial) sum
+  int sum = 0;
+  for (int o=start; o<stop; o++)
+  {
+    int e = expNeg(max_value-inFeatures[o]);
+    outFeatures[o] = e;
+    sum += e;
+  }
+#ifdef MULTICORE
+  partial_val[core_id] = sum;
+  synch_barrier();
+  sum = 0;
+  for (int c=0; c<NR_CORES; c++)
+  {
+    sum += partial_val[c];
+  }
+#endif
+
+  // normalize with a single division (sum>0 as e^0 is always part of it), the reciprocal
+  // has 30 fraction bits such that its truncation is below an LSB of the outputs
+  // (e<=sum, hence e*recip<=2^30)
+  int recip = (1<<30)/sum;
+  for (int o=start; o<stop; o++)
+  {
+    outFeatures[o] = (outFeatures[o]*recip + (1<<(30-q_frac-1)))>>(30-q_frac);
   }
-  PROFILING_TANH_END
+
+  PROFILING_HEAD_END
 }
 
-//////////////////////////////////////////////////////////////////////////////////////////////
-#else // ASIP_USETANHSIG
 
-void NOINLINE SigLayer (
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Index of the largest neuron
+ *
+ *  Every core searches its chunk, core 0 reduces the partial results. On ties the 
+ *  lowest index is returned.
+ *
+ *  @param TensorSize Number of neurons
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output (outFeatures[0] contains the index)
+ */
+void NOINLINE ArgmaxLayer (
   // Layer Attributes
   int TensorSize,
-  data_t * __restrict__ Features)
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
 {
-  PROFILING_TANH_START
+  PROFILING_HEAD_START
 
-  #ifdef MULTICORE
-  /* instructions to parallelize the workload:
-  each core computes a balanced number of neurons */
-  int core_id = rt_core_id();
-  int n_cores = NR_CORES;
-  int chunck = 1;
-  int chunkg_orig=1;
+#ifdef MULTICORE
+  int core_id  = rt_core_id();
+  // partial results of the cores, disjoint for concurrent core groups (MULTI_MODEL)
+  int * partial_val = &head_partial_val[CORE_GROUP_FIRST()*TOPK_MAX];
+  int * partial_idx = &head_partial_idx[CORE_GROUP_FIRST()*TOPK_MAX];
+  int Log2Core = __builtin_pulp_fl1(NR_CORES);
+  int chunck   = (TensorSize >> Log2Core) + ((TensorSize & (NR_CORES-1))!=0);
+  int start    = MIN(chunck * core_id, TensorSize);
+  int stop     = MIN(start + chunck, TensorSize);
+#else
+  int start = 0;
+  int stop  = TensorSize;
+#endif
 
-  int start_offset = 0;
-  /* handle the case when number of neurons
-  is less than number of cores: chunck=1 */
-  if(TensorSize <= n_cores)
+  int max_value = HEAD_MIN_VALUE;
+  int max_idx   = 0;
+  for (int o=start; o<stop; o++)
   {
-      // n_cores = TensorSize;
-      n_cores = 1;
-      if (core_id == 0)
-      {
-        chunck = TensorSize;
-      } else
-      {
-        chunck = 0;
-      }
+    if(inFeatures[o] > max_value)
+    {
+      max_value = inFeatures[o];
+      max_idx   = o;
+    }
   }
-  else
+
+#ifdef MULTICORE
+  partial_val[core_id] = max_value;
+  partial_idx[core_id] = max_idx;
+  synch_barrier();
+
+  if (core_id==0)
   {
-      int Log2Core = __builtin_pulp_fl1(n_cores);
-      chunck = (TensorSize >> Log2Core) + ((TensorSize & (n_cores-1))!=0);
-      chunkg_orig = chunck;
-      // printf(" core_id %d a\n",core_id);
-      if ((chunck % 2)!=0)
+    for (int c=1; c<NR_CORES; c++)
+    {
+      if(partial_val[c] > max_value)
       {
-        // printf(" core_id %d b\n",core_id);
-        if ((core_id%2)==0)
-        {
-          // printf(" core_id %d +\n",core_id);
-          chunkg_orig = chunck;
-          chunck = chunck+1;
-        }
-        else
-        {
-          // printf(" core_id %d -\n",core_id);
-          chunkg_orig = chunck;
-          chunck = chunck-1;
-          start_offset = 1;
-        }
+        max_value = partial_val[c];
+        max_idx   = partial_idx[c];
       }
+    }
+    outFeatures[0] = max_idx;
   }
-  /* start and stop neuron to be computed, for each core */
-  int start = MIN((chunkg_orig) * core_id+start_offset,TensorSize);
-  int stop = MIN(start + chunck, TensorSize);
-  int chunck_final = (stop-start);
-
-  // printf(" core_id %d - start: %d - stop: %d \n",core_id, start, stop);
-
-  for (int o=start; o<stop; o++) 
-  {
 #else
-  for (int o=0; o<TensorSize; o++) 
-  {
+  outFeatures[0] = max_idx;
 #endif
 
-    Features[o] = generic_sig(Features[o]);
-  }
-
-  PROFILING_TANH_END
+  PROFILING_HEAD_END
 }
 
-#endif // ASIP_USETANHSIG
-//////////////////////////////////////////////////////////////////////////////////////////////
-
 
 //////////////////////////////////////////////////////////////////////////////////////////////
-/** @brief Fills Tensor with contstant
+/** @brief Indices of the k largest neurons
  *
- *  @param TensorSize Input Value
- *  @param Tensor Input and Output of Activation Fucntion
- *  @param fillValue constant value
+ *  Every core determines the top-k of its chunk, core 0 merges the NR_CORES*k 
+ *  candidates. The indices are sorted by descending value.
+ *
+ *  @param TensorSize Number of neurons
+ *  @param k Number of indices to be returned (at most TOPK_MAX)
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output (outFeatures[0..k-1] contain the indices)
  */
-void NOINLINE fillTensor (
+void NOINLINE TopKLayer (
   // Layer Attributes
   int TensorSize,
-  data_t * __restrict__ Tensor,
-  data_t fillValue)
+  int k,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
 {
-  PROFILING_FILL_START
-  for (int o=0; o< TensorSize; o++) 
+  PROFILING_HEAD_START
+
+#ifdef MULTICORE
+  int core_id  = rt_core_id();
+  // partial results of the cores, disjoint for concurrent core groups (MULTI_MODEL)
+  int * partial_val = &head_partial_val[CORE_GROUP_FIRST()*TOPK_MAX];
+  int * partial_idx = &head_partial_idx[CORE_GROUP_FIRST()*TOPK_MAX];
+  int Log2Core = __builtin_pulp_fl1(NR_CORES);
+  int chunck   = (TensorSize >> Log2Core) + ((TensorSize & (NR_CORES-1))!=0);
+  int start    = MIN(chunck * core_id, TensorSize);
+  int stop     = MIN(start + chunck, TensorSize);
+#else
+  int start = 0;
+  int stop  = TensorSize;
+#endif
+
+  int values[TOPK_MAX];
+  int indices[TOPK_MAX];
+  for (int j=0; j<k; j++)
   {
-    Tensor[o] = fillValue;
+    values[j]  = HEAD_MIN_VALUE;
+    indices[j] = -1;
   }
-  PROFILING_FILL_END
+
+  for (int o=start; o<stop; o++)
+  {
+    topkInsert(inFeatures[o], o, k, values, indices);
+  }
+
+#ifdef MULTICORE
+  for (int j=0; j<k; j++)
+  {
+    partial_val[core_id*TOPK_MAX+j] = values[j];
+    partial_idx[core_id*TOPK_MAX+j] = indices[j];
+  }
+  synch_barrier();
+
+  if (core_id==0)
+  {
+    // candidates of lower cores are inserted first, i.e. lower indices win on ties
+    for (int c=1; c<NR_CORES; c++)
+    {
+      for (int j=0; j<k; j++)
+      {
+        topkInsert(partial_val[c*TOPK_MAX+j], partial_idx[c*TOPK_MAX+j], k, values, indices);
+      }
+    }
+    for (int j=0; j<k; j++)
+    {
+      outFeatures[j] = indices[j];
+    }
+  }
+#else
+  for (int j=0; j<k; j++)
+  {
+    outFeatures[j] = indices[j];
+  }
+#endif
+
+  PROFILING_HEAD_END
 }
 
 
@@ -6997,22 +8187,6 @@ void NOINLINE fillTensor (
 // #endif // FixedPt
 //   #endif // TURNOFF
 // }
-// // inline v2s ALWAYS_INLINE sig_SIMD(v2s value)
-// // {
-// //    // TODO: NOT WORKING at the moment
-// // #ifdef SIMD
-// // #ifdef TURNOFF
-// //   // return value;
-// // // printf("qwer\n");
-// //   int tmp = Max(Min(8, Abs(((int)value+2048)/4096)),0);
-// //   return ((lut_fakeTanh_m[tmp]*value) >> (q_fraqP1))+lut_fakeTanh_q[tmp];
-// // #endif // TURNOFF
-// // #endif // SIMD
-
-// //   printf("This function should not be called this way!");
-
-// // }
-
 
 // inline data_t ALWAYS_INLINE sig_old(data_t value)
 // {
@@ -7070,17 +8244,22 @@ void NOINLINE fillTensor (
  *
  *  Calculates an RNN layer based on 
  *  h_t = \\tanh(w_{ih} x_t + b_{ih}  +  w_{hh} h_{(t-1)} + b_{hh})
+ *  With LAYER_FUSION both FC layers, the addition and tanh are calculated in one kernel.
  *  @param inFeaturesSize Number of input neurons
  *  @param hiddenFeaturesSize Number of hidden neurons
  *  @param weight_ih_l Weights mapping input neurons to hidden neurons
  *  @param weight_hh_l Weights mapping hidden neurons to hidden neurons
  *  @param bias_ih_l Bias mapping input neurons to hidden neurons
  *  @param bias_hh_l Bias mapping hidden neurons to hidden neurons
+ *  The hidden state is kept in a ring of two buffers (outFeatures and hiddenFeatures) whose
+ *  pointers are swapped after every timestep instead of copying the new state.
  *  @param inFeatures Input Feature Map
  *  @param outFeatures Output Feature Map
  *  @param hiddenFeatures Hidden Feature Map
+ *  @return Pointer to the new hidden state and output (outFeatures after an odd number of
+ *  timesteps, hiddenFeatures otherwise), the other buffer is overwritten with scratch data
  */
-void NOINLINE RNNLayer (
+data_t * NOINLINE RNNLayer (
   // Layer Attributes
   int inFeaturesSize, int hiddenFeaturesSize,
   // Layer Parameters
@@ -7090,37 +8269,136 @@ void NOINLINE RNNLayer (
   data_t * __restrict__ bias_hh_l,
   // Input and Output Features
   data_t * __restrict__ inFeatures,
-  data_t * __restrict__ outFeatures, // out and hidden
+  data_t * outFeatures, // out and hidden
   // Hidden Features
-  data_t * __restrict__ hiddenFeatures)
+  data_t * hiddenFeatures)
 {
 
+#if defined(LAYER_FUSION) && defined(MULTICORE) && defined(LSTM_HIGH_OPT)
+  /* instructions to parallelize the workload:
+  each core computes a balanced number of neurons */
+  int core_id = rt_core_id();
+  int n_cores = NR_CORES;
+  int chunck = 1;
+  int chunkg_orig = 1;
+  int start_offset = 0;
+  /* handle the case when number of neurons
+  is less than number of cores: chunck=1 */
+  if(hiddenFeaturesSize <= n_cores)
+  {
+      n_cores = 1;
+      if (core_id == 0)
+      {
+        chunck = hiddenFeaturesSize;
+      } else
+      {
+        chunck = 0;
+      }
+  }
+  else
+  {
+    int Log2Core = __builtin_pulp_fl1(n_cores);
+    chunck = (hiddenFeaturesSize >> Log2Core) + ((hiddenFeaturesSize & (n_cores-1))!=0);
+    chunkg_orig = chunck;
+    if ((chunck % 2)!=0)
+    {
+      if ((core_id%2)==0)
+      {
+        chunkg_orig = chunck;
+        chunck = chunck+1;
+      }
+      else
+      {
+        chunkg_orig = chunck;
+        chunck = chunck-1;
+        start_offset = 1;
+      }
+    }
+  }
+  /* start and stop neuron to be computed, for each core */
+  int start = MIN((chunkg_orig) * core_id+start_offset,hiddenFeaturesSize);
+  int stop = MIN(start + chunck, hiddenFeaturesSize);
+  int chunck_final = (stop-start);
+#endif // LAYER_FUSION && MULTICORE && LSTM_HIGH_OPT
+
+  // ring of two hidden state buffers: the new state is written to h_next and the pointers are swapped
+  data_t * h_prev = hiddenFeatures;
+  data_t * h_next = outFeatures;
+
   for(int seq=0; seq< rnn_seqSize; seq++) {
 
+#ifdef LAYER_FUSION
+    // h_t = tanh(w_{ih} x_t + b_{ih} + w_{hh} h_{(t-1)} + b_{hh}) in one pass without intermediate FMs
+#if defined(MULTICORE) && defined(LSTM_HIGH_OPT)
+    TwoLinearLayersAccumulate(inFeaturesSize, hiddenFeaturesSize, chunck_final, ACT_TANH,
+      weight_ih_l + start*inFeaturesSize,
+      weight_hh_l + start*hiddenFeaturesSize,
+      bias_ih_l + start,
+      bias_hh_l + start,
+      inFeatures+seq*inFeaturesSize,
+      h_prev,
+      h_next + start);
+#else // MULTICORE && LSTM_HIGH_OPT
+    TwoLinearLayersAccumulate(inFeaturesSize, hiddenFeaturesSize, hiddenFeaturesSize, ACT_TANH,
+      weight_ih_l, weight_hh_l, bias_ih_l, bias_hh_l,
+      inFeatures+seq*inFeaturesSize,
+      h_prev,
+      h_next);
+#endif // MULTICORE && LSTM_HIGH_OPT
+#ifdef MULTICORE
+    synch_barrier();
+#endif
+#ifndef DOACTONTHEFLY
+    TanhLayer(hiddenFeaturesSize, h_next);
+#ifdef MULTICORE
+    synch_barrier();
+#endif
+#endif // DOACTONTHEFLY
+#else // LAYER_FUSION
+
 #ifdef EFFICIENT_CORE_ASSIGNMENT
     printf("ERROR: not implemented RNNLayer with TILING_HARD");
 #ifdef BATCHING
-    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,0,True,1,(data_t*)weight_hh_l, bias_hh_l, hiddenFeatures, outFeatures); //w_{hh} h_{(t-1)}
-    LinearLayer(inFeaturesSize,hiddenFeaturesSize,0,True,1,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, hiddenFeatures); //w_{ih} x_t + b_{ih}
+    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,0,True,1,(data_t*)weight_hh_l, bias_hh_l, h_prev, h_next); //w_{hh} h_{(t-1)}
+#ifdef MULTICORE
+    synch_barrier(); // h_prev is overwritten below
+#endif
+    LinearLayer(inFeaturesSize,hiddenFeaturesSize,0,True,1,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, h_prev); //w_{ih} x_t + b_{ih}
 #else
-    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,0,True,(data_t*)weight_hh_l, bias_hh_l, hiddenFeatures, outFeatures); //w_{hh} h_{(t-1)}
-    LinearLayer(inFeaturesSize,hiddenFeaturesSize,0,True,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, hiddenFeatures); //w_{ih} x_t + b_{ih}
+    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,0,True,(data_t*)weight_hh_l, bias_hh_l, h_prev, h_next); //w_{hh} h_{(t-1)}
+#ifdef MULTICORE
+    synch_barrier(); // h_prev is overwritten below
+#endif
+    LinearLayer(inFeaturesSize,hiddenFeaturesSize,0,True,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, h_prev); //w_{ih} x_t + b_{ih}
 #endif
 #else
 #ifdef BATCHING
-    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,True,1,(data_t*)weight_hh_l, bias_hh_l, hiddenFeatures, outFeatures); //w_{hh} h_{(t-1)}
-    LinearLayer(inFeaturesSize,hiddenFeaturesSize,True,1,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, hiddenFeatures); //w_{ih} x_t + b_{ih} 
+    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,True,1,(data_t*)weight_hh_l, bias_hh_l, h_prev, h_next); //w_{hh} h_{(t-1)}
+#ifdef MULTICORE
+    synch_barrier(); // h_prev is overwritten below
+#endif
+    LinearLayer(inFeaturesSize,hiddenFeaturesSize,True,1,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, h_prev); //w_{ih} x_t + b_{ih} 
 #else
-    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_hh_l, bias_hh_l, hiddenFeatures, outFeatures); //w_{hh} h_{(t-1)}
-    LinearLayer(inFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, hiddenFeatures); //w_{ih} x_t + b_{ih} 
+    LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_hh_l, bias_hh_l, h_prev, h_next); //w_{hh} h_{(t-1)}
+#ifdef MULTICORE
+    synch_barrier(); // h_prev is overwritten below
+#endif
+    LinearLayer(inFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, h_prev); //w_{ih} x_t + b_{ih} 
 #endif
 #endif
 
-    AddTensor(hiddenFeaturesSize, outFeatures, hiddenFeatures);
-    TanhLayer(hiddenFeaturesSize, outFeatures);
-    CopyTensor(hiddenFeaturesSize, hiddenFeatures, outFeatures);
+    AddTensor(hiddenFeaturesSize, h_next, h_prev);
+    TanhLayer(hiddenFeaturesSize, h_next);
+#ifdef MULTICORE
+    synch_barrier();
+#endif
+#endif // LAYER_FUSION
+    data_t * h_tmp = h_prev;
+    h_prev = h_next;
+    h_next = h_tmp;
   }
 
+  return h_prev;
 }
 
 
@@ -7143,8 +8421,10 @@ void NOINLINE RNNLayer (
  *  @param lstm_i input/update gate activation tensor
  *  @param lstm_g g tensor 
  *  @param lstm_o output gate tensor
+ *  @return Pointer to the new hidden state h_t (lstm_h_out after an odd number of timesteps,
+ *  lstm_h otherwise as lstm_h and lstm_h_out are used as a ring of two buffers)
  */
-void NOINLINE LSTMLayer (
+data_t * NOINLINE LSTMLayer (
   // Layer Attributes
   int inFeaturesSize, int hiddenFeaturesSize,
   // Layer Parameters
@@ -7154,11 +8434,11 @@ void NOINLINE LSTMLayer (
   data_t * __restrict__ bias_hh_l,
   // Input and Output Features
   data_t * __restrict__ inFeatures,
-  data_t * __restrict__ lstm_h,
+  data_t * lstm_h,
   // Hidden Features
   data_t * __restrict__ lstm_c,
   // intermediate nodes
-  data_t * __restrict__ lstm_h_out,
+  data_t * lstm_h_out,
   data_t * __restrict__ lstm_f,
   data_t * __restrict__ lstm_i,
   data_t * __restrict__ lstm_g,
@@ -7416,14 +8696,19 @@ void NOINLINE LSTMLayer (
       PROFILING_ADDT_START
 #ifdef SIMD
 
-      int TensorSizeP2 = start + chunck_final/2;
+      // start is even, i.e. each core updates exactly its own neurons
+      int TensorSizeP2 = (start + chunck_final)/2;
       v2s * SIMD_FeaturesA = (v2s*) lstm_c;
       v2s * SIMD_FeaturesB = (v2s*) lstm_i;
 
-      for(int o=start; o<stop; o++)
+      for(int o=start/2; o<TensorSizeP2; o++)
       {
         SIMD_FeaturesA[o] += SIMD_FeaturesB[o];
       }
+      if (chunck_final & 0x1)
+      {
+        lstm_c[stop-1] += lstm_i[stop-1];
+      }
 
 #else // SIMD
 
@@ -7450,26 +8735,26 @@ void NOINLINE LSTMLayer (
 #endif
 
     //ht=ottanh(ct)
+    // every core writes its own neurons of h_out directly, as c_t and o_t of these neurons
+    // have been calculated by the same core (no copy, no barrier)
     if ( rt_core_id()==0 )
     {
         PROFILING_LSTM_AMDAHL_PARALLEL_END
         PROFILING_LSTM_AMDAHL_SERIELL_START
-
-        PROFILING_COPY_START
-        for (int o=0; o< hiddenFeaturesSize; o++) 
+    }
+    if ( core_id<NR_CORES )
+    {
+        PROFILING_HADM_START
+        for (int o=start; o<stop; o++) 
         {
-          // lstm_h_out[o] = generic_tanh(lstm_c[o]);
 #ifdef FixedPt
           lstm_h_out[o] = (generic_tanh(lstm_c[o]) * lstm_o[o])>>(q_fraqP1);
 #else
           lstm_h_out[o] = lstm_o[o] * generic_tanh(lstm_c[o]);
 #endif
-
         }
-        PROFILING_COPY_END
-
+        PROFILING_HADM_END
     }
-    // synch_barrier();
 
 
 #ifdef DEBUG_LSTM
@@ -7480,6 +8765,11 @@ void NOINLINE LSTMLayer (
 #endif
 
 #ifdef MULTI_INF
+    // h_t is the input of the next timestep: swap the hidden state ring instead of copying
+    synch_barrier();
+    data_t * lstm_h_tmp = lstm_h;
+    lstm_h = lstm_h_out;
+    lstm_h_out = lstm_h_tmp;
   }
 #endif // MULTI_INF
 
@@ -7499,6 +8789,11 @@ void NOINLINE LSTMLayer (
   }
 #endif
 
+#ifdef MULTI_INF
+  return lstm_h;
+#else
+  return lstm_h_out;
+#endif
 }
 
 
@@ -7520,8 +8815,10 @@ void NOINLINE LSTMLayer (
  *  @param lstm_i input/update gate activation tensor
  *  @param lstm_g g tensor 
  *  @param lstm_o output gate tensor
+ *  @return Pointer to the new hidden state h_t (lstm_h_out after an odd number of timesteps,
+ *  lstm_h otherwise as lstm_h and lstm_h_out are used as a ring of two buffers)
  */
-void NOINLINE LSTMLayer (
+data_t * NOINLINE LSTMLayer (
   // Layer Attributes
   int inFeaturesSize, int hiddenFeaturesSize,
   // Layer Parameters
@@ -7531,11 +8828,11 @@ void NOINLINE LSTMLayer (
   data_t * __restrict__ bias_hh_l,
   // Input and Output Features
   data_t * __restrict__ inFeatures,
-  data_t * __restrict__ lstm_h,
+  data_t * lstm_h,
   // Hidden Features
   data_t * __restrict__ lstm_c,
   // intermediate nodes
-  data_t * __restrict__ lstm_h_out,
+  data_t * lstm_h_out,
   data_t * __restrict__ lstm_f,
   data_t * __restrict__ lstm_i,
   data_t * __restrict__ lstm_g,
@@ -7783,32 +9080,11 @@ void NOINLINE LSTMLayer (
 #endif
 
     //ht=ottanh(ct)
-    if ( rt_core_id()==0 )
-    {
-      CopyTensor(hiddenFeaturesSize, lstm_h_out, lstm_c); // h=c
-    }
+    // c_t is read in place and h_t is written directly to h_out (no copy of c_t)
     synch_barrier();
-
     if(core_id<NR_CORES)
     {
-      // CopyTensor(hiddenFeaturesSize, lstm_h, lstm_c); // h=c
-      // TanhLayer(hiddenFeaturesSize, lstm_h); // tanh(c_t)
-      // HadMulTensor(hiddenFeaturesSize, lstm_h, lstm_o);
-      
-// #ifdef DEBUG_LSTM
-//     if ( core_id<NR_CORES )
-//     {
-//       printf("lstm_h: "); PrintTensor(hiddenFeaturesSize, lstm_h_out);
-//     }
-// #endif
-      TanhLayer(hiddenFeaturesSize, lstm_h_out); // tanh(c_t)
-// #ifdef DEBUG_LSTM
-//     if ( core_id<NR_CORES )
-//     {
-//       printf("lstm_h: "); PrintTensor(hiddenFeaturesSize, lstm_h_out);
-//     }
-// #endif
-      HadMulTensor(hiddenFeaturesSize, lstm_h_out, lstm_o);
+      TanhHadMulTensor(hiddenFeaturesSize, lstm_h_out, lstm_c, lstm_o);
     }
     // synch_barrier();
 
@@ -7819,6 +9095,11 @@ void NOINLINE LSTMLayer (
     }
 #endif
 
+    // h_t is the input of the next timestep: swap the hidden state ring instead of copying
+    synch_barrier();
+    data_t * lstm_h_tmp = lstm_h;
+    lstm_h = lstm_h_out;
+    lstm_h_out = lstm_h_tmp;
   }
 
   if ( core_id<NR_CORES )
@@ -7826,6 +9107,7 @@ void NOINLINE LSTMLayer (
     PROFILING_LSTM_END
   }
 
+  return lstm_h;
 }
 
 #endif
@@ -7847,8 +9129,10 @@ void NOINLINE LSTMLayer (
  *  @param lstm_i input/update gate activation tensor
  *  @param lstm_g g tensor 
  *  @param lstm_o output gate tensor
+ *  @return Pointer to the new hidden state h_t (lstm_h_out after an odd number of timesteps,
+ *  lstm_h otherwise as lstm_h and lstm_h_out are used as a ring of two buffers)
  */
-void NOINLINE LSTMLayer (
+data_t * NOINLINE LSTMLayer (
   // Layer Attributes
   int inFeaturesSize, int hiddenFeaturesSize,
   // Layer Parameters
@@ -7858,11 +9142,11 @@ void NOINLINE LSTMLayer (
   data_t * __restrict__ bias_hh_l,
   // Input and Output Features
   data_t * __restrict__ inFeatures,
-  data_t * __restrict__ lstm_h,
+  data_t * lstm_h,
   // Hidden Features
   data_t * __restrict__ lstm_c,
   // intermediate nodes
-  data_t * __restrict__ lstm_h_out,
+  data_t * lstm_h_out,
   data_t * __restrict__ lstm_f,
   data_t * __restrict__ lstm_i,
   data_t * __restrict__ lstm_g,
@@ -8049,32 +9333,11 @@ void NOINLINE LSTMLayer (
 #endif
 
     //ht=ottanh(ct)
-    if ( rt_core_id()==0 )
-    {
-      CopyTensor(hiddenFeaturesSize, lstm_h_out, lstm_c); // h=c
-    }
+    // c_t is read in place and h_t is written directly to h_out (no copy of c_t)
     synch_barrier();
-
     if(core_id<NR_CORES)
     {
-      // CopyTensor(hiddenFeaturesSize, lstm_h, lstm_c); // h=c
-      // TanhLayer(hiddenFeaturesSize, lstm_h); // tanh(c_t)
-      // HadMulTensor(hiddenFeaturesSize, lstm_h, lstm_o);
-      
-// #ifdef DEBUG_LSTM
-//     if ( core_id<NR_CORES )
-//     {
-//       printf("lstm_h: "); PrintTensor(hiddenFeaturesSize, lstm_h_out);
-//     }
-// #endif
-      TanhLayer(hiddenFeaturesSize, lstm_h_out); // tanh(c_t)
-// #ifdef DEBUG_LSTM
-//     if ( core_id<NR_CORES )
-//     {
-//       printf("lstm_h: "); PrintTensor(hiddenFeaturesSize, lstm_h_out);
-//     }
-// #endif
-      HadMulTensor(hiddenFeaturesSize, lstm_h_out, lstm_o);
+      TanhHadMulTensor(hiddenFeaturesSize, lstm_h_out, lstm_c, lstm_o);
     }
     synch_barrier();
 
@@ -8085,10 +9348,15 @@ void NOINLINE LSTMLayer (
     }
 #endif
 
+    // h_t is the input of the next timestep: swap the hidden state ring instead of copying
+    data_t * lstm_h_tmp = lstm_h;
+    lstm_h = lstm_h_out;
+    lstm_h_out = lstm_h_tmp;
   }
 
   PROFILING_LSTM_END
 
+  return lstm_h;
 }
 
 #endif //LSTM_OPT
@@ -8107,6 +9375,11 @@ void PrintTensor2D (
   )
 {
   // for 1d array -> set dim2 = 1
+  if(dataArray == NULL) // e.g. output of a network rejected by inferNetwork
+  {
+    printf("\033[91mERROR - no tensor to print!!!\033[0m\n");
+    return;
+  }
   for (int o=0; o< dim2; o++) 
   {
     printf("[");
@@ -8171,6 +9444,11 @@ data_t PrintTensorDiff2D (
 {
    // for 1d array -> set dim2 = 1
   int temp_sum = 0;
+  if(dataArray == NULL || data2Array == NULL) // e.g. output of a network rejected by inferNetwork
+  {
+    printf("\033[91mERROR - no tensor to compare!!!\033[0m\n");
+    return -1;
+  }
   for (int o=0; o< dim2; o++) 
   {
     printf("[");
@@ -8296,7 +9574,7 @@ inline int  Min(int  a, int  b) {return (((a)<(b))?(a):(b));}
 inline int  Max(int  a, int  b) {return (((a)>(b))?(a):(b));}
 inline int  Abs(int  a)           {return (((a)>(0.0))?(a):(-a));}
 
-#else // ASIP
+#elif defined(PULP_USETANHSIG) // ASIP
 
  /** @brief Intrinsic for the PULP tanh extension
  *  @param tanh_value
@@ -8326,6 +9604,12 @@ inline int pulpRNNExt_sig(int sig_value) {
  inline data_t generic_tanh(data_t value) {return pulpRNNExt_tanh(value);}
 /// Select sigmoid function to be used
  inline data_t generic_sig(data_t value) {return pulpRNNExt_sig(value);}
+#ifdef SIMD
+/// Select packed tanh function to be used
+ inline v2s generic_tanh_v2s(v2s value) {return (v2s){pulpRNNExt_tanh(value[0]), pulpRNNExt_tanh(value[1])};}
+/// Select packed sigmoid function to be used
+ inline v2s generic_sig_v2s(v2s value) {return (v2s){pulpRNNExt_sig(value[0]), pulpRNNExt_sig(value[1])};}
+#endif // SIMD
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 #elif defined MATHH
@@ -8353,6 +9637,13 @@ inline data_t generic_sig(data_t x)
      return return_value;
 }
 
+#ifdef SIMD
+/// Select packed tanh function to be used
+inline v2s generic_tanh_v2s(v2s value) {return (v2s){generic_tanh(value[0]), generic_tanh(value[1])};}
+/// Select packed sigmoid function to be used
+inline v2s generic_sig_v2s(v2s value) {return (v2s){generic_sig(value[0]), generic_sig(value[1])};}
+#endif // SIMD
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 #else 
 
@@ -8361,14 +9652,21 @@ inline data_t generic_sig(data_t x)
  *  @param value input varialbe
  *  @return tanh of the input variable
  */
-inline data_t generic_tanh(data_t value) {return Tanh(value);}
+inline data_t generic_tanh(data_t value) {return Tanh_noBranch(value);}
 
 /** @brief Generic Sigmoid Activation Function
  *
  *  @param value input varialbe
  *  @return sigmoid of the input variable
  */
-inline data_t generic_sig(data_t value) {return sig(value);}
+inline data_t generic_sig(data_t value) {return sig_noBranch(value);}
+
+#ifdef SIMD
+/// Select packed tanh function to be used
+inline v2s generic_tanh_v2s(v2s value) {return Tanh_SIMD(value);}
+/// Select packed sigmoid function to be used
+inline v2s generic_sig_v2s(v2s value) {return sig_SIMD(value);}
+#endif // SIMD
 
 #endif
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,6 +41,8 @@ const short lut_Tanh_m[16] = {4021, 3563, 2835, 2070, 1418, 929, 592, 370, 228,
 const int lut_Tanh_q[16] = {17060, 512067, 2012407, 4361003, 7021506, 9510743, 11575189, 13158594, 14311861, 15123015, 15679911, 16055709, 16306104, 16471340, 16579558, 16650000};
 const short lut_sig_m[16] = {1019, 988, 930, 850, 758, 660, 563, 472, 391, 319, 258, 207, 165, 131, 104, 82};
 const int lut_sig_q[16] = {8389671, 8423495, 8544906, 8789991, 9169470, 9670607, 10264318, 10914030, 11583389, 12241371, 12864661, 13437943, 13952921, 14406803, 14800713, 15138308};
+const short lut_exp_m[32] = {3624, 2822, 2198, 1712, 1333, 1038, 809, 630, 490, 382, 297, 232, 180, 141, 109, 85, 66, 52, 40, 31, 24, 19, 15, 12, 9, 7, 5, 4, 3, 3, 2, 2};
+const int lut_exp_q[32] = {16719280, 15911202, 14642556, 13156637, 11611639, 10106404, 8698935, 7419631, 6280658, 5282529, 4418664, 3678502, 3049586, 2518915, 2073799, 1702353, 1393765, 1138401, 927815, 754690, 612758, 496691, 401990, 324882, 262217, 211379, 170201, 136898, 110001, 88304, 70824, 56756};
 
 
 /** @brief Sigmoid Activation Function
@@ -140,6 +142,75 @@ inline data_t Tanh(data_t value) {
 }
 
 
+/** @brief Sigmoid Activation Function without branches
+ *
+ *  Same piecewise linear approximation as sig(), but the sign and the saturation are
+ *  handled with masks and the LUT index is clamped, such that all values follow the 
+ *  same instruction stream (used for the v2s activations).
+ *
+ *  @param value input varialbe
+ *  @return sigmoid of the input variable
+ */
+inline data_t sig_noBranch(int value) {
+    int sign_mask = value>>31;                   // 0x0 or 0xffffffff
+    int abs_a     = (value^sign_mask)-sign_mask;
+    int id        = abs_a>>(13-3);
+    int sat       = (id>=16);                    // set-less-than, no branch
+    int mac_result;
+
+    id = MIN(id, 15);
+    mac_result = (lut_sig_m[id]*abs_a+lut_sig_q[id])>>12;
+    mac_result = (mac_result & (sat-1)) | (4096 & (-sat));
+
+    // negative: 1-(mx+q) = 4095+(~mac_result), saturated to 0
+    return (mac_result^sign_mask) + (sign_mask & (4095+2*sat));
+}
+
+
+/** @brief Tangent Hyperbolic without branches
+ *
+ *  Same piecewise linear approximation as Tanh(), see sig_noBranch().
+ *
+ *  @param value input variable
+ *  @return tangent hypberbolic of the input variable
+ */
+inline data_t Tanh_noBranch(int value) {
+    int sign_mask = value>>31;                   // 0x0 or 0xffffffff
+    int abs_x     = (value^sign_mask)-sign_mask;
+    int id        = abs_x>>(13-3);
+    int sat       = (id>=16);                    // set-less-than, no branch
+    int mac_result;
+
+    id = MIN(id, 15);
+    mac_result = (lut_Tanh_m[id]*abs_x+lut_Tanh_q[id])>>12;
+    mac_result = (mac_result & (sat-1)) | (4096 & (-sat));
+
+    // negative: ~(mx+q), saturated to -1
+    return (mac_result^sign_mask) + (sign_mask & sat);
+}
+
+
+#ifdef SIMD
+/** @brief Sigmoid Activation Function on two packed values
+ *
+ *  @param value two input variables
+ *  @return sigmoid of both input variables
+ */
+inline v2s sig_SIMD(v2s value) {
+    return (v2s){sig_noBranch(value[0]), sig_noBranch(value[1])};
+}
+
+/** @brief Tangent Hyperbolic on two packed values
+ *
+ *  @param value two input variables
+ *  @return tangent hypberbolic of both input variables
+ */
+inline v2s Tanh_SIMD(v2s value) {
+    return (v2s){Tanh_noBranch(value[0]), Tanh_noBranch(value[1])};
+}
+#endif // SIMD
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //  _     _                         _                           ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -157,7 +228,116 @@ inline data_t Tanh(data_t value) {
  //|_____ |_____| |     | |_____/ |  |  | |     | |_____         \/   |_____ __|__ |__|__|   // 
  //                                                                                          //
  //////////////////////////////////////////////////////////////////////////////////////////////
-#if defined FMOUTTILING && !defined(ASIP) && defined MANUALLOOPUNFOLDING && defined VLIWEXT // obv vliw
+#if defined(WEIGHT_PACKING) && !defined(ASIP)
+/** @brief Calculates a Fully-Connected (or Linear Layer) with pre-packed weights
+ *
+ *  The weights are exported pre-packed (see packWeights in pyTorch_Kernels.py): the output neurons
+ *  are grouped in tiles of OUTPUTBUFFER neurons (the last tile holds the remaining neurons) and
+ *  within a tile the weights of all neurons are interleaved per v2s word:
+ *  w[o+0][0:1], w[o+1][0:1], ..., w[o+OUTPUTBUFFER-1][0:1], w[o+0][2:3], ...
+ *  An odd last input neuron is stored as one halfword per neuron at the end of the tile.
+ *  The inner loop therefore reads one sequential weight stream with a single address register,
+ *  no W_OFFSET padding is needed and every tile is one contiguous block (single DMA burst).
+ *  Supports the following configurations:
+ *  => FixedPt and SIMD only, OUTPUTBUFFER has to be even
+ *  => VLIWEXT: full tiles with pl.sdotsp (alternating SPRs on the same stream)
+ *
+ *  @param inFeaturesSize Number of input neurons
+ *  @param outFeaturesSize Number of output neurons
+ *  @param hasBias FC with bias or not?
+ *  @param weight Pointer to the packed weights
+ *  @param bias Pointer to bias
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map
+ */
+void NOINLINE LinearLayer (
+  // Layer Attributes
+  int inFeaturesSize,
+  int outFeaturesSize,
+  short hasBias,
+  // Layer Parameters
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures) //property(functional)
+{
+
+    PROFILING_LINEAR_START
+
+    int inFeaturesSizeP2 = inFeaturesSize/2;
+    int outFeatureTiles  = (outFeaturesSize-1)/OUTPUTBUFFER+1;
+
+    int start = 0;
+    int stop = outFeatureTiles;
+
+    for (int o_tile=start; o_tile<stop; o_tile++)
+    {
+      int o_start  = o_tile*OUTPUTBUFFER;
+      int tileSize = Min(OUTPUTBUFFER, outFeaturesSize-o_start);
+      v2s * weight_ptr = (v2s*)&weight[o_start*inFeaturesSize];
+      int32_t temp[OUTPUTBUFFER];
+
+      for(int o_rel=0; o_rel<tileSize; o_rel++)
+        temp[o_rel] = hasBias ? (int32_t)bias[o_start+o_rel]<<(q_fraqP1) : 0;
+
+      if(tileSize == OUTPUTBUFFER)
+      {
+#ifdef VLIWEXT
+        // register null
+        register int x0 asm("x0");
+        register_attribute uint32_t addr = (uint32_t) weight_ptr;
+        register_attribute uint32_t in_addr = (uint32_t) inFeatures;
+
+        asm volatile("pl.sdotsp.h.0 %0, %1, %2" : "+r" (x0), "+r" (addr) : "r" (x0) ); // preload first weight
+        asm volatile("pl.sdotsp.h.1 %0, %1, %2" : "+r" (x0), "+r" (addr) : "r" (x0) ); // preload second weight
+
+        for(int i=0; i<inFeaturesSizeP2; i++) {
+          v2s inF_temp;
+          asm volatile("p.lw %0, 4(%1!)" : "=r" (inF_temp), "+r" (in_addr));
+          // weights of neuron 2k and 2k+1 are in SPR0 and SPR1, the next two words are loaded from the same stream
+          for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel+=2) {
+            asm volatile("pl.sdotsp.h.0 %0, %1, %2" : "+r" (temp[o_rel+0]), "+r" (addr) : "r" (inF_temp) );
+            asm volatile("pl.sdotsp.h.1 %0, %1, %2" : "+r" (temp[o_rel+1]), "+r" (addr) : "r" (inF_temp) );
+          }
+        }
+#else // no VLIWEXT
+        for(int i=0; i<inFeaturesSizeP2; i++) {
+          v2s inF_temp = ((v2s*)inFeatures)[i];
+          for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel++) {
+            SDOTP_GENERIC(temp[o_rel], weight_ptr[o_rel], inF_temp);
+          }
+          weight_ptr += OUTPUTBUFFER;
+        }
+#endif // VLIWEXT
+      }
+      else // last tile with less than OUTPUTBUFFER neurons
+      {
+        for(int i=0; i<inFeaturesSizeP2; i++) {
+          v2s inF_temp = ((v2s*)inFeatures)[i];
+          for(int o_rel=0; o_rel<tileSize; o_rel++) {
+            SDOTP_GENERIC(temp[o_rel], weight_ptr[o_rel], inF_temp);
+          }
+          weight_ptr += tileSize;
+        }
+      }
+
+      // odd number of input neurons: one halfword per neuron at the end of the tile
+      if(inFeaturesSize & 1)
+      {
+        data_t * weight_tail = &weight[o_start*inFeaturesSize + 2*inFeaturesSizeP2*tileSize];
+        for(int o_rel=0; o_rel<tileSize; o_rel++)
+          temp[o_rel] += inFeatures[inFeaturesSize-1]*weight_tail[o_rel];
+      }
+
+      for(int o_rel=0; o_rel<tileSize; o_rel++)
+        outFeatures[o_start+o_rel] = temp[o_rel]>>(q_fraqP1);
+    }
+
+    PROFILING_LINEAR_END
+}
+
+#elif defined FMOUTTILING && !defined(ASIP) && defined MANUALLOOPUNFOLDING && defined VLIWEXT // obv vliw
 /** @brief Calculates a Fully-Connected (or Linear Layer) 
  *  
  *  Calculates a fully conntected Layer with the custom VLIW instructions for load and MAC
@@ -222,6 +402,7 @@ void NOINLINE LinearLayer (
   // Tile with largest tileOption
   for(unsigned int i=0; i<sizeof(tileOptions)/sizeof(int); i++) {
     outFeaturesPerTile = tileOptions[i];
+    if(outFeaturesPerTile > LINEAR_MAX_TILE) continue; // tile limit of the current layer (see tuneLinearLayer)
     outFeatureTiles = outFeaturesSize_remain/outFeaturesPerTile;
     
     if(outFeatureTiles == 0) continue;
@@ -780,6 +961,7 @@ void NOINLINE LinearLayer (
   // Tile with largest tileOption
   for(unsigned int i=0; i<sizeof(tileOptions)/sizeof(int); i++) {
     outFeaturesPerTile = tileOptions[i];
+    if(outFeaturesPerTile > LINEAR_MAX_TILE) continue; // tile limit of the current layer (see tuneLinearLayer)
     outFeatureTiles = outFeaturesSize_remain/outFeaturesPerTile;
     
     if(outFeatureTiles == 0) continue;
@@ -1549,7 +1731,7 @@ void NOINLINE LinearLayer (
 //     printf("FMOUTTILING \n");
 // #endif // DEBUG_LSTM
 
-    const int outFeaturesPerTile = Min(outFeaturesSize, OUTPUTBUFFER); // Find maximum possible feature tile size
+    const int outFeaturesPerTile = Min(outFeaturesSize, Min(OUTPUTBUFFER, LINEAR_MAX_TILE)); // Find maximum possible feature tile size
     int outFeatureTiles = (int)(outFeaturesSize-1)/outFeaturesPerTile+1; // output channels per tile (round it up)
 
     // printf("outFeaturesSize=%i, outFeaturesPerTile=%i, outFeatureTiles=%i", outFeaturesSize, outFeaturesPerTile, outFeatureTiles);
@@ -4973,6 +5155,328 @@ void NOINLINE TwoLinearLayersAccumulate (
 
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates a Fully-Connected Layer with fused element-wise operations
+ *
+ *  Calculates outFeatures = ops(weight*inFeatures + bias) in a single kernel invocation,
+ *  where ops is the chain of element-wise operations (residual add, tensor add, Hadamard
+ *  product, tanh, sigmoid) folded into the FC layer by the network export.
+ *  As in LinearLayer, the output neurons are calculated in tiles of OUTPUTBUFFER neurons
+ *  (with pl.sdotsp if VLIWEXT), every input pair is loaded once per tile. The accumulators
+ *  stay in registers until the operation chain is applied to them and they are stored once,
+ *  so there are no intermediate FM round-trips.
+ *  With SIMD the number of input neurons has to be even (word-aligned weight rows), odd
+ *  sizes are rejected by the export (fuseLayers) and by inferNetwork.
+ *
+ *  @param inFeaturesSize Number of input neurons
+ *  @param outFeaturesSize Number of output neurons
+ *  @param fusedOps Fused operation chain (see FUSE_*)
+ *  @param weight Pointer to weights
+ *  @param bias Pointer to bias
+ *  @param fusedTensors Tensors consumed by FUSE_ADD and FUSE_HADAMARD
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map
+ */
+void NOINLINE FusedLinearLayer (
+  // Layer Attributes
+  int inFeaturesSize, int outFeaturesSize,
+  int fusedOps,
+  // Layer Parameters
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  data_t ** __restrict__ fusedTensors,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+
+  PROFILING_LINEAR_START
+
+#if defined(FixedPt) && defined(SIMD)
+  int inFeaturesSizeP2 = (inFeaturesSize)/2;
+
+  for (int o_start=0; o_start<outFeaturesSize; o_start+=OUTPUTBUFFER)
+  {
+    int tileSize = Min(OUTPUTBUFFER, outFeaturesSize-o_start);
+    v2s * weight_ptr = &((v2s*)weight)[inFeaturesSizeP2*o_start];
+    int32_t temp[OUTPUTBUFFER];
+
+    for(int o_rel=0; o_rel<tileSize; o_rel++)
+      temp[o_rel] = (int32_t)bias[o_start+o_rel]<<(q_fraqP1);
+
+    if(tileSize == OUTPUTBUFFER)
+    {
+# if defined(VLIWEXT) && !defined(ASIP) && (OUTPUTBUFFER % 2) == 0
+      // one weight stream per neuron, neighbouring neurons alternate between SPR0 and SPR1 and
+      // every pl.sdotsp preloads the weight of the neuron two positions later
+      register int x0 asm("x0");
+      uint32_t addr[OUTPUTBUFFER]; // kept in registers as the tile loops are unrolled
+      register_attribute uint32_t in_addr = (uint32_t) inFeatures;
+      for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel++)
+        addr[o_rel] = (uint32_t) &weight_ptr[inFeaturesSizeP2*o_rel];
+
+      PL_SDOTP0(x0, addr[0], x0); // preload first weight
+      PL_SDOTP1(x0, addr[1], x0); // preload second weight
+
+      for(int i=0; i<inFeaturesSizeP2; i++)
+      {
+        v2s inF_temp;
+        asm volatile("p.lw %0, 4(%1!)" : "=r" (inF_temp), "+r" (in_addr));
+        for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel+=2)
+        {
+          PL_SDOTP0(temp[o_rel+0], addr[(o_rel+2)%OUTPUTBUFFER], inF_temp);
+          PL_SDOTP1(temp[o_rel+1], addr[(o_rel+3)%OUTPUTBUFFER], inF_temp);
+        }
+      }
+# else // no VLIWEXT
+      for(int i=0; i<inFeaturesSizeP2; i++)
+      {
+        v2s inF_temp = ((v2s*)inFeatures)[i];
+        for(int o_rel=0; o_rel<OUTPUTBUFFER; o_rel++)
+        {
+          SDOTP_GENERIC(temp[o_rel], weight_ptr[inFeaturesSizeP2*o_rel + i], inF_temp);
+        }
+      }
+# endif // VLIWEXT
+    }
+    else // last tile with less than OUTPUTBUFFER neurons
+    {
+      for(int i=0; i<inFeaturesSizeP2; i++)
+      {
+        v2s inF_temp = ((v2s*)inFeatures)[i];
+        for(int o_rel=0; o_rel<tileSize; o_rel++)
+        {
+          SDOTP_GENERIC(temp[o_rel], weight_ptr[inFeaturesSizeP2*o_rel + i], inF_temp);
+        }
+      }
+    }
+
+    for(int o_rel=0; o_rel<tileSize; o_rel++)
+      outFeatures[o_start+o_rel] = fusedEpilogue(temp[o_rel]>>(q_fraqP1), o_start+o_rel, fusedOps, fusedTensors, inFeatures);
+  }
+
+#else // no FixedPt SIMD
+  for (int o=0; o<outFeaturesSize; o++)
+  {
+# ifdef FixedPt
+    int32_t temp = ((int32_t)bias[o])<<(q_fraqP1);
+# else
+    data_t temp = bias[o];
+# endif
+    for(int i=0; i<inFeaturesSize; i++)
+    {
+      temp += inFeatures[i]*weight[inFeaturesSize*o + i];
+    }
+# ifdef FixedPt
+    temp = temp>>(q_fraqP1);
+# endif
+    outFeatures[o] = fusedEpilogue(temp, o, fusedOps, fusedTensors, inFeatures);
+  }
+#endif // FixedPt SIMD
+
+  PROFILING_LINEAR_END
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates one (edge) tile of GemmLayer without register blocking
+ *
+ *  @param inFeaturesSize Number of input neurons (K)
+ *  @param outFeaturesSize Number of output neurons (M)
+ *  @param o0 First output neuron of the tile
+ *  @param rows Output neurons of the tile
+ *  @param n0 First vector of the tile
+ *  @param cols Vectors of the tile
+ *  @param hasBias FC with bias or not?
+ *  @param weight Pointer to weights
+ *  @param bias Pointer to bias
+ *  @param inFeatures Input Feature Maps (one vector after the other)
+ *  @param outFeatures Output Feature Maps (one vector after the other)
+ */
+static void gemmEdgeTile (
+  int inFeaturesSize, int outFeaturesSize,
+  int o0, int rows, int n0, int cols,
+  short hasBias,
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+#ifdef FixedPt
+  typedef int32_t acc_t;
+#else
+  typedef data_t acc_t;
+#endif
+  int inFeaturesSizeP2    = (inFeaturesSize)/2;
+  int inFeaturesSizeP2_p1 = (inFeaturesSize)/2;
+
+  for (int n=n0; n<n0+cols; n++)
+  {
+    for (int o=o0; o<o0+rows; o++)
+    {
+#ifdef FixedPt
+      acc_t temp0 = hasBias ? ((acc_t)bias[o])<<(q_fraqP1) : 0;
+#else
+      acc_t temp0 = hasBias ? bias[o] : 0;
+#endif
+
+#if defined(FixedPt) && defined(SIMD)
+      if ((inFeaturesSize & 0x1) == 0)
+      {
+        v2s * weight0 = &((v2s*)weight)[inFeaturesSizeP2_p1*o];
+        v2s * inF0    = &((v2s*)inFeatures)[inFeaturesSizeP2*n];
+        for(int i=0; i<inFeaturesSizeP2; i++)
+        {
+# ifdef ASIP
+          temp0 = temp0 + inF0[i] * weight0[i];
+# else // not ASIP
+          temp0 = __SUMDOTP2(inF0[i], weight0[i], temp0);
+# endif // ASIP
+        }
+      }
+      else
+#endif // FixedPt SIMD
+      // odd number of input neurons: the rows and vectors are not word aligned, no v2s loads
+      for(int i=0; i<inFeaturesSize; i++)
+      {
+        temp0 += inFeatures[inFeaturesSize*n + i]*weight[inFeaturesSize*o + i];
+      }
+
+#ifdef FixedPt
+      temp0 = temp0>>(q_fraqP1);
+#endif
+      outFeatures[outFeaturesSize*n + o] = temp0;
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates a Fully-Connected Layer on several input vectors (GEMM)
+ *
+ *  Calculates outFeatures[n] = weight*inFeatures[n] + bias for nrVectors input vectors, i.e. the
+ *  (M x K) by (K x N) matrix product with M=outFeaturesSize, K=inFeaturesSize and N=nrVectors.
+ *  The outputs are computed in register blocks of GEMM_BLOCK_M output neurons times GEMM_BLOCK_N
+ *  vectors: every loaded weight pair is used for GEMM_BLOCK_N vectors and every input pair for
+ *  GEMM_BLOCK_M neurons, instead of one MAC per weight load as in LinearLayer. The blocks at the
+ *  matrix edges use gemmEdgeTile. The vectors use the BATCHING layout (inFeatures[n*K+k],
+ *  outFeatures[n*M+m]), the weights the layout of LinearLayer.
+ *
+ *  @param inFeaturesSize Number of input neurons (K)
+ *  @param outFeaturesSize Number of output neurons (M)
+ *  @param nrVectors Number of input vectors (N)
+ *  @param hasBias FC with bias or not?
+ *  @param weight Pointer to weights
+ *  @param bias Pointer to bias
+ *  @param inFeatures Input Feature Maps (one vector after the other)
+ *  @param outFeatures Output Feature Maps (one vector after the other)
+ */
+void NOINLINE GemmLayer (
+  // Layer Attributes
+  int inFeaturesSize, int outFeaturesSize,
+  int nrVectors,
+  short hasBias,
+  // Layer Parameters
+  data_t * __restrict__ weight,
+  data_t * __restrict__ bias,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+
+  PROFILING_LINEAR_START
+
+  int tilesM  = (outFeaturesSize+GEMM_BLOCK_M-1)/GEMM_BLOCK_M;
+  int tilesN  = (nrVectors+GEMM_BLOCK_N-1)/GEMM_BLOCK_N;
+  int nrTiles = tilesM*tilesN;
+
+  int start = 0;
+  int stop = nrTiles;
+#ifdef FixedPt
+  typedef int32_t acc_t;
+#else
+  typedef data_t acc_t;
+#endif
+
+  // with an odd number of input neurons all blocks are computed by gemmEdgeTile (scalar)
+  int inFeaturesSizeP2    = (inFeaturesSize)/2;
+  int inFeaturesSizeP2_p1 = (inFeaturesSize)/2;
+
+  for (int t=start; t<stop; t++)
+  {
+    int o = (t/tilesN)*GEMM_BLOCK_M;
+    int n = (t%tilesN)*GEMM_BLOCK_N;
+#if defined(FixedPt) && defined(SIMD)
+    if (o+GEMM_BLOCK_M > outFeaturesSize || n+GEMM_BLOCK_N > nrVectors || (inFeaturesSize & 0x1))
+#endif
+    {
+      gemmEdgeTile(inFeaturesSize, outFeaturesSize, o, Min(GEMM_BLOCK_M, outFeaturesSize-o),
+                   n, Min(GEMM_BLOCK_N, nrVectors-n), hasBias, weight, bias, inFeatures, outFeatures);
+      continue;
+    }
+
+#if defined(FixedPt) && defined(SIMD)
+    // 4 output neurons x 2 vectors (GEMM_BLOCK_M x GEMM_BLOCK_N)
+    acc_t temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
+    acc_t temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
+    if (hasBias)
+    {
+      temp0 = temp4 = ((acc_t)bias[o  ])<<(q_fraqP1);
+      temp1 = temp5 = ((acc_t)bias[o+1])<<(q_fraqP1);
+      temp2 = temp6 = ((acc_t)bias[o+2])<<(q_fraqP1);
+      temp3 = temp7 = ((acc_t)bias[o+3])<<(q_fraqP1);
+    }
+
+    v2s * weight0 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o  )];
+    v2s * weight1 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o+1)];
+    v2s * weight2 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o+2)];
+    v2s * weight3 = &((v2s*)weight)[inFeaturesSizeP2_p1*(o+3)];
+    v2s * inF0    = &((v2s*)inFeatures)[inFeaturesSizeP2*(n  )];
+    v2s * inF1    = &((v2s*)inFeatures)[inFeaturesSizeP2*(n+1)];
+
+    for(int i=0; i<inFeaturesSizeP2; i++)
+    {
+      v2s inF_temp0 = inF0[i];
+      v2s inF_temp1 = inF1[i];
+      v2s w0 = weight0[i], w1 = weight1[i], w2 = weight2[i], w3 = weight3[i];
+# ifdef ASIP
+      temp0 = temp0 + inF_temp0 * w0;
+      temp1 = temp1 + inF_temp0 * w1;
+      temp2 = temp2 + inF_temp0 * w2;
+      temp3 = temp3 + inF_temp0 * w3;
+      temp4 = temp4 + inF_temp1 * w0;
+      temp5 = temp5 + inF_temp1 * w1;
+      temp6 = temp6 + inF_temp1 * w2;
+      temp7 = temp7 + inF_temp1 * w3;
+# else // not ASIP
+      temp0 = __SUMDOTP2(inF_temp0, w0, temp0);
+      temp1 = __SUMDOTP2(inF_temp0, w1, temp1);
+      temp2 = __SUMDOTP2(inF_temp0, w2, temp2);
+      temp3 = __SUMDOTP2(inF_temp0, w3, temp3);
+      temp4 = __SUMDOTP2(inF_temp1, w0, temp4);
+      temp5 = __SUMDOTP2(inF_temp1, w1, temp5);
+      temp6 = __SUMDOTP2(inF_temp1, w2, temp6);
+      temp7 = __SUMDOTP2(inF_temp1, w3, temp7);
+# endif // ASIP
+    }
+
+    data_t * out0 = &outFeatures[outFeaturesSize*(n  ) + o];
+    data_t * out1 = &outFeatures[outFeaturesSize*(n+1) + o];
+    out0[0] = temp0>>(q_fraqP1);
+    out0[1] = temp1>>(q_fraqP1);
+    out0[2] = temp2>>(q_fraqP1);
+    out0[3] = temp3>>(q_fraqP1);
+    out1[0] = temp4>>(q_fraqP1);
+    out1[1] = temp5>>(q_fraqP1);
+    out1[2] = temp6>>(q_fraqP1);
+    out1[3] = temp7>>(q_fraqP1);
+#endif // FixedPt SIMD
+  }
+
+  PROFILING_LINEAR_END
+}
+
+
 /** @brief Calculates point-wise Addition of Tensors (A+=B)
  *
  *  @param TensorSize Input Value
@@ -5036,6 +5540,37 @@ void NOINLINE TwoLinearLayersAccumulate (
    }
 
 
+/** @brief Calculates the Hadamard Product with the tangent hyperbolic of a Tensor (Out=tanh(A)*B)
+ *
+ *  Writes the LSTM hidden state h_t=o_t*tanh(c_t) directly to its destination, without copying
+ *  the cell state.
+ *
+ *  @param TensorSize Input Value
+ *  @param FeaturesOut Output Tensor
+ *  @param FeaturesA Tensor passed through tanh (not modified)
+ *  @param FeaturesB Multiplicand Tensor
+ */
+    void NOINLINE TanhHadMulTensor (
+        // Layer Attributes
+      int TensorSize,
+        // Layer Parameters
+      data_t * __restrict__ FeaturesOut,
+      data_t * __restrict__ FeaturesA,
+      data_t * __restrict__ FeaturesB)
+    {
+      PROFILING_HADM_START
+      for (int o=0; o< TensorSize; o++) 
+      {
+#ifdef FixedPt
+       FeaturesOut[o] = (generic_tanh(FeaturesA[o])*FeaturesB[o])>>(q_fraqP1);
+#else
+       FeaturesOut[o] = generic_tanh(FeaturesA[o])*FeaturesB[o];
+#endif
+     }
+     PROFILING_HADM_END
+   }
+
+
 /** @brief Copy of Tensor A to B
  *
  *  @param TensorSize Input Value
@@ -5080,8 +5615,30 @@ void NOINLINE TwoLinearLayersAccumulate (
     data_t * __restrict__ Features)
   {
     PROFILING_TANH_START
+#ifdef SIMD
+    // peel off the first neuron if it is not word-aligned
+    int o = 0;
+    if ((o<TensorSize) && ((uintptr_t)&Features[o] & 0x2))
+    {
+      Features[o] = generic_tanh(Features[o]);
+      o++;
+    }
+
+    // two neurons per iteration
+    v2s * Features_v2s = (v2s *)&Features[o];
+    for (; o<TensorSize-1; o+=2) 
+    {
+      *Features_v2s = generic_tanh_v2s(*Features_v2s);
+      Features_v2s++;
+    }
+
+    // leftover
+    if (o<TensorSize)
+      Features[o] = generic_tanh(Features[o]);
+#else
     for (int o=0; o< TensorSize; o++) 
       Features[o] = generic_tanh(Features[o]);
+#endif // SIMD
 
     PROFILING_TANH_END
   }
@@ -5115,8 +5672,30 @@ void NOINLINE TwoLinearLayersAccumulate (
     data_t * __restrict__ Features)
   {
     PROFILING_TANH_START
+#ifdef SIMD
+    // peel off the first neuron if it is not word-aligned
+    int o = 0;
+    if ((o<TensorSize) && ((uintptr_t)&Features[o] & 0x2))
+    {
+      Features[o] = generic_sig(Features[o]);
+      o++;
+    }
+
+    // two neurons per iteration
+    v2s * Features_v2s = (v2s *)&Features[o];
+    for (; o<TensorSize-1; o+=2) 
+    {
+      *Features_v2s = generic_sig_v2s(*Features_v2s);
+      Features_v2s++;
+    }
+
+    // leftover
+    if (o<TensorSize)
+      Features[o] = generic_sig(Features[o]);
+#else
     for (int o=0; o< TensorSize; o++) 
       Features[o] = generic_sig(Features[o]);
+#endif // SIMD
 
     PROFILING_TANH_END
   }
@@ -5147,6 +5726,175 @@ void NOINLINE TwoLinearLayersAccumulate (
   }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Piecewise linear approximation of e^(-x) for x>=0
+ *
+ *  32 segments of width 0.25 cover [0,8), larger inputs return 0.
+ *
+ *  @param value non-negative input value
+ *  @return e^(-value)
+ */
+inline int expNeg(int value) {
+    int id = MIN(value>>(13-3), 31); // get (clamped) index of LUT
+    return MAX((lut_exp_q[id]-lut_exp_m[id]*value)>>12, 0);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Inserts a value into a (descending) sorted list of k values
+ *
+ *  @param value value to be inserted
+ *  @param index index of the value
+ *  @param k length of the list
+ *  @param values sorted values
+ *  @param indices indices belonging to values
+ */
+inline void topkInsert(int value, int index, int k, int * values, int * indices) {
+    if(value <= values[k-1]) return;
+    int j = k-1;
+    while(j>0 && values[j-1] < value) {
+        values[j]  = values[j-1];
+        indices[j] = indices[j-1];
+        j--;
+    }
+    values[j]  = value;
+    indices[j] = index;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Calculates a fixed-point softmax
+ *
+ *  out_i = e^(x_i-max(x)) / sum_j e^(x_j-max(x))
+ *
+ *  @param TensorSize Number of neurons
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output Feature Map
+ */
+void NOINLINE SoftmaxLayer (
+  // Layer Attributes
+  int TensorSize,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+  PROFILING_HEAD_START
+
+  int start = 0;
+  int stop  = TensorSize;
+
+  // maximum, such that all exponents are <= 0
+  int max_value = HEAD_MIN_VALUE;
+  for (int o=start; o<stop; o++)
+  {
+    max_value = MAX(max_value, inFeatures[o]);
+  }
+
+  // exponents and sum
+  int sum = 0;
+  for (int o=start; o<stop; o++)
+  {
+    int e = expNeg(max_value-inFeatures[o]);
+    outFeatures[o] = e;
+    sum += e;
+  }
+
+  // normalize with a single division (sum>0 as e^0 is always part of it), the reciprocal
+  // has 30 fraction bits such that its truncation is below an LSB of the outputs
+  // (e<=sum, hence e*recip<=2^30)
+  int recip = (1<<30)/sum;
+  for (int o=start; o<stop; o++)
+  {
+    outFeatures[o] = (outFeatures[o]*recip + (1<<(30-q_frac-1)))>>(30-q_frac);
+  }
+
+  PROFILING_HEAD_END
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Index of the largest neuron
+ *
+ *  On ties the lowest index is returned.
+ *
+ *  @param TensorSize Number of neurons
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output (outFeatures[0] contains the index)
+ */
+void NOINLINE ArgmaxLayer (
+  // Layer Attributes
+  int TensorSize,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+  PROFILING_HEAD_START
+
+  int start = 0;
+  int stop  = TensorSize;
+
+  int max_value = HEAD_MIN_VALUE;
+  int max_idx   = 0;
+  for (int o=start; o<stop; o++)
+  {
+    if(inFeatures[o] > max_value)
+    {
+      max_value = inFeatures[o];
+      max_idx   = o;
+    }
+  }
+
+  outFeatures[0] = max_idx;
+
+  PROFILING_HEAD_END
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/** @brief Indices of the k largest neurons
+ *
+ *  The indices are sorted by descending value.
+ *
+ *  @param TensorSize Number of neurons
+ *  @param k Number of indices to be returned (at most TOPK_MAX)
+ *  @param inFeatures Input Feature Map
+ *  @param outFeatures Output (outFeatures[0..k-1] contain the indices)
+ */
+void NOINLINE TopKLayer (
+  // Layer Attributes
+  int TensorSize,
+  int k,
+  // Input and Output Features
+  data_t * __restrict__ inFeatures,
+  data_t * __restrict__ outFeatures)
+{
+  PROFILING_HEAD_START
+
+  int start = 0;
+  int stop  = TensorSize;
+
+  int values[TOPK_MAX];
+  int indices[TOPK_MAX];
+  for (int j=0; j<k; j++)
+  {
+    values[j]  = HEAD_MIN_VALUE;
+    indices[j] = -1;
+  }
+
+  for (int o=start; o<stop; o++)
+  {
+    topkInsert(inFeatures[o], o, k, values, indices);
+  }
+
+  for (int j=0; j<k; j++)
+  {
+    outFeatures[j] = indices[j];
+  }
+
+  PROFILING_HEAD_END
+}
+
+
 
 
 
@@ -5201,22 +5949,6 @@ void NOINLINE TwoLinearLayersAccumulate (
 // #endif // FixedPt
 //   #endif // TURNOFF
 // }
-// // inline v2s ALWAYS_INLINE sig_SIMD(v2s value)
-// // {
-// //    // TODO: NOT WORKING at the moment
-// // #ifdef SIMD
-// // #ifdef TURNOFF
-// //   // return value;
-// // // printf("qwer\n");
-// //   int tmp = Max(Min(8, Abs(((int)value+2048)/4096)),0);
-// //   return ((lut_fakeTanh_m[tmp]*value) >> (q_fraqP1))+lut_fakeTanh_q[tmp];
-// // #endif // TURNOFF
-// // #endif // SIMD
-
-// //   printf("This function should not be called this way!");
-
-// // }
-
 
 // inline data_t ALWAYS_INLINE sig_old(data_t value)
 // {
@@ -5274,17 +6006,22 @@ void NOINLINE TwoLinearLayersAccumulate (
  *
  *  Calculates an RNN layer based on 
  *  h_t = \\tanh(w_{ih} x_t + b_{ih}  +  w_{hh} h_{(t-1)} + b_{hh})
+ *  With LAYER_FUSION both FC layers, the addition and tanh are calculated in one kernel.
  *  @param inFeaturesSize Number of input neurons
  *  @param hiddenFeaturesSize Number of hidden neurons
  *  @param weight_ih_l Weights mapping input neurons to hidden neurons
  *  @param weight_hh_l Weights mapping hidden neurons to hidden neurons
  *  @param bias_ih_l Bias mapping input neurons to hidden neurons
  *  @param bias_hh_l Bias mapping hidden neurons to hidden neurons
+ *  The hidden state is kept in a ring of two buffers (outFeatures and hiddenFeatures) whose
+ *  pointers are swapped after every timestep instead of copying the new state.
  *  @param inFeatures Input Feature Map
  *  @param outFeatures Output Feature Map
  *  @param hiddenFeatures Hidden Feature Map
+ *  @return Pointer to the new hidden state and output (outFeatures after an odd number of
+ *  timesteps, hiddenFeatures otherwise), the other buffer is overwritten with scratch data
  */
-void NOINLINE RNNLayer (
+data_t * NOINLINE RNNLayer (
         // Layer Attributes
   int inFeaturesSize, int hiddenFeaturesSize,
         // Layer Parameters
@@ -5294,18 +6031,38 @@ void NOINLINE RNNLayer (
   data_t * __restrict__ bias_hh_l,
         // Input and Output Features
   data_t * __restrict__ inFeatures,
-        data_t * __restrict__ outFeatures, // out and hidden
+        data_t * outFeatures, // out and hidden
         // Hidden Features
-        data_t * __restrict__ hiddenFeatures)
+        data_t * hiddenFeatures)
 {
-  for(int seq=0; seq< rnn_seqSize; seq++) {
-      LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_hh_l, bias_hh_l, hiddenFeatures, outFeatures); //w_{hh} h_{(t-1)}
-      LinearLayer(inFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, hiddenFeatures); //w_{ih} x_t + b_{ih} 
+  // ring of two hidden state buffers: the new state is written to h_next and the pointers are swapped
+  data_t * h_prev = hiddenFeatures;
+  data_t * h_next = outFeatures;
 
-      AddTensor(hiddenFeaturesSize, outFeatures, hiddenFeatures);
-      TanhLayer(hiddenFeaturesSize, outFeatures);
-      CopyTensor(hiddenFeaturesSize, hiddenFeatures, outFeatures);
+  for(int seq=0; seq< rnn_seqSize; seq++) {
+#ifdef LAYER_FUSION
+      // h_t = tanh(w_{ih} x_t + b_{ih} + w_{hh} h_{(t-1)} + b_{hh}) in one pass without intermediate FMs
+      TwoLinearLayersAccumulate(inFeaturesSize, hiddenFeaturesSize, hiddenFeaturesSize, ACT_TANH,
+        weight_ih_l, weight_hh_l, bias_ih_l, bias_hh_l,
+        inFeatures+seq*inFeaturesSize,
+        h_prev,
+        h_next);
+#ifndef DOACTONTHEFLY
+      TanhLayer(hiddenFeaturesSize, h_next);
+#endif // DOACTONTHEFLY
+#else // LAYER_FUSION
+      LinearLayer(hiddenFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_hh_l, bias_hh_l, h_prev, h_next); //w_{hh} h_{(t-1)}
+      LinearLayer(inFeaturesSize,hiddenFeaturesSize,True,(data_t*)weight_ih_l, bias_ih_l, inFeatures+seq*inFeaturesSize, h_prev); //w_{ih} x_t + b_{ih} 
+
+      AddTensor(hiddenFeaturesSize, h_next, h_prev);
+      TanhLayer(hiddenFeaturesSize, h_next);
+#endif // LAYER_FUSION
+      data_t * h_tmp = h_prev;
+      h_prev = h_next;
+      h_next = h_tmp;
     }
+
+  return h_prev;
   }
 
 /** @brief Calculates an LSTM layer
@@ -5322,8 +6079,10 @@ void NOINLINE RNNLayer (
  *  @param lstm_i input/update gate activation tensor
  *  @param lstm_g g tensor 
  *  @param lstm_o output gate tensor
+ *  @return Pointer to the new hidden state h_t (lstm_h_out after an odd number of timesteps,
+ *  lstm_h otherwise as lstm_h and lstm_h_out are used as a ring of two buffers)
  */
-void NOINLINE LSTMLayer (
+data_t * NOINLINE LSTMLayer (
 // Layer Attributes
     int inFeaturesSize, int hiddenFeaturesSize,
         // Layer Parameters
@@ -5333,11 +6092,11 @@ void NOINLINE LSTMLayer (
     data_t * __restrict__ bias_hh_l,
         // Input and Output Features
     data_t * __restrict__ inFeatures,
-    data_t * __restrict__ lstm_h,
+    data_t * lstm_h,
         // Hidden Features
     data_t * __restrict__ lstm_c,
         // intermediate nodes
-    data_t * __restrict__ lstm_h_out,
+    data_t * lstm_h_out,
     data_t * __restrict__ lstm_f,
     data_t * __restrict__ lstm_i,
     data_t * __restrict__ lstm_g,
@@ -5445,15 +6204,18 @@ void NOINLINE LSTMLayer (
       printf("lstm_c: ");PrintTensor(hiddenFeaturesSize, lstm_c);
     #endif
     //ht=ottanh(ct)
-    CopyTensor(hiddenFeaturesSize, lstm_h_out, lstm_c); // h=c
-    TanhLayer(hiddenFeaturesSize, lstm_h_out); // tanh(c_t)
-    HadMulTensor(hiddenFeaturesSize, lstm_h_out, lstm_o);
+    TanhHadMulTensor(hiddenFeaturesSize, lstm_h_out, lstm_c, lstm_o);
     #ifdef DEBUG_LSTM
     printf("lstm_h_out: ");PrintTensor(hiddenFeaturesSize, lstm_h_out);
     #endif
+    // h_t is the input of the next timestep: swap the hidden state ring instead of copying
+    data_t * lstm_h_tmp = lstm_h;
+    lstm_h = lstm_h_out;
+    lstm_h_out = lstm_h_tmp;
   }   
   PROFILING_LSTM_END
 
+  return lstm_h;
 }
 
 /** @brief Print 2D Tensor
@@ -5666,6 +6428,12 @@ inline int pulpRNNExt_sig(int sig_value) {
  inline data_t generic_tanh(data_t value) {return pulpRNNExt_tanh(value);}
 /// Select sigmoid function to be used
  inline data_t generic_sig(data_t value) {return pulpRNNExt_sig(value);}
+#ifdef SIMD
+/// Select packed tanh function to be used
+ inline v2s generic_tanh_v2s(v2s value) {return (v2s){pulpRNNExt_tanh(value[0]), pulpRNNExt_tanh(value[1])};}
+/// Select packed sigmoid function to be used
+ inline v2s generic_sig_v2s(v2s value) {return (v2s){pulpRNNExt_sig(value[0]), pulpRNNExt_sig(value[1])};}
+#endif // SIMD
 #elif defined MATHH
 
 
@@ -5681,7 +6449,16 @@ inline data_t generic_sig(data_t x)
      return return_value;
 }
 
+#ifdef SIMD
+inline v2s generic_tanh_v2s(v2s value) {return (v2s){generic_tanh(value[0]), generic_tanh(value[1])};}
+inline v2s generic_sig_v2s(v2s value) {return (v2s){generic_sig(value[0]), generic_sig(value[1])};}
+#endif // SIMD
+
 #else 
-inline data_t generic_tanh(data_t value) {return Tanh(value);}
-inline data_t generic_sig(data_t value) {return sig(value);}
+inline data_t generic_tanh(data_t value) {return Tanh_noBranch(value);}
+inline data_t generic_sig(data_t value) {return sig_noBranch(value);}
+#ifdef SIMD
+inline v2s generic_tanh_v2s(v2s value) {return Tanh_SIMD(value);}
+inline v2s generic_sig_v2s(v2s value) {return sig_SIMD(value);}
+#endif // SIMD
 #endif
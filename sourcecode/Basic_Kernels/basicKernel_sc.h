@@ -86,7 +86,33 @@ void NOINLINE TwoLinearLayersAccumulate (
     data_t * __restrict__ outFeatures);
 
 
-void NOINLINE RNNLayer (
+void NOINLINE FusedLinearLayer (
+    // Layer Attributes
+    int inFeaturesSize, int outFeaturesSize,
+    int fusedOps,
+    // Layer Parameters
+    data_t * __restrict__ weight,
+    data_t * __restrict__ bias,
+    data_t ** __restrict__ fusedTensors,
+    // Input and Output Features
+    data_t * __restrict__ inFeatures,
+    data_t * __restrict__ outFeatures);
+
+
+void NOINLINE GemmLayer (
+    // Layer Attributes
+    int inFeaturesSize, int outFeaturesSize,
+    int nrVectors,
+    short hasBias,
+    // Layer Parameters
+    data_t * __restrict__ weight,
+    data_t * __restrict__ bias,
+    // Input and Output Features
+    data_t * __restrict__ inFeatures,
+    data_t * __restrict__ outFeatures);
+
+
+data_t * NOINLINE RNNLayer (
     // Layer Attributes
     int inFeaturesSize, int hiddenFeaturesSize,
     // Layer Parameters
@@ -96,12 +122,12 @@ void NOINLINE RNNLayer (
     data_t * __restrict__ bias_hh_l,
     // Input and Output Features
     data_t * __restrict__ inFeatures,
-    data_t * __restrict__ outFeatures, // out and hidden
+    data_t * outFeatures, // out and hidden
     // Hidden Features
-    data_t * __restrict__ hiddenFeatures);
+    data_t * hiddenFeatures);
 
 
-void NOINLINE LSTMLayer (
+data_t * NOINLINE LSTMLayer (
     // Layer Attributes
     int inFeaturesSize, int hiddenFeaturesSize,
     // Layer Parameters
@@ -111,12 +137,12 @@ void NOINLINE LSTMLayer (
     data_t * __restrict__ bias_hh_l,
     // Input and Output Features
     data_t * __restrict__ inFeatures,
-    // data_t * __restrict__ outFeatures, // out and hidden
+    // data_t * outFeatures, // out and hidden
     // Hidden Features
-    data_t * __restrict__ lstm_h,
+    data_t * lstm_h,
     data_t * __restrict__ lstm_c,
     // intermediate nodes
-    data_t * __restrict__ lstm_h_out,
+    data_t * lstm_h_out,
     data_t * __restrict__ lstm_f,
     data_t * __restrict__ lstm_i,
     data_t * __restrict__ lstm_g,
@@ -131,11 +157,38 @@ int NOINLINE Conv2dLayer (
     data_t * __restrict__ inFeatures,
     data_t * __restrict__ outFeatures);
 
+void NOINLINE TanhLayer (
+    // Layer Attributes
+    int TensorSize,
+    data_t * __restrict__ Features);
+
 void NOINLINE SigLayer (
     // Layer Attributes
     int TensorSize,
     data_t * __restrict__ Features);
 
+void NOINLINE SoftmaxLayer (
+    // Layer Attributes
+    int TensorSize,
+    // Input and Output Features
+    data_t * __restrict__ inFeatures,
+    data_t * __restrict__ outFeatures);
+
+void NOINLINE ArgmaxLayer (
+    // Layer Attributes
+    int TensorSize,
+    // Input and Output Features
+    data_t * __restrict__ inFeatures,
+    data_t * __restrict__ outFeatures);
+
+void NOINLINE TopKLayer (
+    // Layer Attributes
+    int TensorSize,
+    int k,
+    // Input and Output Features
+    data_t * __restrict__ inFeatures,
+    data_t * __restrict__ outFeatures);
+
 void NOINLINE AddTensor (
         // Layer Attributes
     int TensorSize,
@@ -150,6 +203,14 @@ void NOINLINE HadMulTensor (
         // Layer Parameters
     data_t * __restrict__ FeaturesA,
     data_t * __restrict__ FeaturesB);
+// Out=tanh(A)*B
+void NOINLINE TanhHadMulTensor (
+        // Layer Attributes
+    int TensorSize,
+        // Layer Parameters
+    data_t * __restrict__ FeaturesOut,
+    data_t * __restrict__ FeaturesA,
+    data_t * __restrict__ FeaturesB);
 // A=B
 void NOINLINE CopyTensor (
         // Layer Attributes
@@ -0,0 +1,986 @@
+/** @file benchHost.c
+ *  @brief Host-native benchmark harness for the basic kernels and the exported benchmark models
+ *
+ *  Links the multi-core kernels of basicKernel_mc.c directly and runs them on Linux without the
+ *  PULP-SDK (see host/pulp.h and Makefile_host). Cluster cores are emulated by threads, shapes,
+ *  batch and number of threads are given at runtime. Every benchmark runs a few warm-up
+ *  iterations first (as the PREFETCH_ICACHE loop in testKernel.c does on target) and reports
+ *  ns/op, MAC/s and the variation over the measured iterations.
+ *
+ *  Models are either compiled in (benchmarks.h) or mmap-ed from binary model containers (-l, see
+ *  scripts/model_container.py) without copying or rebuilding. With L3_STREAMING, containers can
+ *  also be streamed from a file which models the external memory (-s). With MULTI_MODEL, -g runs the
+ *  models of all containers concurrently on disjoint core groups (relative deadlines with -d). With ASYNC_INFERENCE, every
+ *  model is additionally run through the inference queue (<model>:async, throughput). GemmLayer is
+ *  run on -v input vectors and compared to LinearLayer called once per vector (GemmLinearLoop, with
+ *  the weights packed like packWeights in pyTorch_Kernels.py under WEIGHT_PACKING). With
+ *  WEIGHT_COMPRESSION, the expansion of random exp8 and cb4 weights (-n x -m) into L1 is measured.
+ *
+ *  Usage: benchHost [-t threads] [-i iterations] [-w warmup] [-b batch] [-n in] [-m out/hidden] [-v vectors]
+ *                   [-f filter] [-c] [-e tolerance] [-l model.bin]... [-s model.bin]... [-g [-d deadline,...]]
+ *
+ *  The outputs are checked (kernels bit-exact against scalar or unfused references, models within
+ *  -e LSBs of their golden output), benchHost exits with 1 if a check fails.
+ *
+ *----------------------------------------------------------------------------*
+ * Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+ * SPDX-License-Identifier: Apache-2.0                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ * http://www.apache.org/licenses/LICENSE-2.0                                 *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *----------------------------------------------------------------------------*
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <config.h>
+#include <config_profiling.h>
+#include "basicKernel.h"
+
+/// @cond DOXYGEN_EXCLUDE
+#if __has_include("benchmarks.h")
+#include "benchmarks.h"
+#endif
+/// @endcond
+
+/** @brief buffer to store intermediate FM */
+data_t buffer[BUFFER_SIZE];
+
+int host_nr_cores = 1;
+__thread int host_core_id = 0;
+__thread unsigned long long host_timer_start = 0;
+static pthread_barrier_t host_barrier;
+
+/** @brief Barrier over all emulated cores (the parentheses keep the MULTI_MODEL redirect to the core group away) */
+void (synch_barrier)() {
+    pthread_barrier_wait(&host_barrier);
+}
+
+static pthread_barrier_t host_eu_barriers[NR_CORES_MAX+1];
+static unsigned int host_eu_masks[NR_CORES_MAX+1];
+
+/** @brief Sets up an event unit barrier for the cores of coreMask (called while no core waits on it) */
+void eu_bar_setup(unsigned int barAddr, unsigned int coreMask) {
+    if(host_eu_masks[barAddr] == coreMask)
+      return;
+    if(host_eu_masks[barAddr])
+      pthread_barrier_destroy(&host_eu_barriers[barAddr]);
+    pthread_barrier_init(&host_eu_barriers[barAddr], NULL, __builtin_popcount(coreMask));
+    host_eu_masks[barAddr] = coreMask;
+}
+
+/** @brief Waits on an event unit barrier */
+void eu_bar_trig_wait_clr(unsigned int barAddr) {
+    pthread_barrier_wait(&host_eu_barriers[barAddr]);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark settings and tensors
+//////////////////////////////////////////////////////////////////////////////////////////////
+static int iterations = 50;     ///< measured iterations per benchmark
+static int warmup     = 3;      ///< warm-up iterations (caches, branch predictors)
+static int batch      = 1;      ///< inferences per measured operation
+static int inSize     = 256;    ///< input neurons (FC, RNN, LSTM) or tensor size (element-wise)
+static int outSize    = 256;    ///< output/hidden neurons
+static int vectors    = 8;      ///< input vectors of GemmLayer (GEMM columns)
+static int modelTolerance = 1<<(q_frac-4); ///< largest error of a model against its golden output (-e)
+static int failed     = 0;      ///< a checked benchmark exceeded its tolerance (exit code)
+static const char * filter = NULL;
+static int csv        = 0;
+
+static data_t *W1, *W2, *B1, *B2, *X, *H, *C, *Y, *T0, *T1, *G[4];
+static data_t * fusedTensors[FUSE_MAX_TENSORS];
+static data_t *XN, *YN;   ///< input and output vectors of GemmLayer
+#ifdef WEIGHT_PACKING
+static data_t *W1P;       ///< W1 packed for LinearLayer
+#else
+#define W1P W1
+#endif
+
+/// Model under test (set before the threads of a model benchmark are started)
+static struct layer * curNetwork;
+static int curDepth;
+static data_t * curIn;
+static data_t * curOut;
+static data_t * curGolden;
+static int curOutSize;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Kernel wrappers (called by every emulated core)
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void runLinear() {
+    LinearLayer(inSize, outSize,
+#ifdef EFFICIENT_CORE_ASSIGNMENT
+                outSize,
+#endif
+                True,
+#ifdef BATCHING
+                BATCHING,
+#endif
+                W1P, B1, X, Y);
+}
+static void runFusedLinear() { FusedLinearLayer(inSize, outSize, FUSE_ADD | (FUSE_TANH<<FUSE_OP_BITS), W1, B1, fusedTensors, X, Y); }
+static void runGemm()      { GemmLayer(inSize, outSize, vectors, True, W1, B1, XN, YN); }
+static void runGemmLinearLoop() {
+    for(int n=0; n<vectors; n++)
+      LinearLayer(inSize, outSize,
+#ifdef EFFICIENT_CORE_ASSIGNMENT
+                  outSize,
+#endif
+                  True,
+#ifdef BATCHING
+                  BATCHING,
+#endif
+                  W1P, B1, &XN[n*inSize], &YN[n*outSize]);
+}
+static void runTwoLinear() { TwoLinearLayersAccumulate(inSize, outSize, outSize, ACT_TANH, W1, W2, B1, B2, X, H, Y); }
+static void runRNN()       { RNNLayer(inSize, outSize, W1, W2, B1, B2, X, Y, H); }
+static void runLSTM()      { LSTMLayer(inSize, outSize, W1, W2, B1, B2, X, H, C, Y, G[0], G[1], G[2], G[3]); }
+static void runTanh()      { TanhLayer(inSize, T0); }
+static void runSig()       { SigLayer(inSize, T0); }
+static void runAdd()       { AddTensor(inSize, T0, T1); }
+static void runHadMul()    { HadMulTensor(inSize, T0, T1); }
+static void runTanhHadMul(){ TanhHadMulTensor(inSize, Y, T0, T1); }
+static void runCopy()      { CopyTensor(inSize, T0, T1); }
+static void runFill()      { fillTensor(inSize, T0, 0x123); }
+static void runSoftmax()   { SoftmaxLayer(inSize, X, Y); }
+static void runArgmax()    { ArgmaxLayer(inSize, X, Y); }
+static void runTopK()      { TopKLayer(inSize, TOPK_MAX, X, Y); }
+static void runModel()     { curOut = inferNetwork(curNetwork, curDepth, curIn, buffer); }
+#ifdef WEIGHT_COMPRESSION
+static uint8_t * expandBlob;  ///< compressed weights expanded by WeightExpand (outSize x inSize)
+static void runWeightExpand() { weightExpand(expandBlob, W1, outSize, inSize); }
+#endif
+#ifdef L3_STREAMING
+static struct stream_engine curStream;
+static void runStreamed()  { curOut = inferNetworkStreamed(&curStream, curIn); }
+#endif
+
+/** @brief Unfused reference of runFusedLinear: LinearLayer, AddTensor and TanhLayer on 16 bit FMs */
+static void runUnfusedLinear() {
+    runLinear();
+    synch_barrier();
+    AddTensor(outSize, Y, fusedTensors[0]);
+    synch_barrier();
+    TanhLayer(outSize, Y);
+}
+
+static void (*parallelKernel)();
+
+/** @brief Body of one emulated core of parallel() */
+static void * parallelCore(void * arg) {
+    host_core_id = (int)(long)arg;
+#ifdef BANK_PLACEMENT
+    bankReplicateLUTs();
+#endif
+    parallelKernel();
+    return NULL;
+}
+
+/** @brief Runs a kernel wrapper once on host_nr_cores threads (reference computations of the checks) */
+static void parallel(void (*kernel)()) {
+    pthread_t threads[NR_CORES_MAX];
+
+    parallelKernel = kernel;
+    pthread_barrier_init(&host_barrier, NULL, host_nr_cores);
+    for(int c=1; c<host_nr_cores; c++)
+      pthread_create(&threads[c], NULL, parallelCore, (void*)(long)c);
+    parallelCore((void*)0);
+    for(int c=1; c<host_nr_cores; c++)
+      pthread_join(threads[c], NULL);
+    pthread_barrier_destroy(&host_barrier);
+}
+
+/** @brief Maximum absolute error of the GemmLayer outputs against a scalar matrix product */
+static int checkGemm() {
+    int error = 0;
+    for(int n=0; n<vectors; n++)
+      for(int o=0; o<outSize; o++)
+      {
+        int32_t acc = ((int32_t)B1[o])<<(q_fraqP1);
+        for(int i=0; i<inSize; i++)
+          acc += XN[n*inSize+i]*W1[(inSize+W_OFFSET)*o+i];
+        error = Max(error, abs((data_t)(acc>>(q_fraqP1))-YN[n*outSize+o]));
+      }
+    return error;
+}
+
+/// Largest error of SoftmaxLayer against a floating-point softmax (LSBs, LUT-based exponential)
+#define SOFTMAX_TOLERANCE 4
+
+/** @brief Maximum absolute error of the SoftmaxLayer outputs against a floating-point softmax */
+static int checkSoftmax() {
+    double maxValue = -1e9, sum = 0;
+    int error = 0;
+    for(int i=0; i<inSize; i++)
+      maxValue = fmax(maxValue, X[i]/(double)(1<<q_frac));
+    for(int i=0; i<inSize; i++)
+      sum += exp(X[i]/(double)(1<<q_frac)-maxValue);
+    for(int i=0; i<inSize; i++)
+      error = Max(error, (int)lround(fabs(exp(X[i]/(double)(1<<q_frac)-maxValue)/sum*(1<<q_frac)-Y[i])));
+    return error;
+}
+
+/** @brief Number of wrong indices of ArgmaxLayer against a scalar search (lowest index on ties) */
+static int checkArgmax() {
+    int best = 0;
+    for(int i=1; i<inSize; i++)
+      if(X[i] > X[best])
+        best = i;
+    return Y[0] != best;
+}
+
+/** @brief Number of wrong indices of TopKLayer against a scalar selection
+ *
+ *  The j-th index is the largest value not selected before (lowest index on ties), -1 beyond the inputs.
+ */
+static int checkTopK() {
+    int error = 0;
+    char taken[inSize];
+    memset(taken, 0, sizeof(taken));
+    for(int j=0; j<TOPK_MAX; j++)
+    {
+      int best = -1;
+      for(int i=0; i<inSize; i++)
+        if(!taken[i] && (best < 0 || X[i] > X[best]))
+          best = i;
+      if(best >= 0)
+        taken[best] = 1;
+      error += Y[j] != best;
+    }
+    return error;
+}
+
+/** @brief Maximum absolute error of the FusedLinearLayer outputs against the unfused kernels
+ *
+ *  The element-wise chain of runFusedLinear is computed by LinearLayer, AddTensor and TanhLayer
+ *  (runUnfusedLinear), i.e. the fused kernel has to be bit-exact.
+ */
+static int checkFusedLinear() {
+    data_t fused[outSize];
+    int error = 0;
+    memcpy(fused, Y, sizeof(fused));
+    parallel(runUnfusedLinear);
+    for(int o=0; o<outSize; o++)
+      error = Max(error, abs(fused[o]-Y[o]));
+    return error;
+}
+
+#ifdef WEIGHT_COMPRESSION
+/** @brief Maximum absolute error of the expanded weights against a scalar decoder of the blob */
+static int checkWeightExpand() {
+    const struct weight_comp_header * header = (const struct weight_comp_header *) expandBlob;
+    const uint8_t * payload = expandBlob + sizeof(struct weight_comp_header);
+    int groups = (inSize + 31) >> 5;
+    int error = 0;
+    for(int o=0; o<outSize; o++)
+      for(int i=0; i<inSize; i++)
+      {
+        int w;
+        if(header->format == WCOMP_EXP8)
+          w = ((const int8_t *) payload)[((outSize*groups+3) & ~3) + o*inSize+i] * (1 << payload[o*groups + (i>>5)]);
+        else
+          w = ((const data_t *) payload)[(payload[2*WCOMP_CODEBOOK + (o*inSize+i)/2] >> (4*(i&1))) & 0xF];
+        error = Max(error, abs(w-W1[(inSize+W_OFFSET)*o+i]));
+      }
+    return error;
+}
+#endif
+
+/** @brief Maximum absolute error of the last model inference against the golden output */
+static int checkModel() {
+    int error = 0;
+    if(curOut == NULL) // rejected by inferNetwork (e.g. compressed weights which cannot be expanded)
+      return 0xFFFF;
+    for(int o=0; o<curOutSize; o++)
+      error = Max(error, abs(curOut[o]-curGolden[o]));
+    return error;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Measurement
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void (*curKernel)();
+static double * samples;
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+/** @brief Body of one emulated core, core 0 takes the time of every iteration */
+static void * benchCore(void * arg) {
+    host_core_id = (int)(long)arg;
+#ifdef BANK_PLACEMENT
+    // the kernels are also called without inferNetwork, which sets up the LUT replicas
+    bankReplicateLUTs();
+#endif
+    for(int it=0; it<warmup+iterations; it++)
+    {
+      double t0 = 0;
+      synch_barrier();
+      if(host_core_id==0)
+        t0 = now_ns();
+      for(int b=0; b<batch; b++)
+        curKernel();
+      synch_barrier();
+      if(host_core_id==0 && it>=warmup)
+        samples[it-warmup] = now_ns()-t0;
+    }
+    return NULL;
+}
+
+/** @brief Prints the statistics of the samples of one benchmark
+ *
+ *  @param name Name of the benchmark
+ *  @param macs Multiply-accumulate operations (or element operations) per inference
+ *  @param error Maximum absolute error against the golden model (-1 if not available)
+ *  @param tolerance Largest error which passes the check
+ */
+static void report(const char * name, long macs, int error, int tolerance) {
+    double mean = 0, var = 0, min = samples[0];
+    for(int it=0; it<iterations; it++)
+    {
+      mean += samples[it]/iterations;
+      min = Min(min, samples[it]);
+    }
+    for(int it=0; it<iterations; it++)
+      var += (samples[it]-mean)*(samples[it]-mean)/iterations;
+
+    double macps = mean > 0 ? (double)macs*batch/(mean*1e-9) : 0;
+    if(csv)
+      printf("%s,%d,%d,%d,%d,%d,%.1f,%.1f,%.1f,%.4g,%d\n", name, host_nr_cores, batch, inSize, outSize,
+             iterations, mean, sqrt(var), min, macps, error);
+    else
+      printf("%-24s %12.1f %10.1f %6.2f%% %12.1f %12.4g %8d\n", name, mean, sqrt(var),
+             mean > 0 ? 100*sqrt(var)/mean : 0, min, macps, error);
+    if(error > tolerance)
+    {
+      printf("\033[91mERROR - %s: error %d exceeds the tolerance of %d!!!\033[0m\n", name, error, tolerance);
+      failed = 1;
+    }
+}
+
+/** @brief Runs one benchmark on host_nr_cores threads and prints its statistics
+ *
+ *  @param name Name of the benchmark
+ *  @param kernel Kernel wrapper
+ *  @param macs Multiply-accumulate operations (or element operations) per inference
+ *  @param check Returns the maximum absolute error against the golden model (NULL if not available)
+ *  @param tolerance Largest error which passes the check
+ */
+static void bench(const char * name, void (*kernel)(), long macs, int (*check)(), int tolerance) {
+    pthread_t threads[NR_CORES_MAX];
+
+    if(filter && !strstr(name, filter))
+      return;
+
+    curKernel = kernel;
+    pthread_barrier_init(&host_barrier, NULL, host_nr_cores);
+    for(int c=1; c<host_nr_cores; c++)
+      pthread_create(&threads[c], NULL, benchCore, (void*)(long)c);
+    benchCore((void*)0);
+    for(int c=1; c<host_nr_cores; c++)
+      pthread_join(threads[c], NULL);
+    pthread_barrier_destroy(&host_barrier);
+
+    report(name, macs, check ? check() : -1, tolerance);
+}
+
+
+#ifdef WEIGHT_COMPRESSION
+/** @brief Random compressed weights (outSize x inSize) in the layout of scripts/weight_compression.py
+ *
+ *  @param format WCOMP_EXP8 (exponents 0..7, groups of 32 weights) or WCOMP_CB4
+ */
+static uint8_t * randomWeightBlob(int format) {
+    int groups = (inSize + 31) >> 5;
+    int size = sizeof(struct weight_comp_header) + (format == WCOMP_EXP8 ?
+               ((outSize*groups+3) & ~3) + ((outSize*inSize+3) & ~3) : 2*WCOMP_CODEBOOK + ((outSize*inSize/2+3) & ~3));
+    uint8_t * blob = malloc(size);
+    struct weight_comp_header * header = (struct weight_comp_header *) blob;
+
+    for(int b=sizeof(struct weight_comp_header); b<size; b++)
+      blob[b] = rand();
+    if(format == WCOMP_EXP8)
+      for(int e=0; e<outSize*groups; e++)
+        blob[sizeof(struct weight_comp_header)+e] &= 7;
+    header->format    = format;
+    header->log2Group = 5;
+    header->reserved  = 0;
+    header->size      = size;
+    return blob;
+}
+#endif
+
+/** @brief Fills a tensor with pseudo-random values in [-1, 1) (Q3.12) */
+static data_t * randomTensor(int size) {
+    data_t * t = malloc(size*sizeof(data_t));
+    for(int i=0; i<size; i++)
+      t[i] = (rand() % (2<<q_frac)) - (1<<q_frac);
+    return t;
+}
+
+#ifdef WEIGHT_PACKING
+/** @brief Packs the padded row-major W1 into the tiles of LinearLayer (see packWeights in pyTorch_Kernels.py) */
+static data_t * packWeights(const data_t * w) {
+    data_t * packed = malloc(inSize*outSize*sizeof(data_t));
+    data_t * p = packed;
+    for(int o_start=0; o_start<outSize; o_start+=OUTPUTBUFFER)
+    {
+      int o_stop = Min(o_start+OUTPUTBUFFER, outSize);
+      for(int i=0; i+1<inSize; i+=2)
+        for(int o=o_start; o<o_stop; o++)
+        {
+          *p++ = w[(inSize+W_OFFSET)*o+i];
+          *p++ = w[(inSize+W_OFFSET)*o+i+1];
+        }
+      if(inSize & 1)
+        for(int o=o_start; o<o_stop; o++)
+          *p++ = w[(inSize+W_OFFSET)*o+inSize-1];
+    }
+    return packed;
+}
+#endif
+
+
+#ifdef ASYNC_INFERENCE
+static struct infer_queue asyncQueue;
+static struct infer_request asyncRequests[INFER_QUEUE_SIZE];
+static data_t * asyncOut[INFER_QUEUE_SIZE];
+static int asyncCompleted;
+static int asyncError;
+static double asyncLast;   ///< time of the last notification
+
+/** @brief Emulated cluster core serving the inference queue */
+static void * asyncCluster(void * arg) {
+    host_core_id = (int)(long)arg;
+#ifdef BANK_PLACEMENT
+    bankReplicateLUTs();
+#endif
+    inferQueueServe(&asyncQueue, buffer);
+    return NULL;
+}
+
+/** @brief Completion callback (FC): checks the output against the golden model */
+static void asyncDone(struct infer_request * req, void * arg) {
+    (void)arg;
+    if(req->result == NULL) // rejected by inferNetwork
+    {
+      asyncError = 0xFFFF;
+      return;
+    }
+    for(int o=0; o<curOutSize; o++)
+      asyncError = Max(asyncError, abs(req->result[o]-curGolden[o]));
+}
+
+/** @brief Calls the completion callbacks, the time since the last completion is shared by the notified requests */
+static int asyncPoll() {
+    int count = inferPoll(&asyncQueue);
+    if(count == 0)
+    {
+      INFER_QUEUE_IDLE();
+      return 0;
+    }
+    double t = now_ns();
+    for(int r=0; r<count; r++, asyncCompleted++)
+      if(asyncCompleted >= warmup)
+        samples[asyncCompleted-warmup] = (t-asyncLast)/count;
+    asyncLast = t;
+    return count;
+}
+
+/** @brief Benchmarks the throughput of the model with the asynchronous inference queue
+ *
+ *  The main thread acts as FC and keeps the queue filled while host_nr_cores threads serve it,
+ *  the samples are the times between two completions (averaged over the requests of one poll).
+ */
+static void benchAsync(const char * name, long macs) {
+    pthread_t threads[NR_CORES_MAX];
+    char asyncName[64];
+    int submitted = 0;
+
+    snprintf(asyncName, sizeof(asyncName), "%s:async", name);
+    if(filter && !strstr(asyncName, filter))
+      return;
+
+    for(int r=0; r<INFER_QUEUE_SIZE; r++)
+    {
+      asyncOut[r] = malloc(curOutSize*sizeof(data_t));
+      asyncRequests[r] = (struct infer_request) {curNetwork, curDepth, curIn, asyncOut[r], curOutSize, asyncDone, NULL};
+    }
+    asyncCompleted = 0;
+    asyncError     = 0;
+    asyncLast      = now_ns();
+
+    inferQueueInit(&asyncQueue);
+    pthread_barrier_init(&host_barrier, NULL, host_nr_cores);
+    for(int c=0; c<host_nr_cores; c++)
+      pthread_create(&threads[c], NULL, asyncCluster, (void*)(long)c);
+    while(submitted < warmup+iterations)
+    {
+      if(inferSubmit(&asyncQueue, &asyncRequests[submitted % INFER_QUEUE_SIZE]) == 0)
+        submitted++;
+      else
+        asyncPoll();
+    }
+    while(asyncCompleted < submitted)
+      asyncPoll();
+    inferQueueStop(&asyncQueue);
+    for(int c=0; c<host_nr_cores; c++)
+      pthread_join(threads[c], NULL);
+    pthread_barrier_destroy(&host_barrier);
+
+    for(int r=0; r<INFER_QUEUE_SIZE; r++)
+      free(asyncOut[r]);
+    report(asyncName, macs, asyncError, modelTolerance);
+}
+#endif
+
+/** @brief Benchmarks one exported model of BenchmarkNetworks.py */
+static void benchModel(const char * name, struct layer * network, int depth, data_t * in,
+                       data_t * golden, int outSize) {
+    long macs = 0;
+    for(int i=0; i<depth; i++)
+    {
+      struct layer * lay = &network[i];
+      if(lay->type == LINEAR)
+      {
+        macs += lay->attributes[LAY_LIN_IN]*lay->attributes[LAY_LIN_OUT];
+        // the exporter leaves the number of tiles at 0, all cores work on the layer
+        if(lay->attributes[LAY_LIN_TILES] == 0)
+          lay->attributes[LAY_LIN_TILES] = host_nr_cores;
+      }
+      else if(lay->type == LSTM)
+      {
+        macs += 4*(lay->attributes[LAY_LSTM_IN]+lay->attributes[LAY_LSTM_HID])*lay->attributes[LAY_LSTM_HID];
+        if(lay->attributes[LAY_LSTM_TILES] == 0)
+          lay->attributes[LAY_LSTM_TILES] = host_nr_cores;
+      }
+      else
+        macs += lay->attributes[LAY_HEAD_IN];
+    }
+
+    curNetwork = network;
+    curDepth   = depth;
+    curIn      = in;
+    curGolden  = golden;
+    curOutSize = outSize;
+#ifdef DEADLINE_SCHEDULER
+    printf("%-24s wcet %ld cycles on %d cores\n", "", networkWcet(network, depth, host_nr_cores), host_nr_cores);
+#endif
+#ifdef BARRIER_PROFILE
+    barrierProfileReset();
+#endif
+    bench(name, runModel, macs, checkModel, modelTolerance);
+#ifdef BARRIER_PROFILE
+    if(!filter || strstr(name, filter))
+      barrierProfileDump();
+#endif
+#ifdef ASYNC_INFERENCE
+    benchAsync(name, macs);
+#endif
+}
+
+/** @brief Maps a binary model container (zero-copy)
+ *
+ *  The file is mapped private and writable, i.e. the LSTM states are copied on write only.
+ *
+ *  @param fileName Container file
+ *  @param size Size of the mapping (for munmap)
+ *  @return Image or NULL if the file cannot be mapped
+ */
+static void * mapContainer(const char * fileName, size_t * size) {
+    struct stat st;
+    void * image = MAP_FAILED;
+
+    int fd = open(fileName, O_RDONLY);
+    if(fd >= 0 && fstat(fd, &st) == 0)
+      image = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(fd >= 0)
+      close(fd);
+    if(image == MAP_FAILED || (size_t)st.st_size < sizeof(struct model_container_header))
+    {
+      printf("\033[91mERROR - cannot map %s!!!\033[0m\n", fileName);
+      if(image != MAP_FAILED)
+        munmap(image, st.st_size);
+      return NULL;
+    }
+    *size = st.st_size;
+    return image;
+}
+
+/** @brief Maps a binary model container and benchmarks the model */
+static void benchContainer(const char * fileName) {
+    static struct layer network[MODEL_CONTAINER_MAX_DEPTH];
+    data_t * in, * golden;
+    int outSize, depth;
+    size_t size;
+
+    void * image = mapContainer(fileName, &size);
+    if(image == NULL)
+      return;
+    depth = loadModelContainer(image, size, network, MODEL_CONTAINER_MAX_DEPTH, &in, &golden, &outSize);
+    if(depth > 0)
+      benchModel(fileName, network, depth, in, golden, outSize);
+    munmap(image, size);
+}
+
+#ifdef MULTI_MODEL
+static struct core_group concGroups[CORE_GROUPS_MAX];
+static data_t * concGolden[CORE_GROUPS_MAX];
+static int concOutSize[CORE_GROUPS_MAX];
+static int concNr;
+
+/** @brief All models on their core groups at the same time */
+static void runConcurrent() { inferNetworksConcurrent(concGroups, concNr); }
+
+/** @brief All models back-to-back on all cores (baseline), the outputs stay in the buffers of the groups */
+static void runSequential() {
+    for(int g=0; g<concNr; g++)
+      concGroups[g].outFeatures = inferNetwork(concGroups[g].network, concGroups[g].depth, concGroups[g].inFeatures, concGroups[g].buffer);
+}
+
+/** @brief Fills the FM buffers of all groups with a value no model computes
+ *
+ *  The sequential and the concurrent run share the buffers, i.e. without clearing the concurrent
+ *  run would be checked against the outputs of the sequential one where it skips rows.
+ */
+static void clearConcurrent() {
+    for(int g=0; g<concNr; g++)
+    {
+      for(int i=0; i<BUFFER_SIZE; i++)
+        concGroups[g].buffer[i] = 0x7fff;
+      concGroups[g].outFeatures = NULL;
+    }
+}
+
+/** @brief Maximum absolute error of the last inferences of all models */
+static int checkConcurrent() {
+    int error = 0;
+    for(int g=0; g<concNr; g++)
+      if(concGroups[g].outFeatures == NULL) // not computed or rejected by inferNetwork
+        return 0xFFFF;
+    for(int g=0; g<concNr; g++)
+      for(int o=0; o<concOutSize[g]; o++)
+        error = Max(error, abs(concGroups[g].outFeatures[o]-concGolden[g][o]));
+    return error;
+}
+
+/** @brief Runs the models of several containers concurrently on disjoint core groups
+ *
+ *  The cores are split by coreGroupsPlan according to the work and the relative deadline of every
+ *  model, the same models run back-to-back on all cores for comparison.
+ *
+ *  @param fileNames Container files
+ *  @param nrModels Number of containers
+ *  @param deadlines Relative deadline of every model (0: best effort)
+ */
+static void benchConcurrent(const char ** fileNames, int nrModels, const int * deadlines) {
+    static struct layer networks[CORE_GROUPS_MAX][MODEL_CONTAINER_MAX_DEPTH];
+    void * images[CORE_GROUPS_MAX];
+    size_t sizes[CORE_GROUPS_MAX];
+    char name[64];
+    long macs = 0;
+
+    concNr = 0;
+    for(int m=0; m<nrModels && concNr<CORE_GROUPS_MAX; m++)
+    {
+      struct core_group * group = &concGroups[concNr];
+      data_t * in;
+      images[concNr] = mapContainer(fileNames[m], &sizes[concNr]);
+      if(images[concNr] == NULL)
+        continue;
+      group->depth = loadModelContainer(images[concNr], sizes[concNr], networks[concNr], MODEL_CONTAINER_MAX_DEPTH, &in,
+                                        &concGolden[concNr], &concOutSize[concNr]);
+      if(group->depth <= 0)
+      {
+        munmap(images[concNr], sizes[concNr]);
+        continue;
+      }
+      for(int l=0; l<group->depth; l++)
+      {
+        // all cores of the group work on the layer
+        if(networks[concNr][l].type == LINEAR)
+          networks[concNr][l].attributes[LAY_LIN_TILES] = NR_CORES_MAX;
+        else if(networks[concNr][l].type == LSTM)
+          networks[concNr][l].attributes[LAY_LSTM_TILES] = NR_CORES_MAX;
+      }
+      group->network    = networks[concNr];
+      group->inFeatures = in;
+      group->buffer     = coreGroupBuffers[concNr];
+      group->deadline   = deadlines[m];
+      concNr++;
+    }
+
+    if(concNr > 0 && coreGroupsPlan(concGroups, concNr, host_nr_cores) == 0)
+    {
+      for(int g=0; g<concNr; g++)
+      {
+        macs += concGroups[g].macs;
+        if(!csv)
+          printf("%-24s group %d: cores %d-%d, %ld MACs, deadline %d\n", "", g, concGroups[g].firstCore,
+                 concGroups[g].firstCore+concGroups[g].nrCores-1, concGroups[g].macs, concGroups[g].deadline);
+      }
+      snprintf(name, sizeof(name), "sequential:%d", concNr);
+      clearConcurrent();
+      bench(name, runSequential, macs, checkConcurrent, modelTolerance);
+      snprintf(name, sizeof(name), "concurrent:%d", concNr);
+      clearConcurrent();
+      bench(name, runConcurrent, macs, checkConcurrent, modelTolerance);
+    }
+
+    for(int g=0; g<concNr; g++)
+      munmap(images[g], sizes[g]);
+}
+#endif
+
+#ifdef L3_STREAMING
+/** @brief Streams the parameters of a binary model container from a file (L3) during the inference
+ *
+ *  Only the header, the layer table, the input and the expected output are read up front.
+ */
+static void benchStreamed(const char * fileName) {
+    static struct pi_device l3;
+    struct model_container_header * header = &curStream.header;
+    char name[64];
+    long macs = 0;
+
+    l3.fd = open(fileName, O_RDONLY);
+    if(l3.fd < 0 || streamOpen(&curStream, &l3, 0) < 0)
+    {
+      printf("\033[91mERROR - cannot stream %s!!!\033[0m\n", fileName);
+      if(l3.fd >= 0)
+        close(l3.fd);
+      return;
+    }
+
+    curIn     = malloc(header->in_size*sizeof(data_t));
+    curGolden = malloc(header->out_size*sizeof(data_t));
+    curOutSize = header->out_size;
+    streamRead(&curStream, header->in_offset, curIn, header->in_size*sizeof(data_t));
+    streamRead(&curStream, header->out_offset, curGolden, header->out_size*sizeof(data_t));
+    for(unsigned int l=0; l<header->depth; l++)
+    {
+      struct model_container_layer * lay = &curStream.layers[l];
+      if(lay->type == LINEAR)
+        macs += lay->attributes[LAY_LIN_IN]*lay->attributes[LAY_LIN_OUT];
+      else if(lay->type == LSTM)
+        macs += 4*(lay->attributes[LAY_LSTM_IN]+lay->attributes[LAY_LSTM_HID])*lay->attributes[LAY_LSTM_HID];
+      else
+        macs += lay->attributes[LAY_HEAD_IN];
+    }
+
+    snprintf(name, sizeof(name), "stream:%s", fileName);
+    bench(name, runStreamed, macs, checkModel, modelTolerance);
+    if(!csv)
+      printf("%-24s %d bytes in %d blocks per inference\n", "", curStream.bytesPerInference, curStream.totalBlocks);
+
+    free(curIn);
+    free(curGolden);
+    close(l3.fd);
+}
+#endif
+
+#if __has_include("benchmarks.h")
+/// Benchmark of model id if it is selected in config_profiling.h / benchmarks.h
+#define BENCH_MODEL(id) benchModel("model" #id, model##id, DEPTH##id, m##id##_In, m##id##_Out, sizeof(m##id##_Out)/sizeof(data_t));
+#endif
+
+
+/** @brief Parses the arguments and runs all kernel and model benchmarks
+ */
+int main(int argc, char ** argv)
+{
+    int opt;
+    const char * containers[16];
+#ifdef L3_STREAMING
+    const char * streamed[16];
+#endif
+#ifdef MULTI_MODEL
+    int deadlines[16] = {0};
+#endif
+    int nrContainers = 0, nrStreamed = 0, concurrent = 0;
+    while((opt = getopt(argc, argv, "t:i:w:b:n:m:v:f:ce:l:s:gd:h")) != -1)
+    {
+      switch(opt) {
+        case 't': host_nr_cores = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'b': batch = atoi(optarg); break;
+        case 'n': inSize = atoi(optarg); break;
+        case 'm': outSize = atoi(optarg); break;
+        case 'v': vectors = atoi(optarg); break;
+        case 'f': filter = optarg; break;
+        case 'c': csv = 1; break;
+        case 'e': modelTolerance = atoi(optarg); break;
+        case 'l': if(nrContainers < 16) containers[nrContainers++] = optarg; break;
+#ifdef L3_STREAMING
+        case 's': if(nrStreamed < 16) streamed[nrStreamed++] = optarg; break;
+#else
+        case 's': nrStreamed++; break;
+#endif
+        case 'g': concurrent = 1; break;
+        case 'd':
+#ifdef MULTI_MODEL
+          // relative deadlines of the concurrent models, in the order of -l
+          for(int m=0; m<16 && optarg; m++, optarg = strchr(optarg, ',') ? strchr(optarg, ',')+1 : NULL)
+            deadlines[m] = atoi(optarg);
+#endif
+          break;
+        default:
+          printf("Usage: %s [-t threads] [-i iterations] [-w warmup] [-b batch] [-n in] [-m out/hidden] [-v vectors] [-f filter] [-c] [-e tolerance] [-l model.bin]... [-s model.bin]... [-g [-d deadline,...]]\n", argv[0]);
+          return 1;
+      }
+    }
+    if(host_nr_cores < 1 || host_nr_cores > NR_CORES_MAX || iterations < 1 || batch < 1 || vectors < 1)
+    {
+      printf("\033[91mERROR - invalid arguments (1 <= threads <= %d, iterations >= 1, batch >= 1, vectors >= 1)!!!\033[0m\n", NR_CORES_MAX);
+      return 1;
+    }
+    // the kernels work on pairs of neurons
+    inSize  += inSize & 1;
+    outSize += outSize & 1;
+
+    samples = malloc(iterations*sizeof(double));
+    W1 = randomTensor(4*outSize*(inSize+outSize));
+    W2 = randomTensor(4*outSize*outSize);
+    B1 = randomTensor(4*outSize);
+    B2 = randomTensor(4*outSize);
+    X  = randomTensor(Max(inSize, outSize));
+    H  = randomTensor(outSize);
+    C  = randomTensor(outSize);
+    Y  = randomTensor(Max(inSize, outSize));
+    T0 = randomTensor(inSize);
+    T1 = randomTensor(inSize);
+    for(int g=0; g<4; g++)
+      G[g] = randomTensor(outSize);
+    for(int t=0; t<FUSE_MAX_TENSORS; t++)
+      fusedTensors[t] = randomTensor(outSize);
+    XN = randomTensor(vectors*inSize);
+    YN = randomTensor(vectors*outSize);
+#ifdef WEIGHT_PACKING
+    W1P = packWeights(W1);
+#endif
+
+    if(csv)
+      printf("benchmark,threads,batch,in,out,iterations,ns_per_op,stddev_ns,min_ns,mac_per_s,max_error\n");
+    else
+      printf("%-24s %12s %10s %7s %12s %12s %8s\n", "benchmark", "ns/op", "stddev", "cv", "min ns", "MAC/s", "error");
+
+    bench("LinearLayer",        runLinear,      (long)inSize*outSize, NULL, 0);
+    bench("FusedLinearLayer",   runFusedLinear, (long)inSize*outSize, checkFusedLinear, 0);
+    bench("GemmLayer",          runGemm,        (long)inSize*outSize*vectors, checkGemm, 0);
+    bench("GemmLinearLoop",     runGemmLinearLoop, (long)inSize*outSize*vectors, checkGemm, 0);
+#ifdef WEIGHT_COMPRESSION
+    expandBlob = randomWeightBlob(WCOMP_EXP8);
+    bench("WeightExpandExp8",   runWeightExpand, (long)inSize*outSize, checkWeightExpand, 0);
+    free(expandBlob);
+    expandBlob = randomWeightBlob(WCOMP_CB4);
+    bench("WeightExpandCb4",    runWeightExpand, (long)inSize*outSize, checkWeightExpand, 0);
+    free(expandBlob);
+#endif
+    bench("TwoLinearLayers",    runTwoLinear,   (long)(inSize+outSize)*outSize, NULL, 0);
+    bench("RNNLayer",           runRNN,         (long)(inSize+outSize)*outSize, NULL, 0);
+    bench("LSTMLayer",          runLSTM,        4L*(inSize+outSize)*outSize, NULL, 0);
+    bench("TanhLayer",          runTanh,        inSize, NULL, 0);
+    bench("SigLayer",           runSig,         inSize, NULL, 0);
+    bench("AddTensor",          runAdd,         inSize, NULL, 0);
+    bench("HadMulTensor",       runHadMul,      inSize, NULL, 0);
+    bench("TanhHadMulTensor",   runTanhHadMul,  inSize, NULL, 0);
+    bench("CopyTensor",         runCopy,        inSize, NULL, 0);
+    bench("fillTensor",         runFill,        inSize, NULL, 0);
+    bench("SoftmaxLayer",       runSoftmax,     inSize, checkSoftmax, SOFTMAX_TOLERANCE);
+    bench("ArgmaxLayer",        runArgmax,      inSize, checkArgmax, 0);
+    bench("TopKLayer",          runTopK,        inSize, checkTopK, 0);
+
+#ifdef MODEL0
+    BENCH_MODEL(0)
+#endif
+#ifdef MODEL1
+    BENCH_MODEL(1)
+#endif
+#ifdef MODEL2
+    BENCH_MODEL(2)
+#endif
+#ifdef MODEL3
+    BENCH_MODEL(3)
+#endif
+#ifdef MODEL4
+    BENCH_MODEL(4)
+#endif
+#ifdef MODEL5
+    BENCH_MODEL(5)
+#endif
+#ifdef MODEL6
+    BENCH_MODEL(6)
+#endif
+#ifdef MODEL7
+    BENCH_MODEL(7)
+#endif
+#ifdef MODEL8
+    BENCH_MODEL(8)
+#endif
+#ifdef MODEL9
+    BENCH_MODEL(9)
+#endif
+#ifdef MODEL10
+    BENCH_MODEL(10)
+#endif
+#ifdef MODEL11
+    BENCH_MODEL(11)
+#endif
+#ifdef MODEL12
+    BENCH_MODEL(12)
+#endif
+#ifdef MODEL13
+    BENCH_MODEL(13)
+#endif
+#ifdef MODEL14
+    BENCH_MODEL(14)
+#endif
+    for(int m=0; m<nrContainers; m++)
+      benchContainer(containers[m]);
+#ifdef MULTI_MODEL
+    if(concurrent)
+      benchConcurrent(containers, nrContainers, deadlines);
+#else
+    if(concurrent)
+      printf("\033[91mERROR - concurrent models (-g) need MULTI_MODEL!!!\033[0m\n");
+#endif
+#ifdef L3_STREAMING
+    for(int m=0; m<nrStreamed; m++)
+      benchStreamed(streamed[m]);
+#else
+    if(nrStreamed > 0)
+      printf("\033[91mERROR - streaming (-s) needs L3_STREAMING!!!\033[0m\n");
+#endif
+
+#ifdef AUTOTUNE
+    // tile configurations found during the warm-up iterations of the models
+    tuneDump();
+#endif
+
+    return failed;
+}
@@ -26,6 +26,10 @@
  *----------------------------------------------------------------------------*
  */
 
+// included by every header, the defines are evaluated once (general.h may redirect NR_CORES)
+#ifndef CONFIG_HEADER_FILE
+#define CONFIG_HEADER_FILE
+
 #ifndef ASIP
 
 /// Fixed-point implementation
@@ -51,6 +55,9 @@
 
 /// Do activation on the fly
 #define DOACTONTHEFLY
+
+/// Fuse element-wise operations (bias, residual, Hadamard, activation) into the preceding FC/RNN kernel
+// #define LAYER_FUSION
 /// On RISC-Y use TANH and sigmoid extension
 #define PULP_USETANHSIG
 
@@ -62,8 +69,63 @@
 #define LSTM_HIGH_OPT
 
 // #define BATCHING 1
+/// FC layers of a BATCHING build use GemmLayer (register blocks of outputs x batch vectors) instead of LinearLayer
+// #define GEMM_BATCHING
 // #define TILING_HARD
 
+/// FC weights are exported pre-packed in tiles of OUTPUTBUFFER neurons interleaved per v2s word
+/// (export with packWeights=True in BenchmarkNetworks.py), LinearLayer reads one sequential weight stream
+// #define WEIGHT_PACKING
+
+/// FC weights are exported compressed (compressWeights="exp8"/"cb4" in BenchmarkNetworks.py or
+/// scripts/weight_compression.py), DMA'd compressed and expanded into L1 by all cores (less L2->L1 traffic)
+// #define WEIGHT_COMPRESSION
+
+/// run the model of a binary model container (path for .incbin, written by BenchmarkNetworks.py into containers/)
+/// instead of the models of benchmarks.h, changing the model only needs a relink
+// #define MODEL_CONTAINER "containers/model0.bin"
+
+/// tune the largest output FM tile of every FC Layer at first load (needs TIMER hardware), the results are
+/// kept in a tuning table which is pre-filled from tuning.h (generated with scripts/autotune.py)
+// #define AUTOTUNE
+
+/// replicate the input FM of the FC Layers and the tanh/sigm LUTs per core with bank-staggered
+/// offsets, such that the cores do not access the same TCDM bank in lockstep (see scripts/bank_sim.py)
+// #define BANK_PLACEMENT
+
+/// stream the weights of a model container from L3 (HyperRAM at L3_IMAGE_ADDR) through an L2 ring and an
+/// L1 double buffer, for models which do not fit into L2 (see inferNetworkStreamed)
+// #define L3_STREAMING
+
+/// the FC submits inferences to a queue (inferSubmit) and gets a callback on completion (inferPoll),
+/// while the cluster computes the queued requests back-to-back (inferQueueServe)
+// #define ASYNC_INFERENCE
+
+/// inferQueueServe overlaps the DMA transfers of the input of the next request and of the output of the
+/// previous request with the current inference (three stage pipeline, needs ASYNC_INFERENCE)
+// #define INFER_PIPELINE
+
+/// several models run concurrently on disjoint groups of cluster cores (inferNetworksConcurrent),
+/// the cores are split by coreGroupsPlan according to MACs and deadlines (needs NR_CORES_MAX, no DMA)
+// #define MULTI_MODEL
+
+/// worst-case cycle estimates of the models (wcetTable, scripts/wcet.py), inferNetworkDeadline runs a
+/// smaller fallback model or rejects the inference if the primary model misses the cycle budget
+// #define DEADLINE_SCHEDULER
+
+/// per-core timestamps at the layer start, the barrier arrival and the barrier exit of every barrier of a layer
+/// in an L1 ring buffer (barrierProfileDump), scripts/barrier_profile.py reports the load imbalance per layer and shape
+// #define BARRIER_PROFILE
+
+/// issue and completion timestamps of the next-layer DMA prefetches of inferNetwork and the compute window of
+/// every layer in an L2 ring buffer (dmaProfileDump, needs DMA), scripts/dma_profile.py reports the exposed
+/// DMA latency and the achieved bandwidth per layer
+// #define DMA_PROFILE
+
+/// all cores issue the parameter transfers of inferNetwork (dmaLoadLayer), every core copies its slice of
+/// every weight, bias and state buffer in chunks of at most DMA_MAX_CHUNK bytes (needs DMA)
+// #define DMA_DISTRIBUTED
+
 #define PREFETCH_ICACHE
 
 /// activate old rt
@@ -95,5 +157,12 @@
 // #define PROFILING_COPY
 // #define PROFILING_HADM
 // #define PROFILING_ADDT
+// #define PROFILING_HEAD
+
+/// per-layer profiling (requires PROFILING_NEW): records every layer and every kernel of the selected
+/// profiling level into an L2 ring buffer, all counters are measured in one build (one inference per counter)
+// #define PROFILING_LAYERS
 
 #endif
+
+#endif // CONFIG_HEADER_FILE
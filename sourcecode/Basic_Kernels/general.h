@@ -34,6 +34,10 @@
     #include "pulp.h"
     // #include "rt/rt_api.h"
     #include <math.h>
+#ifdef L3_STREAMING
+    // external memory (HyperRAM) with cluster-side uDMA reads
+    #include "bsp/ram.h"
+#endif
 #endif
 
 
@@ -155,8 +159,8 @@
 #else 
     // nothing
 #endif
-    inline data_t Tanh(data_t value);
-    inline data_t sig(data_t value);
+    static inline data_t Tanh(data_t value);
+    static inline data_t sig(data_t value);
     // #ifndef SIMD
     // typedef int v2s;
     // #endif
@@ -260,6 +264,16 @@
 
 
 #define MAX_NR_TRANSACTIONS 16
+/// Largest transfer of one plp_dma_memcpy (16 bit size of the cluster DMA, word aligned)
+#define DMA_MAX_CHUNK 65532
+
+/// Upper bound of NR_CORES for statically allocated per-core buffers (NR_CORES is a runtime variable on the host)
+#ifndef NR_CORES_MAX
+#ifdef MULTI_MODEL
+#error "MULTI_MODEL needs NR_CORES_MAX (number of cluster cores) in config_profiling.h, NR_CORES is the size of the core group"
+#endif
+#define NR_CORES_MAX NR_CORES
+#endif
 
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
 #define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
@@ -273,7 +287,10 @@ enum layerType
     LINEAR = 0, /**< Linear Layer/Fully-Connected Layer */
     RNN    = 1, /**< Recurrent Neural Layer */
     LSTM   = 2, /**< Long short-term Memory Layer */
-    Conv2d = 3  /**< 2D Convolution Layer */
+    Conv2d = 3, /**< 2D Convolution Layer */
+    SOFTMAX = 4,/**< Fixed-Point Softmax Output Head */
+    ARGMAX = 5, /**< Argmax Output Head (index of largest neuron) */
+    TOPK   = 6  /**< Top-k Output Head (indices of the k largest neurons) */
 };
 
 /// Layer Data
@@ -290,6 +307,8 @@ struct layer {
 #define LAY_LIN_WEIGHTS 1   ///< Weight ID in FC Layer
 #define LAY_LIN_TILES   2   ///< Nr of Tiles ID in FC Layer
 #define LAY_LIN_TILE_SIZE  3 ///< Nr of Tiles ID in FC Layer
+#define LAY_LIN_FUSED_OPS  4 ///< Layer Attribute ID for the fused element-wise operations in FC Layer (see FUSE_*)
+#define LAY_LIN_FUSED_TENSORS 2 ///< First Parameter ID of the tensors used by the fused operations in FC Layer
 #define LAY_LSTM_IN     0   ///< Layer Attribute ID for Input Neurons in LSTM
 #define LAY_LSTM_HID    1   ///< Layer Attribute ID for Hideen Neurons in LSTM
 #define LAY_LSTM_TILES  2   ///< Nr of Tiles ID in LSTM Layer
@@ -307,17 +326,665 @@ struct layer {
 #define LAY_CONV_KER    2   ///< Layer Attribute ID for kernel size in 2D Conv Layer
 #define LAY_CONV_H      3   ///< Layer Attribute ID for height of input FM in 2D Conv Layer
 #define LAY_CONV_W      4   ///< Layer Attribute ID for width of input FM in 2D Conv Layer
+#define LAY_HEAD_IN     0   ///< Layer Attribute ID for Input Neurons in Output Heads (Softmax, Argmax, Top-k)
+#define LAY_HEAD_K      1   ///< Layer Attribute ID for k in Top-k Layer
+
+/// Maximum k supported by the Top-k Layer
+#define TOPK_MAX 8
+/// Initial value for the maximum search in the output heads (below any data_t)
+#define HEAD_MIN_VALUE (-32768-1)
+
+/// Element-wise operations which can be fused into the epilogue of a FC Layer
+#define FUSE_NONE        0 ///< end of the operation chain
+#define FUSE_RESIDUAL    1 ///< add the input FM of the layer (requires same input and output size)
+#define FUSE_ADD         2 ///< add the next fused parameter tensor
+#define FUSE_HADAMARD    3 ///< multiply point-wise with the next fused parameter tensor
+#define FUSE_TANH        4 ///< tangent hyperbolicus
+#define FUSE_SIG         5 ///< sigmoid
+#define FUSE_OP_BITS     4 ///< bits per operation in LAY_LIN_FUSED_OPS (first operation in the LSBs)
+#define FUSE_OP_MASK     ((1<<FUSE_OP_BITS)-1)
+#define FUSE_MAX_OPS     7 ///< maximum length of a fused operation chain
+#define FUSE_MAX_TENSORS 4 ///< maximum number of tensors used by FUSE_ADD and FUSE_HADAMARD
+
+/// Register block of GemmLayer: output neurons x input vectors (fixed by the unrolled block)
+#define GEMM_BLOCK_M     4
+#define GEMM_BLOCK_N     2
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Autotuning of the FC Layer tiling
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// Entry of the tuning table: largest output FM tile of LinearLayer for one layer shape
+struct tuning_entry {
+    short in;      ///< input neurons of the FC Layer
+    short out;     ///< output neurons of the FC Layer
+    short cores;   ///< number of cores
+    short batch;   ///< batch size
+    short maxTile; ///< largest output FM tile (one of the tile options of LinearLayer)
+};
+
+/// Number of layer shapes in the tuning table (pre-filled from tuning.h, completed at first load)
+#ifndef TUNING_TABLE_SIZE
+#define TUNING_TABLE_SIZE 32
+#endif
+
+#ifdef BATCHING
+#define TUNING_BATCH BATCHING
+#else
+#define TUNING_BATCH 1
+#endif
+
+#ifdef AUTOTUNE
+/// Largest output FM tile used by LinearLayer for the current layer (OUTPUTBUFFER if not tuned),
+/// one entry per core as the cores leave a layer (and reset it) at different times
+extern int linearMaxTile[NR_CORES_MAX];
+# ifdef MULTICORE
+#  define LINEAR_MAX_TILE linearMaxTile[CLUSTER_CORE_ID()]
+# else
+#  define LINEAR_MAX_TILE linearMaxTile[0]
+# endif
+#else
+/// Largest output FM tile used by LinearLayer (only limited per layer by AUTOTUNE)
+# define LINEAR_MAX_TILE OUTPUTBUFFER
+#endif
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Binary model container (written by scripts/model_container.py, read by loadModelContainer)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef ASIP
+#define MODEL_CONTAINER_MAGIC     "RNNM" ///< first bytes of a model container
+#define MODEL_CONTAINER_VERSION   1      ///< container format version
+#define MODEL_CONTAINER_ALIGN     64     ///< alignment of the tensor blobs (bytes)
+#define MODEL_CONTAINER_PACKED    0x1    ///< flag: FC weights are packed (WEIGHT_PACKING)
+#define MODEL_CONTAINER_COMPRESSED 0x2   ///< flag: FC weights are compressed blobs (WEIGHT_COMPRESSION)
+
+/// Maximum number of layers of a network loaded from a container
+#ifndef MODEL_CONTAINER_MAX_DEPTH
+#define MODEL_CONTAINER_MAX_DEPTH 16
+#endif
+
+/// Container header (64 bytes, little endian, all offsets in bytes from the start of the image)
+struct model_container_header {
+    char     magic[4];      ///< MODEL_CONTAINER_MAGIC
+    uint16_t version;       ///< MODEL_CONTAINER_VERSION
+    uint8_t  q_integer;     ///< integer bits of the fixed-point format
+    uint8_t  q_fraction;    ///< fractional bits of the fixed-point format
+    uint32_t depth;         ///< number of layers
+    uint32_t layer_offset;  ///< offset of the layer table
+    uint32_t in_offset;     ///< offset of the input FM
+    uint32_t in_size;       ///< number of input elements
+    uint32_t out_offset;    ///< offset of the expected output FM
+    uint32_t out_size;      ///< number of output elements
+    uint32_t image_size;    ///< size of the whole image
+    uint16_t flags;         ///< MODEL_CONTAINER_PACKED, MODEL_CONTAINER_COMPRESSED
+    uint16_t pack_tile;     ///< OUTPUTBUFFER of the packed FC weights
+    uint32_t reserved[6];
+};
+
+/// Layer table entry (80 bytes)
+struct model_container_layer {
+    uint32_t type;            ///< enum layerType
+    int32_t  attributes[5];   ///< layer attributes as in struct layer
+    uint32_t param_offset[6]; ///< offsets of the parameter blobs (0: no parameter)
+    uint32_t param_size[6];   ///< number of elements of the parameter blobs
+    uint8_t  q_integer;       ///< integer bits of the parameters
+    uint8_t  q_fraction;      ///< fractional bits of the parameters
+    uint16_t reserved;
+    uint32_t reserved2;
+};
+
+int loadModelContainer (void * image, unsigned int imageSize, struct layer * network, int maxDepth, data_t ** inFeatures, data_t ** outFeatures, int * outSize);
+#endif // ASIP
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Compressed FC weights (WEIGHT_COMPRESSION, written by scripts/weight_compression.py)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#ifdef WEIGHT_COMPRESSION
+#define WCOMP_RAW      0  ///< 16-bit weights (layers which are not compressed)
+#define WCOMP_EXP8     1  ///< int8 mantissas with one exponent per group of 2^log2Group weights of a row
+#define WCOMP_CB4      2  ///< 4-bit indices into a codebook of WCOMP_CODEBOOK weights
+#define WCOMP_CODEBOOK 16 ///< entries of the codebook of WCOMP_CB4
+#define WCOMP_MAX_EXP  8  ///< largest exponent of WCOMP_EXP8 (int8 mantissas scaled into int16)
+
+/// Header of a compressed weight blob (LAY_LIN_WEIGHTS points to it), followed by the payload
+struct weight_comp_header {
+    uint8_t  format;    ///< WCOMP_RAW, WCOMP_EXP8 or WCOMP_CB4
+    uint8_t  log2Group; ///< weights per exponent (WCOMP_EXP8)
+    uint16_t reserved;
+    uint32_t size;      ///< bytes of the blob including the header (word aligned)
+};
+
+/// L1 staging buffer of the compressed blob of the next layer (bytes), fits the exp8 blob of a full W1 buffer
+#ifndef WCOMP_STAGE_SIZE
+#define WCOMP_STAGE_SIZE ((BUFFER_LIN_W1_SIZE2) + (BUFFER_LIN_W1_SIZE2)/16 + 64)
+#endif
+
+void weightExpand (const uint8_t * blob, data_t * weight, int rows, int cols);
+int weightCompCheck (const uint8_t * blob, int rows, int cols);
+#endif // WEIGHT_COMPRESSION
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Bank-conflict-aware L1 placement (BANK_PLACEMENT, see scripts/bank_sim.py)
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// TCDM banks per core (banking_factor of the virtual platform), banks are word interleaved
+#ifndef TCDM_BANKING_FACTOR
+#define TCDM_BANKING_FACTOR 2
+#endif
+#define TCDM_NR_BANKS (NR_CORES*TCDM_BANKING_FACTOR)
+
+/// Largest input FM (elements) which is replicated per core, larger FMs are read from the shared buffer
+#ifndef BANK_REPLICA_SIZE
+#define BANK_REPLICA_SIZE 512
+#endif
+/// Distance of two input replicas (elements), shifts consecutive replicas by TCDM_BANKING_FACTOR banks
+#define BANK_REPLICA_STRIDE (BANK_REPLICA_SIZE+2*TCDM_BANKING_FACTOR)
+
+/// Per-core copy of the tanh/sigm LUTs (one word of padding shifts the next replica)
+struct bank_lut_replica {
+    short Tanh_m[16];
+    short sig_m[16];
+    int   Tanh_q[16];
+    int   sig_q[16];
+    int   pad[TCDM_BANKING_FACTOR];
+};
+
+#if defined(MULTICORE) && defined(BANK_PLACEMENT)
+void bankReplicateLUTs ();
+data_t * bankReplicateInput (data_t * inFeatures, int size);
+#endif
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// L3 -> L2 -> L1 weight streaming (L3_STREAMING, models which do not fit L2)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#if defined(L3_STREAMING) && !defined(ASIP)
+/// Size of a streamed block in bytes (one slot of the L2 ring and of the L1 double buffer, DMA limit 65532)
+#ifndef STREAM_SLOT_SIZE
+#define STREAM_SLOT_SIZE 8192
+#endif
+/// Number of slots of the L2 ring, i.e. blocks fetched from L3 ahead of the computation
+#ifndef STREAM_L2_SLOTS
+#define STREAM_L2_SLOTS 4
+#endif
+/// L1 elements for the activations and the LSTM states of the streamed network
+#ifndef STREAM_STATE_SIZE
+#define STREAM_STATE_SIZE 8192
+#endif
+/// L3 address of the model container image (flashed to the HyperRAM, see README)
+#ifndef L3_IMAGE_ADDR
+#define L3_IMAGE_ADDR 0
+#endif
+/// Maximum number of parameter segments of one block (LSTM: W_ih, W_hh, b_ih, b_hh)
+#define STREAM_MAX_SEGMENTS 4
+
+/// One streamed block: consecutive output rows of one layer with all their parameters
+struct stream_block {
+    int layer;                                ///< layer of the block
+    int row;                                  ///< first output row (neuron) of the block
+    int rows;                                 ///< number of output rows
+    int nrSegments;                           ///< number of parameter segments
+    unsigned int l3Addr[STREAM_MAX_SEGMENTS]; ///< L3 address of the segments
+    int segSize[STREAM_MAX_SEGMENTS];         ///< size of the segments in bytes
+    int segOffset[STREAM_MAX_SEGMENTS];       ///< offset of the segments in the slot (bytes, word aligned)
+    data_t * data;                            ///< L1 slot holding the block (set by streamAcquire)
+};
+
+/// Streaming engine, the container image stays in L3 and only its header and layer table are kept in L2
+struct stream_engine {
+    struct pi_device * device;                ///< L3 memory (HyperRAM, a file on the host)
+    unsigned int base;                        ///< L3 address of the model container image
+    struct model_container_header header;
+    struct model_container_layer layers[MODEL_CONTAINER_MAX_DEPTH];
+    int rowsPerBlock[MODEL_CONTAINER_MAX_DEPTH]; ///< output rows per block of every layer
+    int blocks[MODEL_CONTAINER_MAX_DEPTH];    ///< blocks per inference of every layer
+    int totalBlocks;                          ///< blocks per inference
+    int bytesPerInference;                    ///< parameter bytes read from L3 per inference
+    int maxAct;                               ///< largest activation FM (elements)
+    int maxHidden;                            ///< largest LSTM state (elements)
+    int fetchLayer;                           ///< next block to fetch from L3 (layer and block in the layer)
+    int fetchStep;
+    int consumed;                             ///< blocks handed to the cores in this inference
+    struct stream_block slot[STREAM_L2_SLOTS];///< blocks in the L2 ring (block k in slot k%STREAM_L2_SLOTS)
+    struct stream_block current[2];           ///< blocks in the L1 double buffer (block k in current[k%2])
+    pi_cl_ram_req_t req[STREAM_L2_SLOTS][STREAM_MAX_SEGMENTS];
+    int dmaId[2];                             ///< L2->L1 transfers of the L1 double buffer
+};
+
+int streamOpen (struct stream_engine * eng, struct pi_device * device, unsigned int base);
+void streamRead (struct stream_engine * eng, unsigned int offset, void * l2, int size);
+struct stream_block * streamAcquire (struct stream_engine * eng);
+data_t * NOINLINE inferNetworkStreamed (struct stream_engine * eng, data_t * __restrict__ inFeatures);
+#endif // L3_STREAMING
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Asynchronous inference queue (ASYNC_INFERENCE, FC submits, cluster serves)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#if defined(ASYNC_INFERENCE) && !defined(ASIP)
+/// Number of requests which can be pending (submitted and not yet notified)
+#ifndef INFER_QUEUE_SIZE
+#define INFER_QUEUE_SIZE 8
+#endif
+/// Orders the accesses to the queue in L2 shared by FC and cluster
+#define INFER_QUEUE_FENCE() __sync_synchronize()
+/// Body of the polling loops on the queue (the host build yields the emulated core)
+#ifndef INFER_QUEUE_IDLE
+#define INFER_QUEUE_IDLE()
+#endif
+
+struct infer_request;
+/// Completion callback, called on the FC by inferPoll (or inferWait)
+typedef void (*infer_callback_t) (struct infer_request * req, void * arg);
+
+/// One inference request, owned by the caller until its callback has been called
+struct infer_request {
+    struct layer * network;      ///< layers of the model
+    int depth;                   ///< number of layers
+    data_t * inFeatures;         ///< input FM
+    data_t * outFeatures;        ///< destination of the output FM (NULL: result points into the FM buffer)
+    int outSize;                 ///< number of output elements copied to outFeatures
+    infer_callback_t callback;   ///< called on completion (can be NULL)
+    void * arg;                  ///< argument of the callback
+    data_t * result;             ///< output FM, valid when done is set (NULL: rejected by inferNetwork)
+    volatile int done;           ///< set by the cluster when the inference is completed
+#ifdef DEADLINE_SCHEDULER
+    long wcet;                   ///< worst-case cycles of the inference (set by inferSubmit, -1 without cycle model)
+#endif
+};
+
+/// Single producer (FC) single consumer (cluster) ring of requests
+struct infer_queue {
+    struct infer_request * volatile slot[INFER_QUEUE_SIZE];
+    volatile unsigned int head;      ///< requests submitted (written by the FC)
+    volatile unsigned int tail;      ///< requests completed (written by cluster core 0)
+    volatile unsigned int notified;  ///< requests whose callback has been called (written by the FC)
+    volatile int stop;               ///< the cluster returns once the queue is empty
+    struct infer_request * current;  ///< request of all cluster cores
+};
+
+void inferQueueInit (struct infer_queue * queue);
+int inferSubmit (struct infer_queue * queue, struct infer_request * req);
+int inferPoll (struct infer_queue * queue);
+void inferWait (struct infer_queue * queue, struct infer_request * req);
+void inferQueueStop (struct infer_queue * queue);
+void inferQueueServe (struct infer_queue * queue, data_t * buffer);
+#endif // ASYNC_INFERENCE
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Concurrent models on disjoint core groups (MULTI_MODEL)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#if defined(MULTI_MODEL) && !defined(ASIP)
+/// Maximum number of models running concurrently (one core group and event unit barrier each)
+#ifndef CORE_GROUPS_MAX
+#define CORE_GROUPS_MAX 4
+#endif
+
+/// Disjoint subset of the cluster cores running one model with its own barrier and L1 FM buffer
+struct core_group {
+    struct layer * network;   ///< layers of the model
+    int depth;                ///< number of layers
+    data_t * inFeatures;      ///< input FM
+    data_t * buffer;          ///< L1 FM buffer (BUFFER_SIZE elements, NULL: coreGroupBuffers)
+    int deadline;             ///< relative deadline of the model (any time unit, <= 0: best effort)
+    long macs;                ///< MACs per inference (set by coreGroupsPlan)
+    int firstCore;            ///< first cluster core of the group (set by coreGroupsPlan)
+    int nrCores;              ///< number of cores of the group, a power of two (set by coreGroupsPlan)
+    int index;                ///< index of the group (set by coreGroupsPlan)
+    int nrGroups;             ///< number of concurrent groups (set by coreGroupsPlan)
+    int barrier;              ///< event unit barrier of the group (barrier 0 is used by synch_barrier)
+    data_t * outFeatures;     ///< output FM of the last inference (in buffer)
+};
+
+/// Group of every cluster core during inferNetworksConcurrent (NULL: the core works with the whole cluster)
+extern struct core_group * coreGroupOf[NR_CORES_MAX];
+/// L1 FM buffers of the core groups which do not bring their own buffer
+extern data_t coreGroupBuffers[CORE_GROUPS_MAX][BUFFER_SIZE];
+
+// cluster-wide core id, number of cores and barrier (expanded before they are redirected to the core group)
+static inline int clusterCoreId() { return rt_core_id(); }
+static inline int clusterNrCores() { return NR_CORES; }
+static inline void clusterBarrier() { synch_barrier(); }
+
+static inline int coreGroupCoreId() {
+    struct core_group * group = coreGroupOf[clusterCoreId()];
+    return group ? clusterCoreId()-group->firstCore : clusterCoreId();
+}
+static inline int coreGroupNrCores() {
+    struct core_group * group = coreGroupOf[clusterCoreId()];
+    return group ? group->nrCores : clusterNrCores();
+}
+static inline void coreGroupBarrier() {
+    struct core_group * group = coreGroupOf[clusterCoreId()];
+    if(group)
+      eu_bar_trig_wait_clr(eu_bar_addr(group->barrier));
+    else
+      clusterBarrier();
+}
+
+/// Elements of one half (current or next layer) of the slice of an L1 staging buffer of a group
+static inline int coreGroupL1Half(int size, int nrGroups) { return ((size/nrGroups) & ~3)/2; }
+
+/// Offset of the current (half 0) or next (half 1) part of an L1 staging buffer (linear_Weights, ...),
+/// concurrent groups get disjoint slices
+static inline int coreGroupL1Offset(int size, int half) {
+    struct core_group * group = coreGroupOf[clusterCoreId()];
+    if(group == NULL)
+      return half*(size/2);
+    return (2*group->index+half)*coreGroupL1Half(size, group->nrGroups);
+}
+
+long networkMacs (struct layer * network, int depth);
+int coreGroupsPlan (struct core_group * groups, int nrGroups, int nrCores);
+void inferNetworksConcurrent (struct core_group * groups, int nrGroups);
+
+// the kernels see the core group of the calling core as the cluster
+#undef rt_core_id
+#define rt_core_id() coreGroupCoreId()
+#undef NR_CORES
+#define NR_CORES coreGroupNrCores()
+#undef synch_barrier
+#define synch_barrier() coreGroupBarrier()
+
+/// Core id for per-core buffers which are shared by all groups
+#define CLUSTER_CORE_ID() clusterCoreId()
+/// First slot of the calling group in per-core scratch buffers indexed by the group core id
+#define CORE_GROUP_FIRST() (coreGroupOf[clusterCoreId()] ? coreGroupOf[clusterCoreId()]->firstCore : 0)
+#else
+#define CLUSTER_CORE_ID() rt_core_id()
+#define CORE_GROUP_FIRST() 0
+#endif // MULTI_MODEL
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Load imbalance and barrier waits per core (BARRIER_PROFILE)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#if defined(BARRIER_PROFILE) && defined(MULTICORE) && !defined(ASIP)
+/// Number of records in the per-core ring buffer of the barrier profiler (oldest records are overwritten)
+#ifndef BARRIER_PROFILE_RECORDS
+#define BARRIER_PROFILE_RECORDS 64
+#endif
+/// Timestamp of the barrier profiler, common to all cores (low half of the cluster timer, TIMER uses the high half)
+#ifndef BARRIER_PROFILE_TIME
+#define BARRIER_PROFILE_TIME() timer_count_get(timer_base_cl(0, 0, 0))
+#endif
+
+/// One segment of a layer on one core, i.e. the work up to a barrier and the wait in the barrier
+struct barrier_record {
+    unsigned short run;       ///< inference run on this core
+    unsigned char  layer;     ///< layer index in the network
+    unsigned char  type;      ///< layer type (enum layerType)
+    unsigned short segment;   ///< barrier index within the layer
+    unsigned short inSize;    ///< input neurons (or tensor size) of the layer
+    unsigned short outSize;   ///< output or hidden neurons of the layer
+    unsigned int entry;       ///< start of the segment (layer start or exit of the previous barrier)
+    unsigned int arrive;      ///< end of the computation (arrival at the barrier)
+    unsigned int exit;        ///< exit of the barrier
+};
+
+/// Ring buffer and state of the barrier profiler (one per core, in L1)
+struct barrier_profile {
+    int head;                 ///< number of records written so far
+    int run;                  ///< current inference run
+    int layer;                ///< currently executed layer (-1: outside of a layer, barriers are not recorded)
+    int type, inSize, outSize;
+    int segment;              ///< barriers of the current layer so far
+    unsigned int entry;       ///< start of the current segment
+    struct barrier_record records[BARRIER_PROFILE_RECORDS];
+};
+
+void barrierProfileReset ();
+void barrierProfileStart (int layer, int type, int inSize, int outSize);
+void barrierProfileEnd ();
+void barrierProfileRecord (unsigned int arrive, unsigned int exit);
+void barrierProfileDump ();
+
+// barrier of the kernels (expanded before it is redirected to the profiled barrier)
+static inline void barrierProfileBarrier() { synch_barrier(); }
+static inline void barrierProfileWait() {
+    unsigned int arrive = BARRIER_PROFILE_TIME();
+    barrierProfileBarrier();
+    barrierProfileRecord(arrive, BARRIER_PROFILE_TIME());
+}
+
+// every barrier of the kernels and of inferNetwork closes a segment of the current layer
+#undef synch_barrier
+#define synch_barrier() barrierProfileWait()
+
+#define BARRIER_PROFILE_LAYER_START(layer, type, inSize, outSize) barrierProfileStart(layer, type, inSize, outSize);
+#define BARRIER_PROFILE_LAYER_END() barrierProfileEnd();
+#else
+#define BARRIER_PROFILE_LAYER_START(layer, type, inSize, outSize)
+#define BARRIER_PROFILE_LAYER_END()
+#endif // BARRIER_PROFILE
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Parameter transfers issued by all cores (DMA_DISTRIBUTED)
+//////////////////////////////////////////////////////////////////////////////////////////////
+// the flat DMA copies of core 0 cannot insert the W_OFFSET padding, dmaLoadLayer scatters the rows
+#if defined(DMA) && defined(MULTICORE) && !defined(ASIP) && W_OFFSET != 0 && !defined(DMA_DISTRIBUTED)
+#define DMA_DISTRIBUTED
+#endif
+#if defined(DMA_DISTRIBUTED) && defined(DMA) && defined(MULTICORE) && !defined(ASIP)
+/// Transfers one core keeps in flight (the cluster DMA has MAX_NR_TRANSACTIONS transaction ids for all cores)
+#ifndef DMA_CORE_OUTSTANDING
+#define DMA_CORE_OUTSTANDING (MAX_NR_TRANSACTIONS/NR_CORES_MAX)
+#endif
+/// Smallest slice of a copy per core (smaller copies are issued by fewer cores)
+#ifndef DMA_SLICE_MIN
+#define DMA_SLICE_MIN 1024
+#endif
+
+/// DMA transfers of one core which are in flight
+struct dma_queue {
+    int ids[DMA_CORE_OUTSTANDING];
+    int issued;               ///< transfers issued so far
+    int completed;            ///< transfers waited for so far
+    int rotate;               ///< core of the first slice of the next copy (same on all cores)
+};
+
+void dmaQueueWait (struct dma_queue * queue);
+void dmaLoadLayer (struct dma_queue * queue, struct layer * lay, data_t * W1, data_t * B1, data_t * W2, data_t * B2,
+                   data_t * H, data_t * C);
+#endif // DMA_DISTRIBUTED
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Overlap of the next-layer DMA prefetches with the computation (DMA_PROFILE)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#if defined(DMA_PROFILE) && defined(DMA) && defined(MULTICORE) && !defined(ASIP)
+/// Number of DMA transactions in the ring buffer of the DMA profiler (oldest records are overwritten)
+#ifndef DMA_PROFILE_XFERS
+#define DMA_PROFILE_XFERS 128
+#endif
+/// Number of layer windows in the ring buffer of the DMA profiler
+#ifndef DMA_PROFILE_WINDOWS
+#define DMA_PROFILE_WINDOWS 64
+#endif
+/// Timestamp of the DMA profiler (low half of the cluster timer, TIMER uses the high half)
+#ifndef DMA_PROFILE_TIME
+#define DMA_PROFILE_TIME() timer_count_get(timer_base_cl(0, 0, 0))
+#endif
+
+/// One prefetch of the next layer (L2 -> L1), issued by core 0 while the cores compute the current layer
+struct dma_profile_xfer {
+    unsigned short run;       ///< inference run
+    unsigned char  layer;     ///< layer which is computed during the transfer (the data belongs to layer+1)
+    unsigned char  index;     ///< transaction index within the layer (dma_trans_ids)
+    unsigned int size;        ///< bytes of the transfer
+    unsigned int issue;       ///< before plp_dma_memcpy
+    unsigned int done;        ///< plp_dma_wait of the transfer returned (at the earliest at the compute end)
+};
+
+/// Compute window of a layer and the wait of core 0 for the prefetches of the next layer
+struct dma_profile_window {
+    unsigned short run;       ///< inference run
+    unsigned char  layer;     ///< layer index in the network
+    unsigned char  type;      ///< layer type (enum layerType)
+    unsigned char  nextType;  ///< layer type of the prefetched layer
+    unsigned char  xfers;     ///< number of prefetches issued in the layer
+    unsigned int bytes;       ///< bytes of the prefetches
+    unsigned int start;       ///< layer start
+    unsigned int computeEnd;  ///< end of the computation of all cores (before the DMA wait)
+    unsigned int waitEnd;     ///< all prefetches of the layer completed
+};
+
+/// Ring buffers and state of the DMA profiler (written by core 0 only, in L2)
+struct dma_profile {
+    int xferHead;             ///< number of transactions recorded so far
+    int windowHead;           ///< number of windows recorded so far
+    int run;                  ///< current inference run
+    int first;                ///< first transaction of the current layer
+    struct dma_profile_window current;
+    struct dma_profile_xfer xfers[DMA_PROFILE_XFERS];
+    struct dma_profile_window windows[DMA_PROFILE_WINDOWS];
+};
+
+void dmaProfileReset ();
+void dmaProfileStart (int layer, int type, int nextType);
+int  dmaProfileIssue (uint32_t ext, uint32_t loc, unsigned int size, int ext2loc);
+void dmaProfileWait (int nrTransactions);
+void dmaProfileDump ();
+
+// prefetches of inferNetwork are recorded with their issue time
+#define DMA_PREFETCH(ext, loc, size, ext2loc) dmaProfileIssue(ext, loc, size, ext2loc)
+#define DMA_PROFILE_LAYER_START(layer, type, nextType) if(rt_core_id()==0) dmaProfileStart(layer, type, nextType);
+#define DMA_PROFILE_WAIT(nrTransactions) dmaProfileWait(nrTransactions);
+#else
+#define DMA_PREFETCH(ext, loc, size, ext2loc) plp_dma_memcpy(ext, loc, size, ext2loc)
+#define DMA_PROFILE_LAYER_START(layer, type, nextType)
+#define DMA_PROFILE_WAIT(nrTransactions)
+#endif // DMA_PROFILE
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Deadline-aware inference with worst-case cycle estimates (DEADLINE_SCHEDULER)
+//////////////////////////////////////////////////////////////////////////////////////////////
+#if defined(DEADLINE_SCHEDULER) && !defined(ASIP)
+/// Fractional bits of the cycles per MAC in the cycle models
+#define WCET_FRAC_BITS 8
+/// Safety margin added to every estimate (in percent)
+#ifndef WCET_MARGIN
+#define WCET_MARGIN 20
+#endif
+/// Number of cycle models (pre-filled from wcet.h and the built-in defaults)
+#ifndef WCET_TABLE_SIZE
+#define WCET_TABLE_SIZE 32
+#endif
+
+/// Cycle model of one kernel on a given number of cores (scripts/wcet.py)
+/// A layer of R rows (FC outputs, LSTM gates, head elements) with M MACs per row takes on the slowest
+/// core fixed + ceil(R/cores)*(perRow + M*perMac/2^WCET_FRAC_BITS) cycles.
+struct wcet_entry {
+    int type;    ///< enum layerType
+    int cores;   ///< number of cores of the measurement (0: any number of cores)
+    int fixed;   ///< cycles per layer (calls, barriers, parameter copies)
+    int perRow;  ///< cycles per row and core (activations, stores)
+    int perMac;  ///< cycles per MAC and core (WCET_FRAC_BITS fractional bits)
+};
+
+/// Decision of the admission test
+#define DEADLINE_PRIMARY   0  ///< the primary model meets the budget
+#define DEADLINE_FALLBACK  1  ///< only the fallback model meets the budget
+#define DEADLINE_REJECTED -1  ///< no model meets the budget
+#define DEADLINE_QUEUE_FULL -2 ///< the request is not submitted, the queue is full (inferSubmitDeadline)
+
+/// Model with an optional smaller fallback model (degraded accuracy, same output FM)
+struct deadline_model {
+    struct layer * network;   ///< layers of the primary model
+    int depth;                ///< number of layers of the primary model
+    struct layer * fallback;  ///< layers of the fallback model (NULL: none)
+    int fallbackDepth;        ///< number of layers of the fallback model
+    int decision;             ///< decision of the last admission test (DEADLINE_*)
+};
+
+long layerWcet (struct layer * lay, int nrCores);
+long networkWcet (struct layer * network, int depth, int nrCores);
+int deadlineAdmit (struct deadline_model * model, long budget, long backlog, int nrCores);
+data_t * NOINLINE inferNetworkDeadline (struct deadline_model * model, data_t * __restrict__ inFeatures,
+                                        data_t * __restrict__ buffer, long budget);
+#if defined(ASYNC_INFERENCE)
+long inferQueueBacklog (struct infer_queue * queue);
+int inferSubmitDeadline (struct infer_queue * queue, struct infer_request * req, struct deadline_model * model, long budget);
+#endif
+#endif // DEADLINE_SCHEDULER
 //////////////////////////////////////////////////////////////////////////////////////////////
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 // Define Define-Combinations
 //////////////////////////////////////////////////////////////////////////////////////////////
 #ifndef ASIP
-#if (defined(TILING_HARD) && defined(FMOUTTILING) && defined(MANUALLOOPUNFOLDING) && defined(VLIWEXT))
+#if (defined(TILING_HARD) && defined(FMOUTTILING) && defined(MANUALLOOPUNFOLDING) && defined(VLIWEXT)) && !defined(WEIGHT_PACKING) && !defined(L3_STREAMING)
 #define EFFICIENT_CORE_ASSIGNMENT 1
 #endif
 #endif
 
+#if defined(GEMM_BATCHING) && (!defined(BATCHING) || !defined(MULTICORE) || defined(TILING))
+#error "GEMM_BATCHING needs BATCHING and MULTICORE without TILING"
+#endif
+
+// the packed weights fix the output tiles at export time (one tile of OUTPUTBUFFER neurons, v2s interleaved)
+#ifdef WEIGHT_PACKING
+#if defined(TILING) || defined(BATCHING) || defined(AUTOTUNE)
+#error "WEIGHT_PACKING does not support TILING, BATCHING and AUTOTUNE"
+#endif
+#if (OUTPUTBUFFER % 2) != 0 || W_OFFSET != 0
+#error "WEIGHT_PACKING needs an even OUTPUTBUFFER and W_OFFSET 0"
+#endif
+#endif
+
+// the compressed weights are expanded by all cores into the L1 weight buffers of inferNetwork
+#ifdef WEIGHT_COMPRESSION
+#if !defined(MULTICORE) || defined(TILING) || defined(WEIGHT_PACKING) || defined(L3_STREAMING) || defined(MULTI_MODEL) || defined(ASIP)
+#error "WEIGHT_COMPRESSION needs MULTICORE and does not support TILING, WEIGHT_PACKING, L3_STREAMING, MULTI_MODEL and ASIP"
+#endif
+#endif
+
+// the streamed layers are computed block by block on all cores (see inferNetworkStreamed)
+#ifdef L3_STREAMING
+#if !defined(MULTICORE) || defined(TILING) || defined(BATCHING) || defined(WEIGHT_PACKING)
+#error "L3_STREAMING needs MULTICORE and does not support TILING, BATCHING and WEIGHT_PACKING"
+#endif
+// the blocks hold dense rows (no W_OFFSET padding) and inferNetworkStreamed splits the LSTM rows per core
+#if W_OFFSET != 0 || !defined(LSTM_HIGH_OPT)
+#error "L3_STREAMING needs W_OFFSET 0 and LSTM_HIGH_OPT"
+#endif
+#if STREAM_SLOT_SIZE > 65532 || (STREAM_SLOT_SIZE % 4) != 0
+#error "STREAM_SLOT_SIZE has to be word aligned and fit one DMA transfer (65532 bytes)"
+#endif
+#endif
+
+// the queue is served by the cluster while the FC submits
+#if defined(ASYNC_INFERENCE) && (!defined(MULTICORE) || defined(SINGLECORE))
+#error "ASYNC_INFERENCE needs MULTICORE (the requests are computed on the cluster)"
+#endif
+
+// the pipelined queue stages one input FM per request in L1
+#if defined(INFER_PIPELINE) && (!defined(ASYNC_INFERENCE) || defined(BATCHING))
+#error "INFER_PIPELINE needs ASYNC_INFERENCE and does not support BATCHING"
+#endif
+
+// the profiler records the prefetches issued by core 0
+#if defined(DMA_DISTRIBUTED) && defined(DMA_PROFILE)
+#error "DMA_PROFILE does not support DMA_DISTRIBUTED (set by default with DMA and W_OFFSET != 0)"
+#endif
+
+// the core groups share the L1 buffers of the DMA, of the tuner and of the layer profiler
+#ifdef MULTI_MODEL
+#if !defined(MULTICORE) || defined(SINGLECORE) || defined(DMA) || defined(TILING) || defined(AUTOTUNE) || defined(PROFILING_LAYERS) || defined(L3_STREAMING)
+#error "MULTI_MODEL needs MULTICORE and does not support DMA, TILING, AUTOTUNE, PROFILING_LAYERS and L3_STREAMING"
+#endif
+#endif
+
+// the replicas only avoid conflicts between cores
+#if defined(BANK_PLACEMENT) && !defined(MULTICORE)
+#undef BANK_PLACEMENT
+#endif
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -417,6 +1084,15 @@ struct layer {
 #   define PROFILING_COPY_START
 #endif
 
+#ifdef PROFILING_HEAD
+#   define CODE_SEGMENT "PROFILING_HEAD"
+#   define PROFILING_HEAD_START startPerf();
+#   define PROFILING_HEAD_END endPerf();
+#else
+#   define PROFILING_HEAD_END 
+#   define PROFILING_HEAD_START
+#endif
+
 #ifdef PROFILING_LINEAR_AMDAHL_SERIELL
 #   define CODE_SEGMENT "PROFILING_LINEAR_AMDAHL_SERIELL"
 #   define PROFILING_LINEAR_AMDAHL_SERIELL_START startPerf();
@@ -472,6 +1148,22 @@ struct layer {
 #endif
 
 
+#if defined(PROFILING_LAYERS) && defined(PROFILING_NEW)
+#   define PROFILING_LAYER_START(layer) layerProfileStart(layer);
+#   define PROFILING_LAYER_END(type) layerProfileEnd(type);
+#else
+#   define PROFILING_LAYER_START(layer)
+#   define PROFILING_LAYER_END(type)
+#endif
+
+/// Number of records in the per-core ring buffer of the layer profiler (oldest records are overwritten)
+#ifndef LAYER_PROFILE_RECORDS
+#define LAYER_PROFILE_RECORDS 256
+#endif
+/// Record type of kernel invocations (CODE_SEGMENT) in the layer profiler, layer records use enum layerType
+#define LAYER_PROFILE_KERNEL 0xFF
+
+
 #ifdef TIMER
 #   define TIMER_START startTimer();
 #   define TIMER_END endTimer();
@@ -496,9 +1188,36 @@ struct layer {
         int perf_all_counters;
         int perf_counter_id;
         int perf_counters [CSR_PCER_NB_EVENTS];
+        int perf_start;     ///< counter value at startPerf() (PROFILING_LAYERS, counters are not reset)
     };
 
     struct perf_counter perf[NR_CORES];
+
+#ifdef PROFILING_LAYERS
+    /// One measurement of the layer profiler
+    struct layer_profile_record {
+        unsigned short run;   ///< inference run on this core
+        unsigned char  layer; ///< layer index in the network
+        unsigned char  type;  ///< layer type (enum layerType) or LAYER_PROFILE_KERNEL
+        unsigned char  event; ///< measured CSR_PCER event
+        int value;            ///< counter delta
+    };
+
+    /// Ring buffer and state of the layer profiler (one per core)
+    struct layer_profile {
+        int head;             ///< number of records written so far
+        int run;              ///< current inference run
+        int layer;            ///< currently executed layer
+        int layer_start;      ///< counter value at the start of the current layer
+        struct layer_profile_record records[LAYER_PROFILE_RECORDS];
+    };
+
+    void  layerProfileReset ();
+    void  layerProfileStart (int layer);
+    void  layerProfileEnd (int type);
+    void  layerProfileRecord (int type, int value);
+    void  layerProfileDump ();
+#endif // PROFILING_LAYERS
 #endif
 
     int numFunctionCalls;
@@ -507,6 +1226,12 @@ struct layer {
     void  startTimer ();
     void  endTimer ();
 
+#ifdef AUTOTUNE
+    struct tuning_entry * tuneLookup (int inFeaturesSize, int outFeaturesSize);
+    int   tuneLinearLayer (struct layer * lay, data_t * weight, data_t * bias, data_t * inFeatures, data_t * outFeatures);
+    void  tuneDump ();
+#endif // AUTOTUNE
+
 #endif
 //////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,49 @@
+/** @file ram.h
+ *  @brief Host (Linux) replacement of the external RAM driver (HyperRAM) used by L3_STREAMING
+ *
+ *  The external memory is a file, the cluster-side reads of the uDMA are emulated with pread
+ *  (the transfer is done when pi_cl_ram_read returns).
+ *
+ *----------------------------------------------------------------------------*
+ * Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+ * SPDX-License-Identifier: Apache-2.0                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ * http://www.apache.org/licenses/LICENSE-2.0                                 *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *----------------------------------------------------------------------------*
+ */
+
+#ifndef HOST_BSP_RAM_HEADER_FILE
+#define HOST_BSP_RAM_HEADER_FILE
+
+#include <stdint.h>
+#include <unistd.h>
+
+/// External memory device (file descriptor of the L3 image)
+struct pi_device {
+    int fd;
+};
+
+/// Request of a cluster-side read
+typedef struct {
+    int size; ///< bytes read
+} pi_cl_ram_req_t;
+
+/** @brief Reads size bytes at ramAddr of the external memory into addr */
+static inline void pi_cl_ram_read(struct pi_device * device, uint32_t ramAddr, void * addr, uint32_t size, pi_cl_ram_req_t * req) {
+    req->size = pread(device->fd, addr, size, ramAddr);
+}
+
+/** @brief Waits for a cluster-side read */
+static inline void pi_cl_ram_read_wait(pi_cl_ram_req_t * req) { (void)req; }
+
+#endif // HOST_BSP_RAM_HEADER_FILE
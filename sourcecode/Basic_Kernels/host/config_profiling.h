@@ -0,0 +1,58 @@
+/** @file config_profiling.h
+ *  @brief Model selection and target overrides for the host benchmark harness
+ *
+ *  Replaces the config_profiling.h of the target build (Makefile_host puts host/ first in the
+ *  include path). Models are selected with MODELS="MODEL2 MODEL5" on the make command line,
+ *  the number of cores is chosen at runtime.
+ *
+ *----------------------------------------------------------------------------*
+ * Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+ * SPDX-License-Identifier: Apache-2.0                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ * http://www.apache.org/licenses/LICENSE-2.0                                 *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *----------------------------------------------------------------------------*
+ */
+
+// included by every header, the defines are evaluated once (general.h may redirect NR_CORES)
+#ifndef HOST_CONFIG_PROFILING_HEADER_FILE
+#define HOST_CONFIG_PROFILING_HEADER_FILE
+
+ #ifdef MODEL0
+ #define LSTM_ON 1
+ #endif
+ #ifdef MODEL1
+ #define LSTM_ON 1
+ #endif
+
+ #define OUTPUTBUFFER 8
+ #define FMINTILING
+ #define W_OFFSET 0
+
+ #define MULTICORE
+ /// cores are emulated by threads, the number of threads is chosen at runtime (at most NR_CORES_MAX)
+ #define NR_CORES_MAX 16
+ #define NR_CORES host_nr_cores
+
+ // target only features (Xpulp instructions, DMA, cluster timer and performance counters),
+ // the output FM tiling and manually unfolded loops rely on Xpulp post-increment loads (inline assembly)
+ #undef VLIWEXT
+ #undef MANUALLOOPUNFOLDING
+ #undef PULP_USETANHSIG
+ #undef DMA
+ #undef PREFETCH_ICACHE
+ #undef PROFILING
+ #undef PROFILING_NEW
+ #undef TIMER
+ #undef PRINTF_ACTIVE
+
+#endif // HOST_CONFIG_PROFILING_HEADER_FILE
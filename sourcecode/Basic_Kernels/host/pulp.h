@@ -0,0 +1,94 @@
+/** @file pulp.h
+ *  @brief Host (Linux) replacement of the PULP-SDK API used by the kernels
+ *
+ *  Provides the subset of the PULP runtime which is used by basicKernel*.c such that the
+ *  kernels can be compiled with a native compiler (see Makefile_host and benchHost.c).
+ *  Cluster cores are emulated with POSIX threads, the Xpulp instructions with plain C.
+ *
+ *----------------------------------------------------------------------------*
+ * Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+ * SPDX-License-Identifier: Apache-2.0                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ * http://www.apache.org/licenses/LICENSE-2.0                                 *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *----------------------------------------------------------------------------*
+ */
+
+#ifndef HOST_PULP_HEADER_FILE
+#define HOST_PULP_HEADER_FILE
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+/// Packed SIMD type (2x16-bit)
+typedef short v2s __attribute__((vector_size(4)));
+
+/// Number of emulated cluster cores (set at runtime by the host harness)
+extern int host_nr_cores;
+/// Core id of the calling thread
+extern __thread int host_core_id;
+
+/** @brief Returns the id of the emulated core */
+static inline int rt_core_id() { return host_core_id; }
+
+/** @brief Barrier over all emulated cores */
+void synch_barrier();
+
+/** @brief Event unit barriers of subsets of the cores (core groups of MULTI_MODEL), emulated by the harness */
+#define eu_bar_addr(barrier) (barrier)
+void eu_bar_setup(unsigned int barAddr, unsigned int coreMask);
+void eu_bar_trig_wait_clr(unsigned int barAddr);
+
+/** @brief Sum of dot product of two packed vectors (pv.sdotsp.h) */
+static inline int __SUMDOTP2(v2s a, v2s b, int c) { return c + a[0]*b[0] + a[1]*b[1]; }
+
+/** @brief Index of the most significant set bit (p.fl1) */
+#define __builtin_pulp_fl1(x) (31-__builtin_clz(x))
+
+/** @brief Waits for all DMA transfers (the host build copies without DMA) */
+static inline void plp_dma_barrier() {}
+/** @brief Cluster DMA transfer between L2 (ext) and L1 (loc), the host build copies immediately */
+static inline int plp_dma_memcpy(uintptr_t ext, uintptr_t loc, unsigned short size, int ext2loc) {
+    if(ext2loc)
+      memcpy((void *) loc, (void *) ext, size);
+    else
+      memcpy((void *) ext, (void *) loc, size);
+    return 0;
+}
+static inline void plp_dma_wait(int id) { (void)id; }
+
+/** @brief Cluster and FC timers (the host build measures wall-clock time in ns) */
+#define timer_base_cl(cid, tid, sub) 0
+#define timer_base_fc(tid, sub) 0
+/// start time of the emulated timer
+extern __thread unsigned long long host_timer_start;
+
+static inline unsigned long long host_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+static inline void timer_reset(int timer) { (void)timer; host_timer_start = host_time_ns(); }
+static inline void timer_start(int timer) { (void)timer; }
+static inline void timer_conf_set(int timer, int conf) { (void)timer; (void)conf; }
+static inline unsigned int timer_count_get(int timer) { (void)timer; return host_time_ns() - host_timer_start; }
+/// timestamps of the barrier profiler have to be comparable between the threads (BARRIER_PROFILE)
+#define BARRIER_PROFILE_TIME() ((unsigned int) host_time_ns())
+
+#define L2_DATA
+
+/// threads polling the inference queue give up the host CPU (ASYNC_INFERENCE)
+#define INFER_QUEUE_IDLE() sched_yield()
+
+#endif // HOST_PULP_HEADER_FILE
@@ -0,0 +1,643 @@
+/** @file insnStatistic.c
+ *  @brief Native instruction trace analyzer, replaces scripts/create_statistic.py for large traces
+ *
+ *  The gvsoc/ISS trace is mmap-ed and scanned once per worker thread, every thread analyzes the lines
+ *  of its cores (pe<N>/ prefix, or fc/). Per core, between the start and stop instruction addresses
+ *  of start.txt and stop.txt, it streams
+ *  - the histogram of the hot instruction sequences (n-grams of up to MAXLENGTH instructions),
+ *  - the cycles and instructions per instruction and top-level kernel (cycle attribution),
+ *  - the reads and writes per memory.
+ *  The reports on stdout and the per-core pickle files (<trace><core>.pkl, read by scripts/wcet.py)
+ *  are the same as the ones of create_statistic.py.
+ *
+ *  Usage: insnStatistic TRACE_FILE START_STRING MULTI_CORE NR_CORES [-j threads]
+ *
+ *----------------------------------------------------------------------------*
+ * Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+ * SPDX-License-Identifier: Apache-2.0                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ * http://www.apache.org/licenses/LICENSE-2.0                                 *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *----------------------------------------------------------------------------*
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/// Instructions of the hot sequences (n-grams of 1..MAXLENGTH instructions)
+#define MAXLENGTH 6
+/// Minimum count of a sequence in the report
+#define MININSTR 1000
+/// Minimum cycles and number of instructions in the per-kernel table
+#define MINCYCLESHOW 1
+#define TOPXSHOW 100
+/// Fields of a trace line which are used
+#define NR_FIELDS 12
+/// Distinct instructions per core (10 bit ids in the n-gram keys)
+#define MAX_INSTRS 1024
+#define MAX_CORES 64
+#define MAX_MEMORIES 32
+
+/// Kernels the cycles are attributed to, and the kernels which include them (see create_statistic.py)
+static const char * topLevelFuncList[] = {"inferNetwork", "LinearLayer", "Conv2dLayer", "RNNLayer", "LSTMLayer",
+    "SoftmaxLayer", "ArgmaxLayer", "TopKLayer", "TwoLinearLayersAccumulate", "SigLayer", "TanhLayer",
+    "HadMulTensor", "AddTensor", "CopyTensor"};
+#define NR_FUNCS (int)(sizeof(topLevelFuncList)/sizeof(topLevelFuncList[0]))
+#define FUNC_INFER 0
+#define FUNC_LSTM  4
+/// second stage kernels are called by inferNetwork, third stage kernels by inferNetwork or LSTMLayer
+static const int secondStage[NR_FUNCS] = {0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0};
+static const int thirdStage[NR_FUNCS]  = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1};
+
+/// Counter of one n-gram (open addressing, key 0 is empty)
+struct ngram {
+    uint64_t key;      ///< length (3 bit) and instruction ids (10 bit each)
+    long count;
+    long order;        ///< first occurrence (ties of the report are in order of occurrence)
+};
+
+/// Cycles and instructions of one instruction in one kernel
+struct func_stat {
+    long cycles;
+    long instrs;
+    long order;
+};
+
+struct memory_stat {
+    char name[64];
+    long reads;
+    long writes;
+};
+
+/// State and results of one core
+struct core_stat {
+    char prefix[16];                      ///< path element of the core in the trace ("pe3/" or "fc/")
+    int started, stopped;
+    long long startCycle, endCycle;
+    long total;                           ///< analyzed instructions
+    // instruction names
+    char * instrNames[MAX_INSTRS];
+    int nrInstrs;
+    // n-gram histogram
+    struct ngram * grams;
+    long gramCap, gramUsed, gramOrder;
+    int window[MAXLENGTH];                ///< last instructions (oldest first)
+    // cycle attribution
+    struct func_stat * funcs[NR_FUNCS];   ///< [func][instr], NULL until the kernel has been executed
+    long calls[NR_FUNCS];
+    long funcOrder;
+    int currFunc;
+    int pending;                          ///< instruction waiting for the cycle of the next line
+    long long pendingCycle;
+    int pendingInstr;
+    int pendingFunc;
+    // memories
+    struct memory_stat mem[MAX_MEMORIES];
+    int nrMem;
+};
+
+static const char * traceData;
+static size_t traceSize;
+static char startToken[128], stopToken[128];
+static struct core_stat cores[MAX_CORES];
+static int nrCores;
+static int nrThreads = 4;
+
+/** @brief Splits a line into whitespace separated fields
+ *  @return Number of fields (at most NR_FIELDS are stored)
+ */
+static int splitLine(const char * line, const char * end, const char ** field, int * len) {
+    int n = 0;
+    const char * p = line;
+    while(p < end)
+    {
+      while(p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+      if(p >= end)
+        break;
+      const char * s = p;
+      while(p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        p++;
+      if(n < NR_FIELDS)
+      {
+        field[n] = s;
+        len[n] = p - s;
+      }
+      n++;
+    }
+    return n;
+}
+
+static int fieldIs(const char * field, int len, const char * str) {
+    return (int)strlen(str) == len && memcmp(field, str, len) == 0;
+}
+
+static int fieldHas(const char * field, int len, const char * str) {
+    int n = strlen(str);
+    for(int i=0; i+n<=len; i++)
+      if(memcmp(field+i, str, n) == 0)
+        return 1;
+    return 0;
+}
+
+/** @brief Index of the core of a trace path (field 2), -1 if no analyzed core */
+static int coreOf(const char * field, int len) {
+    for(int i=0; i+3<=len; i++)
+    {
+      if(field[i] == 'p' && i+1 < len && field[i+1] == 'e')
+      {
+        int j = i+2, id = 0;
+        if(j >= len || field[j] < '0' || field[j] > '9')
+          continue;
+        while(j < len && field[j] >= '0' && field[j] <= '9')
+          id = 10*id + field[j++] - '0';
+        if(j < len && field[j] == '/' && id < nrCores && cores[id].prefix[0] == 'p')
+          return id;
+      }
+      else if(field[i] == 'f' && field[i+1] == 'c' && field[i+2] == '/' && cores[0].prefix[0] == 'f')
+        return 0;
+    }
+    return -1;
+}
+
+static int instrId(struct core_stat * core, const char * name, int len) {
+    for(int i=0; i<core->nrInstrs; i++)
+      if(fieldIs(name, len, core->instrNames[i]))
+        return i;
+    if(core->nrInstrs == MAX_INSTRS)
+    {
+      fprintf(stderr, "\033[91mERROR - more than %d distinct instructions on %s!!!\033[0m\n", MAX_INSTRS, core->prefix);
+      exit(1);
+    }
+    core->instrNames[core->nrInstrs] = strndup(name, len);
+    return core->nrInstrs++;
+}
+
+static void gramAdd(struct core_stat * core, uint64_t key) {
+    if(2*(core->gramUsed+1) > core->gramCap)
+    {
+      struct ngram * old = core->grams;
+      long oldCap = core->gramCap;
+      core->gramCap = oldCap ? 2*oldCap : 4096;
+      core->grams = calloc(core->gramCap, sizeof(struct ngram));
+      for(long i=0; i<oldCap; i++)
+      {
+        if(old[i].key == 0)
+          continue;
+        long h = (old[i].key*0x9E3779B97F4A7C15ull) & (core->gramCap-1);
+        while(core->grams[h].key)
+          h = (h+1) & (core->gramCap-1);
+        core->grams[h] = old[i];
+      }
+      free(old);
+    }
+    long h = (key*0x9E3779B97F4A7C15ull) & (core->gramCap-1);
+    while(core->grams[h].key && core->grams[h].key != key)
+      h = (h+1) & (core->gramCap-1);
+    if(core->grams[h].key == 0)
+    {
+      core->grams[h].key = key;
+      core->grams[h].order = core->gramOrder++;
+      core->gramUsed++;
+    }
+    core->grams[h].count++;
+}
+
+/** @brief Adds cycles and the instruction to a kernel */
+static void funcAdd(struct core_stat * core, int func, int instr, long cycles) {
+    if(core->funcs[func] == NULL)
+      core->funcs[func] = calloc(MAX_INSTRS, sizeof(struct func_stat));
+    struct func_stat * s = &core->funcs[func][instr];
+    if(s->instrs == 0 && s->cycles == 0)
+      s->order = core->funcOrder++;
+    s->cycles += cycles;
+    s->instrs++;
+}
+
+/** @brief Attributes the cycles of the pending instruction (up to the next line of the core) */
+static void flushPending(struct core_stat * core, long long cycle) {
+    if(!core->pending)
+      return;
+    core->pending = 0;
+    long cycles = cycle - core->pendingCycle;
+    int f = core->pendingFunc;
+    funcAdd(core, f, core->pendingInstr, cycles);
+    if(secondStage[f] || thirdStage[f])
+      funcAdd(core, FUNC_INFER, core->pendingInstr, cycles);
+    if(thirdStage[f])
+      funcAdd(core, FUNC_LSTM, core->pendingInstr, cycles);
+}
+
+static void analyzeLine(struct core_stat * core, const char ** field, int * len) {
+    long long cycle = strtoll(field[1], NULL, 10);
+
+    if(!core->started)
+    {
+      if(!fieldIs(field[6], len[6], startToken))
+        return;
+      core->started = 1;
+      core->startCycle = cycle;
+    }
+    else if(fieldIs(field[6], len[6], stopToken))
+    {
+      flushPending(core, cycle);
+      core->endCycle = cycle;
+      core->stopped = 1;
+      return;
+    }
+    flushPending(core, cycle);
+
+    if(fieldHas(field[2], len[2], "insn"))
+    {
+      char name[64];
+      int n = len[7] < 48 ? len[7] : 48;
+      memcpy(name, field[7], n);
+      if(fieldHas(field[9], len[9], "!"))
+        name[n++] = '!';
+      if(n > 11 && memcmp(name, "pl.sdotsp.h.", 12) == 0)
+        n = 11;
+      int instr = instrId(core, name, n);
+
+      // hot sequences
+      memmove(core->window, core->window+1, (MAXLENGTH-1)*sizeof(int));
+      core->window[MAXLENGTH-1] = instr;
+      uint64_t key = 0;
+      for(int l=1; l<=MAXLENGTH; l++)
+      {
+        key = (key << 10) | core->window[MAXLENGTH-l];
+        gramAdd(core, ((uint64_t)l << 60) | key);
+      }
+      core->total++;
+
+      // kernel of the instruction
+      const char * colon = memchr(field[4], ':', len[4]);
+      int funcLen = colon ? colon - field[4] : len[4];
+      for(int f=0; f<NR_FUNCS; f++)
+      {
+        if(fieldIs(field[4], funcLen, topLevelFuncList[f]))
+        {
+          if(secondStage[f] && core->currFunc == FUNC_INFER)
+            core->calls[f]++;
+          core->currFunc = f;
+          break;
+        }
+      }
+      core->pending = 1;
+      core->pendingCycle = cycle;
+      core->pendingInstr = instr;
+      core->pendingFunc = core->currFunc;
+    }
+    else if(fieldHas(field[4], len[4], "Memory") && len[2] > 32)
+    {
+      char name[64];
+      int n = len[2]-32 < 63 ? len[2]-32 : 63;
+      memcpy(name, field[2]+26, n);
+      name[n] = 0;
+      int m;
+      for(m=0; m<core->nrMem && strcmp(core->mem[m].name, name); m++);
+      if(m == core->nrMem && m < MAX_MEMORIES)
+        strcpy(core->mem[core->nrMem++].name, name);
+      if(m < MAX_MEMORIES)
+      {
+        int write = atoi(field[11]);
+        core->mem[m].writes += write;
+        core->mem[m].reads  += 1-write;
+      }
+    }
+}
+
+/** @brief Worker thread, scans the whole trace and analyzes the lines of the cores c with c%nrThreads == id */
+static void * worker(void * arg) {
+    long id = (long) arg;
+    const char * p = traceData, * end = traceData + traceSize;
+    const char * field[NR_FIELDS];
+    int len[NR_FIELDS];
+    int active = 0;
+
+    for(int c=id; c<nrCores; c+=nrThreads)
+      active++;
+    while(p < end && active)
+    {
+      const char * eol = memchr(p, '\n', end-p);
+      if(eol == NULL)
+        eol = end;
+      int n = splitLine(p, eol, field, len);
+      if(n > 5)
+      {
+        int c = coreOf(field[2], len[2]);
+        if(c >= 0 && c % nrThreads == id && !cores[c].stopped)
+        {
+          if(n < NR_FIELDS)
+            for(int f=n; f<NR_FIELDS; f++) { field[f] = ""; len[f] = 0; }
+          analyzeLine(&cores[c], field, len);
+          if(cores[c].stopped)
+            active--;
+        }
+      }
+      p = eol+1;
+    }
+    return NULL;
+}
+
+static int gramCompare(const void * a, const void * b) {
+    const struct ngram * x = *(const struct ngram **) a, * y = *(const struct ngram **) b;
+    if(x->count != y->count)
+      return x->count < y->count ? 1 : -1;
+    return x->order < y->order ? -1 : 1;
+}
+
+static const struct func_stat * sortFunc;
+static int funcCompare(const void * a, const void * b) {
+    const struct func_stat * x = &sortFunc[*(const int *) a], * y = &sortFunc[*(const int *) b];
+    if(x->cycles != y->cycles)
+      return x->cycles < y->cycles ? 1 : -1;
+    return x->order < y->order ? -1 : 1;
+}
+
+/** @brief Prints a string centered in a column of width characters (Python "{:^16.16}") */
+static void printCentered(const char * str, int width) {
+    int n = strlen(str) < (size_t) width ? (int) strlen(str) : width;
+    int left = (width-n)/2;
+    printf("%*s%.*s%*s", left, "", n, str, width-n-left, "");
+}
+
+static void printFuncHeader() {
+    printf("%12s", "Instr.");
+    for(int f=0; f<NR_FUNCS; f++)
+      printCentered(topLevelFuncList[f], 16);
+    printf("\n");
+}
+
+static void printRule() {
+    for(int i=0; i<12+16*NR_FUNCS; i++)
+      putchar('-');
+    printf("\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Pickle (protocol 2) of the results, as written by create_statistic.py
+//////////////////////////////////////////////////////////////////////////////////////////////
+static void pickleStr(FILE * f, const char * s) {
+    uint32_t n = strlen(s);
+    fputc('X', f);
+    fwrite(&n, 4, 1, f);
+    fwrite(s, 1, n, f);
+}
+
+static void pickleInt(FILE * f, long long v) {
+    if(v >= INT32_MIN && v <= INT32_MAX)
+    {
+      int32_t i = v;
+      fputc('J', f);
+      fwrite(&i, 4, 1, f);
+    }
+    else
+    {
+      fputc(0x8a, f); // LONG1, 8 bytes two's complement
+      fputc(8, f);
+      fwrite(&v, 8, 1, f);
+    }
+}
+
+static void pickleFuncs(FILE * f, struct core_stat * core, int cycles) {
+    fputs("}(", f);
+    for(int func=0; func<NR_FUNCS; func++)
+    {
+      if(core->funcs[func] == NULL)
+        continue;
+      pickleStr(f, topLevelFuncList[func]);
+      fputs("}(", f);
+      for(int i=0; i<core->nrInstrs; i++)
+      {
+        struct func_stat * s = &core->funcs[func][i];
+        if(s->instrs == 0)
+          continue;
+        pickleStr(f, core->instrNames[i]);
+        pickleInt(f, cycles ? s->cycles : s->instrs);
+      }
+      fputc('u', f);
+    }
+    fputc('u', f);
+}
+
+static void writePickle(const char * traceName, struct core_stat * core) {
+    char name[4096];
+    snprintf(name, sizeof(name), "%s%.*s.pkl", traceName, (int) strlen(core->prefix)-1, core->prefix);
+    FILE * f = fopen(name, "wb");
+    if(f == NULL)
+    {
+      printf("\033[91mERROR - cannot write %s!!!\033[0m\n", name);
+      return;
+    }
+    fputs("\x80\x02}(", f);
+    pickleStr(f, "topLevelFuncList");
+    fputs("](", f);
+    for(int func=0; func<NR_FUNCS; func++)
+      pickleStr(f, topLevelFuncList[func]);
+    fputc('e', f);
+    pickleStr(f, "cyclesPerFunc");
+    pickleFuncs(f, core, 1);
+    pickleStr(f, "instrPerFunc");
+    pickleFuncs(f, core, 0);
+    pickleStr(f, "callsPerFunc");
+    fputs("}(", f);
+    for(int func=0; func<NR_FUNCS; func++)
+    {
+      if(core->calls[func])
+      {
+        pickleStr(f, topLevelFuncList[func]);
+        pickleInt(f, core->calls[func]);
+      }
+    }
+    fputc('u', f);
+    pickleStr(f, "cycles");
+    pickleInt(f, core->endCycle-core->startCycle-1);
+    fputs("u.", f);
+    fclose(f);
+}
+
+static void report(const char * traceName, struct core_stat * core) {
+    printf("Statistics for %.*s from %s to %s\n", (int) strlen(core->prefix)-1, core->prefix, startToken, stopToken);
+
+    // hot sequences
+    struct ngram ** hot = malloc((core->gramUsed+1)*sizeof(struct ngram *));
+    long nrHot = 0;
+    for(long i=0; i<core->gramCap; i++)
+      if(core->grams[i].key && core->grams[i].count >= MININSTR)
+        hot[nrHot++] = &core->grams[i];
+    qsort(hot, nrHot, sizeof(struct ngram *), gramCompare);
+    for(long h=0; h<nrHot; h++)
+    {
+      int n = hot[h]->key >> 60;
+      char seq[MAXLENGTH*72] = "[";
+      for(int l=0; l<n; l++)
+      {
+        // the oldest instruction is in the lowest bits
+        int id = (hot[h]->key >> (10*l)) & (MAX_INSTRS-1);
+        strcat(seq, "'");
+        strcat(seq, core->instrNames[id]);
+        strcat(seq, l < n-1 ? "', " : "'");
+      }
+      strcat(seq, "]");
+      printf("%2i, %12s: %6li\n", n, seq, hot[h]->count);
+    }
+    free(hot);
+    printf("--------------------\n       %12s: %6li\n       --------------------\n", "total", core->total);
+
+    for(int m=0; m<core->nrMem; m++)
+      printf("%12s: %6li, %6li\n", core->mem[m].name, core->mem[m].reads, core->mem[m].writes);
+
+    // cycles and instructions per kernel, sorted by the cycles of the last kernel
+    printFuncHeader();
+    printf("%12s", "Instr.");
+    for(int f=0; f<NR_FUNCS; f++)
+      printf("%8s%8s", "cycles", "instrs");
+    printf("\n");
+    struct func_stat * last = core->funcs[core->currFunc];
+    if(last)
+    {
+      int idx[MAX_INSTRS], n = 0;
+      for(int i=0; i<core->nrInstrs; i++)
+        if(last[i].instrs)
+          idx[n++] = i;
+      sortFunc = last;
+      qsort(idx, n, sizeof(int), funcCompare);
+      for(int r=0; r<n && r<TOPXSHOW; r++)
+      {
+        if(last[idx[r]].cycles < MINCYCLESHOW)
+          continue;
+        printf("%12s", core->instrNames[idx[r]]);
+        for(int f=0; f<NR_FUNCS; f++)
+          printf("%8li%8li", core->funcs[f] ? core->funcs[f][idx[r]].cycles : 0,
+                 core->funcs[f] ? core->funcs[f][idx[r]].instrs : 0);
+        printf("\n");
+      }
+    }
+    printRule();
+    printf("%12s", "sum");
+    for(int f=0; f<NR_FUNCS; f++)
+    {
+      long cycles = 0, instrs = 0;
+      for(int i=0; core->funcs[f] && i<core->nrInstrs; i++)
+      {
+        cycles += core->funcs[f][i].cycles;
+        instrs += core->funcs[f][i].instrs;
+      }
+      printf("%8li%8li", cycles, instrs);
+    }
+    printf("\n");
+    printRule();
+    printFuncHeader();
+
+    printf("Start: %lld, End: %lld, Duration in cycles: %lld\n", core->startCycle, core->endCycle-1,
+           core->endCycle-core->startCycle-1);
+    writePickle(traceName, core);
+}
+
+/** @brief Reads the first line of a file without the line break */
+static int readToken(const char * fileName, char * token, int size) {
+    FILE * f = fopen(fileName, "r");
+    if(f == NULL || fgets(token, size, f) == NULL)
+    {
+      printf("\033[91mERROR - cannot read %s!!!\033[0m\n", fileName);
+      if(f)
+        fclose(f);
+      return -1;
+    }
+    fclose(f);
+    // the last character (line break) is not part of the address, as in create_statistic.py
+    if(strlen(token) > 0)
+      token[strlen(token)-1] = 0;
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "j:h")) != -1)
+    {
+      switch(opt) {
+        case 'j': nrThreads = atoi(optarg); break;
+        default:
+          printf("Usage: %s TRACE_FILE START_STRING MULTI_CORE NR_CORES [-j threads]\n", argv[0]);
+          return 1;
+      }
+    }
+    if(optind >= argc)
+    {
+      printf("Usage: %s TRACE_FILE START_STRING MULTI_CORE NR_CORES [-j threads]\n", argv[0]);
+      return 1;
+    }
+    const char * traceName = argv[optind];
+    int cluster = optind+2 < argc ? atoi(argv[optind+2]) : 1;
+    nrCores = cluster == 1 ? (optind+3 < argc ? atoi(argv[optind+3]) : 16) : 1;
+    if(nrCores < 1 || nrCores > MAX_CORES || nrThreads < 1)
+    {
+      printf("\033[91mERROR - 1 to %d cores and at least one thread are supported!!!\033[0m\n", MAX_CORES);
+      return 1;
+    }
+    if(nrThreads > nrCores)
+      nrThreads = nrCores;
+
+    // start and stop instruction addresses
+    if(readToken("./start.txt", startToken, sizeof(startToken)) || readToken("./stop.txt", stopToken, sizeof(stopToken)))
+      return 1;
+
+    int fd = open(traceName, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      printf("\033[91mERROR - cannot open %s!!!\033[0m\n", traceName);
+      return 1;
+    }
+    traceSize = st.st_size;
+    traceData = mmap(NULL, traceSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(traceData == MAP_FAILED)
+    {
+      printf("\033[91mERROR - cannot map %s!!!\033[0m\n", traceName);
+      return 1;
+    }
+    madvise((void *) traceData, traceSize, MADV_SEQUENTIAL);
+
+    for(int c=0; c<nrCores; c++)
+    {
+      if(cluster == 1)
+        snprintf(cores[c].prefix, sizeof(cores[c].prefix), "pe%d/", c);
+      else
+        strcpy(cores[c].prefix, "fc/");
+      // the sequence window starts with nops as in create_statistic.py
+      int nop = instrId(&cores[c], "nop", 3);
+      for(int l=0; l<MAXLENGTH; l++)
+        cores[c].window[l] = nop;
+      cores[c].currFunc = FUNC_INFER;
+    }
+
+    pthread_t threads[MAX_CORES];
+    for(long t=0; t<nrThreads; t++)
+      pthread_create(&threads[t], NULL, worker, (void *) t);
+    for(int t=0; t<nrThreads; t++)
+      pthread_join(threads[t], NULL);
+
+    for(int c=0; c<nrCores; c++)
+      report(traceName, &cores[c]);
+
+    munmap((void *) traceData, traceSize);
+    return 0;
+}
@@ -26,7 +26,9 @@ import os
 import sys
 sys.path.insert(0, '../')
 from math import ceil
-from pyTorch_Kernels import _1DTensor2C, _2DTensor2C, num2format
+from pyTorch_Kernels import _1DTensor2C, _2DTensor2C, _packedWeights2C, _compressedWeights2C, packWeights as packWeightList, num2format
+from model_container import writeContainer
+from weight_compression import encodeWeights, decodeWeights, FORMATS as compressionFormats
 from enum import Enum
 from functools import reduce
 nn=torch.nn
@@ -72,6 +74,69 @@ class myLSTM(nn.LSTM):
       return hn[0]
       # self.hx = tmp[1]
       # return tmp[0]
+
+class myArgmax(nn.Module):
+   """Output head returning the index of the largest neuron (ARGMAX layer)"""
+   def forward(self, input):
+      return torch.argmax(input.reshape(-1)).view(1)
+
+class myTopK(nn.Module):
+   """Output head returning the indices of the k largest neurons (TOPK layer)"""
+   def __init__(self, k):
+      super().__init__()
+      self.k = k
+   def forward(self, input):
+      return torch.topk(input.reshape(-1), self.k)[1]
+
+class myResidual(nn.Module):
+   """Adds the input FM of the preceding Linear layer (fused as FUSE_RESIDUAL)"""
+   def forward(self, input, residual):
+      return input + residual.reshape(input.size())
+
+class myAdd(nn.Module):
+   """Point-wise addition of a constant tensor (fused as FUSE_ADD)"""
+   def __init__(self, tensor):
+      super().__init__()
+      self.tensor = tensor
+   def forward(self, input):
+      return input + self.tensor
+
+class myHadamard(nn.Module):
+   """Point-wise multiplication with a constant tensor (fused as FUSE_HADAMARD)"""
+   def __init__(self, tensor):
+      super().__init__()
+      self.tensor = tensor
+   def forward(self, input):
+      return input * self.tensor
+
+# element-wise layers which are fused into the preceding Linear layer and their FUSE_* op codes
+fuseOpCodes = {myResidual: 1, myAdd: 2, myHadamard: 3, nn.Tanh: 4, nn.Sigmoid: 5}
+FUSE_OP_BITS = 4
+FUSE_MAX_OPS = 7
+FUSE_MAX_TENSORS = 4
+
+def fuseLayers(layers):
+   """Graph-level fusion pass: folds chains of element-wise layers into the preceding Linear layer
+
+   returns a list of (layer, [fused element-wise layers]) in execution order"""
+   groups = []
+   for layer in layers:
+      if type(layer) in fuseOpCodes:
+         if len(groups) == 0 or not isinstance(groups[-1][0], nn.Linear):
+            error(str(type(layer))+" can only be fused into a preceding Linear layer")
+         elif groups[-1][0].in_features % 2:
+            error("element-wise layers can only be fused into a Linear layer with an even number of inputs")
+         elif len(groups[-1][1]) >= FUSE_MAX_OPS:
+            error("more than {} fused element-wise operations".format(FUSE_MAX_OPS))
+         elif isinstance(layer, (myAdd, myHadamard)) and \
+              len([op for op in groups[-1][1] if isinstance(op, (myAdd, myHadamard))]) >= FUSE_MAX_TENSORS:
+            error("more than {} fused parameter tensors".format(FUSE_MAX_TENSORS))
+         else:
+            groups[-1][1].append(layer)
+      else:
+         groups.append((layer, []))
+   return groups
+
 inputFM = torch.randn(1, 1, 3)
 a=myLSTM(3,4)
 a.forward(inputFM)
@@ -139,6 +204,12 @@ class netModel():
             self.out_features = model[self.numLayers-1].hidden_size
         elif isinstance(model[self.numLayers-1], nn.Conv2d):
             self.out_features  = model[self.numLayers-1].out_channels
+        elif isinstance(model[self.numLayers-1], nn.Softmax) or type(model[self.numLayers-1]) in fuseOpCodes:
+            self.out_features  = netModel(model[:-1]).out_features
+        elif isinstance(model[self.numLayers-1], myArgmax):
+            self.out_features  = 1
+        elif isinstance(model[self.numLayers-1], myTopK):
+            self.out_features  = model[self.numLayers-1].k
         else: 
              error(str(type(model[self.numLayers-1]))+"not defined")
    def __repr__(self):
@@ -167,6 +238,12 @@ class netModel():
                    numParams += 0
                elif isinstance(layer, nn.Conv2d):
                    numParams +=  reduce(lambda x, y: x*y, layer.weight.size(), 1)+layer.bias.size()[0];
+               elif isinstance(layer, (nn.Softmax, myArgmax, myTopK)):
+                   numParams += 0 # output heads have no parameters
+               elif isinstance(layer, (myAdd, myHadamard)):
+                   numParams += layer.tensor.numel()
+               elif type(layer) in fuseOpCodes:
+                   numParams += 0
                else: 
                    error(str(type(layer))+" not defined")
         return numParams
@@ -185,13 +262,28 @@ class netModel():
       print("\n╚{:═^2s}╧{:═^11s}╧╝".format("", ""))
       # print(netModel.numParams(netModels))
 
-   def exportModel(netModels, h_im=0, w_im=0):
+   def exportModel(netModels, h_im=0, w_im=0, packWeights=0, containerDir=None, compressWeights=None):
+      """Writes the models to benchmarks.h
+
+      packWeights: OUTPUTBUFFER of the target build to export the FC weights pre-packed for
+                   WEIGHT_PACKING (0: row-major weights)
+      compressWeights: "exp8" or "cb4" to export the FC weights compressed for WEIGHT_COMPRESSION
+                   (see weight_compression.py), the weights of the models are replaced by the
+                   decoded (lossy) weights, i.e. the expected outputs match the device
+      containerDir: additionally writes every model as binary container model<ID>.bin
+                    (see model_container.py) into this directory"""
+      fixedPt = lambda tensor : [num2format(v) for v in tensor.reshape(-1).tolist()]
       if isinstance(netModels, netModel):
          netModels = list([netModels])
       print('asdf')
       data_f = open("benchmarks.h",'w')
       write2file = lambda x : data_f.write(x+"\n")
       write2file(copyright)
+      assert not (packWeights and compressWeights), "packed weights cannot be compressed"
+      if packWeights:
+         write2file("#define WEIGHT_PACKING_OUTPUTBUFFER {}\n".format(packWeights))
+      if compressWeights:
+         write2file("#define WEIGHT_COMPRESSION_FORMAT {}\n".format(compressionFormats[compressWeights]))
       moveFilePointer = lambda x : data_f.seek(data_f.tell() - x, os.SEEK_SET)
       # print(model)
       # print(len(model))
@@ -238,14 +330,18 @@ class netModel():
          # inputFM.data.fill_(1)
          if isinstance(_netModel.model[0], nn.Conv2d): 
           write2file(_1DTensor2C(prefix+"In", inputFM.permute(0,2,3,1).clone().view(-1)))
+          containerIn = fixedPt(inputFM.permute(0,2,3,1))
          else:
           write2file(_1DTensor2C(prefix+"In", inputFM.clone().view(-1)))
+          containerIn = fixedPt(inputFM)
+         containerLayers = []
          
          print("inputfm=")
          print(inputFM)
-         write2file("#define DEPTH{} {}\n".format(modelID, len(_netModel.model)))
-         netDef_c = "struct layer model{}[{}] = {{".format(modelID, len(_netModel.model))
-         for layer in _netModel.model.children():
+         layerGroups = fuseLayers(_netModel.model.children())
+         write2file("#define DEPTH{} {}\n".format(modelID, len(layerGroups)))
+         netDef_c = "struct layer model{}[{}] = {{".format(modelID, len(layerGroups))
+         for layer, fusedLayers in layerGroups:
             # print(layer)
             info(str(layID))
             netDef_c += ", \\\n " if layID != 0 else "\\\n "
@@ -262,12 +358,33 @@ class netModel():
 
                if len(inputFM.size()) == 4:
                 inputFM = inputFM.view(-1)
+               if compressWeights:
+                  # the expected output is computed with the weights as expanded by the cores
+                  blob = encodeWeights(fixedPt(layer.weight), outFeaturesSize, inFeaturesSize, compressWeights)
+                  layer.weight.data = torch.tensor(decodeWeights(blob, outFeaturesSize, inFeaturesSize),
+                     dtype=layer.weight.dtype).view(outFeaturesSize, inFeaturesSize) / 2**12
                outputFM = layer.forward(inputFM)
-               
+               prefix = "m{}_linear{}_".format(modelID, layID)
+
+               # element-wise layers fused into this layer (see FusedLinearLayer)
+               fusedOps = 0
+               fusedTensors = []
+               fusedData = []
+               for opID, op in enumerate(fusedLayers):
+                  if isinstance(op, myResidual):
+                     assert(inFeaturesSize == outFeaturesSize), "residual needs same input and output size"
+                     outputFM = op.forward(outputFM, inputFM)
+                  else:
+                     outputFM = op.forward(outputFM)
+                  if isinstance(op, (myAdd, myHadamard)):
+                     fusedTensors.append(prefix+"Fused"+str(len(fusedTensors)))
+                     write2file(_1DTensor2C(fusedTensors[-1], op.tensor.reshape(-1)))
+                     fusedData.append(fixedPt(op.tensor))
+                  fusedOps |= fuseOpCodes[type(op)] << (FUSE_OP_BITS*opID)
+               fusedTensors += ["0"]*(FUSE_MAX_TENSORS-len(fusedTensors))
 
                write2file("// outputFM.size = "+outputFM.size().__repr__()+"\n");
          #
-               prefix = "m{}_linear{}_".format(modelID, layID)
          #       print(outputFM)
                write2file("/*\n");
                write2file(_1DTensor2C(prefix+"OutExp", outputFM))
@@ -276,13 +393,26 @@ class netModel():
                # write2file("data_t "+prefix+"OutExp["+str(len(outputFM[0]))+"];")
                # print(_1DTensor2C(prefix+"In", inputFM))
                write2file(_1DTensor2C(prefix+"Bias", layer.bias))
-               write2file(_2DTensor2C(prefix+"Weights", layer.weight))
+               # FusedLinearLayer reads row-major weights, only plain FC layers are packed
+               packLayer = packWeights and fusedOps == 0
+               if packLayer:
+                  write2file(_packedWeights2C(prefix+"Weights", layer.weight, packWeights))
+               elif compressWeights:
+                  write2file(_compressedWeights2C(prefix+"Weights", blob))
+               else:
+                  write2file(_2DTensor2C(prefix+"Weights", layer.weight))
          #
                print("int "+prefix+"inFeatureSize = "+str(inFeaturesSize)+";")
                print("int "+prefix+"outFeatureSize = "+str(outFeaturesSize)+";")
               
-               netDef_c += "{{.type=LINEAR, .attributes={{{},{},{},{},{}}}, ".format(inFeaturesSize, outFeaturesSize, 0,0,0)
-               netDef_c += ".parameters={{{},{}[0],{},{},{},{}}}}}".format(prefix+"Bias", prefix+"Weights",0,0,0,0)
+               netDef_c += "{{.type=LINEAR, .attributes={{{},{},{},{},{}}}, ".format(inFeaturesSize, outFeaturesSize, 0,0,fusedOps)
+               weights = prefix+"Weights" if packLayer else "(data_t *) "+prefix+"Weights" if compressWeights else prefix+"Weights[0]"
+               netDef_c += ".parameters={{{},{},{},{},{},{}}}}}".format(prefix+"Bias", weights, *fusedTensors)
+               containerLayers.append(("LINEAR", [inFeaturesSize, outFeaturesSize, 0, 0, fusedOps],
+                  [fixedPt(layer.bias),
+                   [num2format(w) for w in packWeightList(layer.weight, packWeights)] if packLayer else
+                   blob if compressWeights else fixedPt(layer.weight)]
+                  + fusedData + [None]*(FUSE_MAX_TENSORS-len(fusedData))))
             elif isinstance(layer, myLSTM):
                dbgPrint("LSTM")
                write2file("// LSTM Layer")
@@ -333,6 +463,9 @@ class netModel():
 
                netDef_c += "{{.type=LSTM, .attributes={{{},{},{},{},{}}}, ".format(inFeaturesSize, hiddenFeaturesSize, 0,0,0)
                netDef_c += ".parameters={{{}[0],{}[0],{},{},{},{}}}}}".format(prefix+"weight_ih_l"+str(layer_id),prefix+"weight_hh_l"+str(layer_id),prefix+"bias_ih_l"+str(layer_id),prefix+"bias_hh_l"+str(layer_id), prefix+"h", prefix+"c")
+               containerLayers.append(("LSTM", [inFeaturesSize, hiddenFeaturesSize, 0, 0, 0],
+                  [fixedPt(layer.weight_ih_l0), fixedPt(layer.weight_hh_l0), fixedPt(layer.bias_ih_l0),
+                   fixedPt(layer.bias_hh_l0), fixedPt(layer.hx[0]), fixedPt(layer.hx[1])]))
             elif isinstance(layer, nn.Conv2d):
               write2file("// Conv2D Layer")
               # layer.weight.data.fill_(2**-5)
@@ -369,6 +502,21 @@ class netModel():
               print(outputFM)
               netDef_c += "{{.type=Conv2d, .attributes={{{},{},{},{},{}}}, ".format(inFeaturesSize, outFeaturesSize, kernelSize, _h_im, _w_im)
               netDef_c += ".parameters={{{},{},{},{},{},{}}}}}".format(prefix+"weight",prefix+"bias",0,0,0,0)
+              containerLayers.append(("Conv2d", [inFeaturesSize, outFeaturesSize, kernelSize, _h_im, _w_im],
+                 [fixedPt(layer.weight.permute(0,2,3,1)), fixedPt(layer.bias)] + [None]*4))
+            elif isinstance(layer, (nn.Softmax, myArgmax, myTopK)):
+              write2file("// Output Head")
+              inFeaturesSize = inputFM.numel()
+              if isinstance(layer, nn.Softmax):
+                outputFM = torch.softmax(inputFM.reshape(-1), 0)
+                headType, k = "SOFTMAX", 0
+              else:
+                # indices are stored as plain integers, i.e. scaled such that num2format does not shift them
+                outputFM = layer.forward(inputFM).float().div(2**12)
+                headType, k = ("ARGMAX", 1) if isinstance(layer, myArgmax) else ("TOPK", layer.k)
+              netDef_c += "{{.type={}, .attributes={{{},{},{},{},{}}}, ".format(headType, inFeaturesSize, k, 0,0,0)
+              netDef_c += ".parameters={{{},{},{},{},{},{}}}}}".format(0,0,0,0,0,0)
+              containerLayers.append((headType, [inFeaturesSize, k, 0, 0, 0], [None]*6))
             else:
                error("not implemented")
             inputFM = outputFM.clone()
@@ -378,6 +526,10 @@ class netModel():
          netDef_c += "};"
          write2file(netDef_c)   
          write2file("#endif")
+         if containerDir:
+            os.makedirs(containerDir, exist_ok=True)
+            writeContainer(os.path.join(containerDir, "model{}.bin".format(modelID)), containerLayers,
+                           containerIn, fixedPt(outputFM), packWeights, compressed=bool(compressWeights))
          modelID += 1
       data_f.close()
 #end class netModel
@@ -662,7 +814,9 @@ info("Model 11 created.")
 
 
 # for model in models:
-netModel.exportModel(models)
+# packWeights=OUTPUTBUFFER exports the FC weights for WEIGHT_PACKING (config.h),
+# containerDir additionally writes binary model containers (MODEL_CONTAINER, benchHost -l)
+netModel.exportModel(models, packWeights=0, containerDir="containers")
 # net_test=netModel(nn.Sequential(nn.Linear(8, 8, True),))
 # net_test.model[0].bias.data.fill_(0)
 # net_test.model[0].weight.data[0][0].fill_(0)
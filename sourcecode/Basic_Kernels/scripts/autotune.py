@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Offline tuning of the output FM tiles of the FC layers (AUTOTUNE).
+#
+# With AUTOTUNE, inferNetwork measures every tile option of LinearLayer at the first inference of a
+# layer shape and tuneDump() prints the resulting table as "TUNE {in, out, cores, batch, maxTile},".
+# This script runs every model in config_profiling.h with AUTOTUNE, merges the tables and writes
+# tuning.h, which pre-fills the tuning table of the next builds (no tuning at first load anymore).
+# Entries of an existing tuning.h are kept unless the same shape is tuned again.
+#
+# Usage:
+#   python3 scripts/autotune.py                     # build and run all models
+#   python3 scripts/autotune.py MODEL2 MODEL5       # build and run the given models
+#   python3 scripts/autotune.py --parse log [log]   # only convert existing logs
+
+import re
+import sys
+import subprocess
+
+models = ["MODEL0", "MODEL1", "MODEL2", "MODEL3", "MODEL5", "MODEL6",
+          "MODEL7", "MODEL8", "MODEL9", "MODEL10", "MODEL11"]
+
+config_file = "config_profiling.h"
+tuning_file = "tuning.h"
+entry_re    = re.compile(r"\{\s*(\d+),\s*(\d+),\s*(\d+),\s*(\d+),\s*(\d+)\s*\},")
+
+
+def select_model(model):
+   """Enables exactly one model and the autotuner in config_profiling.h"""
+   lines = []
+   for line in open(config_file):
+      m = re.match(r"^\s*(//)?\s*#define\s+(MODEL\d+)\s*$", line)
+      if m:
+         line = ("" if m.group(2) == model else "// ") + "#define " + m.group(2) + "\n"
+      elif re.match(r"^\s*(//)?\s*#define\s+AUTOTUNE\s*$", line):
+         continue
+      lines.append(line)
+   lines.append("#define AUTOTUNE\n")
+   open(config_file, 'w').write("".join(lines))
+
+
+def parse(log, table):
+   """Adds the TUNE lines of one run to table (key: in, out, cores, batch)"""
+   found = 0
+   for line in log:
+      if not line.startswith("TUNE "):
+         continue
+      m = entry_re.search(line)
+      if m:
+         values = [int(v) for v in m.groups()]
+         table[tuple(values[:4])] = values[4]
+         found += 1
+   return found
+
+
+def read_table():
+   table = {}
+   try:
+      for line in open(tuning_file):
+         m = entry_re.search(line)
+         if m:
+            values = [int(v) for v in m.groups()]
+            table[tuple(values[:4])] = values[4]
+   except FileNotFoundError:
+      pass
+   return table
+
+
+def write_table(table):
+   with open(tuning_file, 'w') as f:
+      f.write("// generated by scripts/autotune.py, one entry per FC layer shape (see struct tuning_entry)\n")
+      f.write("// {in, out, cores, batch, maxTile},\n")
+      for key in sorted(table):
+         f.write("{%d, %d, %d, %d, %d},\n" % (key + (table[key],)))
+   print("wrote %d entries to %s" % (len(table), tuning_file))
+
+
+if __name__ == "__main__":
+   table = read_table()
+
+   if len(sys.argv) > 2 and sys.argv[1] == "--parse":
+      for log in sys.argv[2:]:
+         parse(open(log), table)
+   else:
+      config_backup = open(config_file).read()
+      try:
+         for model in (sys.argv[1:] or models):
+            select_model(model)
+            run = subprocess.run("make clean all run", shell=True, stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT, universal_newlines=True)
+            open("log", 'w').write(run.stdout)
+            if not parse(run.stdout.splitlines(), table):
+               print("\033[91mERROR - no tuning results found for %s (see ./log)\033[0m" % model)
+      finally:
+         open(config_file, 'w').write(config_backup)
+
+   write_table(table)
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Host-side TCDM bank-conflict simulator for the multicore FC Layer (LinearLayer, FMINTILING).
+#
+# The L1 of the cluster has NR_CORES*banking_factor word-interleaved banks with one port each.
+# Every core issues one load per cycle, if several cores access the same bank the arbiter grants
+# one of them (round robin) and the others stall. The access streams of LinearLayer are modelled
+# per core: for every input word the input FM and one weight word of each of the OUTPUTBUFFER rows
+# of the current output tile (optionally followed by the tanh/sigm LUT lookups of the tile).
+#
+# Two layouts are compared:
+#   shared : one input FM and one LUT for all cores, weight rows of W_OFFSET=0
+#   placed : per-core input and LUT replicas (BANK_PLACEMENT) and the W_OFFSET row padding which
+#            minimizes the stalls (the recommendation for config_profiling.h)
+#
+# Usage:
+#   python3 scripts/bank_sim.py                       # 256x256 layer, 1..16 cores
+#   python3 scripts/bank_sim.py --in 100 --out 64 --cores 4 8 --lut
+#   python3 scripts/bank_sim.py --banking-factor 4
+
+import os
+import json
+import argparse
+
+vp_config = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                         "../../../vp/src/pulp_with_extended_memory.json")
+
+REPLICA_SIZE = 512 # BANK_REPLICA_SIZE (elements)
+LUT_WORDS    = 48  # words of the tanh/sigm LUTs (struct bank_lut_replica without padding)
+
+
+def banking_factor_from_vp(default=2):
+   """Reads the banking factor of the L1 from the virtual platform configuration"""
+   try:
+      return int(json.load(open(vp_config))["cluster"]["l1"]["banking_factor"])
+   except (OSError, KeyError, ValueError):
+      return default
+
+
+def core_streams(inSize, outSize, cores, tile, bf, wOffset, placed, lut, window):
+   """Word addresses accessed by every core (at most window accesses per core)"""
+   nbBanks   = cores*bf
+   inWords   = (inSize+1)//2
+   rowStride = (inSize+wOffset)//2
+   chunk     = (outSize+cores-1)//cores
+
+   # shared buffers are placed back to back as in the linker script (.heapsram)
+   inBase  = 0
+   lutBase = inBase + inWords
+   wBase   = lutBase + LUT_WORDS
+   replicaStride = (REPLICA_SIZE+2*bf)//2
+   lutStride     = LUT_WORDS+bf
+
+   streams = []
+   for c in range(cores):
+      if placed and inSize <= REPLICA_SIZE:
+         coreIn = wBase + rowStride*outSize + c*replicaStride
+      else:
+         coreIn = inBase
+      coreLut = wBase + rowStride*outSize + cores*replicaStride + c*lutStride if placed else lutBase
+
+      stream = []
+      start = c*chunk
+      end   = min(start+chunk, outSize)
+      for t in range(start, end, tile):
+         rows = range(t, min(t+tile, end))
+         for i in range(inWords):
+            stream.append(coreIn+i)
+            for o in rows:
+               stream.append(wBase + o*rowStride + i)
+         if lut:
+            for o in rows:
+               # the LUT index depends on the data, a simple hash gives a spread over the 16 entries
+               stream.append(coreLut + (o*7+3) % 16)
+         if len(stream) >= window:
+            break
+      streams.append(stream[:window])
+   return streams, nbBanks
+
+
+def simulate(streams, nbBanks):
+   """Cycle-level simulation with one port per bank and round robin arbitration
+
+   Returns (cycles, stall cycles summed over all cores)"""
+   pos     = [0]*len(streams)
+   rrPtr   = [0]*nbBanks
+   cycles  = 0
+   stalls  = 0
+   while any(pos[c] < len(s) for c, s in enumerate(streams)):
+      requests = {}
+      for c, s in enumerate(streams):
+         if pos[c] < len(s):
+            requests.setdefault(s[pos[c]] % nbBanks, []).append(c)
+      for bank, cores in requests.items():
+         winner = min(cores, key=lambda c: (c-rrPtr[bank]) % len(streams))
+         rrPtr[bank] = (winner+1) % len(streams)
+         pos[winner] += 1
+         stalls += len(cores)-1
+      cycles += 1
+   return cycles, stalls
+
+
+def best_w_offset(args, cores, bf):
+   """W_OFFSET (even, the row shift repeats after nbBanks words) with the fewest cycles of the placed layout"""
+   best = None
+   for wOffset in range(0, 2*cores*bf, 2):
+      streams, nbBanks = core_streams(args.inSize, args.outSize, cores, args.tile, bf, wOffset,
+                                      True, args.lut, args.window)
+      cycles, stalls = simulate(streams, nbBanks)
+      if best is None or cycles < best[1]:
+         best = (wOffset, cycles, stalls)
+   return best
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="TCDM bank-conflict simulator for LinearLayer")
+   parser.add_argument("--in", dest="inSize", type=int, default=256, help="input neurons")
+   parser.add_argument("--out", dest="outSize", type=int, default=256, help="output neurons")
+   parser.add_argument("--cores", type=int, nargs="+", default=list(range(1, 17)), help="number of cores")
+   parser.add_argument("--tile", type=int, default=8, help="OUTPUTBUFFER")
+   parser.add_argument("--banking-factor", type=int, default=None, help="banks per core (default: vp config)")
+   parser.add_argument("--lut", action="store_true", help="add the tanh/sigm LUT lookups of a fused activation")
+   parser.add_argument("--window", type=int, default=2048, help="simulated accesses per core")
+   args = parser.parse_args()
+
+   bf = args.banking_factor or banking_factor_from_vp()
+   print("FC Layer %dx%d, OUTPUTBUFFER %d, banking factor %d%s" %
+         (args.inSize, args.outSize, args.tile, bf, ", LUT lookups" if args.lut else ""))
+   print("%5s %6s %10s %10s %10s %10s %8s %9s" %
+         ("cores", "banks", "shared cyc", "stalls", "placed cyc", "stalls", "speedup", "W_OFFSET"))
+   for cores in args.cores:
+      streams, nbBanks = core_streams(args.inSize, args.outSize, cores, args.tile, bf, 0,
+                                      False, args.lut, args.window)
+      sharedCycles, sharedStalls = simulate(streams, nbBanks)
+      wOffset, placedCycles, placedStalls = best_w_offset(args, cores, bf)
+      print("%5d %6d %10d %10d %10d %10d %7.2fx %9d" %
+            (cores, nbBanks, sharedCycles, sharedStalls, placedCycles, placedStalls,
+             sharedCycles/placedCycles, wOffset))
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Load imbalance and barrier waits of the cores per layer and per layer shape (BARRIER_PROFILE).
+#
+# The device (or benchHost) prints one "BARPROF,..." line per barrier of a layer and core (see
+# barrierProfileDump() in basicKernel.c): the start of the segment (layer start or exit of the
+# previous barrier), the arrival at the barrier and the exit of the barrier. Per inference run and
+# layer, the computation of a core is the sum of its segments up to the barrier arrivals, the rest is
+# waiting for the slowest core. The imbalance ratio is the computation of the slowest core divided by
+# the mean computation of all cores (1.00: perfectly balanced, the cores wait
+# (1-1/imbalance) of the layer time). The timestamps are timer ticks on the device and ns on the host.
+#
+# Usage:
+#   python3 scripts/barrier_profile.py log                  # all runs of the log
+#   python3 scripts/barrier_profile.py log --skip 3         # without the 3 warm-up runs
+#   make clean all run | python3 scripts/barrier_profile.py -
+
+import sys
+import argparse
+
+MASK = 0xFFFFFFFF # the timestamps are 32 bit
+
+
+def parse(lines):
+   """Records of the log: (core, run, layer, type, in, out, segment, compute, wait)"""
+   records = []
+   for line in lines:
+      idx = line.find("BARPROF,")
+      if idx < 0:
+         continue
+      fields = line[idx:].strip().split(",")
+      if len(fields) != 11 or fields[1] == "core":
+         continue
+      core, run, layer = int(fields[1]), int(fields[2]), int(fields[3])
+      entry, arrive, exit = int(fields[8]), int(fields[9]), int(fields[10])
+      records.append((core, run, layer, fields[4], int(fields[5]), int(fields[6]), int(fields[7]),
+                      (arrive-entry) & MASK, (exit-arrive) & MASK))
+   return records
+
+
+def layer_runs(records, skip):
+   """Per (run, layer): shape and the computation and waits of every core"""
+   runs = {}
+   for core, run, layer, typ, inSize, outSize, segment, compute, wait in records:
+      if run <= skip:
+         continue
+      entry = runs.setdefault((run, layer), {"shape": (typ, inSize, outSize), "compute": {}, "wait": {},
+                                             "segments": 0})
+      entry["compute"][core] = entry["compute"].get(core, 0) + compute
+      entry["wait"][core] = entry["wait"].get(core, 0) + wait
+      entry["segments"] = max(entry["segments"], segment+1)
+   return runs
+
+
+def imbalance(entry):
+   compute = list(entry["compute"].values())
+   mean = sum(compute)/len(compute)
+   total = sum(compute) + sum(entry["wait"].values())
+   slowest = max(entry["compute"], key=entry["compute"].get)
+   return max(compute)/mean if mean else 1.0, sum(entry["wait"].values())/total if total else 0.0, slowest
+
+
+def report(records, skip):
+   runs = layer_runs(records, skip)
+   if not runs:
+      print("\033[91mERROR - no BARPROF records (build with BARRIER_PROFILE)!!!\033[0m")
+      return 1
+   cores = sorted(set(r[0] for r in records))
+   print("%d records of %d cores, %d layer runs" % (len(records), len(cores), len(runs)))
+
+   print("\nper layer (mean over the runs)")
+   print("{:>6}{:>9}{:>7}{:>7}{:>6}{:>12}{:>12}{:>11}{:>8}{:>9}".format("layer", "type", "in", "out", "bars",
+         "compute", "max", "imbalance", "wait%", "slowest"))
+   layers = sorted(set(l for _, l in runs))
+   for layer in layers:
+      entries = [e for (r, l), e in runs.items() if l == layer]
+      typ, inSize, outSize = entries[0]["shape"]
+      stats = [imbalance(e) for e in entries]
+      meanCompute = sum(sum(e["compute"].values())/len(e["compute"]) for e in entries)/len(entries)
+      maxCompute = sum(max(e["compute"].values()) for e in entries)/len(entries)
+      slowest = max(set(s[2] for s in stats), key=[s[2] for s in stats].count)
+      print("{:>6}{:>9}{:>7}{:>7}{:>6}{:>12.0f}{:>12.0f}{:>11.2f}{:>8.1f}{:>9}".format(layer, typ, inSize, outSize,
+            entries[0]["segments"], meanCompute, maxCompute, sum(s[0] for s in stats)/len(stats),
+            100*sum(s[1] for s in stats)/len(stats), "core%d" % slowest))
+
+   print("\nper shape (all layers and runs)")
+   print("{:>9}{:>7}{:>7}{:>8}{:>11}{:>12}{:>8}".format("type", "in", "out", "layers", "imbalance", "wait", "wait%"))
+   shapes = {}
+   for e in runs.values():
+      shapes.setdefault(e["shape"], []).append(e)
+   for shape in sorted(shapes, key=lambda s: -sum(sum(e["wait"].values()) for e in shapes[s])):
+      entries = shapes[shape]
+      stats = [imbalance(e) for e in entries]
+      print("{:>9}{:>7}{:>7}{:>8}{:>11.2f}{:>12}{:>8.1f}".format(shape[0], shape[1], shape[2], len(entries),
+            sum(s[0] for s in stats)/len(stats), sum(sum(e["wait"].values()) for e in entries),
+            100*sum(s[1] for s in stats)/len(stats)))
+
+   print("\nper core (all layers and runs)")
+   print("{:>6}{:>12}{:>12}{:>8}".format("core", "compute", "wait", "wait%"))
+   for core in cores:
+      compute = sum(e["compute"].get(core, 0) for e in runs.values())
+      wait = sum(e["wait"].get(core, 0) for e in runs.values())
+      print("{:>6}{:>12}{:>12}{:>8.1f}".format(core, compute, wait, 100*wait/(compute+wait) if compute+wait else 0))
+   return 0
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Load imbalance and barrier waits per layer and shape")
+   parser.add_argument("log", help="output of a BARRIER_PROFILE build (- for stdin)")
+   parser.add_argument("--skip", type=int, default=0, help="ignore the first runs (warm-up)")
+   args = parser.parse_args()
+
+   log = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+   sys.exit(report(parse(log), args.skip))
@@ -161,13 +161,13 @@ cyclesPerFunc = {}
 
 memList = {}
 topLevel_only = True
-topLevelFuncList = ["inferNetwork", "LinearLayer", "Conv2dLayer", "LSTMLayer", "TwoLinearLayersAccumulate", "SigLayer", "TanhLayer", "HadMulTensor", "AddTensor", "CopyTensor" ];
+topLevelFuncList = ["inferNetwork", "LinearLayer", "Conv2dLayer", "RNNLayer", "LSTMLayer", "SoftmaxLayer", "ArgmaxLayer", "TopKLayer", "TwoLinearLayersAccumulate", "SigLayer", "TanhLayer", "HadMulTensor", "AddTensor", "CopyTensor" ];
 #"main", "run_networks", 
 countForTopLevelFunc = {}
 # dict in which functions it also should be counter (TODO: Please be aware, that this does not work if the same function is executed by several functions.)
 # countForTopLevelFunc["inferNetwork"] = ["run_networks"]
 # countForTopLevelFunc["run_networks"] = ["run_networks"]
-secondStage = ["Conv2dLayer","LinearLayer", "LSTMLayer"];
+secondStage = ["Conv2dLayer","LinearLayer", "RNNLayer", "LSTMLayer", "SoftmaxLayer", "ArgmaxLayer", "TopKLayer"];
 secondStageTop = ["inferNetwork"]#, "run_networks","main"]
 for i in range(0, len(secondStage)):
   countForTopLevelFunc[secondStage[i]] = secondStageTop
@@ -190,6 +190,7 @@ for core in cores:
    instrCntEnd = 0  #todo fix this impl.
    instrPerFunc = {}
    cyclesPerFunc = {}
+   callsPerFunc = {} # kernel calls of inferNetwork (layers, used by wcet.py)
 
    memList = {}
 
@@ -304,6 +305,8 @@ for core in cores:
                   curr_func =line_split[ID_FUNC][:tmp]
                   if topLevel_only:
                       if curr_func in topLevelFuncList:
+                          if curr_func in secondStage and currTopLevelFunc == "inferNetwork":
+                              dict_acc(callsPerFunc, curr_func, 1)
                           currTopLevelFunc = curr_func
                   else:
                     currTopLevelFunc = curr_func #for all functions
@@ -433,6 +436,8 @@ for core in cores:
    pickle_dump["topLevelFuncList"] = topLevelFuncList;
    pickle_dump["cyclesPerFunc"] = cyclesPerFunc;
    pickle_dump["instrPerFunc"] = instrPerFunc;
+   pickle_dump["callsPerFunc"] = callsPerFunc;
+   pickle_dump["cycles"] = instrCntEnd-instrCntStart-1;
 
    # json.dump(json_dump, open(log_file_name+".json", "w+"))
 
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Overlap of the next-layer DMA prefetches of inferNetwork with the computation (DMA_PROFILE).
+#
+# The device prints the compute window of every layer ("DMAPROF,window,...": layer start, end of the
+# computation of all cores, completion of all prefetches) and every prefetch ("DMAPROF,xfer,...": issue
+# and observed completion), see dmaProfileDump() in basicKernel.c. The prefetches of layer i+1 run during
+# the computation of layer i, the exposed latency is the time the cores wait for them after the
+# computation. Prefetches which completed during the computation are only observed at the compute end,
+# their bandwidth is a lower bound (marked with ">"). A layer is bandwidth-bound if the exposed latency
+# exceeds --threshold percent of its computation, i.e. compression or deeper prefetching pays off there.
+#
+# Usage:
+#   python3 scripts/dma_profile.py log                  # all runs of the log
+#   python3 scripts/dma_profile.py log --skip 3         # without the 3 warm-up runs
+#   make clean all run | python3 scripts/dma_profile.py -
+
+import sys
+import argparse
+
+MASK = 0xFFFFFFFF # the timestamps are 32 bit
+
+
+def parse(lines):
+   """Windows (run, layer, type, next, xfers, bytes, compute, exposed) and transfers {(run, layer): [(size, issue, done)]}"""
+   windows, xfers = [], {}
+   for line in lines:
+      idx = line.find("DMAPROF,")
+      if idx < 0:
+         continue
+      fields = line[idx:].strip().split(",")
+      if len(fields) == 11 and fields[1] == "window" and fields[2] != "run":
+         run, layer, nrXfers, size = int(fields[2]), int(fields[3]), int(fields[6]), int(fields[7])
+         start, computeEnd, waitEnd = int(fields[8]), int(fields[9]), int(fields[10])
+         windows.append((run, layer, fields[4], fields[5], nrXfers, size, (computeEnd-start) & MASK,
+                         (waitEnd-computeEnd) & MASK))
+      elif len(fields) == 8 and fields[1] == "xfer" and fields[2] != "run":
+         xfers.setdefault((int(fields[2]), int(fields[3])), []).append((int(fields[5]), int(fields[6]), int(fields[7])))
+   return windows, xfers
+
+
+def bandwidth(transfers):
+   """Bytes per tick from the first issue to the last completion"""
+   if not transfers:
+      return None
+   first = min(t[1] for t in transfers)
+   span  = max((t[2]-first) & MASK for t in transfers)
+   return sum(t[0] for t in transfers)/span if span else None
+
+
+def report(windows, xfers, skip, threshold):
+   windows = [w for w in windows if w[0] > skip]
+   if not windows:
+      print("\033[91mERROR - no DMAPROF records (build with DMA_PROFILE and DMA)!!!\033[0m")
+      return 1
+   runs = sorted(set(w[0] for w in windows))
+   print("%d layer windows of %d runs, %d prefetches" % (len(windows), len(runs),
+         sum(len(t) for (r, _), t in xfers.items() if r > skip)))
+
+   print("\nper layer (mean over the runs, prefetches of the next layer)")
+   print("{:>6}{:>9}{:>9}{:>7}{:>10}{:>12}{:>10}{:>9}{:>14}  {}".format("layer", "type", "next", "xfers", "bytes",
+         "compute", "exposed", "exp%", "bytes/tick", ""))
+   totalCompute = totalExposed = 0
+   bound = []
+   for layer in sorted(set(w[1] for w in windows)):
+      entries = [w for w in windows if w[1] == layer]
+      compute = sum(w[6] for w in entries)/len(entries)
+      exposed = sum(w[7] for w in entries)/len(entries)
+      totalCompute += sum(w[6] for w in entries)
+      # without prefetches, the wait is the overhead of the measurement
+      totalExposed += sum(w[7] for w in entries if w[4])
+      bws = [b for b in (bandwidth(xfers.get((w[0], w[1]), [])) for w in entries) if b is not None]
+      exposedShare = 100*exposed/compute if compute else 0
+      bw, flag = "-", ""
+      if bws:
+         # hidden prefetches are only observed at the compute end
+         bw = "%s%.2f" % (">" if exposedShare <= threshold else "", sum(bws)/len(bws))
+      if entries[0][4] and exposedShare > threshold:
+         flag = "bandwidth-bound"
+         bound.append(layer)
+      print("{:>6}{:>9}{:>9}{:>7}{:>10}{:>12.0f}{:>10.0f}{:>9.1f}{:>14}  {}".format(layer, entries[0][2],
+            entries[0][3] if entries[0][4] else "-", entries[0][4], entries[0][5], compute, exposed,
+            exposedShare, bw, flag))
+
+   share = 100*totalExposed/(totalCompute+totalExposed) if totalCompute+totalExposed else 0
+   print("\nexposed DMA latency: %d of %d ticks (%.1f%%)" % (totalExposed, totalCompute+totalExposed, share))
+   if bound:
+      print("bandwidth-bound layers (exposed > %g%% of the computation): %s" % (threshold, ", ".join(map(str, bound))))
+   else:
+      print("the prefetches are hidden behind the computation (exposed <= %g%% in every layer)" % threshold)
+   return 0
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Exposed DMA latency and bandwidth of the inferNetwork prefetches")
+   parser.add_argument("log", help="output of a DMA_PROFILE build (- for stdin)")
+   parser.add_argument("--skip", type=int, default=0, help="ignore the first runs (warm-up)")
+   parser.add_argument("--threshold", type=float, default=5.0, help="exposed latency in percent of the computation "
+                       "above which a layer is bandwidth-bound")
+   args = parser.parse_args()
+
+   log = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+   windows, xfers = parse(log)
+   sys.exit(report(windows, xfers, args.skip, args.threshold))
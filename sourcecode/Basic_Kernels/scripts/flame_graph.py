@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Call stacks and per-function cycles of an instruction trace of the virtual platform.
+#
+# The PCs of the trace are resolved against the function symbols of the ELF, the call stack of every
+# core is rebuilt from its calls (jal/jalr linking to ra) and returns (ret, jr ra), and tail calls or
+# missed frames are resynchronized with the symbol of the next PC. Every instruction takes the cycles
+# up to the next instruction of its core. If the function column of the trace (debug info of the PC)
+# names another function than the symbol, the code is an inlined helper and gets an extra "_[i]" frame,
+# the cycles of p.elw (core clock-gated until an event, i.e. barriers and DMA waits) get a "[sleep]" frame.
+#
+# Per core, the stacks are written in the folded format (<out><core>.folded, one "f0;f1;f2 cycles" line
+# per stack) for flamegraph.pl, difffolded.pl or speedscope, and the inclusive and exclusive cycles of
+# the selected functions (shell patterns) are printed.
+#
+# Usage:
+#   python3 scripts/flame_graph.py trace.log --elf build/test/test
+#   python3 scripts/flame_graph.py trace.log --elf build/test/test --start 1c008080 --stop 1c0080c0
+#   python3 scripts/flame_graph.py trace.log --funcs "LinearLayer" "sig*" --out reports/run1_
+#   flamegraph.pl trace.logpe0.folded > pe0.svg
+
+import re
+import sys
+import bisect
+import struct
+import fnmatch
+import argparse
+
+# inferNetwork kernels, activations, DMA waits and barriers
+default_funcs = ["inferNetwork", "LinearLayer", "LSTMLayer", "sig*", "Tanh*", "plp_dma_wait*", "synch_barrier*",
+                 "[sleep]"]
+
+core_re = re.compile(r"(pe\d+|fc)/")
+
+
+class Symbols():
+   """Function (or data object) symbols of an ELF file (32 or 64 bit, any endianness)"""
+   def __init__(self, elf, kind=2):
+      data = open(elf, 'rb').read()
+      if data[:4] != b'\x7fELF':
+         raise ValueError("%s is no ELF file" % elf)
+      wide = data[4] == 2
+      end  = '<' if data[5] == 1 else '>'
+      if wide:
+         shoff, = struct.unpack_from(end+'Q', data, 40)
+         shentsize, shnum = struct.unpack_from(end+'HH', data, 58)
+         shdr, sym = end+'IIQQQQIIQQ', end+'IBBHQQ'
+      else:
+         shoff, = struct.unpack_from(end+'I', data, 32)
+         shentsize, shnum = struct.unpack_from(end+'HH', data, 46)
+         shdr, sym = end+'IIIIIIIIII', end+'IIIBBH'
+      sections = [struct.unpack_from(shdr, data, shoff+i*shentsize) for i in range(shnum)]
+      funcs = {}
+      for s in sections:
+         if s[1] != 2: # SHT_SYMTAB
+            continue
+         strtab = sections[s[6]]
+         for off in range(s[4], s[4]+s[5], struct.calcsize(sym)):
+            fields = struct.unpack_from(sym, data, off)
+            name, info, value, size = (fields[0], fields[1], fields[4], fields[5]) if wide else \
+                                      (fields[0], fields[3], fields[1], fields[2])
+            if info & 0xf != kind or value == 0: # STT_FUNC or STT_OBJECT
+               continue
+            strOff = strtab[4]+name
+            funcs[value] = (data[strOff:data.index(b'\0', strOff)].decode(), size)
+      self.starts = sorted(funcs)
+      self.funcs  = [funcs[a] for a in self.starts]
+
+   def lookup(self, pc):
+      i = bisect.bisect_right(self.starts, pc)-1
+      if i < 0:
+         return None
+      name, size = self.funcs[i]
+      return name if size == 0 or pc < self.starts[i]+size else None
+
+   def lookup_offset(self, addr):
+      """Symbol and offset of an address"""
+      i = bisect.bisect_right(self.starts, addr)-1
+      if i < 0 or (self.funcs[i][1] and addr >= self.starts[i]+self.funcs[i][1]):
+         return None, 0
+      return self.funcs[i][0], addr-self.starts[i]
+
+
+class CoreStack():
+   """Call stack and folded stacks of one core"""
+   def __init__(self):
+      self.stack   = []
+      self.folded  = {}
+      self.pending = None # (frames, cycle, call/ret) of the last instruction
+      self.active  = False
+      self.done    = False
+      self.first   = None
+      self.last    = None
+
+   def resync(self, func):
+      """Makes func the top of the stack (returns over several frames, tail calls)"""
+      if not self.stack:
+         self.stack.append(func)
+      elif self.stack[-1] != func:
+         if func in self.stack:
+            while self.stack[-1] != func:
+               self.stack.pop()
+         else:
+            self.stack[-1] = func
+
+   def instruction(self, cycle, func, inline, mnemonic, operands):
+      if self.pending:
+         frames, start, action = self.pending
+         self.folded[frames] = self.folded.get(frames, 0) + cycle-start
+         if action == "call":
+            self.stack.append(func)
+         elif action == "ret" and self.stack:
+            self.stack.pop()
+      self.resync(func)
+
+      frames = list(self.stack)
+      if inline and inline != func:
+         frames.append(inline + "_[i]")
+      if mnemonic == "p.elw":
+         frames.append("[sleep]")
+      self.pending = (";".join(frames), cycle, branch_kind(mnemonic, operands))
+      self.last = cycle
+
+   def flush(self, cycle):
+      """Attributes the last instruction up to the cycle (stop address or end of trace)"""
+      if self.pending:
+         frames, start, _ = self.pending
+         self.folded[frames] = self.folded.get(frames, 0) + max(1, cycle-start)
+         self.pending = None
+
+
+def branch_kind(mnemonic, operands):
+   """'call' if the instruction links to ra, 'ret' if it jumps to ra"""
+   ops = [o.strip(",") for o in operands]
+   if mnemonic in ("c.jal", "c.jalr"):
+      return "call"
+   if mnemonic in ("jal", "jalr"):
+      if len(ops) > 1 and ops[0] in ("x0", "zero") and "ra" in ops[1]:
+         return "ret"
+      if not ops or ops[0] in ("ra", "x1") or (mnemonic == "jal" and len(ops) == 1):
+         return "call"
+   if mnemonic == "ret" or (mnemonic in ("c.jr", "jr") and ops and ops[0] in ("ra", "x1")):
+      return "ret"
+   return None
+
+
+def analyze(trace, symbols, start, stop, inline):
+   cores = {}
+   for line in open(trace, errors="replace"):
+      split = line.split()
+      if len(split) < 8 or "insn" not in split[2]:
+         continue
+      m = core_re.search(split[2])
+      if m is None:
+         continue
+      core = cores.setdefault(m.group(1), CoreStack())
+      if core.done:
+         continue
+      try:
+         cycle = int(split[1].rstrip(":"))
+         pc    = int(split[6], 16)
+      except ValueError:
+         continue
+      if not core.active:
+         if start and split[6] != start:
+            continue
+         core.active, core.first = True, cycle
+      elif stop and split[6] == stop:
+         core.flush(cycle)
+         core.done, core.last = True, cycle
+         continue
+      traceFunc = split[4].split(":")[0]
+      func = (symbols.lookup(pc) if symbols else None) or traceFunc or hex(pc)
+      core.instruction(cycle, func, traceFunc if symbols and inline else None, split[7], split[8:10])
+   for core in cores.values():
+      core.flush(core.last+1 if core.last is not None else 0)
+   return cores
+
+
+def matches(name, pattern):
+   return name == pattern or fnmatch.fnmatchcase(name, pattern)
+
+
+def function_cycles(folded, pattern):
+   """Inclusive and exclusive cycles of the frames matching the pattern (inlined frames included)"""
+   inclusive = exclusive = 0
+   for frames, cycles in folded.items():
+      names = [f[:-4] if f.endswith("_[i]") else f for f in frames.split(";")]
+      if any(matches(n, pattern) for n in names):
+         inclusive += cycles
+      # the sleep cycles are exclusive cycles of the waiting function as well
+      if matches(names[-1], pattern) or \
+         (names[-1] == "[sleep]" and len(names) > 1 and matches(names[-2], pattern)):
+         exclusive += cycles
+   return inclusive, exclusive
+
+
+def report(cores, funcs, out):
+   for name in sorted(cores, key=lambda c: (len(c), c)):
+      core = cores[name]
+      total = sum(core.folded.values())
+      if total == 0:
+         continue
+      with open(out + name + ".folded", 'w') as f:
+         for frames in sorted(core.folded):
+            f.write("%s %d\n" % (frames, core.folded[frames]))
+      print("%s: %d cycles (%d to %d), %d stacks in %s%s.folded" % (name, total, core.first, core.last,
+            len(core.folded), out, name))
+      print("{:>24}{:>12}{:>8}{:>12}{:>8}".format("function", "inclusive", "%", "exclusive", "%"))
+      for pattern in funcs:
+         inclusive, exclusive = function_cycles(core.folded, pattern)
+         print("{:>24.24}{:>12}{:>8.1f}{:>12}{:>8.1f}".format(pattern, inclusive, 100*inclusive/total, exclusive,
+               100*exclusive/total))
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Folded call stacks and function cycles of an instruction trace")
+   parser.add_argument("trace", help="instruction trace (gvsoc/trace=insn)")
+   parser.add_argument("--elf", help="binary of the trace (without: functions of the trace function column)")
+   parser.add_argument("--start", help="instruction address where the analysis starts (default: first instruction)")
+   parser.add_argument("--stop", help="instruction address where the analysis stops (default: end of the trace)")
+   parser.add_argument("--funcs", nargs="+", default=default_funcs, help="functions of the report (shell patterns)")
+   parser.add_argument("--no-inline", action="store_true", help="no frames for the inlined helpers")
+   parser.add_argument("--out", default=None, help="prefix of the folded files (default: trace)")
+   args = parser.parse_args()
+
+   try:
+      symbols = Symbols(args.elf) if args.elf else None
+   except (OSError, ValueError) as e:
+      print("\033[91mERROR - cannot read the symbols: %s!!!\033[0m" % e)
+      sys.exit(1)
+   cores = analyze(args.trace, symbols, args.start, args.stop, not args.no_inline)
+   report(cores, args.funcs, args.trace if args.out is None else args.out)
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Memory access heatmap and TCDM bank conflicts of a trace of the virtual platform.
+#
+# Every load and store of the trace (memory lines as parsed by create_statistic.py, or instruction lines
+# with the accessed address "PA:<addr>") is attributed to
+#   - its L1 bank (cores*banking_factor word-interleaved banks) or L2 region (priv0, priv1, shared bank),
+#   - the data symbol of the ELF it touches (linear_Weights, buffer, l1_lut_*, ...).
+# Accesses of different cores to the same L1 bank in the same cycle conflict: all but one access stall.
+#
+# The report contains the accesses and conflicts per L1 bank (heatmap), per L2 region and per symbol,
+# the conflicts per cycle window and the hottest addresses. With --json, the same data is written for
+# further processing (e.g. to choose W_OFFSET or the tables to replicate with BANK_PLACEMENT).
+#
+# Usage:
+#   python3 scripts/mem_heatmap.py trace.log --elf build/test/test
+#   python3 scripts/mem_heatmap.py trace.log --elf build/test/test --cores 16 --window 5000 --top 30
+#   python3 scripts/mem_heatmap.py trace.log --json reports/mem_heatmap.json
+
+import os
+import re
+import sys
+import json
+import argparse
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from bank_sim import vp_config, banking_factor_from_vp
+from flame_graph import Symbols
+
+core_re  = re.compile(r"(pe\d+|fc)/")
+store_re = re.compile(r"^(c\.|p\.)?s[bhw](sp|rr)?!?$")
+BAR      = 40 # characters of the largest bar
+
+
+def memory_map():
+   """L1 and L2 regions (name, base, size, banks, interleaving bits) of the virtual platform"""
+   l1 = ("L1", 0x10000000, 0x100000)
+   l2 = [("priv0", 0x1C000000, 0x8000, 1, 2), ("priv1", 0x1C008000, 0x8000, 1, 2),
+         ("shared", 0x1C010000, 0x170000, 4, 2)]
+   try:
+      config = json.load(open(vp_config))
+      c = config["cluster"]["l1"]
+      l1 = ("L1", int(c["base"], 16), int(c["size"], 16))
+      regions = config["soc"]["l2"]
+      l2 = [(n, int(r["base"], 16), int(r["size"], 16), int(r.get("nb_banks", 1)), int(r.get("interleaving_bits", 2)))
+            for n, r in regions.items() if isinstance(r, dict) and "alias" not in n]
+   except (OSError, KeyError, ValueError):
+      pass
+   return l1, l2
+
+
+def accesses(trace):
+   """(cycle, core, address, size, write) of every memory access of the trace"""
+   for line in open(trace, errors="replace"):
+      split = line.split()
+      if len(split) < 8:
+         continue
+      m = core_re.search(split[2])
+      core = m.group(1) if m else "?"
+      try:
+         cycle = int(split[1].rstrip(":"))
+         if "insn" in split[2]:
+            for token in split[8:]:
+               if token.startswith("PA:"):
+                  yield cycle, core, int(token[3:], 16), 4, bool(store_re.match(split[7]))
+         elif len(split) > 11 and "Memory" in split[4]:
+            yield cycle, core, int(split[7][:-1], 16), int(split[9][:-1], 16), int(split[11][:-1]) == 1
+      except ValueError:
+         continue
+
+
+class Counter():
+   def __init__(self):
+      self.reads = self.writes = self.conflicts = 0
+
+   def add(self, write):
+      if write:
+         self.writes += 1
+      else:
+         self.reads += 1
+
+   def total(self):
+      return self.reads + self.writes
+
+   def dict(self):
+      return {"reads": self.reads, "writes": self.writes, "conflicts": self.conflicts}
+
+
+def analyze(trace, symbols, nbBanks, window):
+   (_, l1Base, l1Size), l2 = memory_map()
+   banks   = [Counter() for _ in range(nbBanks)]
+   regions = {}
+   objects = {}
+   hot     = {}
+   windows = {}
+   cycle, sameCycle = None, {} # accesses of the current cycle: bank -> [(core, symbol)]
+
+   def close_cycle():
+      for bank, users in sameCycle.items():
+         # memory traces without core count every access as a separate request
+         cores = [u[0] for u in users]
+         stalls = len(users)-1 if "?" in cores or len(set(cores)) > 1 else 0
+         if stalls:
+            banks[bank].conflicts += stalls
+            windows.setdefault(cycle//window, [0, 0])[1] += stalls
+            for _, sym in users[1:]:
+               objects.setdefault(sym, Counter()).conflicts += 1
+
+   for c, core, addr, size, write in accesses(trace):
+      if c != cycle:
+         close_cycle()
+         cycle, sameCycle = c, {}
+      sym, offset = symbols.lookup_offset(addr) if symbols else (None, 0)
+      sym = sym or "?"
+      objects.setdefault(sym, Counter()).add(write)
+      entry = hot.setdefault(addr, [0, sym, offset, set()])
+      entry[0] += 1
+      entry[3].add(core)
+      windows.setdefault(c//window, [0, 0])[0] += 1
+      if l1Base <= addr < l1Base+l1Size:
+         bank = (addr >> 2) % nbBanks
+         banks[bank].add(write)
+         sameCycle.setdefault(bank, []).append((core, sym))
+      else:
+         name = "other"
+         for n, base, rSize, nb, bits in l2:
+            if base <= addr < base+rSize:
+               name = n if nb == 1 else "%s.bank%d" % (n, (addr >> bits) % nb)
+         regions.setdefault(name, Counter()).add(write)
+   close_cycle()
+   return banks, regions, objects, hot, windows
+
+
+def bar(value, maximum):
+   return "#"*(BAR*value//maximum if maximum else 0)
+
+
+def report(banks, regions, objects, hot, windows, window, top):
+   total = sum(b.total() for b in banks)
+   print("L1 banks: %d accesses, %d conflicts" % (total, sum(b.conflicts for b in banks)))
+   print("{:>6}{:>10}{:>10}{:>10}  {}".format("bank", "reads", "writes", "conflicts", "accesses"))
+   peak = max([b.total() for b in banks] + [0])
+   for i, b in enumerate(banks):
+      print("{:>6}{:>10}{:>10}{:>10}  {}".format(i, b.reads, b.writes, b.conflicts, bar(b.total(), peak)))
+   if banks and total:
+      # max/mean of the bank accesses, 1.0 is a perfectly balanced layout
+      print("imbalance (max/mean): %.2f" % (peak*len(banks)/total))
+
+   print("\nL2 regions and other memories")
+   print("{:>16}{:>10}{:>10}".format("region", "reads", "writes"))
+   for name in sorted(regions):
+      print("{:>16}{:>10}{:>10}".format(name, regions[name].reads, regions[name].writes))
+
+   print("\nsymbols")
+   print("{:>24}{:>10}{:>10}{:>10}".format("symbol", "reads", "writes", "conflicts"))
+   for name in sorted(objects, key=lambda n: objects[n].total(), reverse=True):
+      o = objects[name]
+      print("{:>24.24}{:>10}{:>10}{:>10}".format(name, o.reads, o.writes, o.conflicts))
+
+   print("\nconflicts per window of %d cycles" % window)
+   print("{:>12}{:>10}{:>10}  {}".format("cycle", "accesses", "conflicts", ""))
+   peak = max([w[1] for w in windows.values()] + [0])
+   for w in sorted(windows):
+      print("{:>12}{:>10}{:>10}  {}".format(w*window, windows[w][0], windows[w][1], bar(windows[w][1], peak)))
+
+   print("\nhot addresses")
+   print("{:>12}{:>10}  {:<32}{}".format("address", "accesses", "symbol", "cores"))
+   for addr in sorted(hot, key=lambda a: hot[a][0], reverse=True)[:top]:
+      count, sym, offset, cores = hot[addr]
+      print("{:>12}{:>10}  {:<32}{}".format("%08x" % addr, count, "%s+%d" % (sym, offset) if sym != "?" else sym,
+            ",".join(sorted(cores, key=lambda c: (len(c), c)))))
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Memory access heatmap and TCDM bank conflicts of a trace")
+   parser.add_argument("trace", help="trace with memory accesses")
+   parser.add_argument("--elf", help="binary of the trace (data symbols of the accesses)")
+   parser.add_argument("--cores", type=int, default=8, help="number of cores")
+   parser.add_argument("--banking-factor", type=int, default=None, help="banks per core (default: vp config)")
+   parser.add_argument("--window", type=int, default=1000, help="cycles per conflict window")
+   parser.add_argument("--top", type=int, default=20, help="number of hot addresses")
+   parser.add_argument("--json", help="write the results to a JSON file")
+   args = parser.parse_args()
+
+   try:
+      symbols = Symbols(args.elf, kind=1) if args.elf else None
+   except (OSError, ValueError) as e:
+      print("\033[91mERROR - cannot read the symbols: %s!!!\033[0m" % e)
+      sys.exit(1)
+   nbBanks = args.cores*(args.banking_factor or banking_factor_from_vp())
+   banks, regions, objects, hot, windows = analyze(args.trace, symbols, nbBanks, args.window)
+   report(banks, regions, objects, hot, windows, args.window, args.top)
+   if args.json:
+      json.dump({"banks": [b.dict() for b in banks], "regions": {n: r.dict() for n, r in regions.items()},
+                 "symbols": {n: o.dict() for n, o in objects.items()},
+                 "windows": {w*args.window: v for w, v in sorted(windows.items())},
+                 "hot": [{"address": a, "accesses": hot[a][0], "symbol": hot[a][1], "offset": hot[a][2],
+                          "cores": sorted(hot[a][3])} for a in sorted(hot, key=lambda a: hot[a][0], reverse=True)[:args.top]]},
+                open(args.json, 'w'), indent=1)
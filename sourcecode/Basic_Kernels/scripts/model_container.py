@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Binary model container (see struct model_container_header/layer in general.h).
+#
+# Layout (little endian):
+#   header (64 bytes) | layer table (depth x 80 bytes) | tensor blobs (int16, 64-byte aligned)
+# The blobs are the input FM, the expected output FM and the layer parameters in the order of
+# struct layer. loadModelContainer() builds the layer array without copying the parameters, the
+# host harness mmaps the file (benchHost -l), the target links it into L2 (MODEL_CONTAINER).
+#
+# Usage:
+#   python3 scripts/model_container.py model.bin        # prints header and layer table
+
+import sys
+import struct
+
+MAGIC     = b"RNNM"
+VERSION   = 1
+ALIGN     = 64
+PACKED    = 0x1
+COMPRESSED = 0x2
+Q_FORMAT  = (3, 12)
+
+HEADER_FMT = "<4sHBBIIIIIIIHH24x"
+LAYER_FMT  = "<I5i6I6IBBHI"
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+LAYER_SIZE  = struct.calcsize(LAYER_FMT)
+assert HEADER_SIZE == 64 and LAYER_SIZE == 80
+
+layerTypes = ["LINEAR", "RNN", "LSTM", "Conv2d", "SOFTMAX", "ARGMAX", "TOPK"]
+
+
+def _align(offset):
+   return (offset + ALIGN - 1) // ALIGN * ALIGN
+
+
+def writeContainer(fileName, layers, inFM, outFM, packTile=0, compressed=False):
+   """Writes one network
+
+   layers: list of (type name, [5 attributes], [6 parameters]) with every parameter either None,
+           a list of fixed-point integers or an encoded blob (bytes)
+   inFM, outFM: input and expected output FM as lists of fixed-point integers
+   packTile: OUTPUTBUFFER of packed FC weights (WEIGHT_PACKING), 0 for row-major weights
+   compressed: the FC weights are blobs of weight_compression.py (WEIGHT_COMPRESSION)"""
+   blobs = bytearray()
+   offset = _align(HEADER_SIZE + LAYER_SIZE*len(layers))
+
+   def addBlob(values):
+      nonlocal blobs
+      blobs += bytes(_align(offset + len(blobs)) - offset - len(blobs))
+      start = offset + len(blobs)
+      blobs += values if isinstance(values, bytes) else struct.pack("<%dh" % len(values), *values)
+      return start
+
+   inOffset  = addBlob(inFM)
+   outOffset = addBlob(outFM)
+   table = bytearray()
+   for typ, attributes, parameters in layers:
+      offsets = [addBlob(p) if p is not None else 0 for p in parameters]
+      # blobs count 16-bit elements as well
+      sizes   = [(len(p)+1)//2 if isinstance(p, bytes) else len(p) if p is not None else 0 for p in parameters]
+      table  += struct.pack(LAYER_FMT, layerTypes.index(typ), *attributes, *offsets, *sizes,
+                            Q_FORMAT[0], Q_FORMAT[1], 0, 0)
+   imageSize = _align(offset + len(blobs))
+   blobs += bytes(imageSize - offset - len(blobs))
+
+   header = struct.pack(HEADER_FMT, MAGIC, VERSION, Q_FORMAT[0], Q_FORMAT[1], len(layers), HEADER_SIZE,
+                        inOffset, len(inFM), outOffset, len(outFM), imageSize,
+                        (PACKED if packTile else 0) | (COMPRESSED if compressed else 0), packTile)
+   image = header + table
+   image += bytes(offset - len(image)) + blobs
+   with open(fileName, 'wb') as f:
+      f.write(image)
+   return len(image)
+
+
+def readContainer(fileName):
+   """Returns the header fields and the layer table of a container"""
+   image = open(fileName, 'rb').read()
+   fields = struct.unpack_from(HEADER_FMT, image, 0)
+   header = dict(zip(["magic", "version", "q_integer", "q_fraction", "depth", "layer_offset", "in_offset",
+                      "in_size", "out_offset", "out_size", "image_size", "flags", "pack_tile"], fields))
+   assert header["magic"] == MAGIC, "not a model container"
+   assert header["version"] == VERSION, "unsupported container version"
+   layers = []
+   for l in range(header["depth"]):
+      f = struct.unpack_from(LAYER_FMT, image, header["layer_offset"] + l*LAYER_SIZE)
+      layers.append({"type": layerTypes[f[0]], "attributes": list(f[1:6]), "param_offset": list(f[6:12]),
+                     "param_size": list(f[12:18]), "q": (f[18], f[19])})
+   return header, layers
+
+
+if __name__ == "__main__":
+   header, layers = readContainer(sys.argv[1])
+   print("container v{} Q{}.{}, {} layers, {} bytes, in {}, out {}{}".format(
+      header["version"], header["q_integer"], header["q_fraction"], header["depth"], header["image_size"],
+      header["in_size"], header["out_size"],
+      ", packed weights (tile {})".format(header["pack_tile"]) if header["flags"] & PACKED else "")
+      + (", compressed FC weights" if header["flags"] & COMPRESSED else ""))
+   for l, layer in enumerate(layers):
+      print("{:2d} {:8s} attributes={} parameters={}".format(l, layer["type"], layer["attributes"],
+            [s for s in layer["param_size"]]))
@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Cycle-level performance model of the FC and LSTM kernels for what-if analysis without gvsoc.
+#
+# Per layer and core (the slowest core has ceil(rows/cores) output rows):
+#   inner loop : per pair of inputs one input load, OUTPUTBUFFER weight loads and OUTPUTBUFFER pv.sdotsp.h,
+#                i.e. (2k+1)/(2k) cycles per MAC for an output tile of k neurons
+#   contention : every load waits with the probability that another core accesses the same TCDM bank
+#                (cores*banking_factor word-interleaved banks)
+#   rows       : bias, shift, clipping and store per output neuron, LUT activations of the LSTM
+#   barriers   : fixed cost plus a cost per core for every synch_barrier of the layer
+#   parameters : with DMA the weights of the next layer are transferred (bandwidth and setup) while the
+#                current layer is computed, without DMA core 0 copies them while the other cores wait
+# The coefficients are fitted to the sweeps of run_sweep_fcl.sh and run_sweep_lstm.sh (calibrate). No calibrated
+# coefficients are shipped: without reports/perf_model.json the model uses the uncalibrated defaults below,
+# which are estimates from the instruction counts of the kernels, not measurements.
+#
+# Usage as library:
+#   from perf_model import PerfModel
+#   model = PerfModel.load("reports/perf_model.json")
+#   model.layer("linear", 256, 256, cores=8, tile=8)["cycles"]
+#
+# Usage as CLI:
+#   python3 scripts/perf_model.py calibrate measurements/*.log            # writes reports/perf_model.json
+#   python3 scripts/perf_model.py layer linear 256 256 --cores 1 4 8 16 --tile 4 8
+#   python3 scripts/perf_model.py layer lstm 128 128 --cores 8 --dma
+#   python3 scripts/perf_model.py model containers/model2.bin --cores 2 4 8 --tile 2 4 8 --freq 100
+
+import os
+import re
+import sys
+import json
+import argparse
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from bank_sim import banking_factor_from_vp
+from wcet import solve
+
+model_file  = "reports/perf_model.json"
+config_file = "config_profiling.h"
+
+# uncalibrated initial coefficients (cycles, estimated, not measured), replaced by calibrate
+defaults = {
+   "mac":          1.0,   # scale of the inner loop (1.0: single-cycle loads and pv.sdotsp.h)
+   "contention":   1.0,   # stall cycles per TCDM bank conflict
+   "row":         12.0,   # cycles per output neuron (bias, shift, clip, store)
+   "act":         10.0,   # cycles per LUT activation (sig, tanh)
+   "call":       150.0,   # cycles per layer (call, tile setup)
+   "barrier":     20.0,   # cycles per barrier
+   "barrier_core": 2.0,   # cycles per barrier and core
+   "copy":         2.0,   # cycles per element copied by core 0 (no DMA)
+   "dma_setup":   30.0,   # cycles per DMA transfer
+   "dma_bw":       8.0,   # DMA bandwidth L2->L1 (bytes per cycle)
+}
+# coefficients which are fitted to the sweeps (linear in the features of features())
+fitted = ["mac", "contention", "row", "act", "call", "barrier", "barrier_core"]
+
+# barriers per layer invocation (LinearLayer, LSTMLayer with its element-wise kernels)
+barriers = {"linear": 1, "lstm": 6}
+
+
+def outputbuffer_from_config(default=8):
+   """OUTPUTBUFFER of config_profiling.h"""
+   try:
+      m = re.search(r"^\s*#define\s+OUTPUTBUFFER\s+(\d+)", open(config_file).read(), re.M)
+      return int(m.group(1)) if m else default
+   except OSError:
+      return default
+
+
+class PerfModel:
+   def __init__(self, coefficients=None, banking_factor=None):
+      self.c  = dict(defaults, **(coefficients or {}))
+      self.bf = banking_factor or banking_factor_from_vp()
+
+   @classmethod
+   def load(cls, fileName=model_file):
+      """Calibrated model, or the uncalibrated defaults (with a warning) if the file cannot be read"""
+      try:
+         data = json.load(open(fileName))
+         return cls(data["coefficients"], data.get("banking_factor"))
+      except (OSError, ValueError, KeyError) as e:
+         print("WARNING - cannot read calibrated coefficients from %s (%s), using the uncalibrated defaults "
+               "(run calibrate with sweep logs first)" % (fileName, e), file=sys.stderr)
+         return cls()
+
+   def save(self, fileName=model_file, info=None):
+      os.makedirs(os.path.dirname(fileName) or ".", exist_ok=True)
+      json.dump(dict({"coefficients": self.c, "banking_factor": self.bf}, **(info or {})),
+                open(fileName, 'w'), indent=2)
+
+   def features(self, kind, inputs, hidden, cores, tile):
+      """Amount of work of every fitted coefficient on the slowest core"""
+      tile   = max(1, tile)
+      rows   = 4*hidden if kind == "lstm" else hidden
+      macs   = inputs + hidden if kind == "lstm" else inputs
+      rowsPerCore = -(-rows // cores)
+      macsPerCore = rowsPerCore*macs
+      banks  = cores*self.bf
+      conflict = 1 - (1 - 1/banks)**(cores-1)
+      return {
+         "mac":          macsPerCore*(2*tile+1)/(2*tile),
+         "contention":   macsPerCore*(tile+1)/(2*tile)*conflict,
+         "row":          rowsPerCore + (3*-(-hidden // cores) if kind == "lstm" else 0),
+         "act":          5*-(-hidden // cores) if kind == "lstm" else 0,
+         "call":         1,
+         "barrier":      barriers[kind],
+         "barrier_core": barriers[kind]*cores,
+      }
+
+   def parameter_bytes(self, kind, inputs, hidden):
+      rows = 4*hidden if kind == "lstm" else hidden
+      return 2*(rows*(inputs + (hidden if kind == "lstm" else 0)) + rows*(2 if kind == "lstm" else 1))
+
+   def layer(self, kind, inputs, hidden, cores=1, tile=8, dma=False):
+      """Predicted cycles of one layer with its breakdown (the parameter transfer is not overlapped)"""
+      f = self.features(kind, inputs, hidden, cores, tile)
+      parts = {k: f[k]*self.c[k] for k in f}
+      compute = sum(parts.values())
+      size = self.parameter_bytes(kind, inputs, hidden)
+      if dma:
+         transfer = self.c["dma_setup"]*(-(-size // 65532) + 1) + size/self.c["dma_bw"]
+      else:
+         transfer = size/2*self.c["copy"]
+      return {"cycles": compute + transfer, "compute": compute, "transfer": transfer,
+              "sdotp": parts["mac"], "tcdm": parts["contention"], "rows": parts["row"] + parts["act"],
+              "barrier": parts["barrier"] + parts["barrier_core"], "overhead": parts["call"]}
+
+   def network(self, layers, cores=1, tile=8, dma=False):
+      """Predicted cycles of an inference, layers: list of (kind, inputs, hidden)
+
+      With DMA the parameters of the next layer are transferred during the current layer
+      (inferNetwork), without DMA every transfer adds to the layer."""
+      pred = [self.layer(k, i, h, cores, tile, dma) for k, i, h in layers]
+      if not dma:
+         return sum(p["cycles"] for p in pred), pred
+      total = pred[0]["transfer"] if pred else 0
+      for l, p in enumerate(pred):
+         nxt = pred[l+1]["transfer"] if l+1 < len(pred) else 0
+         total += max(p["compute"], nxt)
+      return total, pred
+
+   def calibrate(self, samples, tile):
+      """Least-squares fit of the relative error to (kind, inputs, hidden, cores, cycles) samples
+
+      Coefficients which would become negative keep their current value."""
+      free = list(fitted)
+      samples = [s for s in samples if s[4] > 0]
+      while free and samples:
+         a, b = [], []
+         for kind, inputs, hidden, cores, cycles in samples:
+            f = self.features(kind, inputs, hidden, cores, tile)
+            a.append([f[k]/cycles for k in free])
+            b.append(1 - sum(f[k]*self.c[k] for k in f if k not in free)/cycles)
+         x = solve(a, b)
+         if x is None:
+            break
+         negative = [k for k, v in zip(free, x) if v < 0]
+         if not negative:
+            self.c.update({k: float(v) for k, v in zip(free, x)})
+            break
+         free = [k for k in free if k not in negative]
+      errors = [abs(self.layer(k, i, h, c, tile)["compute"] - cyc)/cyc for k, i, h, c, cyc in samples]
+      return max(errors) if errors else 0, sum(errors)/len(errors) if errors else 0
+
+
+def parse_sweep(log):
+   """(kind, inputs, hidden, cores, cycles) of the runs of a sweep log (run_sweep_fcl.sh, run_sweep_lstm.sh)"""
+   samples = []
+   run = {}
+   for line in log:
+      fields = line.split()
+      if len(fields) == 3 and fields[0] == "####" and fields[1] in ("NUM_INPUT", "NUM_OUTPUT", "NR_CORES",
+                                                                   "LSTM_ON", "total_cycles"):
+         run[fields[1]] = int(fields[2])
+         if fields[1] == "total_cycles" and "NUM_INPUT" in run:
+            samples.append(("lstm" if run.get("LSTM_ON") else "linear", run["NUM_INPUT"], run["NUM_OUTPUT"],
+                            run.get("NR_CORES", 1), run["total_cycles"]))
+            run = {}
+   return samples
+
+
+def print_table(rows, freq):
+   print("%-28s %5s %4s %12s %10s %10s %10s %10s %10s%s" %
+         ("layer", "cores", "tile", "cycles", "sdotp", "tcdm", "rows", "barrier", "transfer",
+          " %10s" % "time us" if freq else ""))
+   for name, cores, tile, p in rows:
+      print("%-28s %5d %4d %12.0f %10.0f %10.0f %10.0f %10.0f %10.0f%s" %
+            (name, cores, tile, p["cycles"], p.get("sdotp", 0), p.get("tcdm", 0), p.get("rows", 0),
+             p.get("barrier", 0), p.get("transfer", 0), " %10.2f" % (p["cycles"]/freq) if freq else ""))
+
+
+def container_layers(fileName):
+   from model_container import readContainer
+   _, layers = readContainer(fileName)
+   result = []
+   for layer in layers:
+      a = layer["attributes"]
+      if layer["type"] == "LINEAR":
+         result.append(("linear", a[0], a[1]))
+      elif layer["type"] == "LSTM":
+         result.append(("lstm", a[0], a[1]))
+      else:
+         print("\033[91mWARNING - %s layers are not modelled!!!\033[0m" % layer["type"])
+   return result
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Performance model of the FC and LSTM kernels")
+   parser.add_argument("command", choices=["calibrate", "layer", "model"])
+   parser.add_argument("args", nargs="+", help="calibrate: sweep logs, layer: linear|lstm inputs outputs, "
+                                                "model: model container")
+   parser.add_argument("--cores", type=int, nargs="+", default=[8], help="number of cores")
+   parser.add_argument("--tile", type=int, nargs="+", default=None, help="OUTPUTBUFFER (default: config)")
+   parser.add_argument("--dma", action="store_true", help="parameters are transferred by DMA")
+   parser.add_argument("--freq", type=float, default=0, help="cluster frequency in MHz (prints the time)")
+   parser.add_argument("--model", default=model_file, help="calibrated coefficients")
+   args = parser.parse_args()
+   tiles = args.tile or [outputbuffer_from_config()]
+
+   if args.command == "calibrate":
+      samples = []
+      for log in args.args:
+         samples += parse_sweep(open(log, errors="replace"))
+      if not samples:
+         print("\033[91mERROR - no sweep results found!!!\033[0m")
+         sys.exit(1)
+      model = PerfModel()
+      worst, mean = model.calibrate(samples, tiles[0])
+      model.save(args.model, {"samples": len(samples), "tile": tiles[0], "max_error": worst, "mean_error": mean})
+      for k in fitted:
+         print("%-13s %10.3f" % (k, model.c[k]))
+      print("%d samples, error mean %.1f%%, max %.1f%%, wrote %s" % (len(samples), 100*mean, 100*worst, args.model))
+   else:
+      model = PerfModel.load(args.model)
+      layers = container_layers(args.args[0]) if args.command == "model" else None
+      rows = []
+      for cores in args.cores:
+         for tile in tiles:
+            if args.command == "layer":
+               kind, inputs, hidden = args.args[0], int(args.args[1]), int(args.args[2])
+               rows.append(("%s %dx%d" % (kind, inputs, hidden), cores, tile,
+                            model.layer(kind, inputs, hidden, cores, tile, args.dma)))
+            else:
+               total, pred = model.network(layers, cores, tile, args.dma)
+               parts = {k: sum(p[k] for p in pred) for k in ["sdotp", "tcdm", "rows", "barrier", "transfer"]}
+               rows.append((os.path.basename(args.args[0]), cores, tile, dict(parts, cycles=total)))
+      print_table(rows, args.freq)
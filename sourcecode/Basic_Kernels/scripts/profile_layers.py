@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Per-layer profiling of the model zoo with one build per model (PROFILING_LAYERS).
+#
+# The device prints one "LAYPROF,..." line per record of the layer profiler ring buffers
+# (see layerProfileDump() in basicKernel.c). This script selects every model in
+# config_profiling.h, runs it once and converts the records into
+#   reports/layer_profile.csv  : one line per layer (and kernel segment) with one column per counter
+#   reports/layer_profile.json : the same data grouped by model and layer
+#
+# Usage:
+#   python3 scripts/profile_layers.py                      # build and run all models
+#   python3 scripts/profile_layers.py MODEL2 MODEL5        # build and run the given models
+#   python3 scripts/profile_layers.py --parse log [model]  # only convert an existing log
+
+import os
+import re
+import sys
+import json
+import subprocess
+
+models = ["MODEL0", "MODEL1", "MODEL2", "MODEL3", "MODEL5", "MODEL6",
+          "MODEL7", "MODEL8", "MODEL9", "MODEL10", "MODEL11"]
+
+config_file = "config_profiling.h"
+csv_file    = "reports/layer_profile.csv"
+json_file   = "reports/layer_profile.json"
+
+
+def select_model(model):
+   """Enables exactly one model and the layer profiler in config_profiling.h"""
+   lines = []
+   for line in open(config_file):
+      m = re.match(r"^\s*(//)?\s*#define\s+(MODEL\d+)\s*$", line)
+      if m:
+         line = ("" if m.group(2) == model else "// ") + "#define " + m.group(2) + "\n"
+      elif re.match(r"^\s*(//)?\s*#define\s+PROFILING_LAYERS\s*$", line):
+         continue
+      lines.append(line)
+   lines.append("#define PROFILING_LAYERS\n")
+   open(config_file, 'w').write("".join(lines))
+
+
+def parse(log, model):
+   """Collects the LAYPROF records of one run and sums them per core, layer, type and counter"""
+   layers = {}
+   events = []
+   for line in log:
+      fields = line.strip().split(",")
+      if fields[0] != "LAYPROF" or fields[1] == "core":
+         continue
+      core, run, layer, typ, event, value = fields[1:7]
+      if event not in events:
+         events.append(event)
+      key = (int(core), int(layer), typ)
+      entry = layers.setdefault(key, {"model": model, "core": int(core), "layer": int(layer),
+                                      "type": typ, "invocations": {}, "counters": {}})
+      entry["counters"][event] = entry["counters"].get(event, 0) + int(value)
+      entry["invocations"][event] = entry["invocations"].get(event, 0) + 1
+   for entry in layers.values():
+      # every counter is measured in its own inference run, the call count is the same for all of them
+      entry["invocations"] = max(entry["invocations"].values())
+   return [layers[k] for k in sorted(layers)], events
+
+
+def write_reports(results, events):
+   os.makedirs(os.path.dirname(csv_file), exist_ok=True)
+   with open(csv_file, 'w') as f:
+      f.write(",".join(["model", "core", "layer", "type", "invocations"] + events) + "\n")
+      for entry in results:
+         f.write(",".join([entry["model"], str(entry["core"]), str(entry["layer"]), entry["type"],
+                           str(entry["invocations"])] +
+                          [str(entry["counters"].get(e, "")) for e in events]) + "\n")
+
+   report = {}
+   for entry in results:
+      report.setdefault(entry["model"], []).append(
+         {k: entry[k] for k in ["core", "layer", "type", "invocations", "counters"]})
+   with open(json_file, 'w') as f:
+      json.dump(report, f, indent=2)
+
+   print("wrote %d records to %s and %s" % (len(results), csv_file, json_file))
+
+
+if __name__ == "__main__":
+   results = []
+   events  = []
+
+   if len(sys.argv) > 2 and sys.argv[1] == "--parse":
+      model = sys.argv[3] if len(sys.argv) > 3 else "NONE"
+      results, events = parse(open(sys.argv[2]), model)
+   else:
+      config_backup = open(config_file).read()
+      try:
+         for model in (sys.argv[1:] or models):
+            select_model(model)
+            run = subprocess.run("make clean all run", shell=True, stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT, universal_newlines=True)
+            open("log", 'w').write(run.stdout)
+            model_results, model_events = parse(run.stdout.splitlines(), model)
+            if not model_results:
+               print("\033[91mERROR - no layer profile found for %s (see ./log)\033[0m" % model)
+            results += model_results
+            events  += [e for e in model_events if e not in events]
+      finally:
+         open(config_file, 'w').write(config_backup)
+
+   write_reports(results, events)
@@ -32,7 +32,8 @@ profiles = [
 "#define PROFILING_ADDT",
 "#define PROFILING_HADM",
 "#define PROFILING_COPY",
-"#define PROFILING_FILL",]
+"#define PROFILING_FILL",
+"#define PROFILING_HEAD",]
 
 models = [
 "#define MODEL0",
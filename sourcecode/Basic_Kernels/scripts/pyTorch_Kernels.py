@@ -20,6 +20,7 @@
 
 import torch
 import numpy
+import struct
 
 nn = torch.nn;
 
@@ -105,6 +106,43 @@ def _2DTensor2C(var_name, tensor):
    tmp += "};"
    return tmp
 
+def packWeights(tensor, tileSize):
+   """Packs a (out x in) weight matrix into the layout of LinearLayer with WEIGHT_PACKING
+
+   tiles of tileSize output neurons (the last tile holds the remaining neurons), within a tile
+   the weights of all neurons are interleaved per pair of inputs (one v2s word), an odd last
+   input follows as one halfword per neuron at the end of the tile"""
+   outSize = len(tensor)
+   inSize = len(tensor[0])
+   packed = []
+   for o_start in range(0, outSize, tileSize):
+      rows = range(o_start, min(o_start+tileSize, outSize))
+      for i in range(0, inSize-1, 2):
+         for o in rows:
+            packed += [tensor.data[o][i], tensor.data[o][i+1]]
+      if inSize % 2:
+         packed += [tensor.data[o][inSize-1] for o in rows]
+   return packed
+
+def _packedWeights2C(var_name, tensor, tileSize):
+   tmp = ""
+   tmp += "RT_L2_DATA data_t "+var_name+"["+str(len(tensor)*len(tensor[0]))+"] = "
+   tmp += "{"
+   tmp += ", ".join(str(num2format(w)) for w in packWeights(tensor, tileSize))
+   tmp += "};"
+   return tmp
+
+
+def _compressedWeights2C(var_name, blob):
+   """Compressed weight blob (see weight_compression.py) as word array, LAY_LIN_WEIGHTS points to it"""
+   words = struct.unpack("<%dI" % (len(blob)//4), blob)
+   tmp = ""
+   tmp += "RT_L2_DATA uint32_t "+var_name+"["+str(len(words))+"] = "
+   tmp += "{"
+   tmp += ", ".join("0x%08x" % w for w in words)
+   tmp += "};"
+   return tmp
+
 
 if __name__ == "__main__":
    # Linear Layer
@@ -27,7 +27,12 @@ make clean all run CONFIG_OPT="${TRACE_OPT}" &> ${TRACE_FILE}
 cat ${TRACE_FILE} | grep -E "insn|Start|\n"  > tmp
 echo "Created traces and stored in ${TRACE_FILE}"
 
-python3 scripts/create_statistic.py tmp Start | tee ${TRACE_FILE}_summary
+# the native analyzer (make -f Makefile_host trace) is used if built, it is much faster on long traces
+if [ -x build_host/insnStatistic ]; then
+   ./build_host/insnStatistic tmp Start | tee ${TRACE_FILE}_summary
+else
+   python3 scripts/create_statistic.py tmp Start | tee ${TRACE_FILE}_summary
+fi
 echo "Created instruction summary in ${TRACE_FILE}_summary"
 rm tmp
 # CONFIG_OPT=gvsoc/trace=insn
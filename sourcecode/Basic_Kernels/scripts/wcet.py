@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Worst-case cycle estimates of the models for the deadline-aware inference (DEADLINE_SCHEDULER).
+#
+# A layer of R rows (FC outputs, LSTM gates, head elements) with M MACs per row takes on the slowest
+# of C cores
+#   fixed + ceil(R/C)*(perRow + M*perMac)
+# cycles (see layerWcet() in basicKernel.c), the estimate of a model adds WCET_MARGIN percent.
+#
+# The cycle models are calibrated with traces of the virtual platform: create_statistic.py writes the
+# cycles and calls of every kernel per core (<trace><core>.pkl), the layer shapes are taken from the
+# model container of the traced network. The fitted models are scaled such that they bound every
+# measurement and are written to wcet.h, which pre-fills wcetTable of the next builds.
+#
+# Usage:
+#   python3 scripts/wcet.py calibrate --cores 8 trace.log:model2.bin [trace2.log:model5.bin]
+#   python3 scripts/wcet.py estimate --cores 8 model2.bin
+#   python3 scripts/wcet.py admit --cores 8 --budget 150000 model2.bin [fallback.bin]
+
+import os
+import re
+import sys
+import glob
+import pickle
+import argparse
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from model_container import readContainer
+
+wcet_file = "wcet.h"
+entry_re  = re.compile(r"\{\s*(\w+),\s*(\d+),\s*(\d+),\s*(\d+),\s*(\d+)\s*\},")
+
+FRAC_BITS = 8   # WCET_FRAC_BITS
+MARGIN    = 20  # WCET_MARGIN (percent)
+
+# built-in cycle models of wcetTable (any number of cores): fixed, perRow, perMac (FRAC_BITS)
+defaults = {"LINEAR": (400, 24, 160), "RNN": (800, 40, 160), "LSTM": (1200, 48, 160),
+            "SOFTMAX": (600, 40, 0), "ARGMAX": (300, 6, 0), "TOPK": (400, 6, 1536)}
+
+# kernels of create_statistic.py (topLevelFuncList) and the layer type they compute
+kernels = {"LinearLayer": "LINEAR", "RNNLayer": "RNN", "LSTMLayer": "LSTM", "SoftmaxLayer": "SOFTMAX",
+           "ArgmaxLayer": "ARGMAX", "TopKLayer": "TOPK"}
+
+
+def layer_shape(layer):
+   """Rows and MACs per row of a layer (as in layerWcet)"""
+   a = layer["attributes"]
+   if layer["type"] == "LINEAR":
+      return a[1], a[0]
+   if layer["type"] in ("RNN", "LSTM"):
+      return (4 if layer["type"] == "LSTM" else 1)*a[1], a[0]+a[1]
+   return a[0], (a[1] if layer["type"] == "TOPK" else 0)
+
+
+def read_table():
+   """Cycle models of wcet.h, key: (type, cores)"""
+   table = {}
+   try:
+      for line in open(wcet_file):
+         m = entry_re.search(line)
+         if m:
+            table[(m.group(1), int(m.group(2)))] = tuple(int(v) for v in m.groups()[2:])
+   except FileNotFoundError:
+      pass
+   return table
+
+
+def write_table(table):
+   with open(wcet_file, 'w') as f:
+      f.write("// generated by scripts/wcet.py, one cycle model per kernel and number of cores (see struct wcet_entry)\n")
+      f.write("// {type, cores, fixed, perRow, perMac},\n")
+      for key in sorted(table):
+         f.write("{%s, %d, %d, %d, %d},\n" % (key + table[key]))
+   print("wrote %d cycle models to %s" % (len(table), wcet_file))
+
+
+def lookup(table, typ, cores):
+   return table.get((typ, cores)) or table.get((typ, 0)) or defaults.get(typ)
+
+
+def layer_wcet(table, layer, cores):
+   model = lookup(table, layer["type"], cores)
+   if model is None:
+      return None
+   rows, macs = layer_shape(layer)
+   rowsPerCore = (rows+cores-1)//cores
+   return model[0] + rowsPerCore*model[1] + ((rowsPerCore*macs*model[2]) >> FRAC_BITS)
+
+
+def network_wcet(table, layers, cores, verbose=False):
+   """Worst-case cycles of one inference including the margin (None if a layer has no cycle model)"""
+   cycles = 0
+   for l, layer in enumerate(layers):
+      wcet = layer_wcet(table, layer, cores)
+      if verbose:
+         print("{:2d} {:8s} attributes={} {}".format(l, layer["type"], layer["attributes"],
+               "no cycle model" if wcet is None else "%d cycles" % wcet))
+      if wcet is None:
+         return None
+      cycles += wcet
+   return cycles + cycles*MARGIN//100
+
+
+def solve(rows, values):
+   """Least squares fit of the rows (lists of regressors) to values, None if singular"""
+   n = len(rows[0])
+   # the regressors are scaled to the same magnitude for the normal equations
+   scale = [max(abs(r[i]) for r in rows) or 1 for i in range(n)]
+   rows = [[r[i]/scale[i] for i in range(n)] for r in rows]
+   a = [[sum(r[i]*r[j] for r in rows) for j in range(n)] + [sum(r[i]*v for r, v in zip(rows, values))]
+        for i in range(n)]
+   for c in range(n):
+      p = max(range(c, n), key=lambda r: abs(a[r][c]))
+      if abs(a[p][c]) < 1e-9:
+         return None
+      a[c], a[p] = a[p], a[c]
+      for r in range(n):
+         if r != c:
+            f = a[r][c]/a[c][c]
+            a[r] = [x - f*y for x, y in zip(a[r], a[c])]
+   return [a[i][n]/a[i][i]/scale[i] for i in range(n)]
+
+
+def samples(traces, cores):
+   """Per kernel type: (calls, rows per core, MACs per core, cycles of the slowest core) of every trace"""
+   result = {}
+   for trace in traces:
+      log, container = trace.split(":")
+      _, layers = readContainer(container)
+      pickles = glob.glob(log + "*.pkl")
+      if not pickles:
+         print("\033[91mERROR - no create_statistic.py results for %s!!!\033[0m" % log)
+         continue
+      for func, typ in kernels.items():
+         shapes = [layer_shape(l) for l in layers if l["type"] == typ]
+         if not shapes:
+            continue
+         cycles, calls = 0, len(shapes)
+         for name in pickles:
+            stat = pickle.load(open(name, 'rb'))
+            cycles = max(cycles, sum(stat["cyclesPerFunc"].get(func, {}).values()))
+            calls = max(calls, stat.get("callsPerFunc", {}).get(func, 0))
+         # the trace can cover several inferences of the network
+         runs = max(1, calls//len(shapes))
+         rows = runs*sum((r+cores-1)//cores for r, m in shapes)
+         macs = runs*sum((r+cores-1)//cores*m for r, m in shapes)
+         if cycles:
+            result.setdefault(typ, []).append((runs*len(shapes), rows, macs, cycles))
+   return result
+
+
+def calibrate(traces, cores):
+   table = read_table()
+   for typ, points in samples(traces, cores).items():
+      fixed, perRow, perMac = defaults[typ][0], defaults[typ][1], defaults[typ][2]/(1 << FRAC_BITS)
+      fit = solve([p[:3] for p in points], [p[3] for p in points]) if len(points) >= 3 else None
+      if fit and min(fit) >= 0:
+         fixed, perRow, perMac = fit
+      else:
+         # too few shapes for a fit, the overheads keep their defaults
+         rest  = sum(p[3] - p[0]*fixed - p[1]*perRow for p in points)
+         macs  = sum(p[2] for p in points)
+         rows  = sum(p[1] for p in points)
+         if macs:
+            perMac = max(0, rest/macs)
+         elif rows:
+            perRow = max(0, perRow + rest/rows)
+      # tightest scaling which bounds every measurement
+      scale = max(p[3]/max(1, p[0]*fixed + p[1]*perRow + p[2]*perMac) for p in points)
+      model = (int(fixed*scale+0.5), int(perRow*scale+0.5), int(perMac*scale*(1 << FRAC_BITS)+0.5))
+      table[(typ, cores)] = model
+      print("%-8s %d cores: fixed %d, perRow %d, perMac %.3f cycles (%d traces, scaled by %.2f)" %
+            (typ, cores, model[0], model[1], model[2]/(1 << FRAC_BITS), len(points), scale))
+   write_table(table)
+
+
+def estimate(containers, cores, verbose=True):
+   table = read_table()
+   result = []
+   for container in containers:
+      _, layers = readContainer(container)
+      wcet = network_wcet(table, layers, cores, verbose)
+      print("%s: %s on %d cores (margin %d%%)" % (container, "no estimate" if wcet is None else
+            "%d cycles" % wcet, cores, MARGIN))
+      result.append(wcet)
+   return result
+
+
+def admit(primary, fallback, cores, budget, backlog):
+   """Same decision as deadlineAdmit()"""
+   wcets = estimate([primary] + ([fallback] if fallback else []), cores, False)
+   if wcets[0] is not None and backlog + wcets[0] <= budget:
+      print("admitted: %s (%d of %d cycles)" % (primary, backlog + wcets[0], budget))
+   elif fallback and wcets[1] is not None and backlog + wcets[1] <= budget:
+      print("degraded: %s (%d of %d cycles)" % (fallback, backlog + wcets[1], budget))
+   else:
+      print("\033[91mrejected: no model meets the budget of %d cycles\033[0m" % budget)
+      return 1
+   return 0
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Worst-case cycle estimates and admission of models")
+   parser.add_argument("command", choices=["calibrate", "estimate", "admit"])
+   parser.add_argument("files", nargs="+", help="calibrate: trace:container, estimate: containers, "
+                                                 "admit: primary [fallback] container")
+   parser.add_argument("--cores", type=int, default=8, help="number of cores")
+   parser.add_argument("--budget", type=int, default=0, help="cycles until the deadline (admit)")
+   parser.add_argument("--backlog", type=int, default=0, help="cycles of the queued work (admit)")
+   args = parser.parse_args()
+
+   if args.command == "calibrate":
+      calibrate(args.files, args.cores)
+   elif args.command == "estimate":
+      estimate(args.files, args.cores)
+   else:
+      sys.exit(admit(args.files[0], args.files[1] if len(args.files) > 1 else None, args.cores,
+                     args.budget, args.backlog))
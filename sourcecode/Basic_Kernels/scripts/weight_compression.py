@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+#*----------------------------------------------------------------------------*
+#* Copyright (C) 2019-2020 ETH Zurich, Switzerland                            *
+#* SPDX-License-Identifier: Apache-2.0                                        *
+#*                                                                            *
+#* Licensed under the Apache License, Version 2.0 (the "License");            *
+#* you may not use this file except in compliance with the License.           *
+#* You may obtain a copy of the License at                                    *
+#*                                                                            *
+#* http://www.apache.org/licenses/LICENSE-2.0                                 *
+#*                                                                            *
+#* Unless required by applicable law or agreed to in writing, software        *
+#* distributed under the License is distributed on an "AS IS" BASIS,          *
+#* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+#* See the License for the specific language governing permissions and        *
+#* limitations under the License.                                             *
+#*----------------------------------------------------------------------------*
+
+# Compressed FC weights (WEIGHT_COMPRESSION, see struct weight_comp_header in general.h).
+#
+# Every FC weight matrix (out x in, fixed-point) is one blob: an 8-byte header (format, log2 of the
+# group size, total size in bytes) followed by the payload, padded to 4 bytes:
+#   raw   16-bit weights (layers which are not compressed)
+#   exp8  shared exponent: per group of 2^log2Group weights of a row one exponent byte, then one int8
+#         mantissa per weight (weight = mantissa << exponent), ~1.9x smaller
+#   cb4   codebook: 16 16-bit values per layer (1D k-means), then one 4-bit index per weight
+#         (low nibble first), ~4x smaller
+# The blobs are DMA'd compressed and expanded by all cores into the L1 weight buffer (weightExpand()).
+# The formats are lossy: exportModel(..., compressWeights=...) in BenchmarkNetworks.py computes the
+# expected outputs with the decoded weights. Converting an existing container keeps its expected
+# output, i.e. the error reported by benchHost is the error caused by the compression.
+#
+# Usage:
+#   python3 scripts/weight_compression.py model.bin model_exp8.bin                 # all FC layers exp8
+#   python3 scripts/weight_compression.py model.bin model_cb4.bin --format cb4 --min-weights 4096
+#   python3 scripts/weight_compression.py model.bin                                # compression report only
+
+import sys
+import struct
+import argparse
+
+from model_container import readContainer, writeContainer, PACKED
+
+FORMATS    = {"raw": 0, "exp8": 1, "cb4": 2}
+HEADER_FMT = "<BBHI"
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+LOG2_GROUP = 5  # 32 weights per exponent (exp8)
+CODEBOOK   = 16 # entries of the codebook (cb4)
+
+
+def _pad4(data):
+   return data + bytes(-len(data) % 4)
+
+
+def _exp8(weights, rows, cols):
+   group = 1 << LOG2_GROUP
+   groups = (cols + group - 1) // group
+   # rounded mantissa, the decoded weight has to stay a 16-bit value
+   mantissa = lambda v, e: min((v + (1 << e >> 1)) >> e, 0x7FFF >> e)
+   exps, mants = bytearray(), bytearray()
+   for r in range(rows):
+      row = weights[r*cols:(r+1)*cols]
+      for g in range(groups):
+         values = row[g*group:(g+1)*group]
+         # smallest exponent whose mantissas fit into int8
+         e = 0
+         while any(not -128 <= mantissa(v, e) <= 127 for v in values):
+            e += 1
+         exps.append(e)
+         mants += struct.pack("<%db" % len(values), *[mantissa(v, e) for v in values])
+   return _pad4(bytes(exps)) + _pad4(bytes(mants))
+
+
+def _kmeans(weights, k, iterations=20):
+   """1D k-means (Lloyd) of the weights, initialized at the quantiles"""
+   values = sorted(set(weights))
+   if len(values) <= k:
+      return values + [values[-1]]*(k-len(values))
+   ordered = sorted(weights)
+   centers = [ordered[(2*i+1)*len(ordered)//(2*k)] for i in range(k)]
+   for _ in range(iterations):
+      sums, counts = [0]*k, [0]*k
+      for w in weights:
+         c = _nearest(centers, w)
+         sums[c] += w
+         counts[c] += 1
+      update = [round(sums[c]/counts[c]) if counts[c] else centers[c] for c in range(k)]
+      if update == centers:
+         break
+      centers = update
+   return centers
+
+
+def _nearest(centers, w):
+   return min(range(len(centers)), key=lambda c: abs(centers[c]-w))
+
+
+def _cb4(weights, rows, cols):
+   assert cols % 2 == 0, "cb4 needs an even number of inputs"
+   codebook = _kmeans(weights, CODEBOOK)
+   lookup = {w: _nearest(codebook, w) for w in set(weights)}
+   indices = bytes(lookup[weights[i]] | (lookup[weights[i+1]] << 4) for i in range(0, len(weights), 2))
+   return struct.pack("<%dh" % CODEBOOK, *codebook) + _pad4(indices)
+
+
+def encodeWeights(weights, rows, cols, fmt):
+   """Blob of a row-major (rows x cols) fixed-point weight matrix in the format fmt (raw, exp8, cb4)"""
+   assert len(weights) == rows*cols
+   if fmt == "exp8":
+      payload = _exp8(weights, rows, cols)
+   elif fmt == "cb4":
+      payload = _cb4(weights, rows, cols)
+   else:
+      payload = _pad4(struct.pack("<%dh" % len(weights), *weights))
+   return struct.pack(HEADER_FMT, FORMATS[fmt], LOG2_GROUP, 0, HEADER_SIZE + len(payload)) + payload
+
+
+def decodeWeights(blob, rows, cols):
+   """Row-major fixed-point weights of a blob (as expanded by weightExpand())"""
+   fmt, log2Group, _, size = struct.unpack_from(HEADER_FMT, blob, 0)
+   if fmt == FORMATS["exp8"]:
+      groups = (cols + (1 << log2Group) - 1) >> log2Group
+      exps = blob[HEADER_SIZE:HEADER_SIZE+rows*groups]
+      mantOffset = HEADER_SIZE + rows*groups + (-rows*groups % 4)
+      mants = struct.unpack_from("<%db" % (rows*cols), blob, mantOffset)
+      return [mants[r*cols+c] << exps[r*groups + (c >> log2Group)] for r in range(rows) for c in range(cols)]
+   if fmt == FORMATS["cb4"]:
+      codebook = struct.unpack_from("<%dh" % CODEBOOK, blob, HEADER_SIZE)
+      indices = blob[HEADER_SIZE+2*CODEBOOK:]
+      return [codebook[(indices[i >> 1] >> (4*(i & 1))) & 0xF] for i in range(rows*cols)]
+   return list(struct.unpack_from("<%dh" % (rows*cols), blob, HEADER_SIZE))
+
+
+def convert(fileName, outName, fmt, minWeights):
+   """Compresses the FC weights of a container, prints the size and the weight error per layer"""
+   header, layers = readContainer(fileName)
+   image = open(fileName, 'rb').read()
+   blob = lambda offset, size: list(struct.unpack_from("<%dh" % size, image, offset)) if offset else None
+   if header["flags"] & PACKED:
+      print("\033[91mERROR - containers with packed weights cannot be compressed!!!\033[0m")
+      return 1
+
+   print("{:>6}{:>9}{:>7}{:>7}{:>7}{:>10}{:>10}{:>8}{:>10}".format("layer", "type", "in", "out", "format", "bytes",
+         "blob", "ratio", "max err"))
+   newLayers = []
+   total = compressed = 0
+   for l, layer in enumerate(layers):
+      params = [blob(o, s) for o, s in zip(layer["param_offset"], layer["param_size"])]
+      if layer["type"] == "LINEAR":
+         inSize, outSize = layer["attributes"][0], layer["attributes"][1]
+         layerFmt = fmt if inSize*outSize >= minWeights else "raw"
+         params[1] = encodeWeights(params[1], outSize, inSize, layerFmt)
+         error = max(abs(a-b) for a, b in zip(decodeWeights(params[1], outSize, inSize), blob(layer["param_offset"][1],
+                     layer["param_size"][1])))
+         total += 2*inSize*outSize
+         compressed += len(params[1])
+         print("{:>6}{:>9}{:>7}{:>7}{:>7}{:>10}{:>10}{:>8.2f}{:>10}".format(l, layer["type"], inSize, outSize, layerFmt,
+               2*inSize*outSize, len(params[1]), 2*inSize*outSize/len(params[1]), error))
+      newLayers.append((layer["type"], layer["attributes"], params))
+   if total:
+      print("FC weights: %d -> %d bytes (%.2fx)" % (total, compressed, total/compressed))
+   if outName:
+      inFM  = blob(header["in_offset"], header["in_size"])
+      outFM = blob(header["out_offset"], header["out_size"])
+      writeContainer(outName, newLayers, inFM, outFM, compressed=True)
+   return 0
+
+
+if __name__ == "__main__":
+   parser = argparse.ArgumentParser(description="Compresses the FC weights of a model container")
+   parser.add_argument("container", help="model container (see model_container.py)")
+   parser.add_argument("out", nargs="?", help="compressed container (default: report only)")
+   parser.add_argument("--format", choices=["exp8", "cb4"], default="exp8", help="weight format of the FC layers")
+   parser.add_argument("--min-weights", type=int, default=0, help="smaller FC layers keep 16-bit weights (raw)")
+   args = parser.parse_args()
+   sys.exit(convert(args.container, args.out, args.format, args.min_weights))
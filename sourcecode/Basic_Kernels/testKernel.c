@@ -41,6 +41,43 @@
 #include "benchmarks.h"
 /// @endcond
 
+// packed FC weights have to match the tile size of the kernels (see packWeights in pyTorch_Kernels.py)
+#if defined(WEIGHT_PACKING_OUTPUTBUFFER) && (!defined(WEIGHT_PACKING) || WEIGHT_PACKING_OUTPUTBUFFER != OUTPUTBUFFER)
+#error "benchmarks.h was exported with packed weights for another OUTPUTBUFFER or WEIGHT_PACKING is not set"
+#endif
+#if defined(WEIGHT_PACKING) && !defined(WEIGHT_PACKING_OUTPUTBUFFER) && !defined(MODEL_CONTAINER)
+#error "WEIGHT_PACKING needs a benchmarks.h exported with packWeights=OUTPUTBUFFER"
+#endif
+// compressed FC weights are blobs which only inferNetwork expands (see compressWeights in BenchmarkNetworks.py)
+#if defined(WEIGHT_COMPRESSION_FORMAT) != defined(WEIGHT_COMPRESSION) && !defined(MODEL_CONTAINER)
+#error "benchmarks.h was exported with compressed weights and WEIGHT_COMPRESSION is not set or vice versa"
+#endif
+
+#ifdef MODEL_CONTAINER
+// binary model container linked into L2 as it is (scripts/model_container.py), a new model only needs a relink
+asm(".section .l2_data, \"aw\"\n.balign 64\n.global modelImage\nmodelImage:\n.incbin \"" MODEL_CONTAINER "\"\n.global modelImageEnd\nmodelImageEnd:\n.previous\n");
+extern char modelImage[], modelImageEnd[];
+
+/** @brief network built from the model container by loadModelContainer */
+L2_DATA struct layer containerNetwork[MODEL_CONTAINER_MAX_DEPTH];
+int containerDepth;
+data_t * containerIn;
+data_t * containerOut;
+int containerOutSize;
+#endif
+
+#ifdef L3_STREAMING
+#include "bsp/hyperram.h"
+/** @brief HyperRAM holding the model container image at L3_IMAGE_ADDR */
+struct pi_device l3Ram;
+/** @brief streaming engine of the container in L3, used by all cores */
+L2_DATA struct stream_engine streamEngine;
+/** @brief input and golden output of the streamed model (at most STREAM_STATE_SIZE/2 elements, see streamOpen) */
+L2_DATA data_t streamIn[STREAM_STATE_SIZE/2];
+L2_DATA data_t streamOut[STREAM_STATE_SIZE/2];
+int streamDepth;
+#endif
+
 
 
 #ifdef PROFILING
@@ -49,6 +86,55 @@ int event_mask;
 #endif // PROFILING
 
 
+#ifdef ASYNC_INFERENCE
+/** @brief inference queue between the FC (main) and the cluster (run_queue) */
+L2_DATA struct infer_queue inferQueue;
+
+/** @brief completion callback (FC), compares the output with the golden output given as argument */
+static void checkInference(struct infer_request * req, void * golden)
+{
+#ifdef PRINTF_ACTIVE
+    PrintTensorDiff(req->outSize, req->result, (data_t *) golden);
+#endif
+}
+
+/** @brief submits one inference (FC), the callbacks of completed inferences are called while the queue is full */
+#define SUBMIT_INFERENCE(network, depth, in, golden, size, maxSize) \
+    { \
+        static L2_DATA data_t result[maxSize]; \
+        static struct infer_request req; \
+        req = (struct infer_request) {network, depth, in, result, size, checkInference, golden}; \
+        while(inferSubmit(&inferQueue, &req) < 0) \
+          inferPoll(&inferQueue); \
+    }
+/** @brief submits the exported model id */
+#define SUBMIT_MODEL(id) SUBMIT_INFERENCE(model##id, DEPTH##id, m##id##_In, m##id##_Out, \
+                                         (int)(sizeof(m##id##_Out)/sizeof(data_t)), sizeof(m##id##_Out)/sizeof(data_t))
+#endif // ASYNC_INFERENCE
+
+
+#ifdef MULTI_MODEL
+/** @brief core groups of the selected models, run concurrently by run_concurrent */
+L2_DATA struct core_group coreGroups[CORE_GROUPS_MAX];
+/** @brief golden outputs and output sizes of the core groups */
+L2_DATA data_t * coreGroupGolden[CORE_GROUPS_MAX];
+L2_DATA int coreGroupOutSize[CORE_GROUPS_MAX];
+int nrCoreGroups;
+
+/** @brief adds one model as core group (core 0), the models beyond CORE_GROUPS_MAX are skipped */
+#define GROUP_INFERENCE(network, depth, in, golden, size) \
+    if(nrCoreGroups < CORE_GROUPS_MAX) \
+    { \
+      coreGroups[nrCoreGroups] = (struct core_group) {network, depth, in, NULL, 0}; \
+      coreGroupGolden[nrCoreGroups] = golden; \
+      coreGroupOutSize[nrCoreGroups] = size; \
+      nrCoreGroups++; \
+    }
+/** @brief adds the exported model id as core group */
+#define GROUP_MODEL(id) GROUP_INFERENCE(model##id, DEPTH##id, m##id##_In, m##id##_Out, (int)(sizeof(m##id##_Out)/sizeof(data_t)))
+#endif // MULTI_MODEL
+
+
 /** @brief buffer to store intermediate FM */
 #ifdef MULTICORE
 __attribute__ ((section(".heapsram"))) data_t buffer[BUFFER_SIZE];
@@ -65,6 +151,22 @@ static int run_networks()
 
     int core_id = rt_core_id();
 
+#ifdef L3_STREAMING
+    // only the header and the layer table of the container are read, the weights are streamed by inferNetworkStreamed
+    if(core_id == 0)
+    {
+      streamDepth = streamOpen(&streamEngine, &l3Ram, L3_IMAGE_ADDR);
+      if(streamDepth >= 0)
+      {
+        streamRead(&streamEngine, streamEngine.header.in_offset, streamIn, streamEngine.header.in_size*sizeof(data_t));
+        streamRead(&streamEngine, streamEngine.header.out_offset, streamOut, streamEngine.header.out_size*sizeof(data_t));
+      }
+    }
+    synch_barrier();
+    if(streamDepth < 0)
+      return 1;
+#endif
+
     {
 #ifdef DEBUG
         printf("Entered cluster on cluster %d core %d\n", get_cluster_id(), core_id);
@@ -79,6 +181,16 @@ static int run_networks()
 #endif // ASIP
 
         numFunctionCalls = 0;
+#if defined(BARRIER_PROFILE) && defined(MULTICORE)
+        if(core_id==0)
+          barrierProfileReset();
+        synch_barrier();
+#endif
+#if defined(DMA_PROFILE) && defined(DMA) && defined(MULTICORE)
+        if(core_id==0)
+          dmaProfileReset();
+        synch_barrier();
+#endif
 
 
 #ifdef PREFETCH_ICACHE
@@ -437,6 +549,41 @@ static int run_networks()
         #endif
     #endif // PRINTF_ACTIVE
 #endif // MODEL14
+
+/////////////////////
+// MODEL CONTAINER //
+/////////////////////
+#ifdef MODEL_CONTAINER
+        m0_OutAct = inferNetwork(containerNetwork, containerDepth, containerIn, buffer);
+    #ifdef PRINTF_ACTIVE
+        #ifdef MULTICORE
+        if ( rt_core_id()==0 )
+        {
+        #endif
+        PrintTensor(containerOutSize, m0_OutAct);
+        PrintTensor(containerOutSize, containerOut);
+        PrintTensorDiff(containerOutSize, m0_OutAct, containerOut);
+        #ifdef MULTICORE
+        }
+        #endif
+    #endif // PRINTF_ACTIVE
+#endif // MODEL_CONTAINER
+
+#ifdef L3_STREAMING
+        m0_OutAct = inferNetworkStreamed(&streamEngine, streamIn);
+    #ifdef PRINTF_ACTIVE
+        #ifdef MULTICORE
+        if ( rt_core_id()==0 )
+        {
+        #endif
+        PrintTensor(streamEngine.header.out_size, m0_OutAct);
+        PrintTensor(streamEngine.header.out_size, streamOut);
+        PrintTensorDiff(streamEngine.header.out_size, m0_OutAct, streamOut);
+        #ifdef MULTICORE
+        }
+        #endif
+    #endif // PRINTF_ACTIVE
+#endif // L3_STREAMING
         }
 
 #endif // PREFETCH_ICACHE
@@ -512,6 +659,10 @@ static int run_networks()
         // int i=0;
         // if(core_id == 0)
         // for(unsigned int i=0; i < 1; i++)
+#ifdef PROFILING_LAYERS
+        layerProfileReset();
+#endif
+
 #ifdef TIMER
         for(unsigned int i=0; i < CSR_PCER_NB_EVENTS+1; i++)
 #else
@@ -526,6 +677,13 @@ static int run_networks()
             perf[core_id].perf_counter_id = i;
             perf[core_id].perf_counters[i] = 0;
             perf_reset();
+#ifdef PROFILING_LAYERS
+            // counter runs freely over the whole inference, layers and kernels record deltas
+            if(i < CSR_PCER_NB_EVENTS)
+            {
+              perf_enable_id(i);
+            }
+#endif
             synch_barrier();
             PROFILING_ALL_START
 
@@ -936,6 +1094,41 @@ static int run_networks()
     #endif // PRINTF_ACTIVE
 #endif // MODEL14
 
+/////////////////////
+// MODEL CONTAINER //
+/////////////////////
+#ifdef MODEL_CONTAINER
+        m0_OutAct = inferNetwork(containerNetwork, containerDepth, containerIn, buffer);
+    #ifdef PRINTF_ACTIVE
+        #ifdef MULTICORE
+        if ( rt_core_id()==0 )
+        {
+        #endif
+        PrintTensor(containerOutSize, m0_OutAct);
+        PrintTensor(containerOutSize, containerOut);
+        PrintTensorDiff(containerOutSize, m0_OutAct, containerOut);
+        #ifdef MULTICORE
+        }
+        #endif
+    #endif // PRINTF_ACTIVE
+#endif // MODEL_CONTAINER
+
+#ifdef L3_STREAMING
+        m0_OutAct = inferNetworkStreamed(&streamEngine, streamIn);
+    #ifdef PRINTF_ACTIVE
+        #ifdef MULTICORE
+        if ( rt_core_id()==0 )
+        {
+        #endif
+        PrintTensor(streamEngine.header.out_size, m0_OutAct);
+        PrintTensor(streamEngine.header.out_size, streamOut);
+        PrintTensorDiff(streamEngine.header.out_size, m0_OutAct, streamOut);
+        #ifdef MULTICORE
+        }
+        #endif
+    #endif // PRINTF_ACTIVE
+#endif // L3_STREAMING
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 // Profiling with OLD RT (Multi Core)
@@ -1098,9 +1291,37 @@ static int run_networks()
         }
     #endif
 
+#ifdef PROFILING_LAYERS
+        synch_barrier();
+        if ( core_id==0 )
+        {
+            layerProfileDump();
+        }
+#endif
+
 #endif // PROFILING_NEW
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+#ifdef AUTOTUNE
+    #ifdef MULTICORE
+        synch_barrier();
+        if ( core_id==0 )
+    #endif
+        tuneDump();
+#endif
+
+#if defined(BARRIER_PROFILE) && defined(MULTICORE)
+        synch_barrier();
+        if ( core_id==0 )
+          barrierProfileDump();
+#endif
+
+#if defined(DMA_PROFILE) && defined(DMA) && defined(MULTICORE)
+        synch_barrier();
+        if ( core_id==0 )
+          dmaProfileDump();
+#endif
+
 
 #ifdef ASIP
 #ifdef PRINTF_ACTIVE
@@ -1117,6 +1338,163 @@ static int run_networks()
 }
 
 
+#ifdef ASYNC_INFERENCE
+/** @brief cluster entry of the asynchronous inference, computes the queued requests until inferQueueStop
+ */
+static int run_queue()
+{
+    inferQueueServe(&inferQueue, buffer);
+    return 0;
+}
+
+/** @brief submits all selected models to the cluster and waits for their callbacks (FC)
+ */
+static int run_async()
+{
+    inferQueueInit(&inferQueue);
+    cluster_start(0, run_queue);
+
+    // the FC is free while the cluster computes, e.g. to prepare the next input
+#ifdef MODEL0
+    SUBMIT_MODEL(0)
+#endif
+#ifdef MODEL1
+    SUBMIT_MODEL(1)
+#endif
+#ifdef MODEL2
+    SUBMIT_MODEL(2)
+#endif
+#ifdef MODEL3
+    SUBMIT_MODEL(3)
+#endif
+#ifdef MODEL4
+    SUBMIT_MODEL(4)
+#endif
+#ifdef MODEL5
+    SUBMIT_MODEL(5)
+#endif
+#ifdef MODEL6
+    SUBMIT_MODEL(6)
+#endif
+#ifdef MODEL7
+    SUBMIT_MODEL(7)
+#endif
+#ifdef MODEL8
+    SUBMIT_MODEL(8)
+#endif
+#ifdef MODEL9
+    SUBMIT_MODEL(9)
+#endif
+#ifdef MODEL10
+    SUBMIT_MODEL(10)
+#endif
+#ifdef MODEL11
+    SUBMIT_MODEL(11)
+#endif
+#ifdef MODEL12
+    SUBMIT_MODEL(12)
+#endif
+#ifdef MODEL13
+    SUBMIT_MODEL(13)
+#endif
+#ifdef MODEL14
+    SUBMIT_MODEL(14)
+#endif
+#ifdef MODEL_CONTAINER
+    // the output of inferNetwork is at most half of the FM buffer
+    SUBMIT_INFERENCE(containerNetwork, containerDepth, containerIn, containerOut, containerOutSize, BUFFER_SIZE2)
+#endif
+
+    inferQueueStop(&inferQueue);
+    int retval = cluster_wait(0);
+    inferPoll(&inferQueue);
+    return retval;
+}
+#endif // ASYNC_INFERENCE
+
+
+#ifdef MULTI_MODEL
+/** @brief runs all selected models concurrently, each on its own group of cluster cores
+ */
+static int run_concurrent()
+{
+    int core_id = CLUSTER_CORE_ID();
+
+    if(core_id == 0)
+    {
+      nrCoreGroups = 0;
+#ifdef MODEL0
+      GROUP_MODEL(0)
+#endif
+#ifdef MODEL1
+      GROUP_MODEL(1)
+#endif
+#ifdef MODEL2
+      GROUP_MODEL(2)
+#endif
+#ifdef MODEL3
+      GROUP_MODEL(3)
+#endif
+#ifdef MODEL4
+      GROUP_MODEL(4)
+#endif
+#ifdef MODEL5
+      GROUP_MODEL(5)
+#endif
+#ifdef MODEL6
+      GROUP_MODEL(6)
+#endif
+#ifdef MODEL7
+      GROUP_MODEL(7)
+#endif
+#ifdef MODEL8
+      GROUP_MODEL(8)
+#endif
+#ifdef MODEL9
+      GROUP_MODEL(9)
+#endif
+#ifdef MODEL10
+      GROUP_MODEL(10)
+#endif
+#ifdef MODEL11
+      GROUP_MODEL(11)
+#endif
+#ifdef MODEL12
+      GROUP_MODEL(12)
+#endif
+#ifdef MODEL13
+      GROUP_MODEL(13)
+#endif
+#ifdef MODEL14
+      GROUP_MODEL(14)
+#endif
+#ifdef MODEL_CONTAINER
+      // the output of inferNetwork is at most half of the FM buffer
+      GROUP_INFERENCE(containerNetwork, containerDepth, containerIn, containerOut, containerOutSize)
+#endif
+      // equal deadlines, the cores are split according to the MACs of the models
+      if(coreGroupsPlan(coreGroups, nrCoreGroups, NR_CORES) < 0)
+        nrCoreGroups = -1;
+    }
+    synch_barrier();
+    if(nrCoreGroups < 0)
+      return 1;
+
+    inferNetworksConcurrent(coreGroups, nrCoreGroups);
+
+#ifdef PRINTF_ACTIVE
+    if(core_id == 0)
+    {
+      for(int g=0; g<nrCoreGroups; g++)
+        PrintTensorDiff(coreGroupOutSize[g], coreGroups[g].outFeatures, coreGroupGolden[g]);
+    }
+#endif
+    synch_barrier();
+    return 0;
+}
+#endif // MULTI_MODEL
+
+
 /** @brief Main function calling the run_networks() function on FC or on the Cluster
  */
 int main()
@@ -1126,6 +1504,33 @@ int main()
     printf("Entering main controller core %d\n", get_core_id());
 #endif
 
+#ifdef MODEL_CONTAINER
+    containerDepth = loadModelContainer(modelImage, modelImageEnd-modelImage, containerNetwork, MODEL_CONTAINER_MAX_DEPTH,
+                                        &containerIn, &containerOut, &containerOutSize);
+    if(containerDepth < 0)
+      return 1;
+#endif
+
+#ifdef L3_STREAMING
+    struct pi_hyperram_conf l3Conf;
+    pi_hyperram_conf_init(&l3Conf);
+    pi_open_from_conf(&l3Ram, &l3Conf);
+    if(pi_ram_open(&l3Ram))
+    {
+      printf("\033[91mERROR - cannot open the HyperRAM!!!\033[0m\n");
+      return 1;
+    }
+#endif
+
+#ifdef ASYNC_INFERENCE
+    return run_async();
+#endif
+
+#ifdef MULTI_MODEL
+    cluster_start(0, run_concurrent);
+    return cluster_wait(0);
+#endif
+
 // multicore implementation
 #ifdef MULTICORE
     cluster_start(0, run_networks);